@@ -0,0 +1,590 @@
+// sysinfo_agg: fleet inventory from a directory of `sysinfo --format=bin`
+// reports, one file per machine.
+//
+//   sysinfo_agg [--jobs <n>] [--top <n>] [--format=text|json] <dir>...
+//
+// Every report is memory-mapped and walked with scanBinReport(), so the
+// only strings copied are the distinct keys of the tallies. Files are
+// dealt to per-thread queues and idle threads steal from the others; each
+// thread aggregates into its own tallies, which are merged once at the end.
+// The output counts machines by CPU model and BIOS version, drives by
+// model, sums installed RAM, and lists machines whose RAM, disk capacity
+// or thread count is far from the fleet median, plus reports that couldn't
+// be read or whose CPU, memory, disk or BIOS queries were cut short.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "report_bin.h"
+#include "report_json.h"
+
+namespace {
+
+// Robust z-score above which a machine is an outlier (Iglewicz and Hoaglin).
+const double kOutlierZ = 3.5;
+const uint64_t kGiB = uint64_t(1) << 30;
+
+struct StrRefHash {
+    size_t operator()(const StrRef& s) const {
+        uint64_t h = 14695981039346656037ull; // FNV-1a
+        for (uint32_t k = 0; k < s.n; ++k) h = (h ^ static_cast<unsigned char>(s.p[k])) * 1099511628211ull;
+        return static_cast<size_t>(h);
+    }
+};
+
+struct StrRefEq {
+    bool operator()(const StrRef& a, const StrRef& b) const {
+        return a.n == b.n && std::memcmp(a.p, b.p, a.n) == 0;
+    }
+};
+
+StrRef trimmed(StrRef s) {
+    while (s.n && (*s.p == ' ' || *s.p == '\t')) ++s.p, --s.n;
+    while (s.n && (s.p[s.n - 1] == ' ' || s.p[s.n - 1] == '\t')) --s.n;
+    return s;
+}
+
+// Counts per string key. Lookups hash the caller's bytes in place; only a
+// key seen for the first time is copied, into the tally's own arena.
+class Tally {
+public:
+    void add(StrRef key, uint64_t n) {
+        std::unordered_map<StrRef, uint64_t, StrRefHash, StrRefEq>::iterator it = m_counts.find(key);
+        if (it != m_counts.end()) {
+            it->second += n;
+            return;
+        }
+        StrRef own = { m_arena.copy(key.p, key.n), key.n };
+        m_counts.insert(std::make_pair(own, n));
+    }
+
+    void merge(const Tally& other) {
+        for (std::unordered_map<StrRef, uint64_t, StrRefHash, StrRefEq>::const_iterator it = other.m_counts.begin();
+             it != other.m_counts.end(); ++it) {
+            add(it->first, it->second);
+        }
+    }
+
+    // Largest counts first, ties by key.
+    std::vector<std::pair<StrRef, uint64_t> > sorted() const {
+        std::vector<std::pair<StrRef, uint64_t> > out(m_counts.begin(), m_counts.end());
+        std::sort(out.begin(), out.end(), [](const std::pair<StrRef, uint64_t>& a, const std::pair<StrRef, uint64_t>& b) {
+            if (a.second != b.second) return a.second > b.second;
+            const int c = std::memcmp(a.first.p, b.first.p, std::min(a.first.n, b.first.n));
+            return c != 0 ? c < 0 : a.first.n < b.first.n;
+        });
+        return out;
+    }
+
+private:
+    Arena m_arena;
+    std::unordered_map<StrRef, uint64_t, StrRefHash, StrRefEq> m_counts;
+};
+
+// What one report says about its machine.
+struct Machine {
+    size_t file;
+    uint64_t ramBytes;
+    uint64_t diskBytes;
+    uint64_t threads; // logical processors
+    bool partial;     // some query timed out or was cancelled
+};
+
+struct Failure {
+    size_t file;
+    std::string error;
+};
+
+// One worker's share of the result; merged after all workers are done.
+struct Aggregate {
+    Aggregate() : bytes(0) {}
+    Tally cpuModels;  // machines
+    Tally diskModels; // drives
+    Tally bios;       // machines
+    std::map<uint64_t, uint64_t> ramGiB; // machines by installed GiB
+    std::vector<Machine> machines;
+    std::vector<Failure> failures;
+    uint64_t bytes;
+
+    void merge(const Aggregate& other) {
+        cpuModels.merge(other.cpuModels);
+        diskModels.merge(other.diskModels);
+        bios.merge(other.bios);
+        for (std::map<uint64_t, uint64_t>::const_iterator it = other.ramGiB.begin(); it != other.ramGiB.end(); ++it) {
+            ramGiB[it->first] += it->second;
+        }
+        machines.insert(machines.end(), other.machines.begin(), other.machines.end());
+        failures.insert(failures.end(), other.failures.begin(), other.failures.end());
+        bytes += other.bytes;
+    }
+};
+
+bool is(StrRef s, const char* text) {
+    return s.n == std::strlen(text) && std::memcmp(s.p, text, s.n) == 0;
+}
+
+// Picks the few properties the aggregate needs out of one report.
+class ReportScanner : public BinReportVisitor {
+public:
+    explicit ReportScanner(Aggregate& agg)
+        : m_agg(agg), m_query(Other), m_colA(-1), m_colB(-1), m_rowOpen(false), m_a(), m_b() {}
+
+    // Scans one mapped report into the aggregate. A corrupt report counts
+    // as a failure only, not as a machine.
+    void scan(size_t file, const unsigned char* data, size_t len) {
+        m_machine.file = file;
+        m_machine.ramBytes = 0;
+        m_machine.diskBytes = 0;
+        m_machine.threads = 0;
+        m_machine.partial = false;
+        m_cpus.clear();
+        m_disks.clear();
+        m_rowOpen = false;
+        m_biosMaker.n = m_biosVersion.n = 0;
+        std::string error;
+        if (!scanBinReport(data, len, *this, error)) {
+            Failure f = { file, error };
+            m_agg.failures.push_back(f);
+            return;
+        }
+        flushRow();
+        // Several sockets with the same model count the machine once.
+        std::sort(m_cpus.begin(), m_cpus.end(), [](const StrRef& a, const StrRef& b) {
+            const int c = std::memcmp(a.p, b.p, std::min(a.n, b.n));
+            return c != 0 ? c < 0 : a.n < b.n;
+        });
+        m_cpus.erase(std::unique(m_cpus.begin(), m_cpus.end(), StrRefEq()), m_cpus.end());
+        for (size_t k = 0; k < m_cpus.size(); ++k) m_agg.cpuModels.add(m_cpus[k], 1);
+        for (size_t k = 0; k < m_disks.size(); ++k) m_agg.diskModels.add(m_disks[k], 1);
+        if (m_biosMaker.n || m_biosVersion.n) {
+            m_key.assign(m_biosMaker.p, m_biosMaker.n);
+            m_key += ' ';
+            m_key.append(m_biosVersion.p, m_biosVersion.n);
+            StrRef key = { m_key.data(), static_cast<uint32_t>(m_key.size()) };
+            m_agg.bios.add(key, 1);
+        }
+        m_agg.ramGiB[(m_machine.ramBytes + kGiB / 2) / kGiB] += 1;
+        m_agg.machines.push_back(m_machine);
+        m_agg.bytes += len;
+    }
+
+    bool section(StrRef id) {
+        return is(id, "cpu") || is(id, "memory") || is(id, "disk") || is(id, "bios");
+    }
+
+    bool query(StrRef cls, QueryStatus status, const std::vector<StrRef>& columns) {
+        flushRow();
+        if (status != QueryStatus::Complete) m_machine.partial = true;
+        m_query = is(cls, "Win32_Processor") ? Processor
+                : is(cls, "Win32_PhysicalMemory") ? Memory
+                : is(cls, "Win32_DiskDrive") ? DiskDrive
+                : is(cls, "Win32_BIOS") ? Bios
+                : Other;
+        m_colA = m_colB = -1;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const StrRef& name = columns[c];
+            const int col = static_cast<int>(c);
+            switch (m_query) {
+            case Processor:
+                if (is(name, "Name")) m_colA = col;
+                else if (is(name, "NumberOfLogicalProcessors")) m_colB = col;
+                break;
+            case Memory:
+                if (is(name, "Capacity")) m_colA = col;
+                break;
+            case DiskDrive:
+                if (is(name, "Model")) m_colA = col;
+                else if (is(name, "Size")) m_colB = col;
+                break;
+            case Bios:
+                if (is(name, "Manufacturer")) m_colA = col;
+                else if (is(name, "SMBIOSBIOSVersion")) m_colB = col;
+                break;
+            default:
+                break;
+            }
+        }
+        return m_query != Other && (m_colA >= 0 || m_colB >= 0);
+    }
+
+    void row() {
+        flushRow();
+        m_rowOpen = true;
+    }
+
+    void cell(size_t column, const Value& v) {
+        const int col = static_cast<int>(column);
+        if (col == m_colA) m_a = v;
+        else if (col == m_colB) m_b = v;
+    }
+
+private:
+    enum QueryKind { Other, Processor, Memory, DiskDrive, Bios };
+
+    // Rows are only complete once the next one starts, so each is folded
+    // in lazily.
+    void flushRow() {
+        if (!m_rowOpen) return;
+        m_rowOpen = false;
+        switch (m_query) {
+        case Processor:
+            if (m_a.type == ValueType::String) {
+                StrRef name = trimmed(m_a.s);
+                if (name.n) m_cpus.push_back(name);
+            }
+            m_machine.threads += m_b.asUint();
+            break;
+        case Memory:
+            m_machine.ramBytes += m_a.asUint();
+            break;
+        case DiskDrive:
+            if (m_a.type == ValueType::String) {
+                StrRef model = trimmed(m_a.s);
+                if (model.n) m_disks.push_back(model);
+            }
+            m_machine.diskBytes += m_b.asUint();
+            break;
+        case Bios:
+            if (m_a.type == ValueType::String) m_biosMaker = trimmed(m_a.s);
+            if (m_b.type == ValueType::String) m_biosVersion = trimmed(m_b.s);
+            break;
+        default:
+            break;
+        }
+        m_a = Value();
+        m_b = Value();
+    }
+
+    Aggregate& m_agg;
+    Machine m_machine;
+    std::vector<StrRef> m_cpus;  // into the current mapping
+    std::vector<StrRef> m_disks; // likewise
+    StrRef m_biosMaker;
+    StrRef m_biosVersion;
+    std::string m_key;
+    QueryKind m_query;
+    int m_colA, m_colB;
+    bool m_rowOpen;
+    Value m_a, m_b;
+};
+
+// A worker's file indices. The owner takes from the back, thieves from
+// the front, so they rarely contend for the same end.
+class StealQueue {
+public:
+    void push(size_t file) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_files.push_back(file);
+    }
+    bool pop(size_t& file) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_files.empty()) return false;
+        file = m_files.back();
+        m_files.pop_back();
+        return true;
+    }
+    bool steal(size_t& file) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_files.empty()) return false;
+        file = m_files.front();
+        m_files.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<size_t> m_files;
+};
+
+// Scans every file into one aggregate per worker and merges them.
+Aggregate aggregate(const std::vector<std::string>& files, unsigned jobs) {
+    // Contiguous runs keep each worker in one directory; stealing evens
+    // out the slow ones.
+    std::vector<StealQueue> queues(jobs);
+    for (size_t f = 0; f < files.size(); ++f) queues[f * jobs / files.size()].push(f);
+
+    std::vector<Aggregate> parts(jobs);
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < jobs; ++w) {
+        threads.push_back(std::thread([&, w]() {
+            ReportScanner scanner(parts[w]);
+            MappedFile file;
+            for (;;) {
+                size_t f;
+                bool found = queues[w].pop(f);
+                for (unsigned k = 1; !found && k < jobs; ++k) found = queues[(w + k) % jobs].steal(f);
+                if (!found) return; // nothing is queued after the start
+                if (!file.open(files[f])) {
+                    Failure fail = { f, "could not open" };
+                    parts[w].failures.push_back(fail);
+                    continue;
+                }
+                file.adviseSequential();
+                scanner.scan(f, file.data(), file.size());
+                file.close();
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    for (unsigned w = 1; w < jobs; ++w) parts[0].merge(parts[w]);
+    return std::move(parts[0]);
+}
+
+// Median and scaled median absolute deviation of one metric.
+struct Spread {
+    double median;
+    double mad;
+};
+
+Spread spread(std::vector<double> v) {
+    Spread s = { 0, 0 };
+    if (v.empty()) return s;
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    s.median = v[v.size() / 2];
+    for (size_t k = 0; k < v.size(); ++k) v[k] = std::fabs(v[k] - s.median);
+    std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+    // A uniform fleet has no spread; 1% of the median keeps the z-score
+    // finite and ignores rounding noise.
+    s.mad = std::max(v[v.size() / 2], s.median * 0.01);
+    return s;
+}
+
+struct Outlier {
+    size_t machine;
+    const char* metric;
+    double value;
+    double median;
+    double z;
+};
+
+std::vector<Outlier> findOutliers(const std::vector<Machine>& machines) {
+    struct Metric {
+        const char* name;
+        double (*get)(const Machine&);
+    };
+    static const Metric kMetrics[] = {
+        { "ram_gib", [](const Machine& m) { return static_cast<double>(m.ramBytes) / kGiB; } },
+        { "disk_gib", [](const Machine& m) { return static_cast<double>(m.diskBytes) / kGiB; } },
+        { "threads", [](const Machine& m) { return static_cast<double>(m.threads); } },
+    };
+    std::vector<Outlier> out;
+    for (size_t k = 0; k < sizeof(kMetrics) / sizeof(kMetrics[0]); ++k) {
+        std::vector<double> values(machines.size());
+        for (size_t m = 0; m < machines.size(); ++m) values[m] = kMetrics[k].get(machines[m]);
+        const Spread s = spread(values);
+        if (s.mad <= 0) continue;
+        for (size_t m = 0; m < machines.size(); ++m) {
+            const double z = 0.6745 * (values[m] - s.median) / s.mad;
+            if (std::fabs(z) <= kOutlierZ) continue;
+            Outlier o = { m, kMetrics[k].name, values[m], s.median, z };
+            out.push_back(o);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const Outlier& a, const Outlier& b) { return std::fabs(a.z) > std::fabs(b.z); });
+    return out;
+}
+
+void printTally(const char* title, const Tally& tally, size_t top) {
+    const std::vector<std::pair<StrRef, uint64_t> > rows = tally.sorted();
+    std::printf("\n%s:\n", title);
+    for (size_t k = 0; k < rows.size() && k < top; ++k) {
+        std::printf("  %8llu  %.*s\n", static_cast<unsigned long long>(rows[k].second), static_cast<int>(rows[k].first.n),
+                    rows[k].first.p);
+    }
+    if (rows.size() > top) std::printf("  ... %llu more\n", static_cast<unsigned long long>(rows.size() - top));
+}
+
+void jsonTally(JsonWriter& w, const char* key, const Tally& tally, size_t top) {
+    const std::vector<std::pair<StrRef, uint64_t> > rows = tally.sorted();
+    w.key(key);
+    w.beginArray();
+    for (size_t k = 0; k < rows.size() && k < top; ++k) {
+        w.beginObject();
+        w.key("name");
+        w.string(rows[k].first.p, rows[k].first.n);
+        w.key("count");
+        w.u64(rows[k].second);
+        w.endObject();
+    }
+    w.endArray();
+}
+
+void printText(const Aggregate& agg, const std::vector<std::string>& files, const std::vector<Outlier>& outliers,
+               size_t top) {
+    uint64_t ramTotal = 0;
+    size_t partial = 0;
+    for (size_t m = 0; m < agg.machines.size(); ++m) {
+        ramTotal += agg.machines[m].ramBytes;
+        if (agg.machines[m].partial) ++partial;
+    }
+    std::printf("Machines: %llu (%llu reports unreadable, %llu incomplete)\n",
+                static_cast<unsigned long long>(agg.machines.size()), static_cast<unsigned long long>(agg.failures.size()),
+                static_cast<unsigned long long>(partial));
+    printTally("CPU models (machines)", agg.cpuModels, top);
+
+    std::printf("\nInstalled RAM (machines):\n");
+    for (std::map<uint64_t, uint64_t>::const_iterator it = agg.ramGiB.begin(); it != agg.ramGiB.end(); ++it) {
+        std::printf("  %8llu  %llu GiB\n", static_cast<unsigned long long>(it->second), static_cast<unsigned long long>(it->first));
+    }
+    std::printf("  Total %.2f TiB, mean %.2f GiB per machine\n", static_cast<double>(ramTotal) / kGiB / 1024,
+                agg.machines.empty() ? 0.0 : static_cast<double>(ramTotal) / kGiB / agg.machines.size());
+
+    printTally("Disk models (drives)", agg.diskModels, top);
+    printTally("BIOS versions (machines)", agg.bios, top);
+
+    std::printf("\nOutliers (robust z > %.1f):\n", kOutlierZ);
+    for (size_t k = 0; k < outliers.size() && k < top; ++k) {
+        const Outlier& o = outliers[k];
+        std::printf("  %-10s %10.2f (median %.2f, z %+.1f)  %s\n", o.metric, o.value, o.median, o.z,
+                    files[agg.machines[o.machine].file].c_str());
+    }
+    if (outliers.size() > top) std::printf("  ... %llu more\n", static_cast<unsigned long long>(outliers.size() - top));
+
+    if (partial) {
+        std::printf("\nIncomplete reports:\n");
+        for (size_t m = 0, shown = 0; m < agg.machines.size() && shown < top; ++m) {
+            if (!agg.machines[m].partial) continue;
+            std::printf("  %s\n", files[agg.machines[m].file].c_str());
+            ++shown;
+        }
+    }
+    if (!agg.failures.empty()) {
+        std::printf("\nUnreadable reports:\n");
+        for (size_t k = 0; k < agg.failures.size() && k < top; ++k) {
+            std::printf("  %s: %s\n", files[agg.failures[k].file].c_str(), agg.failures[k].error.c_str());
+        }
+    }
+}
+
+void printJson(const Aggregate& agg, const std::vector<std::string>& files, const std::vector<Outlier>& outliers,
+               size_t top) {
+    JsonWriter w;
+    uint64_t ramTotal = 0;
+    for (size_t m = 0; m < agg.machines.size(); ++m) ramTotal += agg.machines[m].ramBytes;
+    w.beginObject();
+    w.key("machines");
+    w.u64(agg.machines.size());
+    w.key("unreadable");
+    w.u64(agg.failures.size());
+    jsonTally(w, "cpu_models", agg.cpuModels, top);
+    w.key("ram_total_bytes");
+    w.u64(ramTotal);
+    w.key("ram_gib");
+    w.beginArray();
+    for (std::map<uint64_t, uint64_t>::const_iterator it = agg.ramGiB.begin(); it != agg.ramGiB.end(); ++it) {
+        w.beginObject();
+        w.key("gib");
+        w.u64(it->first);
+        w.key("machines");
+        w.u64(it->second);
+        w.endObject();
+    }
+    w.endArray();
+    jsonTally(w, "disk_models", agg.diskModels, top);
+    jsonTally(w, "bios_versions", agg.bios, top);
+    w.key("outliers");
+    w.beginArray();
+    for (size_t k = 0; k < outliers.size() && k < top; ++k) {
+        const Outlier& o = outliers[k];
+        w.beginObject();
+        w.key("file");
+        w.string(files[agg.machines[o.machine].file].c_str());
+        w.key("metric");
+        w.string(o.metric);
+        w.key("value");
+        w.fixed(o.value, 2);
+        w.key("median");
+        w.fixed(o.median, 2);
+        w.key("z");
+        w.i64(static_cast<int64_t>(std::floor(o.z + 0.5)));
+        w.endObject();
+    }
+    w.endArray();
+    w.key("incomplete");
+    w.beginArray();
+    for (size_t m = 0; m < agg.machines.size(); ++m) {
+        if (agg.machines[m].partial) w.string(files[agg.machines[m].file].c_str());
+    }
+    w.endArray();
+    w.key("failures");
+    w.beginArray();
+    for (size_t k = 0; k < agg.failures.size(); ++k) {
+        w.beginObject();
+        w.key("file");
+        w.string(files[agg.failures[k].file].c_str());
+        w.key("error");
+        w.string(agg.failures[k].error.c_str());
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    w.newline();
+    std::fwrite(w.buffer().data(), 1, w.buffer().size(), stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    unsigned jobs = std::thread::hardware_concurrency();
+    size_t top = 20;
+    bool json = false;
+    std::vector<std::string> dirs;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::strtoul(argv[++i], NULL, 10));
+        } else if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = std::strtoul(argv[++i], NULL, 10);
+        } else if (std::strcmp(argv[i], "--format=text") == 0) {
+            json = false;
+        } else if (std::strcmp(argv[i], "--format=json") == 0) {
+            json = true;
+        } else if (argv[i][0] != '-') {
+            dirs.push_back(argv[i]);
+        } else {
+            dirs.clear();
+            break;
+        }
+    }
+    if (dirs.empty()) {
+        std::fprintf(stderr, "Usage: sysinfo_agg [--jobs <n>] [--top <n>] [--format=text|json] <dir>...\n"
+                             "  Aggregates a directory tree of `sysinfo --format=bin` reports.\n");
+        return 2;
+    }
+    if (jobs == 0) jobs = 1;
+
+    std::vector<std::string> files;
+    for (size_t d = 0; d < dirs.size(); ++d) {
+        if (!listFiles(dirs[d], files)) {
+            std::fprintf(stderr, "Could not read directory %s\n", dirs[d].c_str());
+            return 1;
+        }
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const Aggregate agg = aggregate(files, jobs);
+    const std::vector<Outlier> outliers = findOutliers(agg.machines);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::fprintf(stderr, "Scanned %llu files, %.1f MB in %.2f s (%.0f MB/s) on %u threads\n",
+                 static_cast<unsigned long long>(files.size()), agg.bytes / 1e6, seconds,
+                 seconds > 0 ? agg.bytes / 1e6 / seconds : 0.0, jobs);
+
+    if (json) {
+        printJson(agg, files, outliers, top);
+    } else {
+        printText(agg, files, outliers, top);
+    }
+    return 0;
+}
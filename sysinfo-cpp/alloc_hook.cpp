@@ -0,0 +1,32 @@
+// Counts C++ heap allocations per thread for --profile. Linked into the
+// sysinfo executable only: tools with their own operator new (the bench)
+// must not get a second definition.
+
+#include <cstdlib>
+#include <new>
+
+#include "profile.h"
+
+namespace {
+
+void* countedAlloc(size_t n) {
+    ++t_heapAllocs;
+    void* p = std::malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+} // namespace
+
+void* operator new(size_t n) { return countedAlloc(n); }
+void* operator new[](size_t n) { return countedAlloc(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(n); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(n); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
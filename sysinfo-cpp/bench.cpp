@@ -0,0 +1,811 @@
+// sysinfo_bench: micro-benchmarks of the collection, conversion and
+// rendering paths, replayed from fixtures so they run anywhere.
+//
+//   sysinfo_bench [--fixture <file>]... [--filter <text>] [--min-time <ms>]
+//   sysinfo_bench --write-proc-tree <dir>
+//
+// Without --fixture it runs the recorded Windows desktop from fixtures/
+// plus a synthetic machine with 500 disks, 2000 partitions and 5000 PnP
+// entities; the enum_batch benchmarks replay a simulated WMI provider at
+// several --batch sizes; the sample benchmarks read this machine's live
+// counters, as the --utilization sampler does on every tick; the history
+// benchmarks record and query a simulated week of --watch ticks; the
+// process benchmarks scan a generated /proc tree of 50,000 processes
+// (Linux) and summarize the result; --write-proc-tree leaves such a tree
+// behind for `sysinfo --proc-root`; the device benchmarks poll 5000 PnP
+// entities with and without the device table and replay hotplug events
+// through it. Output is one JSON document on stdout
+// with a line per benchmark, in a fixed order, so CI can diff runs:
+//
+//   {"schema":1,"benchmarks":[
+//   {"name":"render_text/win11-desktop","iterations":2048,"ns_per_op":...,
+//    "allocs_per_op":...,"bytes_per_op":...,"items_per_op":...},
+//   ...
+//   ]}
+//
+// ns_per_op is the fastest of several timed batches; allocation counts come
+// from replacing the global operator new and are exact.
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+#include "devices.h"
+#include "diff.h"
+#include "enumerate.h"
+#include "fixture_source.h"
+#include "history.h"
+#include "metrics.h"
+#include "processes.h"
+#include "report_json.h"
+#include "sampler.h"
+#include "schema.h"
+#include "sections.h"
+#include "session.h"
+#include "sysinfo_c.h"
+#include "storage.h"
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "linux_source.h"
+#endif
+
+#ifndef SYSINFO_FIXTURE_DIR
+#define SYSINFO_FIXTURE_DIR "fixtures"
+#endif
+
+namespace {
+
+std::atomic<uint64_t> g_allocs(0);
+std::atomic<uint64_t> g_allocBytes(0);
+
+void* countedAlloc(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(n, std::memory_order_relaxed);
+    void* p = std::malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+} // namespace
+
+void* operator new(size_t n) { return countedAlloc(n); }
+void* operator new[](size_t n) { return countedAlloc(n); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(n); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(n); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Discards everything, so rendering is measured without console I/O.
+class NullWideBuf : public std::wstreambuf {
+protected:
+    int_type overflow(int_type c) { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const wchar_t*, std::streamsize n) { return n; }
+};
+
+// Keeps results observable so the optimiser can't drop the work.
+volatile uint64_t g_sink = 0;
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+    uint64_t itemsPerOp;
+};
+
+struct Options {
+    std::vector<std::string> fixtures;
+    std::string filter;
+    unsigned minTimeMs;
+};
+
+// Runs fn() in batches: the batch size doubles until a batch takes at
+// least minTime/5, then five batches are timed and the fastest counts.
+template <class Fn>
+Result measure(const std::string& name, uint64_t itemsPerOp, const Options& opt, Fn fn) {
+    typedef std::chrono::steady_clock Clock;
+    const double batchNs = opt.minTimeMs * 1e6 / 5;
+    fn(); // warm up caches and lazily built state
+
+    uint64_t batch = 1;
+    for (;;) {
+        Clock::time_point t0 = Clock::now();
+        for (uint64_t k = 0; k < batch; ++k) fn();
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+        if (ns >= batchNs || batch >= (uint64_t(1) << 30)) break;
+        batch *= 2;
+    }
+
+    Result r;
+    r.name = name;
+    r.iterations = 0;
+    r.nsPerOp = 0;
+    r.itemsPerOp = itemsPerOp;
+    const uint64_t allocs0 = g_allocs.load(), bytes0 = g_allocBytes.load();
+    for (int round = 0; round < 5; ++round) {
+        Clock::time_point t0 = Clock::now();
+        for (uint64_t k = 0; k < batch; ++k) fn();
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+        double perOp = ns / static_cast<double>(batch);
+        if (round == 0 || perOp < r.nsPerOp) r.nsPerOp = perOp;
+        r.iterations += batch;
+    }
+    r.allocsPerOp = static_cast<double>(g_allocs.load() - allocs0) / static_cast<double>(r.iterations);
+    r.bytesPerOp = static_cast<double>(g_allocBytes.load() - bytes0) / static_cast<double>(r.iterations);
+    return r;
+}
+
+// Fixture text for a large machine: `disks` drives with `partitions`
+// spread evenly over them, one logical disk mapped to each partition, `pnp` USB
+// devices. Values are deterministic so runs are comparable.
+std::string syntheticFixture(unsigned disks, unsigned partitions, unsigned pnp) {
+    std::string f;
+    char buf[512];
+    f += "[Win32_OperatingSystem]\n"
+         "Caption=Microsoft Windows Server 2022 Datacenter\nVersion=10.0.20348\nBuildNumber=20348\n"
+         "OSArchitecture=64-bit\nSerialNumber=00454-60000-00001-AA000\nInstallDate=20230105093000.000000+000\n"
+         "LastBootUpTime=20240401080000.500000+000\nRegisteredUser=Storage Lab\nOrganization=Example Corp\n"
+         "BootDevice=\\Device\\HarddiskVolume1\nWindowsDirectory=C:\\Windows\nSystemDirectory=C:\\Windows\\system32\n"
+         "Locale=0409\nOSLanguage:u64=1033\nCountryCode=1\nTotalVisibleMemorySize:u64=1073217536\n"
+         "FreePhysicalMemory:u64=802811904\n";
+    f += "\n[Win32_Processor]\n";
+    for (unsigned k = 0; k < 2; ++k) {
+        if (k) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "Name=AMD EPYC 9654 96-Core Processor\nNumberOfCores:u64=96\nNumberOfLogicalProcessors:u64=192\n"
+                      "MaxClockSpeed:u64=2400\nManufacturer=AuthenticAMD\nProcessorId=178BFBFF00A10F11\n"
+                      "SocketDesignation=CPU%u\nL2CacheSize:u64=98304\nL3CacheSize:u64=393216\n"
+                      "VirtualizationFirmwareEnabled:bool=True\n", k);
+        f += buf;
+    }
+    f += "\n[Win32_PhysicalMemory]\n";
+    for (unsigned k = 0; k < 24; ++k) {
+        if (k) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "BankLabel=P%u CHANNEL %c\nCapacity:u64=68719476736\nSpeed:u64=4800\nManufacturer=Samsung\n"
+                      "SerialNumber=%08X\nPartNumber=M321R8GA0BB0-CQKZJ\nMemoryType:u64=34\nFormFactor:u64=8\n",
+                      k / 12, 'A' + k % 12, 0x4E000000u + k);
+        f += buf;
+    }
+    f += "\n[Win32_VideoController]\n"
+         "Name=Matrox G200eH3 (Microsoft Corporation - WDDM)\nDriverVersion=10.0.20348.1\nAdapterRAM:u64=16777216\n"
+         "VideoProcessor=Matrox G200eH3\nPNPDeviceID=PCI\\VEN_102B&DEV_0538\\4&1A2B3C4D&0&00E0\nStatus=OK\n"
+         "CurrentHorizontalResolution:u64=1024\nCurrentVerticalResolution:u64=768\nCurrentRefreshRate:u64=60\n";
+
+    f += "\n[Win32_DiskDrive]\n";
+    for (unsigned d = 0; d < disks; ++d) {
+        if (d) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "Model=SEAGATE ST18000NM004J\nSerialNumber=ZR5%05u\nFirmwareRevision=E004\nInterfaceType=SCSI\n"
+                      "MediaType=Fixed hard disk media\nSize:u64=18000207937536\nIndex:u64=%u\nPartitions:u64=%u\n"
+                      "Status=OK\nPNPDeviceID=SCSI\\DISK&VEN_SEAGATE&PROD_ST18000NM004J\\5&%X&0&%06u\n",
+                      d, d, partitions / disks + (d < partitions % disks ? 1 : 0), 0x2000u + d, d);
+        f += buf;
+    }
+    f += "\n[Win32_DiskPartition]\n";
+    for (unsigned p = 0; p < partitions; ++p) {
+        if (p) f += "--\n";
+        // Interleaved across disks, so a join can't rely on row order.
+        const unsigned disk = p % disks, number = p / disks;
+        std::snprintf(buf, sizeof(buf),
+                      "DeviceID=Disk #%u, Partition #%u\nDiskIndex:u64=%u\nName=Disk #%u, Partition #%u\n"
+                      "Size:u64=4398046511104\nType=GPT: Basic Data\nBootable:bool=False\nBootPartition:bool=False\n"
+                      "StartingOffset:u64=%llu\n",
+                      disk, number, disk, disk, number, 16777216ULL + number * 4398046511104ULL);
+        f += buf;
+    }
+    f += "\n[Win32_LogicalDisk]\n";
+    for (unsigned p = 0; p < partitions; ++p) {
+        if (p) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "DeviceID=C:\\Mounts\\vol%04u\nVolumeName=data%04u\nFileSystem=ReFS\nFreeSpace:u64=%llu\n"
+                      "Size:u64=4398046511104\n",
+                      p, p, 1099511627776ULL + p * 1048576ULL);
+        f += buf;
+    }
+    f += "\n[Win32_LogicalDiskToPartition]\n";
+    for (unsigned p = 0; p < partitions; ++p) {
+        if (p) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "Antecedent=\\\\BENCH\\root\\cimv2:Win32_DiskPartition.DeviceID=\"Disk #%u, Partition #%u\"\n"
+                      "Dependent=\\\\BENCH\\root\\cimv2:Win32_LogicalDisk.DeviceID=\"C:\\\\Mounts\\\\vol%04u\"\n",
+                      p % disks, p / disks, p);
+        f += buf;
+    }
+    f += "\n[Win32_BaseBoard]\nManufacturer=Supermicro\nProduct=H13DSH\nSerialNumber=OM231S600123\nVersion=1.01\n";
+    f += "\n[Win32_BIOS]\nManufacturer=American Megatrends International, LLC.\nSMBIOSBIOSVersion=1.5a\n"
+         "ReleaseDate=20231116000000.000000+000\nSerialNumber=S123456X3C01234\nVersion=SMCI   - 10000\n";
+    f += "\n[Win32_ComputerSystemProduct]\nUUID=3E1F0C00-8A4B-11EE-8000-3CECEF123456\n";
+    f += "\n[Win32_Tpm]\nSpecVersion=2.0, 0, 1.59\nManufacturerID:u64=1095582720\nManufacturerVersion=5.63.3144.0\n"
+         "IsEnabled_InitialValue:bool=True\nIsActivated_InitialValue:bool=True\nPhysicalPresenceVersionInfo=1.3\n";
+    f += "\n[Win32_SoundDevice]\n";
+    f += "\n[Win32_PnPEntity]\n";
+    for (unsigned k = 0; k < pnp; ++k) {
+        if (k) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "Name=USB Mass Storage Device\nDeviceID=USB\\VID_0781&PID_%04X\\%08u\n"
+                      "PNPDeviceID=USB\\VID_0781&PID_%04X\\%08u\nDescription=USB Mass Storage Device\nStatus=OK\n"
+                      "Manufacturer=Compatible USB storage device\n",
+                      0x5500 + k % 64, k, 0x5500 + k % 64, k);
+        f += buf;
+    }
+    f += "\n[Win32_NetworkAdapter]\n";
+    for (unsigned k = 0; k < 8; ++k) {
+        if (k) f += "--\n";
+        std::snprintf(buf, sizeof(buf),
+                      "Name=Mellanox ConnectX-6 Dx Adapter #%u\nMACAddress=0C:42:A1:00:00:%02X\nAdapterType=Ethernet 802.3\n"
+                      "Speed:u64=100000000000\nManufacturer=Mellanox\nNetConnectionStatus:u64=2\n"
+                      "PNPDeviceID=PCI\\VEN_15B3&DEV_101D\\%u\nNetEnabled:bool=True\n",
+                      k, k, k);
+        f += buf;
+    }
+    return f;
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+// Every query of every section, as the collector would run them.
+std::vector<std::vector<ResultSet> > materialize(FixtureSource& src, const std::vector<SectionDef>& sections) {
+    std::vector<std::vector<ResultSet> > all(sections.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        for (size_t q = 0; q < sections[i].queries.size(); ++q) all[i].push_back(src.query(sections[i].queries[q]));
+    }
+    return all;
+}
+
+void benchFixture(const std::string& label, FixtureSource& src, const Options& opt, std::vector<Result>& out) {
+    const std::vector<SectionDef>& sections = allSections();
+    const std::vector<std::vector<ResultSet> > data = materialize(src, sections);
+
+    uint64_t rows = 0, cells = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        for (size_t q = 0; q < data[i].size(); ++q) {
+            rows += data[i][q].rowCount();
+            cells += data[i][q].rowCount() * data[i][q].columnCount();
+        }
+    }
+    size_t diskSection = 0;
+    while (diskSection < sections.size() && std::strcmp(sections[diskSection].id, "disk") != 0) ++diskSection;
+    const ResultSet& disks = data[diskSection][0];
+    const ResultSet& parts = data[diskSection][1];
+    const ResultSet& logics = data[diskSection][2];
+    const ResultSet& links = data[diskSection][3];
+
+    const auto wanted = [&](const char* name) {
+        return opt.filter.empty() || (std::string(name) + "/" + label).find(opt.filter) != std::string::npos;
+    };
+
+    // Row materialisation: projecting every query's rows into fresh
+    // ResultSets, the same work the WMI ingest does per property.
+    if (wanted("materialize")) {
+        out.push_back(measure("materialize/" + label, rows, opt, [&]() {
+            std::vector<std::vector<ResultSet> > r = materialize(src, sections);
+            g_sink = g_sink + r.size();
+        }));
+    }
+    // One op = one cell.
+    if (wanted("safe_get")) {
+        Result r = measure("safe_get/" + label, 1, opt, [&]() {
+            uint64_t n = 0;
+            for (size_t i = 0; i < data.size(); ++i)
+                for (size_t q = 0; q < data[i].size(); ++q) {
+                    const ResultSet& rs = data[i][q];
+                    for (size_t row = 0; row < rs.rowCount(); ++row)
+                        for (size_t c = 0; c < rs.columnCount(); ++c) n += safeGet(rs, row, static_cast<int>(c)).size();
+                }
+            g_sink = g_sink + n;
+        });
+        const double scale = cells ? static_cast<double>(cells) : 1.0;
+        r.iterations *= cells;
+        r.nsPerOp /= scale;
+        r.allocsPerOp /= scale;
+        r.bytesPerOp /= scale;
+        out.push_back(r);
+    }
+    if (wanted("safe_u64")) {
+        Result r = measure("safe_u64/" + label, 1, opt, [&]() {
+            uint64_t n = 0;
+            for (size_t i = 0; i < data.size(); ++i)
+                for (size_t q = 0; q < data[i].size(); ++q) {
+                    const ResultSet& rs = data[i][q];
+                    for (size_t row = 0; row < rs.rowCount(); ++row)
+                        for (size_t c = 0; c < rs.columnCount(); ++c) n += safeU64(rs, row, static_cast<int>(c));
+                }
+            g_sink = g_sink + n;
+        });
+        const double scale = cells ? static_cast<double>(cells) : 1.0;
+        r.iterations *= cells;
+        r.nsPerOp /= scale;
+        r.allocsPerOp /= scale;
+        r.bytesPerOp /= scale;
+        out.push_back(r);
+    }
+    if (wanted("disk_join")) {
+        out.push_back(measure("disk_join/" + label, disks.rowCount() + parts.rowCount() + links.rowCount() + logics.rowCount(), opt, [&]() {
+            g_sink = g_sink + buildStorageTopology(disks, parts, links, logics).disks.size();
+        }));
+    }
+    if (wanted("render_text")) {
+        NullWideBuf nullBuf;
+        std::wostream nullOut(&nullBuf);
+        out.push_back(measure("render_text/" + label, rows, opt, [&]() {
+            for (size_t i = 0; i < sections.size(); ++i) sections[i].print(data[i], nullOut);
+        }));
+    }
+    if (wanted("render_jsonl")) {
+        std::vector<std::vector<std::string> > classes(sections.size());
+        for (size_t i = 0; i < sections.size(); ++i)
+            for (size_t q = 0; q < sections[i].queries.size(); ++q) {
+                std::wstring cls = wqlClassName(sections[i].queries[q]);
+                classes[i].push_back(std::string(cls.begin(), cls.end()));
+            }
+        JsonWriter json;
+        out.push_back(measure("render_jsonl/" + label, rows, opt, [&]() {
+            for (size_t i = 0; i < sections.size(); ++i) {
+                appendJsonSection(json, sections[i].id, classes[i], data[i]);
+                g_sink = g_sink + json.buffer().size();
+                json.clear();
+            }
+        }));
+    }
+    // What a --serve refresh renders; scrapes then only copy the result.
+    if (wanted("render_metrics")) {
+        MetricsWriter metrics;
+        out.push_back(measure("render_metrics/" + label, rows, opt, [&]() {
+            for (size_t i = 0; i < sections.size(); ++i) appendSectionMetrics(metrics, sections[i].id, data[i]);
+            g_sink = g_sink + metrics.buffer().size();
+            metrics.clear();
+        }));
+    }
+    // --diff between two snapshots: hashing them when they're written, and
+    // comparing two of an unchanged machine, which reads only the digests.
+    if (wanted("snapshot_digest") || wanted("snapshot_diff")) {
+        std::vector<std::vector<std::string> > classes(sections.size());
+        for (size_t i = 0; i < sections.size(); ++i)
+            for (size_t q = 0; q < sections[i].queries.size(); ++q) {
+                std::wstring cls = wqlClassName(sections[i].queries[q]);
+                classes[i].push_back(std::string(cls.begin(), cls.end()));
+            }
+        if (wanted("snapshot_digest")) {
+            out.push_back(measure("snapshot_digest/" + label, rows, opt, [&]() {
+                for (size_t i = 0; i < sections.size(); ++i) g_sink = g_sink + sectionDigest(classes[i], data[i]);
+            }));
+        }
+        std::string bin;
+        appendBinHeader(bin);
+        for (size_t i = 0; i < sections.size(); ++i) {
+            appendBinSection(bin, sections[i].id, classes[i], data[i], sectionDigest(classes[i], data[i]));
+        }
+        if (wanted("snapshot_diff")) {
+            std::vector<SnapshotSection> before, after;
+            std::string error;
+            out.push_back(measure("snapshot_diff/" + label, sections.size(), opt, [&]() {
+                indexSnapshot(bin.data(), bin.size(), before, error);
+                indexSnapshot(bin.data(), bin.size(), after, error);
+                markChangedSections(before, after);
+                g_sink = g_sink + diffSnapshots(before, after).size();
+            }));
+        }
+    }
+}
+
+// Round trips against a simulated provider (200 us per call, 2 us per
+// object, 500 objects): what --batch buys on a remote or busy WMI. These
+// sleep, so ns_per_op is latency rather than CPU time.
+void benchEnumeration(const Options& opt, std::vector<Result>& out) {
+    FakeEnumerator::Latency latency;
+    latency.perCall = std::chrono::microseconds(200);
+    latency.perObject = std::chrono::microseconds(2);
+    const size_t objects = 500;
+    const size_t batches[] = { 1, 8, 32, 128 };
+    for (size_t k = 0; k < sizeof(batches) / sizeof(batches[0]); ++k) {
+        const std::string name = "enum_batch/" + std::to_string(static_cast<unsigned long long>(batches[k]));
+        if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos) continue;
+        out.push_back(measure(name, objects, opt, [&]() {
+            FakeEnumerator e(objects, latency);
+            size_t taken = 0;
+            enumerateBatched(e, batches[k], QueryBudget(), [&](size_t n) { taken += n; });
+            g_sink = g_sink + taken;
+        }));
+    }
+}
+
+// One sampler tick (read every counter into the ring) and one rate
+// computation. At 100 Hz, sample/tick's ns_per_op / 1e5 is the share of a
+// core the sampler takes, in percent.
+void benchSampler(const Options& opt, std::vector<Result>& out) {
+    std::unique_ptr<SampleRing<CounterSample, Sampler::kRingSize> > ring(new SampleRing<CounterSample, Sampler::kRingSize>());
+    CounterReader reader;
+    if (opt.filter.empty() || std::string("sample/tick").find(opt.filter) != std::string::npos) {
+        out.push_back(measure("sample/tick", 1, opt, [&]() {
+            CounterSample& sample = ring->beginWrite();
+            if (reader.read(sample)) {
+                ring->publish();
+            } else {
+                ring->discard();
+            }
+        }));
+    }
+    if (opt.filter.empty() || std::string("sample/rates").find(opt.filter) != std::string::npos) {
+        std::unique_ptr<CounterSample> prev(new CounterSample()), cur(new CounterSample());
+        std::unique_ptr<Rates> rates(new Rates());
+        reader.read(*prev);
+        reader.read(*cur);
+        out.push_back(measure("sample/rates", 1, opt, [&]() {
+            computeRates(*prev, *cur, *rates);
+            g_sink = g_sink + rates->cpuCount;
+        }));
+    }
+}
+
+// A week of 1 s --watch ticks of a machine with 50 disks: free memory moves
+// every tick, each disk's free space every few minutes. history/append is
+// one tick; history/query_week folds one disk's week into hourly buckets,
+// and history/query_hour a single hour of every series at 1 s.
+void benchHistory(const Options& opt, std::vector<Result>& out) {
+    const char* names[] = { "history/append", "history/query_week", "history/query_hour" };
+    bool any = false;
+    for (size_t k = 0; k < 3; ++k) any = any || opt.filter.empty() || std::string(names[k]).find(opt.filter) != std::string::npos;
+    if (!any) return;
+
+    const std::string path = "sysinfo_bench-history.tmp";
+    std::remove(path.c_str());
+    std::vector<HistoryPoint> points(51);
+    points[0].series = "memory/FreePhysicalMemory";
+    points[0].value = 8ull << 20;
+    for (size_t d = 1; d < points.size(); ++d) {
+        points[d].series = "disk/" + std::to_string(static_cast<unsigned long long>(d)) + "/FreeSpace";
+        points[d].value = 500ull << 30;
+    }
+    uint64_t rng = 88172645463325252ull;
+    int64_t time = 1700000000000;
+    const int64_t week = 7 * 24 * 3600;
+    {
+        HistoryWriter writer;
+        std::string error;
+        if (!writer.open(path, error)) return;
+        for (int64_t t = 0; t < week; ++t) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            points[0].value += (rng & 0xFFF) - 0x800;
+            points[1 + (rng >> 32) % 50].value -= (rng >> 40) % 300 == 0 ? (rng & 0xFFFFF) : 0;
+            writer.append(time + t * 1000, points);
+        }
+        if (opt.filter.empty() || std::string(names[0]).find(opt.filter) != std::string::npos) {
+            int64_t t = week;
+            out.push_back(measure(names[0], points.size(), opt, [&]() {
+                points[0].value += 4096;
+                writer.append(time + t++ * 1000, points);
+            }));
+        }
+    }
+    MappedFile file;
+    if (!file.open(path)) return;
+    int64_t first = 0, last = 0;
+    historySpan(file.data(), file.size(), first, last);
+    std::vector<HistorySeries> series;
+    std::string error;
+    if (opt.filter.empty() || std::string(names[1]).find(opt.filter) != std::string::npos) {
+        out.push_back(measure(names[1], week, opt, [&]() {
+            queryHistory(file.data(), file.size(), "disk/7/", first, last + 1, 3600 * 1000, series, error);
+            g_sink = g_sink + series.size();
+        }));
+    }
+    if (opt.filter.empty() || std::string(names[2]).find(opt.filter) != std::string::npos) {
+        out.push_back(measure(names[2], 3600, opt, [&]() {
+            queryHistory(file.data(), file.size(), "", last + 1 - 3600 * 1000, last + 1, 1000, series, error);
+            g_sink = g_sink + series.size();
+        }));
+    }
+    file.close();
+    std::remove(path.c_str());
+}
+
+#ifndef _WIN32
+// A fake /proc of `count` processes: just the <pid>/stat files the process
+// scan reads, with kernel-thread, daemon and awkward names ("Web Content",
+// "(sd-pam)"), for `sysinfo --proc-root` and the benchmarks below.
+bool writeProcTree(const std::string& dir, unsigned count) {
+    static const char* const names[] = { "kworker/3:1-events", "systemd", "Web Content", "(sd-pam)", "java", "python3" };
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    char line[512];
+    uint64_t rng = 88172645463325252ull;
+    for (unsigned k = 0; k < count; ++k) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const unsigned pid = 100 + k * 3;
+        const std::string sub = dir + "/" + std::to_string(static_cast<unsigned long long>(pid));
+        if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        const int n = std::snprintf(line, sizeof(line),
+            "%u (%s) S %u %u %u 0 -1 4194560 %u 0 0 0 %llu %llu 0 0 20 0 %u 0 %llu %llu %llu 18446744073709551615 "
+            "1 1 0 0 0 0 0 0 0 0 0 0 17 %u 0 0 0 0 0\n",
+            pid, names[rng % 6], k ? 100 : 0, pid, pid, static_cast<unsigned>(rng % 5000),
+            static_cast<unsigned long long>(rng % 100000), static_cast<unsigned long long>((rng >> 20) % 20000),
+            static_cast<unsigned>(1 + (rng >> 40) % 64), static_cast<unsigned long long>(rng % 1000000),
+            static_cast<unsigned long long>((rng >> 8) % (1ull << 34)), static_cast<unsigned long long>((rng >> 24) % 500000),
+            static_cast<unsigned>(k % 64));
+        FILE* f = std::fopen((sub + "/stat").c_str(), "w");
+        if (!f) return false;
+        std::fwrite(line, 1, static_cast<size_t>(n), f);
+        std::fclose(f);
+    }
+    return true;
+}
+
+void removeProcTree(const std::string& dir, unsigned count) {
+    for (unsigned k = 0; k < count; ++k) {
+        const std::string sub = dir + "/" + std::to_string(static_cast<unsigned long long>(100 + k * 3));
+        unlink((sub + "/stat").c_str());
+        rmdir(sub.c_str());
+    }
+    rmdir(dir.c_str());
+}
+#endif
+
+// process_scan/50000 reads a generated tree of 50,000 processes with owners
+// (Linux only); process_summary/50000 is the report's top-N and per-user
+// pass over the result.
+void benchProcesses(const Options& opt, std::vector<Result>& out) {
+#ifndef _WIN32
+    const unsigned count = 50000;
+    const std::string scan = "process_scan/50000", summary = "process_summary/50000";
+    const bool wantScan = opt.filter.empty() || scan.find(opt.filter) != std::string::npos;
+    const bool wantSummary = opt.filter.empty() || summary.find(opt.filter) != std::string::npos;
+    if (!wantScan && !wantSummary) return;
+    char dir[] = "/tmp/sysinfo_bench-proc-XXXXXX";
+    if (!mkdtemp(dir)) return;
+    if (writeProcTree(dir, count)) {
+        LinuxSource src;
+        src.setProcRoot(dir);
+        const std::wstring wql = schemaQuery(kProcessSchema);
+        ResultSet rs = src.query(wql);
+        if (wantScan) {
+            out.push_back(measure(scan, count, opt, [&]() {
+                rs = src.query(wql);
+                g_sink = g_sink + rs.rowCount();
+            }));
+        }
+        if (wantSummary) {
+            ProcessSummary sum;
+            out.push_back(measure(summary, count, opt, [&]() {
+                summarizeProcesses(rs, kTopProcesses, sum);
+                g_sink = g_sink + sum.users.size();
+            }));
+        }
+    }
+    removeProcTree(dir, count);
+#else
+    (void)opt;
+    (void)out;
+#endif
+}
+
+// What an agent embedding libsysinfo pays per call on a warm session:
+// session/query_os is one Win32_OperatingSystem property through the C++
+// API, session/c_section_cpu the cpu section encoded into a caller buffer
+// through the C interface. Live data, so only for comparing builds on one
+// machine.
+void benchSession(const Options& opt, std::vector<Result>& out) {
+    const std::string query = "session/query_os", section = "session/c_section_cpu";
+    const bool wantQuery = opt.filter.empty() || query.find(opt.filter) != std::string::npos;
+    const bool wantSection = opt.filter.empty() || section.find(opt.filter) != std::string::npos;
+    if (wantQuery) {
+        SysinfoSession session;
+        if (session.open(SessionOptions())) {
+            const std::wstring wql = L"SELECT FreePhysicalMemory FROM Win32_OperatingSystem";
+            out.push_back(measure(query, 1, opt, [&]() {
+                ResultSet rs = session.query(wql);
+                g_sink = g_sink + rs.rowCount();
+            }));
+        }
+    }
+    sysinfo_session* session = nullptr;
+    if (wantSection && sysinfo_open(nullptr, &session) == SYSINFO_OK) {
+        std::vector<char> buf(1 << 16);
+        out.push_back(measure(section, 1, opt, [&]() {
+            size_t len = 0;
+            sysinfo_section(session, "cpu", SYSINFO_FORMAT_JSON, 0, buf.data(), buf.size(), &len);
+            g_sink = g_sink + len;
+        }));
+        sysinfo_close(session);
+    }
+}
+
+// Lends a source to a wrapper that wants to own one.
+class BorrowedSource : public DataSource {
+public:
+    explicit BorrowedSource(DataSource& src) : m_src(src) {}
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget) { return m_src.query(wql, budget); }
+    bool queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget, ResultSet& rows,
+                      std::vector<std::string>& paths) {
+        return m_src.queryDevices(wql, path, budget, rows, paths);
+    }
+
+private:
+    DataSource& m_src;
+};
+
+void benchDevices(const Options& opt, std::vector<Result>& out) {
+    const char* names[] = { "devices/usb_rescan", "devices/usb_from_table", "devices/replay_hotplug", "devices/parse_uevent" };
+    bool want[4];
+    bool any = false;
+    for (size_t k = 0; k < 4; ++k) {
+        want[k] = opt.filter.empty() || std::string(names[k]).find(opt.filter) != std::string::npos;
+        any = any || want[k];
+    }
+    if (!any) return;
+
+    const std::string text = syntheticFixture(0, 0, 5000);
+    FixtureSource src;
+    src.parse(text.data(), text.size());
+    src.setDelays(false);
+    const std::wstring usb = schemaQuery(kUsbDeviceSchema);
+    const size_t rows = src.query(usb).rowCount();
+
+    // What a kiosk polling for plugged devices pays per poll, without and
+    // with the table.
+    if (want[0]) {
+        out.push_back(measure(names[0], rows, opt, [&]() {
+            ResultSet rs = src.query(usb);
+            g_sink = g_sink + rs.rowCount();
+        }));
+    }
+    if (want[1]) {
+        DeviceTable table(std::unique_ptr<DataSource>(new BorrowedSource(src)), std::unique_ptr<DeviceEventSource>());
+        out.push_back(measure(names[1], rows, opt, [&]() {
+            std::shared_ptr<const ResultSet> rs = table.queryShared(usb, QueryBudget());
+            g_sink = g_sink + rs->rowCount();
+        }));
+    }
+    // A stick plugged in and pulled 100 times, each event followed by a
+    // poll that has to see it: parse the stream, play it, look up the device.
+    if (want[2]) {
+        std::string script;
+        char buf[160];
+        for (unsigned k = 0; k < 200; ++k) {
+            std::snprintf(buf, sizeof(buf), "@0 %s usb\nPNPDeviceID=USB\\VID_0951&PID_1666\\BENCH%u\nName=USB Mass Storage Device\n",
+                          k % 2 ? "remove" : "add", k / 2);
+            script += buf;
+        }
+        out.push_back(measure(names[2], 200, opt, [&]() {
+            DeviceReplay* replay = new DeviceReplay(std::unique_ptr<DataSource>(new BorrowedSource(src)));
+            std::unique_ptr<DataSource> owner(replay);
+            replay->parse(script.data(), script.size());
+            std::unique_ptr<DeviceEventSource> events = replay->events();
+            DeviceTable table(std::unique_ptr<DataSource>(new BorrowedSource(*replay)), std::unique_ptr<DeviceEventSource>());
+            g_sink = g_sink + table.queryShared(usb, QueryBudget())->rowCount();
+            std::vector<DeviceEvent> batch;
+            for (bool more = true; more;) {
+                batch.clear();
+                more = events->wait(batch, std::chrono::milliseconds(0));
+                for (size_t k = 0; k < batch.size(); ++k) {
+                    table.apply(batch[k]);
+                    g_sink = g_sink + table.queryShared(usb, QueryBudget())->rowCount();
+                }
+            }
+        }));
+    }
+    if (want[3]) {
+        static const char msg[] = "add@/devices/pci0000:00/0000:00:14.0/usb1/1-2\0ACTION=add\0"
+                                  "DEVPATH=/devices/pci0000:00/0000:00:14.0/usb1/1-2\0SUBSYSTEM=usb\0"
+                                  "MAJOR=189\0MINOR=3\0DEVNAME=bus/usb/001/004\0DEVTYPE=usb_device\0"
+                                  "PRODUCT=951/1666/110\0TYPE=0/0/0\0BUSNUM=001\0DEVNUM=004\0SEQNUM=4711";
+        DeviceEvent event;
+        out.push_back(measure(names[3], 1, opt, [&]() {
+            g_sink = g_sink + parseUevent(msg, sizeof(msg), event);
+        }));
+    }
+}
+
+int writeProcTreeCommand(const char* dir) {
+#ifndef _WIN32
+    if (writeProcTree(dir, 50000)) return 0;
+    std::fprintf(stderr, "Could not write %s\n", dir);
+#else
+    std::fprintf(stderr, "--write-proc-tree is for Linux\n");
+    (void)dir;
+#endif
+    return 1;
+}
+
+void printResults(const std::vector<Result>& results) {
+    std::string doc = "{\"schema\":1,\"benchmarks\":[\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const Result& r = results[k];
+        JsonWriter w;
+        w.beginObject();
+        w.key("name");
+        w.string(r.name.c_str());
+        w.key("iterations");
+        w.u64(r.iterations);
+        w.key("ns_per_op");
+        w.fixed(r.nsPerOp, 2);
+        w.key("allocs_per_op");
+        w.fixed(r.allocsPerOp, 3);
+        w.key("bytes_per_op");
+        w.fixed(r.bytesPerOp, 1);
+        w.key("items_per_op");
+        w.u64(r.itemsPerOp);
+        w.endObject();
+        doc += w.buffer();
+        doc += k + 1 < results.size() ? ",\n" : "\n";
+    }
+    doc += "]}\n";
+    std::fwrite(doc.data(), 1, doc.size(), stdout);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    opt.minTimeMs = 500;
+    bool synthetic = true;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--fixture") == 0 && i + 1 < argc) {
+            opt.fixtures.push_back(argv[++i]);
+            synthetic = false;
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            opt.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--write-proc-tree") == 0 && i + 1 < argc) {
+            return writeProcTreeCommand(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            opt.minTimeMs = static_cast<unsigned>(std::strtoul(argv[++i], NULL, 10));
+        } else {
+            std::fprintf(stderr, "Usage: sysinfo_bench [--fixture <file>]... [--filter <text>] [--min-time <ms>]\n"
+                                 "       sysinfo_bench --write-proc-tree <dir>\n");
+            return 2;
+        }
+    }
+    if (opt.fixtures.empty()) opt.fixtures.push_back(SYSINFO_FIXTURE_DIR "/win11-desktop.fixture");
+
+    std::vector<Result> results;
+    for (size_t k = 0; k < opt.fixtures.size(); ++k) {
+        FixtureSource src;
+        if (!src.load(opt.fixtures[k])) return 1;
+        src.setDelays(false);
+        benchFixture(baseName(opt.fixtures[k]), src, opt, results);
+    }
+    if (synthetic) {
+        const std::string text = syntheticFixture(500, 2000, 5000);
+        FixtureSource src;
+        src.parse(text.data(), text.size());
+        benchFixture("synthetic-500d-2000p-5000pnp", src, opt, results);
+    }
+    benchEnumeration(opt, results);
+    benchSampler(opt, results);
+    benchHistory(opt, results);
+    benchProcesses(opt, results);
+    benchSession(opt, results);
+    benchDevices(opt, results);
+    printResults(results);
+    return 0;
+}
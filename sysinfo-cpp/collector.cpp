@@ -0,0 +1,219 @@
+#include "collector.h"
+
+#include <algorithm>
+#include <ostream>
+#include <utility>
+
+namespace {
+
+typedef QueryBudget::Clock Clock;
+
+// How long past its deadline a query may take to notice it before the
+// collector stops waiting for it.
+const std::chrono::milliseconds kWriteOffGrace(500);
+// How often the collector polls the cancel flag.
+const std::chrono::milliseconds kCancelPoll(100);
+
+std::atomic<unsigned> g_abandoned(0);
+
+enum class SlotState { Queued, Running, Done, WrittenOff };
+
+struct QuerySlot {
+    QuerySlot() : state(SlotState::Queued) {}
+    SlotState state;
+    Clock::time_point deadline; // valid while Running
+    std::thread::id worker;     // valid while Running
+};
+
+struct Pending {
+    std::vector<ResultSet> results;
+    std::vector<QuerySlot> slots;
+    size_t remaining;
+};
+
+// Everything a worker touches. Shared, because an abandoned worker may
+// still return into it after collectSections() is gone.
+struct CollectState {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<Pending> pending;
+};
+
+} // namespace
+
+unsigned abandonedWorkers() {
+    return g_abandoned.load();
+}
+
+WorkerPool::WorkerPool(DataSource& src, unsigned threads) : m_shared(std::make_shared<Shared>(src)) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; ++i) {
+        m_threads.push_back(std::thread(&WorkerPool::run, m_shared));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->stopping = true;
+    }
+    m_shared->cv.notify_all();
+    for (size_t i = 0; i < m_threads.size(); ++i) m_threads[i].join();
+}
+
+void WorkerPool::submit(const std::function<void()>& task) {
+    {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->tasks.push_back(task);
+    }
+    m_shared->cv.notify_one();
+}
+
+void WorkerPool::abandon(std::thread::id worker) {
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        if (m_threads[i].get_id() != worker) continue;
+        {
+            std::lock_guard<std::mutex> lock(m_shared->mutex);
+            m_shared->abandoned.push_back(worker);
+        }
+        m_threads[i].detach();
+        m_threads[i] = std::thread(&WorkerPool::run, m_shared);
+        ++g_abandoned;
+        return;
+    }
+}
+
+void WorkerPool::run(std::shared_ptr<Shared> shared) {
+    shared->src.threadAttach();
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(shared->mutex);
+            const std::vector<std::thread::id>& gone = shared->abandoned;
+            if (std::find(gone.begin(), gone.end(), std::this_thread::get_id()) != gone.end()) break;
+            while (!shared->stopping && shared->tasks.empty()) shared->cv.wait(lock);
+            if (shared->tasks.empty()) break; // stopping and drained
+            task = shared->tasks.front();
+            shared->tasks.pop_front();
+        }
+        task();
+    }
+    shared->src.threadDetach();
+}
+
+void collectSections(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs, const SectionSink& sink,
+                     const CollectLimits& limits) {
+    std::shared_ptr<CollectState> state = std::make_shared<CollectState>();
+    std::vector<Pending>& pending = state->pending;
+    pending.resize(sections.size());
+    size_t totalQueries = 0;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        pending[i].results.resize(sections[i].queries.size());
+        pending[i].slots.resize(sections[i].queries.size());
+        pending[i].remaining = 0;
+        for (size_t q = 0; q < sections[i].queries.size(); ++q) {
+            if (!sections[i].queries[q].empty()) ++pending[i].remaining;
+        }
+        totalQueries += pending[i].remaining;
+    }
+    if (jobs == 0) jobs = static_cast<unsigned>(totalQueries);
+
+    const Clock::time_point runDeadline =
+        limits.total.count() ? Clock::now() + limits.total : Clock::time_point::max();
+    const std::chrono::milliseconds perQuery = limits.perQuery;
+    const std::atomic<bool>* cancel = limits.cancel;
+    {
+        WorkerPool pool(src, jobs);
+        // Submit in table order so that with few workers the first sections
+        // finish first and printing can start early.
+        for (size_t i = 0; i < sections.size(); ++i) {
+            for (size_t q = 0; q < sections[i].queries.size(); ++q) {
+                if (sections[i].queries[q].empty()) continue;
+                const std::wstring wql = sections[i].queries[q];
+                pool.submit([&src, state, wql, i, q, runDeadline, perQuery, cancel]() {
+                    Clock::time_point deadline = runDeadline;
+                    if (perQuery.count()) deadline = std::min(deadline, Clock::now() + perQuery);
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        QuerySlot& slot = state->pending[i].slots[q];
+                        slot.state = SlotState::Running;
+                        slot.deadline = deadline;
+                        slot.worker = std::this_thread::get_id();
+                        // The collector may be waiting without a deadline.
+                        state->done.notify_all();
+                    }
+                    // Queued past the run deadline (or a cancel): don't start.
+                    const QueryBudget budget(deadline, cancel);
+                    ResultSet rows;
+                    const QueryStatus status = budget.check();
+                    if (status == QueryStatus::Complete) {
+                        rows = src.query(wql, budget);
+                    } else {
+                        rows.setStatus(status);
+                    }
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    Pending& slot = state->pending[i];
+                    if (slot.slots[q].state == SlotState::WrittenOff) return;
+                    slot.slots[q].state = SlotState::Done;
+                    slot.results[q] = std::move(rows);
+                    --slot.remaining;
+                    state->done.notify_all();
+                });
+            }
+        }
+
+        Clock::time_point cancelSeen = Clock::time_point::max();
+        for (size_t i = 0; i < sections.size(); ++i) {
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                while (pending[i].remaining) {
+                    const Clock::time_point now = Clock::now();
+                    if (cancel && *cancel && cancelSeen == Clock::time_point::max()) cancelSeen = now;
+                    // Write off every overdue query, not just this section's,
+                    // so its replacement worker can get on with the queue.
+                    Clock::time_point wake = Clock::time_point::max();
+                    for (size_t s = 0; s < pending.size(); ++s) {
+                        for (size_t q = 0; q < pending[s].slots.size(); ++q) {
+                            QuerySlot& slot = pending[s].slots[q];
+                            if (slot.state != SlotState::Running) continue;
+                            const bool cancelled = cancelSeen < slot.deadline;
+                            const Clock::time_point limit = std::min(slot.deadline, cancelSeen);
+                            if (limit == Clock::time_point::max()) continue; // no deadline: wait it out
+                            const Clock::time_point due = limit + kWriteOffGrace;
+                            if (now < due) {
+                                wake = std::min(wake, due);
+                                continue;
+                            }
+                            slot.state = SlotState::WrittenOff;
+                            pending[s].results[q] = ResultSet();
+                            pending[s].results[q].setStatus(cancelled ? QueryStatus::Cancelled : QueryStatus::TimedOut);
+                            --pending[s].remaining;
+                            pool.abandon(slot.worker);
+                        }
+                    }
+                    if (!pending[i].remaining) break;
+                    if (cancel && cancelSeen == Clock::time_point::max()) wake = std::min(wake, now + kCancelPoll);
+                    if (wake == Clock::time_point::max()) {
+                        state->done.wait(lock);
+                    } else {
+                        state->done.wait_until(lock, wake);
+                    }
+                }
+            }
+            sink(i, pending[i].results);
+            pending[i].results.clear(); // release the rows early
+        }
+    }
+}
+
+void collectAndPrint(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs, std::wostream& out,
+                     const CollectLimits& limits) {
+    collectSections(src, sections, jobs, [&sections, &out](size_t i, std::vector<ResultSet>& results) {
+        sections[i].print(results, out);
+        for (size_t q = 0; q < results.size(); ++q) {
+            if (!results[q].partial()) continue;
+            const std::wstring cls = wqlClassName(sections[i].queries[q]);
+            out << L"  [" << cls << L": incomplete, query " << queryStatusName(results[q].status()) << L"]" << std::endl;
+        }
+    }, limits);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "datasource.h"
+
+// A report section: the queries it needs and how to print their results.
+// results[i] holds the rows of queries[i]. An empty query is not run and
+// leaves a ResultSet without columns (see projectSections()).
+struct SectionDef {
+    const char* id;
+    std::vector<std::wstring> queries;
+    void (*print)(const std::vector<ResultSet>& results, std::wostream& out);
+};
+
+// Fixed set of threads draining a FIFO of tasks. Each thread is attached
+// to the data source for its whole lifetime.
+class WorkerPool {
+public:
+    WorkerPool(DataSource& src, unsigned threads);
+    ~WorkerPool();
+
+    void submit(const std::function<void()>& task);
+
+    // Gives up on a worker stuck in a task: the thread is detached and
+    // replaced, and exits once the task returns, if it ever does. The
+    // queue lives on until then, but the data source must too.
+    void abandon(std::thread::id worker);
+
+private:
+    struct Shared {
+        explicit Shared(DataSource& src) : src(src), stopping(false) {}
+        DataSource& src;
+        std::deque<std::function<void()> > tasks;
+        std::vector<std::thread::id> abandoned;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stopping;
+    };
+    static void run(std::shared_ptr<Shared> shared);
+
+    std::shared_ptr<Shared> m_shared;
+    std::vector<std::thread> m_threads;
+};
+
+// Time limits for one collection run. A query that outlives its budget by
+// more than a short grace period is written off: its section gets an empty
+// TimedOut (or Cancelled) result and its worker is abandoned.
+struct CollectLimits {
+    CollectLimits() : perQuery(0), total(0), cancel(nullptr) {}
+    std::chrono::milliseconds perQuery; // from the moment a query starts; 0: none
+    std::chrono::milliseconds total;    // for the whole run; 0: none
+    const std::atomic<bool>* cancel;    // e.g. set by a SIGINT handler
+};
+
+// Workers abandoned so far in this process. While non-zero, the data
+// source must not be destroyed: a stuck query may still return into it.
+unsigned abandonedWorkers();
+
+// Receives a gathered section: its index in the table and the results of
+// its queries. Runs on the calling thread of collectSections().
+typedef std::function<void(size_t section, std::vector<ResultSet>& results)> SectionSink;
+
+// Gathers every query of every section on `jobs` workers and hands the
+// sections to `sink` in table order; each one is delivered as soon as it
+// and all the sections before it have their data. jobs == 0 means one
+// worker per query. Results cut short by `limits` come back partial().
+void collectSections(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs, const SectionSink& sink,
+                     const CollectLimits& limits = CollectLimits());
+
+// collectSections() with each section's text renderer as the sink, plus a
+// note under any section whose data is incomplete.
+void collectAndPrint(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs, std::wostream& out,
+                     const CollectLimits& limits = CollectLimits());
@@ -0,0 +1,126 @@
+#include "datasource.h"
+
+#include <cwctype>
+
+namespace {
+
+bool isWordChar(wchar_t c) {
+    return std::iswalnum(c) || c == L'_';
+}
+
+// Case-insensitive match of a WQL keyword at position i, delimited on both sides.
+bool keywordAt(const std::wstring& s, size_t i, const wchar_t* kw) {
+    size_t n = 0;
+    while (kw[n]) {
+        if (i + n >= s.size() || static_cast<wchar_t>(std::towupper(s[i + n])) != kw[n]) return false;
+        ++n;
+    }
+    if (i > 0 && isWordChar(s[i - 1])) return false;
+    if (i + n < s.size() && isWordChar(s[i + n])) return false;
+    return true;
+}
+
+} // namespace
+
+void DataSource::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into) {
+    into = query(wql, budget);
+}
+
+std::shared_ptr<const ResultSet> DataSource::queryShared(const std::wstring& wql, const QueryBudget& budget) {
+    return std::shared_ptr<const ResultSet>(new ResultSet(query(wql, budget)));
+}
+
+bool DataSource::queryDevices(const std::wstring&, const std::string&, const QueryBudget&, ResultSet&,
+                              std::vector<std::string>&) {
+    return false;
+}
+
+std::wstring wqlClassName(const std::wstring& wql) {
+    for (size_t i = 0; i < wql.size(); ++i) {
+        if (!keywordAt(wql, i, L"FROM")) continue;
+        size_t b = i + 4;
+        while (b < wql.size() && std::iswspace(wql[b])) ++b;
+        size_t e = b;
+        while (e < wql.size() && isWordChar(wql[e])) ++e;
+        return wql.substr(b, e - b);
+    }
+    return std::wstring();
+}
+
+std::vector<std::wstring> wqlColumns(const std::wstring& wql) {
+    std::vector<std::wstring> cols;
+    size_t i = 0;
+    while (i < wql.size() && std::iswspace(wql[i])) ++i;
+    if (!keywordAt(wql, i, L"SELECT")) return cols;
+    i += 6;
+    for (;;) {
+        while (i < wql.size() && std::iswspace(wql[i])) ++i;
+        size_t b = i;
+        while (i < wql.size() && isWordChar(wql[i])) ++i;
+        if (b == i) return std::vector<std::wstring>(); // "*" or garbage
+        cols.push_back(wql.substr(b, i - b));
+        while (i < wql.size() && std::iswspace(wql[i])) ++i;
+        if (i < wql.size() && wql[i] == L',') {
+            ++i;
+            continue;
+        }
+        if (keywordAt(wql, i, L"FROM")) return cols;
+        return std::vector<std::wstring>();
+    }
+}
+
+std::wstring wqlWithColumns(const std::wstring& wql, const std::vector<std::wstring>& columns) {
+    for (size_t i = 0; i < wql.size(); ++i) {
+        if (!keywordAt(wql, i, L"FROM")) continue;
+        std::wstring out = L"SELECT ";
+        for (size_t c = 0; c < columns.size(); ++c) {
+            if (c) out += L", ";
+            out += columns[c];
+        }
+        out += L" ";
+        out.append(wql, i, std::wstring::npos);
+        return out;
+    }
+    return std::wstring();
+}
+
+std::wstring utf8ToWide(const char* s, size_t len) {
+    std::wstring out;
+    out.reserve(len);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    const unsigned char* end = p + len;
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) {
+            out.push_back(static_cast<wchar_t>(c));
+            ++p;
+            continue;
+        }
+        int extra = (c >= 0xF0 && c < 0xF8) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC2) ? 1 : -1;
+        if (extra < 0 || end - p <= extra) {
+            out.push_back(static_cast<wchar_t>(0xFFFD));
+            ++p;
+            continue;
+        }
+        unsigned long cp = c & (0x3F >> extra);
+        bool ok = true;
+        for (int k = 1; k <= extra; ++k) {
+            if ((p[k] & 0xC0) != 0x80) { ok = false; break; }
+            cp = (cp << 6) | (p[k] & 0x3F);
+        }
+        if (!ok || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            out.push_back(static_cast<wchar_t>(0xFFFD));
+            ++p;
+            continue;
+        }
+        p += extra + 1;
+        if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+            cp -= 0x10000;
+            out.push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+            out.push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+        } else {
+            out.push_back(static_cast<wchar_t>(cp));
+        }
+    }
+    return out;
+}
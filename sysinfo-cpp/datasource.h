@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "resultset.h"
+
+// When a query has to give up: a deadline on the steady clock and an
+// optional cancellation flag owned by whoever can abort the run (e.g. a
+// SIGINT handler). Sources check it between round trips and return the
+// rows they have, with the status check() reports.
+class QueryBudget {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // No deadline, not cancellable.
+    QueryBudget() : m_deadline(Clock::time_point::max()), m_cancel(nullptr) {}
+    QueryBudget(Clock::time_point deadline, const std::atomic<bool>* cancel)
+        : m_deadline(deadline), m_cancel(cancel) {}
+
+    Clock::time_point deadline() const { return m_deadline; }
+
+    // Complete while the query may go on, else why it has to stop.
+    QueryStatus check() const {
+        if (m_cancel && m_cancel->load(std::memory_order_relaxed)) return QueryStatus::Cancelled;
+        if (m_deadline != Clock::time_point::max() && Clock::now() >= m_deadline) return QueryStatus::TimedOut;
+        return QueryStatus::Complete;
+    }
+
+    // Time left, at most `slice`, so that a blocking wait wakes up often
+    // enough to notice cancellation.
+    std::chrono::milliseconds remaining(std::chrono::milliseconds slice) const {
+        if (m_deadline == Clock::time_point::max()) return slice;
+        Clock::duration left = m_deadline - Clock::now();
+        if (left <= Clock::duration::zero()) return std::chrono::milliseconds(0);
+        std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(left);
+        return ms < slice ? ms : slice;
+    }
+
+private:
+    Clock::time_point m_deadline;
+    const std::atomic<bool>* m_cancel;
+};
+
+// Where section data comes from (live WMI, a recorded fixture, ...).
+// query() is called concurrently from the collector's worker threads,
+// so implementations must be thread-safe.
+class DataSource {
+public:
+    virtual ~DataSource() {}
+
+    // Runs `wql` within `budget`. A source that runs out of it returns
+    // the rows gathered so far with the budget's status set on the result.
+    // Subclasses add `using DataSource::query;` to keep the overload below.
+    virtual ResultSet query(const std::wstring& wql, const QueryBudget& budget) = 0;
+    ResultSet query(const std::wstring& wql) { return query(wql, QueryBudget()); }
+    // The same rows in `into`, which is cleared first. Sources that build
+    // rows (the collectors, WMI, fixtures, the caches) fill it in place and
+    // reuse its storage; the default moves a new result in.
+    virtual void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+    // The same rows, shared and read-only. Sources that keep rows (the
+    // device table) hand out theirs instead of a copy.
+    virtual std::shared_ptr<const ResultSet> queryShared(const std::wstring& wql, const QueryBudget& budget);
+    // For the device classes, which DeviceTable keeps up to date: the rows
+    // of `wql` for the one device an event names by `path` (none once it is
+    // gone), or for every device if `path` is empty. Appends each row's own
+    // path, in the form events name it by, to `paths`. False if the source
+    // can only enumerate whole classes.
+    virtual bool queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget,
+                              ResultSet& rows, std::vector<std::string>& paths);
+
+    // Called on every worker thread before its first query and after its
+    // last one. The WMI source joins the COM MTA here.
+    virtual void threadAttach() {}
+    virtual void threadDetach() {}
+};
+
+// Returns the class name of "SELECT ... FROM <class> [WHERE ...]", or an
+// empty string if the statement has no FROM clause.
+std::wstring wqlClassName(const std::wstring& wql);
+
+// Returns the property list of "SELECT a, b, c FROM ...", or an empty
+// vector for "SELECT *" and anything that doesn't parse.
+std::vector<std::wstring> wqlColumns(const std::wstring& wql);
+
+// Returns `wql` with its SELECT list replaced by `columns`, or an empty
+// string if the statement has no FROM clause.
+std::wstring wqlWithColumns(const std::wstring& wql, const std::vector<std::wstring>& columns);
+
+// Decodes UTF-8 into a wide string (UTF-16 on Windows, UTF-32 elsewhere).
+// Invalid sequences become U+FFFD.
+std::wstring utf8ToWide(const char* s, size_t len);
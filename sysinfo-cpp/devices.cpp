@@ -0,0 +1,479 @@
+#include "devices.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include "fixture_source.h"
+
+namespace {
+
+// The classes served from the table, the subsystem whose events touch
+// them and the property their rows are indexed by.
+struct TrackedClass {
+    const char* subsystem;
+    const wchar_t* wmiClass;
+    const char* key;
+};
+
+const TrackedClass kTrackedClasses[] = {
+    { "usb", L"Win32_PnPEntity", "PNPDeviceID" },
+    { "sound", L"Win32_SoundDevice", "PNPDeviceID" },
+    { "net", L"Win32_NetworkAdapter", "MACAddress" },
+    { "block", L"Win32_DiskDrive", "SerialNumber" },
+};
+const size_t kTrackedCount = sizeof(kTrackedClasses) / sizeof(kTrackedClasses[0]);
+
+int trackedByClass(const std::wstring& cls) {
+    for (size_t k = 0; k < kTrackedCount; ++k) {
+        if (cls == kTrackedClasses[k].wmiClass) return static_cast<int>(k);
+    }
+    return -1;
+}
+
+int trackedBySubsystem(const std::string& subsystem) {
+    for (size_t k = 0; k < kTrackedCount; ++k) {
+        if (subsystem == kTrackedClasses[k].subsystem) return static_cast<int>(k);
+    }
+    return -1;
+}
+
+std::string text(const Value& v) {
+    return v.type == ValueType::String ? std::string(v.s.p, v.s.n) : std::string();
+}
+
+// A row's index key: its key property, or its path where that is blank
+// or taken by another row (disks without serial numbers). The NUL keeps
+// paths apart from property values.
+std::string rowKey(const ResultSet& rows, size_t r, int keyCol, const std::string& path,
+                   const std::unordered_map<std::string, size_t>& taken) {
+    std::string key = text(rows.at(r, keyCol));
+    if (key.empty() || taken.count(key)) key = std::string(1, '\0') + path;
+    return key;
+}
+
+bool startsWith(const char* b, const char* e, const char* prefix) {
+    size_t n = std::strlen(prefix);
+    return static_cast<size_t>(e - b) >= n && std::memcmp(b, prefix, n) == 0;
+}
+
+bool parseAction(const char* b, const char* e, DeviceEvent::Action& action) {
+    const std::string word(b, e);
+    if (word == "add") action = DeviceEvent::Add;
+    else if (word == "remove") action = DeviceEvent::Remove;
+    // bind, unbind, move, online, offline: the device is still there but
+    // what it reports may not be.
+    else if (!word.empty()) action = DeviceEvent::Change;
+    else return false;
+    return true;
+}
+
+} // namespace
+
+bool parseUevent(const char* msg, size_t len, DeviceEvent& out) {
+    const char* p = msg;
+    const char* end = msg + len;
+    // The kernel's header is "action@devpath"; udevd's re-broadcasts start
+    // with "libudev" and a binary header instead.
+    const char* header = static_cast<const char*>(std::memchr(p, '\0', len));
+    if (!header || !std::memchr(p, '@', header - p)) return false;
+    bool haveAction = false;
+    out = DeviceEvent();
+    for (p = header + 1; p < end;) {
+        const char* e = static_cast<const char*>(std::memchr(p, '\0', end - p));
+        if (!e) e = end;
+        if (startsWith(p, e, "ACTION=")) haveAction = parseAction(p + 7, e, out.action);
+        else if (startsWith(p, e, "SUBSYSTEM=")) out.subsystem.assign(p + 10, e);
+        else if (startsWith(p, e, "DEVPATH=")) out.path.assign(p + 8, e);
+        p = e + 1;
+    }
+    return haveAction && !out.subsystem.empty();
+}
+
+DeviceTable::DeviceTable(std::unique_ptr<DataSource> inner, std::unique_ptr<DeviceEventSource> events)
+    : m_inner(std::move(inner)), m_source(std::move(events)), m_generations(kTrackedCount, 0), m_stop(false),
+      m_hits(0), m_refreshes(0), m_events(0), m_lookups(0) {}
+
+DeviceTable::~DeviceTable() {
+    m_stop = true;
+    if (m_listener.joinable()) m_listener.join();
+}
+
+void DeviceTable::start() {
+    if (m_source && !m_listener.joinable()) m_listener = std::thread(&DeviceTable::listen, this);
+}
+
+void DeviceTable::listen() {
+    std::vector<DeviceEvent> batch;
+    // Short waits, so the destructor doesn't sit out a quiet bus.
+    while (!m_stop) {
+        batch.clear();
+        const bool more = m_source->wait(batch, std::chrono::milliseconds(200));
+        for (size_t k = 0; k < batch.size(); ++k) apply(batch[k]);
+        if (!more) break;
+    }
+}
+
+void DeviceTable::index(Table& table, const char* keyProperty) {
+    const ResultSet& rows = *table.rows;
+    const int keyCol = rows.column(keyProperty);
+    table.keys.resize(rows.rowCount());
+    table.paths.resize(rows.rowCount());
+    for (size_t r = 0; r < rows.rowCount(); ++r) {
+        table.keys[r] = rowKey(rows, r, keyCol, table.paths[r], table.byKey);
+        table.byKey[table.keys[r]] = r;
+        table.byPath[table.paths[r]] = r;
+    }
+}
+
+// The rows to edit: a copy if a reader holds them, and now and then anyway
+// so strings replaced in place don't pile up in the arena.
+ResultSet& DeviceTable::writable(Table& table) {
+    if (table.rows.use_count() > 1 || table.edits > table.rows->rowCount() + 16) {
+        table.rows.reset(new ResultSet(table.rows->clone()));
+        table.edits = 0;
+    }
+    ++table.edits;
+    return *table.rows;
+}
+
+void DeviceTable::unindex(Table& table, size_t row) {
+    std::unordered_map<std::string, size_t>::iterator it = table.byKey.find(table.keys[row]);
+    if (it != table.byKey.end() && it->second == row) table.byKey.erase(it);
+    it = table.byPath.find(table.paths[row]);
+    if (it != table.byPath.end() && it->second == row) table.byPath.erase(it);
+}
+
+void DeviceTable::drop(Table& table, size_t row) {
+    ResultSet& rows = writable(table);
+    const size_t last = rows.rowCount() - 1;
+    unindex(table, row);
+    rows.removeRow(row);
+    if (row != last) {
+        // The last row took its place.
+        table.keys[row].swap(table.keys[last]);
+        table.paths[row].swap(table.paths[last]);
+        table.byKey[table.keys[row]] = row;
+        table.byPath[table.paths[row]] = row;
+    }
+    table.keys.pop_back();
+    table.paths.pop_back();
+}
+
+// Adds row r of `found` or replaces the row of the same device: the one at
+// the same path, else the one with the same key (a device that came back
+// at another port).
+void DeviceTable::upsert(Table& table, const ResultSet& found, size_t r, const std::string& path,
+                         const char* keyProperty) {
+    const int keyCol = found.column(keyProperty);
+    size_t row = static_cast<size_t>(-1);
+    std::unordered_map<std::string, size_t>::const_iterator it = table.byPath.find(path);
+    if (it != table.byPath.end()) {
+        row = it->second;
+    } else {
+        const std::string key = text(found.at(r, keyCol));
+        it = key.empty() ? table.byKey.end() : table.byKey.find(key);
+        if (it != table.byKey.end()) row = it->second;
+    }
+
+    ResultSet& rows = writable(table);
+    if (row == static_cast<size_t>(-1)) {
+        rows.addRow();
+        row = rows.rowCount() - 1;
+        table.keys.push_back(std::string());
+        table.paths.push_back(std::string());
+    } else {
+        unindex(table, row);
+    }
+    for (size_t c = 0; c < rows.columnCount(); ++c) {
+        const int col = static_cast<int>(c);
+        rows.setValue(row, col, found.at(r, found.column(rows.columnName(col).c_str())));
+    }
+    table.keys[row] = rowKey(found, r, keyCol, path, table.byKey);
+    table.paths[row] = path;
+    table.byKey[table.keys[row]] = row;
+    table.byPath[path] = row;
+}
+
+void DeviceTable::update(Table& table, const DeviceEvent& event, const ResultSet& found,
+                         const std::vector<std::string>& paths, const char* keyProperty) {
+    if (found.empty()) {
+        // Gone, or not a device of this query (an interface, a partition).
+        std::unordered_map<std::string, size_t>::const_iterator it = table.byPath.find(event.path);
+        if (it != table.byPath.end()) drop(table, it->second);
+        return;
+    }
+    for (size_t r = 0; r < found.rowCount(); ++r) upsert(table, found, r, paths[r], keyProperty);
+}
+
+void DeviceTable::apply(const DeviceEvent& event) {
+    ++m_events;
+    std::vector<std::wstring> lookups;
+    const int k = trackedBySubsystem(event.subsystem);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (event.subsystem.empty()) {
+            for (size_t c = 0; c < kTrackedCount; ++c) ++m_generations[c];
+            for (std::map<std::wstring, Table>::iterator it = m_tables.begin(); it != m_tables.end(); ++it) {
+                it->second.stale = true;
+            }
+            return;
+        }
+        if (k < 0) return;
+        ++m_generations[k];
+        for (std::map<std::wstring, Table>::iterator it = m_tables.begin(); it != m_tables.end(); ++it) {
+            Table& table = it->second;
+            if (table.stale || trackedByClass(wqlClassName(it->first)) != k) continue;
+            if (table.incremental) lookups.push_back(it->first);
+            else table.stale = true;
+        }
+    }
+
+    // Look the device up without holding the lock; queries keep being
+    // served from the tables meanwhile.
+    for (size_t q = 0; q < lookups.size(); ++q) {
+        ResultSet found;
+        std::vector<std::string> paths;
+        if (event.action != DeviceEvent::Remove) {
+            m_inner->queryDevices(lookups[q], event.path, QueryBudget(), found, paths);
+            ++m_lookups;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::wstring, Table>::iterator it = m_tables.find(lookups[q]);
+        if (it == m_tables.end() || it->second.stale) continue;
+        if (found.partial() || paths.size() != found.rowCount()) it->second.stale = true;
+        else update(it->second, event, found, paths, kTrackedClasses[k].key);
+    }
+}
+
+ResultSet DeviceTable::query(const std::wstring& wql, const QueryBudget& budget) {
+    if (trackedByClass(wqlClassName(wql)) < 0) return m_inner->query(wql, budget);
+    return queryShared(wql, budget)->clone();
+}
+
+void DeviceTable::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into) {
+    if (trackedByClass(wqlClassName(wql)) < 0) m_inner->query(wql, budget, into);
+    else into.assign(*queryShared(wql, budget));
+}
+
+std::shared_ptr<const ResultSet> DeviceTable::queryShared(const std::wstring& wql, const QueryBudget& budget) {
+    const int k = trackedByClass(wqlClassName(wql));
+    if (k < 0) return m_inner->queryShared(wql, budget);
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::wstring, Table>::const_iterator it = m_tables.find(wql);
+        if (it != m_tables.end() && !it->second.stale) {
+            ++m_hits;
+            return it->second.rows;
+        }
+        generation = m_generations[k];
+    }
+    Table fresh;
+    ResultSet rows;
+    fresh.incremental = m_inner->queryDevices(wql, std::string(), budget, rows, fresh.paths);
+    if (!fresh.incremental) rows = m_inner->query(wql, budget);
+    ++m_refreshes;
+    std::shared_ptr<ResultSet> shared(new ResultSet(std::move(rows)));
+    if (shared->partial()) return shared;
+    fresh.rows = shared;
+    if (fresh.incremental) index(fresh, kTrackedClasses[k].key);
+    // Keep it only if no event came in while enumerating: the rows may
+    // predate it.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_generations[k] == generation) m_tables[wql] = std::move(fresh);
+    return shared;
+}
+
+class DeviceReplay::Player : public DeviceEventSource {
+public:
+    explicit Player(DeviceReplay& replay) : m_replay(replay), m_next(0), m_started(false) {}
+
+    bool wait(std::vector<DeviceEvent>& out, std::chrono::milliseconds timeout) {
+        const std::vector<Scripted>& script = m_replay.m_script;
+        if (m_next >= script.size()) return false;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!m_started) {
+            m_start = now;
+            m_started = true;
+        }
+        std::chrono::steady_clock::time_point due = m_start + script[m_next].at;
+        if (due > now + timeout) {
+            std::this_thread::sleep_for(timeout);
+            return true;
+        }
+        std::this_thread::sleep_until(due);
+        now = std::chrono::steady_clock::now();
+        while (m_next < script.size() && m_start + script[m_next].at <= now) out.push_back(m_replay.play(m_next++));
+        return m_next < script.size();
+    }
+
+private:
+    DeviceReplay& m_replay;
+    size_t m_next;
+    bool m_started;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+DeviceReplay::DeviceReplay(std::unique_ptr<DataSource> inner) : m_inner(std::move(inner)), m_devices(kTrackedCount) {}
+
+bool DeviceReplay::load(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        std::wcerr << L"Could not open event stream " << utf8ToWide(path.data(), path.size()) << std::endl;
+        return false;
+    }
+    std::string text;
+    char buf[16384];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+    std::fclose(f);
+    parse(text.data(), text.size());
+    return true;
+}
+
+void DeviceReplay::parse(const char* text, size_t len) {
+    const char* p = text;
+    const char* end = p + len;
+    if (end - p >= 3 && (unsigned char)p[0] == 0xEF && (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF) p += 3;
+
+    Scripted* current = nullptr;
+    while (p < end) {
+        const char* eol = p;
+        while (eol < end && *eol != '\n') ++eol;
+        const char* b = p;
+        const char* e = eol;
+        p = eol < end ? eol + 1 : end;
+        while (e > b && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) --e;
+        if (b == e || *b == '#') continue;
+
+        if (*b == '@') {
+            // "@<ms> <action> <subsystem>"
+            const std::string line(b + 1, e);
+            char action[16], subsystem[32];
+            double ms;
+            current = nullptr;
+            if (std::sscanf(line.c_str(), "%lf %15s %31s", &ms, action, subsystem) != 3) continue;
+            Scripted s;
+            s.at = std::chrono::milliseconds(static_cast<long long>(ms));
+            if (!parseAction(action, action + std::strlen(action), s.event.action)) continue;
+            s.event.subsystem = subsystem;
+            s.props.addRow();
+            m_script.push_back(std::move(s));
+            current = &m_script.back();
+        } else if (current) {
+            setFixtureProperty(current->props, b, e - b);
+        }
+    }
+}
+
+std::unique_ptr<DeviceEventSource> DeviceReplay::events() {
+    return std::unique_ptr<DeviceEventSource>(new Player(*this));
+}
+
+DeviceReplay::Devices& DeviceReplay::devices(int tracked) {
+    Devices& d = m_devices[tracked];
+    if (d.loaded) return d;
+    d.rows = m_inner->query(std::wstring(L"SELECT * FROM ") + kTrackedClasses[tracked].wmiClass);
+    d.gone.assign(d.rows.rowCount(), false);
+    const int idCol = d.rows.column("PNPDeviceID");
+    for (size_t r = 0; r < d.rows.rowCount(); ++r) {
+        const std::string id = text(d.rows.at(r, idCol));
+        if (!id.empty()) d.byId[id] = r;
+    }
+    d.loaded = true;
+    return d;
+}
+
+void DeviceReplay::applyTo(Scripted& s, Devices& d) {
+    const ResultSet& props = s.props;
+    if (!props.columnCount()) return;
+    const Value& name = props.at(0, 0);
+    long row = -1;
+    if (props.columnName(0) == "PNPDeviceID") {
+        std::unordered_map<std::string, size_t>::const_iterator it = d.byId.find(text(name));
+        if (it != d.byId.end()) row = static_cast<long>(it->second);
+    } else {
+        const int nameCol = d.rows.column(props.columnName(0).c_str());
+        for (size_t r = 0; r < d.rows.rowCount() && nameCol >= 0 && row < 0; ++r) {
+            if (!d.gone[r] && d.rows.at(r, nameCol).equals(name)) row = static_cast<long>(r);
+        }
+    }
+    if (row < 0 && s.event.action == DeviceEvent::Remove) return;
+
+    const int idCol = d.rows.column("PNPDeviceID");
+    std::string id = row < 0 ? std::string() : text(d.rows.at(row, idCol));
+    if (!id.empty()) d.byId.erase(id);
+    if (s.event.action == DeviceEvent::Remove) {
+        d.gone[row] = true;
+    } else {
+        if (row < 0) {
+            d.rows.addRow();
+            d.gone.push_back(false);
+            row = static_cast<long>(d.rows.rowCount() - 1);
+        }
+        for (size_t c = 0; c < props.columnCount(); ++c) {
+            const int col = d.rows.addColumn(props.columnName(static_cast<int>(c)));
+            d.rows.setValue(row, col, props.at(0, static_cast<int>(c)));
+        }
+        id = text(d.rows.at(row, d.rows.column("PNPDeviceID")));
+        if (!id.empty()) d.byId[id] = row;
+    }
+    s.event.path = id;
+}
+
+const DeviceEvent& DeviceReplay::play(size_t index) {
+    Scripted& s = m_script[index];
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int k = trackedBySubsystem(s.event.subsystem);
+    if (k >= 0) applyTo(s, devices(k));
+    return s.event;
+}
+
+ResultSet DeviceReplay::query(const std::wstring& wql, const QueryBudget& budget) {
+    ResultSet rows;
+    std::vector<std::string> paths;
+    if (!queryDevices(wql, std::string(), budget, rows, paths)) return m_inner->query(wql, budget);
+    return rows;
+}
+
+bool DeviceReplay::queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget&,
+                                ResultSet& rows, std::vector<std::string>& paths) {
+    const int k = trackedByClass(wqlClassName(wql));
+    if (k < 0) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Devices& d = devices(k);
+
+    // Project onto the SELECT list, as the fixture does.
+    std::vector<int> from;
+    std::vector<std::wstring> cols = wqlColumns(wql);
+    if (cols.empty()) {
+        for (size_t c = 0; c < d.rows.columnCount(); ++c) {
+            rows.addColumn(d.rows.columnName(static_cast<int>(c)));
+            from.push_back(static_cast<int>(c));
+        }
+    } else {
+        for (size_t c = 0; c < cols.size(); ++c) {
+            std::string name(cols[c].begin(), cols[c].end()); // property names are ASCII
+            rows.addColumn(name);
+            from.push_back(d.rows.column(name.c_str()));
+        }
+    }
+    const int idCol = d.rows.column("PNPDeviceID");
+    size_t first = 0, end = d.rows.rowCount();
+    if (!path.empty()) {
+        std::unordered_map<std::string, size_t>::const_iterator it = d.byId.find(path);
+        if (it == d.byId.end()) return true;
+        first = it->second;
+        end = first + 1;
+    }
+    for (size_t r = first; r < end; ++r) {
+        if (d.gone[r]) continue;
+        rows.addRow();
+        for (size_t c = 0; c < from.size(); ++c) rows.setValue(static_cast<int>(c), d.rows.at(r, from[c]));
+        paths.push_back(text(d.rows.at(r, idCol)));
+    }
+    return true;
+}
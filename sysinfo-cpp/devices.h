@@ -0,0 +1,191 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "datasource.h"
+
+// A device arriving, leaving or changing, as the OS reports it. The
+// subsystem says which table it touches: "usb", "sound", "net" or "block"
+// (Linux names; the Windows listener maps its interface classes onto
+// them). An empty subsystem means events were lost and anything may have
+// changed.
+struct DeviceEvent {
+    enum Action { Add, Remove, Change };
+
+    DeviceEvent() : action(Change) {}
+    DeviceEvent(Action a, const std::string& sub, const std::string& p) : action(a), subsystem(sub), path(p) {}
+
+    Action action;
+    std::string subsystem;
+    // Which device: its devpath (Linux uevents), device instance ID
+    // (Windows interface notifications) or interface index (link
+    // changes). DataSource::queryDevices() looks it up.
+    std::string path;
+};
+
+// Where device events come from.
+class DeviceEventSource {
+public:
+    virtual ~DeviceEventSource() {}
+
+    // Waits up to `timeout` for events and appends them to `out`. False
+    // once no more will come (the end of a replayed stream).
+    virtual bool wait(std::vector<DeviceEvent>& out, std::chrono::milliseconds timeout) = 0;
+};
+
+// The OS's hotplug notifications: kernel uevents and rtnetlink link
+// changes on Linux, configuration manager interface notifications and IP
+// interface changes on Windows. Null (with a message on stderr) if they
+// can't be subscribed to.
+std::unique_ptr<DeviceEventSource> openDeviceEvents();
+
+// Parses one NETLINK_KOBJECT_UEVENT datagram ("add@/devices/...\0ACTION=add
+// \0DEVPATH=...\0SUBSYSTEM=usb\0..."). False for anything else, such as
+// the udev daemon's own re-broadcasts.
+bool parseUevent(const char* msg, size_t len, DeviceEvent& out);
+
+// Serves the device classes (USB PnP entities, sound devices, network
+// adapters, disk drives) from a table per query text kept up to date by
+// device events, and forwards everything else to the wrapped source. The
+// first query enumerates the class; after that an event costs a lookup of
+// the one device it names (DataSource::queryDevices()), whose row is then
+// added, replaced or dropped in place. Rows are indexed by the class's
+// key property (PNPDeviceID, SerialNumber, MACAddress) and by device
+// path. Readers share the table's rows through queryShared(); an event
+// that arrives while they hold them edits a copy. Classes of a source
+// that can't look devices up one at a time, and every class after lost
+// events, are enumerated again on their next query.
+class DeviceTable : public DataSource {
+public:
+    DeviceTable(std::unique_ptr<DataSource> inner, std::unique_ptr<DeviceEventSource> events);
+    // Stops listening before the wrapped source goes away.
+    ~DeviceTable();
+
+    // Starts the listener thread. Before that, events only arrive through
+    // apply().
+    void start();
+    // Looks up the device the event names and updates its row in every
+    // table of its class.
+    void apply(const DeviceEvent& event);
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+    std::shared_ptr<const ResultSet> queryShared(const std::wstring& wql, const QueryBudget& budget);
+    void threadAttach() { m_inner->threadAttach(); }
+    void threadDetach() { m_inner->threadDetach(); }
+
+    size_t hits() const { return m_hits; }
+    size_t refreshes() const { return m_refreshes; }
+    size_t events() const { return m_events; }
+    size_t lookups() const { return m_lookups; }
+
+private:
+    struct Table {
+        Table() : edits(0), incremental(false), stale(false) {}
+
+        std::shared_ptr<ResultSet> rows;
+        std::vector<std::string> keys;  // each row's index key
+        std::vector<std::string> paths; // each row's device path
+        std::unordered_map<std::string, size_t> byKey, byPath;
+        size_t edits;     // since the rows were last copied
+        bool incremental; // the wrapped source looks devices up one at a time
+        bool stale;       // enumerate again
+    };
+
+    void listen();
+    static void index(Table& table, const char* keyProperty);
+    static ResultSet& writable(Table& table);
+    static void unindex(Table& table, size_t row);
+    static void drop(Table& table, size_t row);
+    static void upsert(Table& table, const ResultSet& found, size_t r, const std::string& path, const char* keyProperty);
+    static void update(Table& table, const DeviceEvent& event, const ResultSet& found,
+                       const std::vector<std::string>& paths, const char* keyProperty);
+
+    std::unique_ptr<DataSource> m_inner;
+    std::unique_ptr<DeviceEventSource> m_source;
+    std::mutex m_mutex;
+    std::map<std::wstring, Table> m_tables;
+    std::vector<uint64_t> m_generations; // per tracked class, bumped by its events
+    std::atomic<bool> m_stop;
+    std::thread m_listener;
+    std::atomic<size_t> m_hits, m_refreshes, m_events, m_lookups;
+};
+
+// Stand-in for hotplug hardware, for testing the table without any. A
+// stream file scripts events and the device rows they bring or take away:
+//
+//   # comment
+//   @0 add usb                  milliseconds from the first wait(), action, subsystem
+//   PNPDeviceID=USB\VID_0781&PID_5581\4C530001
+//   Name=Ultra
+//   @1500 change net
+//   Name=eth0
+//   NetConnectionStatus:u64=7
+//   @3000 remove usb
+//   PNPDeviceID=USB\VID_0781&PID_5581\4C530001
+//
+// Properties use the fixture syntax (fixture_source.h). The first one
+// names the device, best by its PNPDeviceID (found through an index;
+// other properties are searched for): a matching row takes the event's
+// properties on top of its own (add, change) or is dropped (remove), and
+// an add that matches none appends one. Played events name the device by
+// its PNPDeviceID, which queryDevices() takes as the path. Tracked classes
+// start out as the wrapped source returns them for SELECT *, loaded on
+// first use; as with fixtures, the WHERE clause is ignored.
+class DeviceReplay : public DataSource {
+public:
+    explicit DeviceReplay(std::unique_ptr<DataSource> inner);
+
+    // Parses the stream; false (with a message on stderr) if it can't be read.
+    bool load(const std::string& path);
+    void parse(const char* text, size_t len);
+    size_t eventCount() const { return m_script.size(); }
+
+    // Plays the stream in real time, starting at the first wait(). The
+    // table stops waiting before it releases this source, which the
+    // returned object refers to.
+    std::unique_ptr<DeviceEventSource> events();
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    bool queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget, ResultSet& rows,
+                      std::vector<std::string>& paths);
+    void threadAttach() { m_inner->threadAttach(); }
+    void threadDetach() { m_inner->threadDetach(); }
+
+private:
+    struct Scripted {
+        std::chrono::milliseconds at;
+        DeviceEvent event;
+        ResultSet props; // one row
+    };
+    // A tracked class with the events played so far applied. Dropped rows
+    // stay behind as tombstones, so row numbers never move.
+    struct Devices {
+        Devices() : loaded(false) {}
+
+        ResultSet rows; // every property
+        std::vector<bool> gone;
+        std::unordered_map<std::string, size_t> byId; // PNPDeviceID of live rows
+        bool loaded;
+    };
+    class Player;
+
+    // Applies script[index] to its class and returns its event.
+    const DeviceEvent& play(size_t index);
+    Devices& devices(int tracked);
+    static void applyTo(Scripted& s, Devices& d);
+
+    std::unique_ptr<DataSource> m_inner;
+    std::vector<Scripted> m_script;
+    std::mutex m_mutex;
+    std::vector<Devices> m_devices; // per tracked class
+};
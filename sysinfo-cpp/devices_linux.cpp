@@ -0,0 +1,106 @@
+#include "devices.h"
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// The kernel broadcasts uevents to multicast group 1; udevd re-sends them
+// (after its rules ran) to group 2, which needs a running udevd.
+const unsigned kKernelUevents = 1;
+
+int openNetlink(int protocol, unsigned groups) {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, protocol);
+    if (fd < 0) return -1;
+    sockaddr_nl addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = groups;
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    // Room for a hub's worth of devices arriving at once; best effort.
+    int size = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    return fd;
+}
+
+// Kernel uevents for device presence, plus rtnetlink link messages: an
+// adapter's carrier, operstate and speed change without a uevent.
+class NetlinkEvents : public DeviceEventSource {
+public:
+    NetlinkEvents(int uevents, int links) : m_uevents(uevents), m_links(links) {}
+    ~NetlinkEvents() {
+        close(m_uevents);
+        close(m_links);
+    }
+
+    bool wait(std::vector<DeviceEvent>& out, std::chrono::milliseconds timeout) {
+        pollfd fds[2] = { { m_uevents, POLLIN, 0 }, { m_links, POLLIN, 0 } };
+        if (poll(fds, 2, static_cast<int>(timeout.count())) <= 0) return true;
+        if (fds[0].revents) drainUevents(out);
+        if (fds[1].revents) drainLinks(out);
+        return true;
+    }
+
+private:
+    // Reads one datagram without blocking; false when the socket is empty.
+    // An overflowed socket lost events: report that as a resync.
+    bool receive(int fd, ssize_t& n, std::vector<DeviceEvent>& out) {
+        for (;;) {
+            n = recv(fd, m_buf, sizeof(m_buf), MSG_DONTWAIT);
+            if (n >= 0) return true;
+            if (errno == ENOBUFS) out.push_back(DeviceEvent());
+            else if (errno != EINTR) return false;
+        }
+    }
+
+    void drainUevents(std::vector<DeviceEvent>& out) {
+        ssize_t n;
+        DeviceEvent event;
+        while (receive(m_uevents, n, out)) {
+            if (parseUevent(m_buf, static_cast<size_t>(n), event)) out.push_back(event);
+        }
+    }
+
+    void drainLinks(std::vector<DeviceEvent>& out) {
+        ssize_t n;
+        while (receive(m_links, n, out)) {
+            int left = static_cast<int>(n);
+            for (const nlmsghdr* h = reinterpret_cast<const nlmsghdr*>(m_buf); NLMSG_OK(h, left); h = NLMSG_NEXT(h, left)) {
+                if (h->nlmsg_type != RTM_NEWLINK && h->nlmsg_type != RTM_DELLINK) continue;
+                const ifinfomsg* ifi = static_cast<const ifinfomsg*>(NLMSG_DATA(h));
+                out.push_back(DeviceEvent(DeviceEvent::Change, "net", std::to_string(ifi->ifi_index)));
+            }
+        }
+    }
+
+    int m_uevents;
+    int m_links;
+    char m_buf[16384]; // a uevent is at most 8 KiB; link messages carry their statistics
+};
+
+} // namespace
+
+std::unique_ptr<DeviceEventSource> openDeviceEvents() {
+    int uevents = openNetlink(NETLINK_KOBJECT_UEVENT, kKernelUevents);
+    int links = uevents >= 0 ? openNetlink(NETLINK_ROUTE, RTMGRP_LINK) : -1;
+    if (links < 0) {
+        std::wcerr << L"Device events unavailable (netlink: " << std::strerror(errno) << L"); devices are re-enumerated"
+                   << std::endl;
+        if (uevents >= 0) close(uevents);
+        return std::unique_ptr<DeviceEventSource>();
+    }
+    return std::unique_ptr<DeviceEventSource>(new NetlinkEvents(uevents, links));
+}
@@ -0,0 +1,131 @@
+#define NOMINMAX
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0602 // CM_Register_Notification
+#endif
+#include <winsock2.h>
+#include <windows.h>
+#include <cfgmgr32.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <cwchar>
+#include <iostream>
+#include <mutex>
+
+#include "devices.h"
+
+#pragma comment(lib, "cfgmgr32.lib")
+#pragma comment(lib, "iphlpapi.lib")
+
+namespace {
+
+// Device interface classes and the subsystem they stand for. Spelled out
+// here rather than pulling in usbiodef.h, ntddstor.h, ksmedia.h and
+// ndisguid.h for one GUID each.
+struct InterfaceClass {
+    GUID guid;
+    const char* subsystem;
+};
+
+const InterfaceClass kInterfaceClasses[] = {
+    // GUID_DEVINTERFACE_USB_DEVICE
+    { { 0xA5DCBF10, 0x6530, 0x11D2, { 0x90, 0x1F, 0x00, 0xC0, 0x4F, 0xB9, 0x51, 0xED } }, "usb" },
+    // GUID_DEVINTERFACE_DISK
+    { { 0x53F56307, 0xB6BF, 0x11D0, { 0x94, 0xF2, 0x00, 0xA0, 0xC9, 0x1E, 0xFB, 0x8B } }, "block" },
+    // KSCATEGORY_AUDIO
+    { { 0x6994AD04, 0x93EF, 0x11D0, { 0xA3, 0xCC, 0x00, 0xA0, 0xC9, 0x22, 0x31, 0x96 } }, "sound" },
+    // GUID_DEVINTERFACE_NET
+    { { 0xCAC88484, 0x7515, 0x4C03, { 0x82, 0xE6, 0x71, 0xA8, 0x7A, 0xBA, 0xC3, 0x61 } }, "net" },
+};
+
+// The instance ID of the device behind an interface path, which is what
+// WMI's PNPDeviceID holds: "\\?\USB#VID_0781&PID_5581#4C53...#{a5dcbf10-...}"
+// is "USB\VID_0781&PID_5581\4C53...". Upper case, as WMI reports them.
+std::string instanceId(const wchar_t* s) {
+    if (std::wcsncmp(s, L"\\\\?\\", 4) == 0) s += 4;
+    std::string out;
+    for (; *s && !(s[0] == L'#' && s[1] == L'{'); ++s) {
+        const wchar_t c = *s == L'#' ? L'\\' : *s;
+        out += c < 0x80 ? static_cast<char>(std::toupper(static_cast<int>(c))) : '?'; // interface paths are ASCII
+    }
+    return out;
+}
+
+// Configuration manager notifications for device interfaces arriving and
+// going away (what RegisterDeviceNotification delivers to a window,
+// without needing one), plus IP interface changes for link state. Both
+// call back on system threads; wait() hands their events over.
+class CmEvents : public DeviceEventSource {
+public:
+    CmEvents() : m_devices(nullptr), m_links(nullptr) {}
+    ~CmEvents() {
+        // Both unregister calls wait for callbacks in flight.
+        if (m_devices) CM_Unregister_Notification(m_devices);
+        if (m_links) CancelMibChangeNotify2(m_links);
+    }
+
+    bool subscribe() {
+        CM_NOTIFY_FILTER filter;
+        std::memset(&filter, 0, sizeof(filter));
+        filter.cbSize = sizeof(filter);
+        filter.Flags = CM_NOTIFY_FILTER_FLAG_ALL_INTERFACE_CLASSES;
+        filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+        if (CM_Register_Notification(&filter, this, onDevice, &m_devices) != CR_SUCCESS) return false;
+        return NotifyIpInterfaceChange(AF_UNSPEC, onLink, this, FALSE, &m_links) == NO_ERROR;
+    }
+
+    bool wait(std::vector<DeviceEvent>& out, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.wait_for(lock, timeout, [this] { return !m_pending.empty(); });
+        out.insert(out.end(), m_pending.begin(), m_pending.end());
+        m_pending.clear();
+        return true;
+    }
+
+private:
+    void push(const DeviceEvent& event) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(event);
+        m_ready.notify_one();
+    }
+
+    static DWORD CALLBACK onDevice(HCMNOTIFICATION, PVOID context, CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA data,
+                                   DWORD) {
+        if (action != CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL && action != CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL) {
+            return ERROR_SUCCESS;
+        }
+        const GUID& guid = data->u.DeviceInterface.ClassGuid;
+        for (size_t k = 0; k < sizeof(kInterfaceClasses) / sizeof(kInterfaceClasses[0]); ++k) {
+            if (!IsEqualGUID(guid, kInterfaceClasses[k].guid)) continue;
+            DeviceEvent::Action a = action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL ? DeviceEvent::Add : DeviceEvent::Remove;
+            static_cast<CmEvents*>(context)->push(
+                DeviceEvent(a, kInterfaceClasses[k].subsystem, instanceId(data->u.DeviceInterface.SymbolicLink)));
+        }
+        return ERROR_SUCCESS;
+    }
+
+    static VOID NETIOAPI_API_ onLink(PVOID context, PMIB_IPINTERFACE_ROW row, MIB_NOTIFICATION_TYPE) {
+        const std::string index = row ? std::to_string(row->InterfaceIndex) : std::string();
+        static_cast<CmEvents*>(context)->push(DeviceEvent(DeviceEvent::Change, "net", index));
+    }
+
+    HCMNOTIFICATION m_devices;
+    HANDLE m_links;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::vector<DeviceEvent> m_pending;
+};
+
+} // namespace
+
+std::unique_ptr<DeviceEventSource> openDeviceEvents() {
+    std::unique_ptr<CmEvents> events(new CmEvents());
+    if (!events->subscribe()) {
+        std::wcerr << L"Device events unavailable; devices are re-enumerated" << std::endl;
+        return std::unique_ptr<DeviceEventSource>();
+    }
+    return std::unique_ptr<DeviceEventSource>(events.release());
+}
@@ -0,0 +1,370 @@
+#include "diff.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+#include "schema.h"
+#include "sections.h"
+
+namespace {
+
+// NULL and "" both mean "not reported": the Linux collectors leave a
+// property out where a recording from WMI has an empty string.
+bool blank(const Value& v) {
+    return v.isNull() || (v.type == ValueType::String && v.s.n == 0);
+}
+
+bool sameContent(const Value& a, const Value& b) {
+    return blank(a) ? blank(b) : a.equals(b);
+}
+
+// FNV-1a. Not collision resistant, which spotting accidental change
+// doesn't need.
+class Hasher {
+public:
+    Hasher() : m_h(14695981039346656037ull) {}
+
+    void bytes(const void* p, size_t n) {
+        const unsigned char* b = static_cast<const unsigned char*>(p);
+        for (size_t k = 0; k < n; ++k) m_h = (m_h ^ b[k]) * 1099511628211ull;
+    }
+    void u64(uint64_t v) {
+        unsigned char b[8];
+        for (int k = 0; k < 8; ++k) b[k] = static_cast<unsigned char>(v >> (8 * k));
+        bytes(b, 8);
+    }
+    void str(const char* s, size_t n) {
+        u64(n);
+        bytes(s, n);
+    }
+    void value(const Value& v) {
+        const unsigned char type = static_cast<unsigned char>(blank(v) ? ValueType::Null : v.type);
+        bytes(&type, 1);
+        switch (v.type) {
+        case ValueType::Int: u64(static_cast<uint64_t>(v.i)); break;
+        case ValueType::Uint: u64(v.u); break;
+        case ValueType::Bool: u64(v.b ? 1 : 0); break;
+        case ValueType::String:
+            if (v.s.n) str(v.s.p, v.s.n);
+            break;
+        default: break;
+        }
+    }
+    uint64_t digest() const { return m_h; }
+
+private:
+    uint64_t m_h;
+};
+
+const ClassSchema* schemaOf(const std::string& cls) {
+    return findClassSchema(std::wstring(cls.begin(), cls.end())); // class names are ASCII
+}
+
+// Classes made only of readings, like the process list, aren't hardware:
+// snapshots don't compare them at all.
+bool comparable(const ClassSchema* schema) {
+    for (size_t f = 0; schema && f < schema->fieldCount; ++f) {
+        if (!schema->fields[f].reading) return true;
+    }
+    return !schema;
+}
+
+// Columns of a result that are content: all but the schema's readings.
+std::vector<bool> contentColumns(const ClassSchema* schema, const ResultSet& rs) {
+    std::vector<bool> content(rs.columnCount(), true);
+    for (size_t f = 0; schema && f < schema->fieldCount; ++f) {
+        const int c = rs.column(schema->fields[f].property);
+        if (c >= 0 && schema->fields[f].reading) content[c] = false;
+    }
+    return content;
+}
+
+uint64_t deviceDigest(const ResultSet& rs, size_t row, const std::vector<bool>& content) {
+    Hasher h;
+    for (size_t c = 0; c < content.size(); ++c) {
+        if (!content[c]) continue;
+        const std::string& name = rs.columnName(static_cast<int>(c));
+        h.str(name.data(), name.size());
+        h.value(rs.at(row, static_cast<int>(c)));
+    }
+    return h.digest();
+}
+
+struct Device {
+    std::wstring key;
+    uint64_t digest;
+    size_t row;
+    bool numbered; // no key value: numbered among the others without
+    bool operator<(const Device& other) const { return key < other.key; }
+};
+
+bool byKeyThenDigest(const Device& a, const Device& b) {
+    return a.key != b.key ? a.key < b.key : a.digest < b.digest;
+}
+
+// The columns of a schema's key, for those of its properties present.
+std::vector<int> keyColumns(const ClassSchema* schema, const ResultSet& rs) {
+    std::vector<int> cols;
+    for (const char* p = schema ? schema->key : nullptr; p && *p;) {
+        const char* e = std::strchr(p, ',');
+        if (!e) e = p + std::strlen(p);
+        const int c = rs.column(std::string(p, e).c_str());
+        if (c >= 0) cols.push_back(c);
+        p = *e ? e + 1 : e;
+    }
+    return cols;
+}
+
+// The rows of a result as devices, sorted by key. Repeated keys get a
+// counter in the order of the devices' digests, and rows without a key
+// value are numbered the same way, so reordered rows keep their keys.
+// Rows of classes without a key (one row each) are keyed by position.
+std::vector<Device> devicesOf(const ClassSchema* schema, const ResultSet& rs) {
+    const std::vector<bool> content = contentColumns(schema, rs);
+    const std::vector<int> cKeys = keyColumns(schema, rs);
+    std::vector<Device> devices(rs.columnCount() ? rs.rowCount() : 0);
+    for (size_t r = 0; r < devices.size(); ++r) {
+        Device& d = devices[r];
+        for (size_t k = 0; k < cKeys.size(); ++k) {
+            if (rs.at(r, cKeys[k]).isNull()) continue;
+            if (!d.key.empty()) d.key += L" / ";
+            d.key += safeGet(rs, r, cKeys[k]);
+        }
+        d.numbered = d.key.empty() && schema && schema->key;
+        if (d.key.empty() && !d.numbered && (!schema || r)) {
+            d.key = L"#" + std::to_wstring(static_cast<unsigned long long>(r + 1));
+        }
+        d.digest = deviceDigest(rs, r, content);
+        d.row = r;
+    }
+    std::sort(devices.begin(), devices.end(), byKeyThenDigest);
+    std::vector<size_t> run(devices.size(), 1);
+    for (size_t i = 1; i < devices.size(); ++i) {
+        if (devices[i].key == devices[i - 1].key) run[i] = run[i - 1] + 1;
+    }
+    for (size_t i = 0; i < devices.size(); ++i) {
+        const std::wstring n = std::to_wstring(static_cast<unsigned long long>(run[i]));
+        if (devices[i].numbered) devices[i].key = L"#" + n;
+        else if (run[i] > 1) devices[i].key += L" #" + n;
+    }
+    std::sort(devices.begin(), devices.end());
+    return devices;
+}
+
+// The content properties whose values differ between two rows.
+void diffFields(const ClassSchema* schema, const ResultSet& a, size_t ra, const ResultSet& b, size_t rb,
+                std::vector<FieldChange>& fields) {
+    const std::vector<bool> contentA = contentColumns(schema, a), contentB = contentColumns(schema, b);
+    for (size_t c = 0; c < b.columnCount(); ++c) {
+        if (!contentB[c]) continue;
+        const std::string& name = b.columnName(static_cast<int>(c));
+        const int ca = a.column(name.c_str());
+        if (sameContent(a.at(ra, ca), b.at(rb, static_cast<int>(c)))) continue;
+        FieldChange change = { name, safeGet(a, ra, ca), safeGet(b, rb, static_cast<int>(c)) };
+        fields.push_back(change);
+    }
+    for (size_t c = 0; c < a.columnCount(); ++c) {
+        const std::string& name = a.columnName(static_cast<int>(c));
+        if (!contentA[c] || b.column(name.c_str()) >= 0 || blank(a.at(ra, static_cast<int>(c)))) continue;
+        FieldChange change = { name, safeGet(a, ra, static_cast<int>(c)), safeGet(b, rb, -1) };
+        fields.push_back(change);
+    }
+}
+
+const ResultSet* findQuery(const ReportSection& section, const std::string& cls) {
+    for (size_t q = 0; q < section.classes.size() && q < section.results.size(); ++q) {
+        if (section.classes[q] == cls) return &section.results[q];
+    }
+    return nullptr;
+}
+
+const SnapshotSection* findSection(const std::vector<SnapshotSection>& sections, const std::string& id) {
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (sections[i].id == id) return &sections[i];
+    }
+    return nullptr;
+}
+
+const wchar_t* kindName(DeviceChange::Kind kind) {
+    switch (kind) {
+    case DeviceChange::Added: return L"Added   ";
+    case DeviceChange::Removed: return L"Removed ";
+    case DeviceChange::Modified: return L"Modified";
+    default: return L"Partial ";
+    }
+}
+
+std::wstring widen(const std::string& ascii) {
+    return std::wstring(ascii.begin(), ascii.end());
+}
+
+} // namespace
+
+uint64_t sectionDigest(const std::vector<std::string>& classes, const std::vector<ResultSet>& results) {
+    Hasher section;
+    std::vector<uint64_t> devices;
+    for (size_t q = 0; q < results.size(); ++q) {
+        const ResultSet& rs = results[q];
+        const std::string cls = q < classes.size() ? classes[q] : std::string();
+        if (!comparable(schemaOf(cls))) continue;
+        const std::vector<bool> content = contentColumns(schemaOf(cls), rs);
+        devices.assign(rs.columnCount() ? rs.rowCount() : 0, 0);
+        for (size_t r = 0; r < devices.size(); ++r) devices[r] = deviceDigest(rs, r, content);
+        std::sort(devices.begin(), devices.end()); // row order is not content
+
+        Hasher query;
+        query.str(cls.data(), cls.size());
+        query.u64(static_cast<uint64_t>(rs.status()));
+        for (size_t r = 0; r < devices.size(); ++r) query.u64(devices[r]);
+        section.u64(query.digest());
+    }
+    return section.digest();
+}
+
+bool indexSnapshot(const void* data, size_t len, std::vector<SnapshotSection>& sections, std::string& error) {
+    BinReportReader reader;
+    sections.clear();
+    if (!reader.open(data, len)) {
+        error = reader.error();
+        return false;
+    }
+    SnapshotSection section;
+    while (reader.peek(section.id, section.digest)) {
+        if (section.digest) {
+            reader.skip();
+        } else if (reader.next(section.data)) {
+            section.digest = sectionDigest(section.data.classes, section.data.results);
+            section.loaded = true;
+        }
+        sections.push_back(std::move(section));
+        section = SnapshotSection();
+    }
+    error = reader.error();
+    return error.empty();
+}
+
+bool loadChangedSections(const void* data, size_t len, std::vector<SnapshotSection>& sections, std::string& error) {
+    BinReportReader reader;
+    if (!reader.open(data, len)) {
+        error = reader.error();
+        return false;
+    }
+    // `sections` follows the report's order but may leave some out.
+    std::string id;
+    uint64_t digest;
+    for (size_t i = 0; i < sections.size() && reader.peek(id, digest);) {
+        SnapshotSection& section = sections[i];
+        if (id != section.id || !section.changed || section.loaded) {
+            if (!reader.skip()) break;
+            if (id == section.id) ++i;
+        } else if (reader.next(section.data)) {
+            section.loaded = true;
+            ++i;
+        }
+    }
+    error = reader.error();
+    return error.empty();
+}
+
+size_t markChangedSections(std::vector<SnapshotSection>& before, std::vector<SnapshotSection>& after) {
+    size_t distinct = before.size();
+    for (size_t i = 0; i < before.size(); ++i) {
+        const SnapshotSection* other = findSection(after, before[i].id);
+        before[i].changed = !other || other->digest != before[i].digest;
+    }
+    for (size_t i = 0; i < after.size(); ++i) {
+        const SnapshotSection* other = findSection(before, after[i].id);
+        after[i].changed = !other || other->changed;
+        if (!other) ++distinct;
+    }
+    return distinct;
+}
+
+void diffSection(const ReportSection& before, const ReportSection& after, std::vector<DeviceChange>& changes) {
+    std::vector<std::string> classes = before.classes;
+    for (size_t q = 0; q < after.classes.size(); ++q) {
+        if (std::find(classes.begin(), classes.end(), after.classes[q]) == classes.end()) classes.push_back(after.classes[q]);
+    }
+    const std::string& id = before.id.empty() ? after.id : before.id;
+    const ResultSet none;
+    for (size_t q = 0; q < classes.size(); ++q) {
+        const std::string& cls = classes[q];
+        const ClassSchema* schema = schemaOf(cls);
+        if (!comparable(schema)) continue;
+        const ResultSet* pa = findQuery(before, cls);
+        const ResultSet* pb = findQuery(after, cls);
+        const ResultSet& a = pa ? *pa : none;
+        const ResultSet& b = pb ? *pb : none;
+        // Rows missing from a cut-short query say nothing about the device.
+        const bool complete = !a.partial() && !b.partial();
+        if (!complete) {
+            DeviceChange change = { DeviceChange::Incomplete, id, cls, std::wstring(), std::vector<FieldChange>() };
+            changes.push_back(change);
+        }
+
+        const std::vector<Device> da = devicesOf(schema, a), db = devicesOf(schema, b);
+        size_t i = 0, j = 0;
+        while (i < da.size() || j < db.size()) {
+            DeviceChange change = { DeviceChange::Modified, id, cls, std::wstring(), std::vector<FieldChange>() };
+            if (j == db.size() || (i < da.size() && da[i] < db[j])) {
+                change.kind = DeviceChange::Removed;
+                change.key = da[i++].key;
+                if (complete) changes.push_back(change);
+            } else if (i == da.size() || db[j] < da[i]) {
+                change.kind = DeviceChange::Added;
+                change.key = db[j++].key;
+                if (complete) changes.push_back(change);
+            } else {
+                if (da[i].digest != db[j].digest) {
+                    change.key = db[j].key;
+                    diffFields(schema, a, da[i].row, b, db[j].row, change.fields);
+                    changes.push_back(change);
+                }
+                ++i;
+                ++j;
+            }
+        }
+    }
+}
+
+std::vector<DeviceChange> diffSnapshots(const std::vector<SnapshotSection>& before,
+                                        const std::vector<SnapshotSection>& after) {
+    std::vector<DeviceChange> changes;
+    const ReportSection empty;
+    for (size_t i = 0; i < before.size(); ++i) {
+        if (!before[i].changed) continue;
+        const SnapshotSection* other = findSection(after, before[i].id);
+        diffSection(before[i].data, other ? other->data : empty, changes);
+    }
+    for (size_t i = 0; i < after.size(); ++i) {
+        if (after[i].changed && !findSection(before, after[i].id)) diffSection(empty, after[i].data, changes);
+    }
+    return changes;
+}
+
+void printChanges(const std::vector<DeviceChange>& changes, size_t sections, std::wostream& out) {
+    out << L"[Hardware Changes]" << std::endl;
+    size_t devices = 0, changedSections = 0;
+    for (size_t k = 0; k < changes.size(); ++k) {
+        const DeviceChange& change = changes[k];
+        out << L"  " << kindName(change.kind) << L"  " << widen(change.section) << L": " << widen(change.cls);
+        if (!change.key.empty()) out << L" " << change.key;
+        if (change.kind == DeviceChange::Incomplete) {
+            out << L" (query cut short; additions and removals not reported)";
+        } else {
+            if (!devices++ || change.section != changes[k - 1].section) ++changedSections;
+        }
+        out << std::endl;
+        for (size_t f = 0; f < change.fields.size(); ++f) {
+            out << L"      " << widen(change.fields[f].property) << L": " << change.fields[f].before << L" -> "
+                << change.fields[f].after << std::endl;
+        }
+    }
+    if (!devices) {
+        out << L"  No hardware changes in " << sections << L" section" << (sections == 1 ? L"" : L"s") << L"." << std::endl;
+    } else {
+        out << L"  " << devices << L" device" << (devices == 1 ? L"" : L"s") << L" changed in " << changedSections
+            << L" of " << sections << L" section" << (sections == 1 ? L"" : L"s") << L"." << std::endl;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "report_bin.h"
+
+// Hardware change detection between two snapshots (binary reports).
+//
+// Content hashes form a Merkle tree: a device (one row) hashes its
+// property names and values, a query its class, status and the sorted
+// hashes of its devices, and a section the hashes of its queries. Row
+// order is not content, and neither are readings (FieldDef::reading) such
+// as free space or link state, which change between any two runs; nor is
+// NULL versus "", which is how the platforms differ in leaving a property
+// unreported. Classes with nothing but readings (the process list) are
+// left out entirely.
+//
+// Binary reports store each section's hash in its record, so snapshots of
+// an unchanged machine compare by reading a dozen record headers. Only
+// sections whose hashes differ are decoded, and their devices matched by
+// the schema's key (ClassSchema::key).
+
+// Content hash of a section as appendBinSection() records it.
+uint64_t sectionDigest(const std::vector<std::string>& classes, const std::vector<ResultSet>& results);
+
+// A section of a snapshot. `data` is filled in once it is decoded.
+struct SnapshotSection {
+    SnapshotSection() : digest(0), changed(false), loaded(false) {}
+    std::string id;
+    uint64_t digest;
+    bool changed; // set by markChangedSections()
+    bool loaded;
+    ReportSection data;
+};
+
+// Reads the id and digest of every section of a binary report. Sections
+// without one (version 2 reports) are decoded and hashed instead.
+// False (with `error` set) for foreign or corrupt data.
+bool indexSnapshot(const void* data, size_t len, std::vector<SnapshotSection>& sections, std::string& error);
+
+// Decodes the sections of an indexed report that are changed and not yet
+// loaded. Sections may have been dropped from the index since.
+bool loadChangedSections(const void* data, size_t len, std::vector<SnapshotSection>& sections, std::string& error);
+
+// Marks the sections whose digests differ, or that only one snapshot has,
+// as changed. Returns how many distinct sections the two have.
+size_t markChangedSections(std::vector<SnapshotSection>& before, std::vector<SnapshotSection>& after);
+
+struct FieldChange {
+    std::string property;
+    std::wstring before;
+    std::wstring after;
+};
+
+struct DeviceChange {
+    enum Kind {
+        Added,
+        Removed,
+        Modified,
+        Incomplete // a query was cut short on either side; no adds or removes reported for it
+    };
+    Kind kind;
+    std::string section;
+    std::string cls;
+    std::wstring key;                // empty for single-row classes
+    std::vector<FieldChange> fields; // Modified only
+};
+
+// Device changes between two versions of one section. Queries are matched
+// by class and devices by key; a missing side counts as empty.
+void diffSection(const ReportSection& before, const ReportSection& after, std::vector<DeviceChange>& changes);
+
+// Device changes between two snapshots whose changed sections are loaded.
+std::vector<DeviceChange> diffSnapshots(const std::vector<SnapshotSection>& before,
+                                        const std::vector<SnapshotSection>& after);
+
+// Prints the changes, one device per line, under a "[Hardware Changes]"
+// header. `sections` is how many sections were compared.
+void printChanges(const std::vector<DeviceChange>& changes, size_t sections, std::wostream& out);
@@ -0,0 +1,55 @@
+#include "enumerate.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// Longest single wait, so a cancelled run stops within about this long.
+const std::chrono::milliseconds kWaitSlice(100);
+
+} // namespace
+
+QueryStatus enumerateBatched(ObjectEnumerator& e, size_t batch, const QueryBudget& budget,
+                             const std::function<void(size_t objects)>& take) {
+    if (batch == 0) batch = 1;
+    for (;;) {
+        const QueryStatus status = budget.check();
+        if (status != QueryStatus::Complete) return status;
+        const EnumStep step = e.next(budget.remaining(kWaitSlice), batch);
+        if (step.objects) take(step.objects);
+        if (step.done) return QueryStatus::Complete;
+    }
+}
+
+FakeEnumerator::FakeEnumerator(size_t objects, const Latency& latency)
+    : m_total(objects), m_pos(0), m_calls(0), m_latency(latency), m_startupLeft(latency.startup) {}
+
+EnumStep FakeEnumerator::next(std::chrono::milliseconds timeout, size_t count) {
+    typedef std::chrono::microseconds us;
+    const us limit = std::chrono::duration_cast<us>(timeout);
+    EnumStep step = { 0, false };
+    ++m_calls;
+
+    // Every round trip pays its overhead, then the provider's start-up
+    // cost once, then each object.
+    us used = std::min(m_latency.perCall, limit);
+    if (m_startupLeft > us::zero()) {
+        const us wait = std::min(m_startupLeft, limit - used);
+        used += wait;
+        m_startupLeft -= wait;
+    }
+    const size_t available = std::min(m_total, m_latency.stallAfter);
+    while (m_startupLeft == us::zero() && step.objects < count && m_pos < available &&
+           used + m_latency.perObject <= limit) {
+        used += m_latency.perObject;
+        ++m_pos;
+        ++step.objects;
+    }
+    step.done = m_pos >= m_total;
+    // Like Next(), a short batch that isn't the end means the call waited
+    // out its whole timeout.
+    if (step.objects < count && !step.done) used = limit;
+    if (used > us::zero()) std::this_thread::sleep_for(used);
+    return step;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+#include "datasource.h"
+
+// Objects requested per round trip unless --batch says otherwise.
+const size_t kDefaultEnumBatch = 32;
+
+// What one round trip of an object enumerator produced.
+struct EnumStep {
+    size_t objects; // delivered by this call
+    bool done;      // end of the results (or a provider error)
+};
+
+// A forward-only stream of result objects fetched in round trips, the way
+// IEnumWbemClassObject::Next works: wait at most `timeout` for up to
+// `count` objects and return whatever arrived.
+class ObjectEnumerator {
+public:
+    virtual ~ObjectEnumerator() {}
+    virtual EnumStep next(std::chrono::milliseconds timeout, size_t count) = 0;
+};
+
+// Fetches up to `batch` objects per round trip until the enumerator is
+// done or the budget runs out, handing each step's objects to `take`.
+// Waits are cut into short slices so cancellation is noticed promptly.
+QueryStatus enumerateBatched(ObjectEnumerator& e, size_t batch, const QueryBudget& budget,
+                             const std::function<void(size_t objects)>& take);
+
+// Simulated provider with injectable latency, so batching and timeouts can
+// be exercised without WMI. Latencies are real sleeps.
+class FakeEnumerator : public ObjectEnumerator {
+public:
+    struct Latency {
+        Latency() : startup(0), perCall(0), perObject(0), stallAfter(static_cast<size_t>(-1)) {}
+        std::chrono::microseconds startup;   // before the first object
+        std::chrono::microseconds perCall;   // every round trip
+        std::chrono::microseconds perObject; // every object delivered
+        size_t stallAfter;                   // objects past this never arrive (a hung provider)
+    };
+
+    FakeEnumerator(size_t objects, const Latency& latency);
+
+    EnumStep next(std::chrono::milliseconds timeout, size_t count);
+
+    size_t calls() const { return m_calls; }
+    size_t position() const { return m_pos; }
+
+private:
+    size_t m_total;
+    size_t m_pos;
+    size_t m_calls;
+    Latency m_latency;
+    std::chrono::microseconds m_startupLeft;
+};
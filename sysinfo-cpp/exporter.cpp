@@ -0,0 +1,353 @@
+#include "exporter.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "metrics.h"
+
+namespace {
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+const Socket kNoSocket = INVALID_SOCKET;
+const int kSendFlags = 0;
+void closeSocket(Socket s) { closesocket(s); }
+std::string socketError() { return "error " + std::to_string(WSAGetLastError()); }
+#else
+typedef int Socket;
+const Socket kNoSocket = -1;
+const int kSendFlags = MSG_NOSIGNAL; // a scraper hanging up is not fatal
+void closeSocket(Socket s) { close(s); }
+std::string socketError() { return std::strerror(errno); }
+#endif
+
+// Set by SIGINT/SIGTERM; also cancels the collection in flight.
+std::atomic<bool> g_stop(false);
+
+void onStopSignal(int) {
+    g_stop = true;
+}
+
+// How long a scraper may take to send its whole request and read the
+// whole response, however it trickles them.
+const std::chrono::milliseconds kClientDeadline(2000);
+// Connections served at once, and how many more may wait for a turn
+// before new ones are turned away.
+const unsigned kClientThreads = 4;
+const size_t kMaxWaiting = 64;
+const char kLoopback[] = "127.0.0.1";
+// Requests are a request line and a few headers; anything bigger is not a
+// scrape.
+const size_t kMaxRequest = 8192;
+const std::chrono::milliseconds kStopPoll(250);
+
+// A complete HTTP response; HEAD sends only the first headerLength bytes.
+struct Page {
+    std::string response;
+    size_t headerLength;
+};
+
+Page makePage(const char* status, const char* contentType, const std::string& body) {
+    Page page;
+    page.response.reserve(body.size() + 160);
+    page.response += "HTTP/1.1 ";
+    page.response += status;
+    page.response += "\r\nContent-Type: ";
+    page.response += contentType;
+    page.response += "\r\nContent-Length: ";
+    page.response += std::to_string(static_cast<unsigned long long>(body.size()));
+    page.response += "\r\nConnection: close\r\n\r\n";
+    page.headerLength = page.response.size();
+    page.response += body;
+    return page;
+}
+
+// Waits until `s` is readable (or writable) or `deadline` passes.
+bool waitFor(Socket s, bool write, std::chrono::steady_clock::time_point deadline) {
+    const std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero()) return false;
+    const long long us = std::chrono::duration_cast<std::chrono::microseconds>(left).count();
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(s, &set);
+    timeval tv;
+    tv.tv_sec = static_cast<long>(us / 1000000);
+    tv.tv_usec = static_cast<long>(us % 1000000);
+    return select(static_cast<int>(s + 1), write ? nullptr : &set, write ? &set : nullptr, nullptr, &tv) > 0;
+}
+
+void sendAll(Socket s, const char* p, size_t n, std::chrono::steady_clock::time_point deadline) {
+    while (n && waitFor(s, true, deadline)) {
+        const int chunk = n > (1u << 30) ? (1 << 30) : static_cast<int>(n);
+        const int sent = static_cast<int>(send(s, p, chunk, kSendFlags));
+        if (sent <= 0) return;
+        p += sent;
+        n -= static_cast<size_t>(sent);
+    }
+}
+
+Socket openListener(const std::string& host, const std::string& port, std::string& error) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* found = nullptr;
+    const int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+    if (rc != 0) {
+        error = gai_strerror(rc);
+        return kNoSocket;
+    }
+    Socket s = kNoSocket;
+    for (addrinfo* a = found; a && s == kNoSocket; a = a->ai_next) {
+        s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (s == kNoSocket) continue;
+#ifndef _WIN32
+        // Restarting the exporter shouldn't wait out TIME_WAIT.
+        const int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#endif
+        if (bind(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0 || listen(s, 64) != 0) {
+            error = socketError();
+            closeSocket(s);
+            s = kNoSocket;
+        }
+    }
+    freeaddrinfo(found);
+    return s;
+}
+
+// Answers one connection from the latest page. The request is read to
+// its end before answering so that closing doesn't reset the connection
+// under the response. The whole exchange has kClientDeadline.
+void serveClient(Socket client, const std::shared_ptr<const Page>& metrics) {
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + kClientDeadline;
+    char request[kMaxRequest];
+    size_t len = 0;
+    for (;;) {
+        if (!waitFor(client, false, deadline)) return;
+        const int n = static_cast<int>(recv(client, request + len, static_cast<int>(sizeof(request) - len), 0));
+        if (n <= 0) return;
+        len += static_cast<size_t>(n);
+        if (len >= 4 && std::memcmp(request + len - 4, "\r\n\r\n", 4) == 0) break;
+        if (len == sizeof(request)) return;
+    }
+    const char* end = request + len;
+    const char* sp = static_cast<const char*>(std::memchr(request, ' ', len));
+    if (!sp) return;
+    const bool head = sp - request == 4 && std::memcmp(request, "HEAD", 4) == 0;
+    const bool get = sp - request == 3 && std::memcmp(request, "GET", 3) == 0;
+    const char* path = sp + 1;
+    const char* pathEnd = path;
+    while (pathEnd < end && *pathEnd != ' ' && *pathEnd != '?' && *pathEnd != '\r') ++pathEnd;
+    const std::string target(path, pathEnd);
+
+    static const Page notAllowed = makePage("405 Method Not Allowed", "text/plain; charset=utf-8", "Only GET and HEAD.\n");
+    static const Page notFound = makePage("404 Not Found", "text/plain; charset=utf-8", "Metrics are at /metrics.\n");
+    static const Page notReady =
+        makePage("503 Service Unavailable", "text/plain; charset=utf-8", "The first collection is still running.\n");
+    static const Page index = makePage("200 OK", "text/html; charset=utf-8",
+                                       "<html><body><a href=\"/metrics\">sysinfo metrics</a></body></html>\n");
+    const Page* page = &notFound;
+    if (!get && !head) page = &notAllowed;
+    else if (target == "/metrics") page = metrics ? metrics.get() : &notReady;
+    else if (target == "/") page = &index;
+    sendAll(client, page->response.data(), head ? page->headerLength : page->response.size(), deadline);
+}
+
+// Accepted connections waiting for one of the client threads.
+class ClientQueue {
+public:
+    // False if too many are waiting already.
+    bool push(Socket client) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_clients.size() >= kMaxWaiting) return false;
+        m_clients.push_back(client);
+        m_ready.notify_one();
+        return true;
+    }
+    // The next connection, or kNoSocket once stopped and drained.
+    Socket pop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_clients.empty() && !g_stop) m_ready.wait_for(lock, kStopPoll);
+        if (m_clients.empty()) return kNoSocket;
+        const Socket client = m_clients.front();
+        m_clients.pop_front();
+        return client;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::deque<Socket> m_clients;
+};
+
+void serveClients(ClientQueue* queue, const std::shared_ptr<const Page>* latest) {
+    for (Socket client; (client = queue->pop()) != kNoSocket;) {
+        serveClient(client, std::atomic_load(latest));
+        closeSocket(client);
+    }
+}
+
+// Collects every opt.refresh and publishes each rendering into `latest`.
+void refreshLoop(DataSource& src, const std::vector<SectionDef>& sections, const ExporterOptions& opt,
+                 std::shared_ptr<const Page>* latest) {
+    std::vector<std::vector<std::string> > classes(sections.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        for (size_t q = 0; q < sections[i].queries.size(); ++q) {
+            const std::wstring cls = wqlClassName(sections[i].queries[q]);
+            classes[i].push_back(std::string(cls.begin(), cls.end())); // class names are ASCII
+        }
+    }
+    std::vector<std::vector<QueryStatus> > statuses(sections.size());
+    MetricsWriter w;
+    uint64_t collections = 0;
+    size_t lastSize = 0;
+    while (!g_stop) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        w.clear();
+        w.buffer().reserve(lastSize + lastSize / 8);
+        collectSections(src, sections, opt.jobs, [&](size_t i, std::vector<ResultSet>& results) {
+            appendSectionMetrics(w, sections[i].id, results);
+            statuses[i].clear();
+            for (size_t q = 0; q < results.size(); ++q) statuses[i].push_back(results[q].status());
+        }, opt.limits);
+        if (g_stop) break;
+        ++collections;
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        w.family("sysinfo_query_complete", "gauge", "Whether a query returned all its rows in the last collection.");
+        for (size_t i = 0; i < sections.size(); ++i) {
+            for (size_t q = 0; q < statuses[i].size(); ++q) {
+                if (sections[i].queries[q].empty()) continue; // skipped by --fields
+                w.sample();
+                w.label("section", sections[i].id, std::strlen(sections[i].id));
+                w.label("class", classes[i][q].data(), classes[i][q].size());
+                w.value(static_cast<uint64_t>(statuses[i][q] == QueryStatus::Complete ? 1 : 0));
+            }
+        }
+        w.family("sysinfo_collect_duration_seconds", "gauge", "Wall time of the last collection.");
+        w.sample();
+        w.value(seconds, 6);
+        w.family("sysinfo_collect_timestamp_seconds", "gauge", "When the last collection finished.");
+        w.sample();
+        w.value(static_cast<uint64_t>(std::time(nullptr)));
+        w.family("sysinfo_collections", "counter", "Collections since the exporter started.");
+        w.sample();
+        w.value(collections);
+        w.eof();
+        lastSize = w.buffer().size();
+
+        std::shared_ptr<const Page> page = std::make_shared<Page>(makePage("200 OK", kOpenMetricsContentType, w.buffer()));
+        std::atomic_store(latest, page);
+
+        const std::chrono::steady_clock::time_point next = start + opt.refresh;
+        while (!g_stop && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(kStopPoll, next - std::chrono::steady_clock::now()));
+        }
+    }
+}
+
+} // namespace
+
+bool parseListenAddress(const char* text, std::string& host, std::string& port) {
+    const char* colon;
+    if (text[0] == '[') {
+        const char* close = std::strchr(text, ']');
+        if (!close || close[1] != ':') return false;
+        host.assign(text + 1, close);
+        colon = close + 1;
+    } else {
+        colon = std::strrchr(text, ':');
+        if (!colon) return false;
+        host.assign(text, colon);
+    }
+    port = colon + 1;
+    return !port.empty() && port.find_first_not_of("0123456789") == std::string::npos;
+}
+
+int runExporter(DataSource& src, const std::vector<SectionDef>& sections, const ExporterOptions& opt,
+                std::wostream& log) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        log << L"Could not initialize Winsock" << std::endl;
+        return 1;
+    }
+#endif
+    // No host: loopback. Every interface has to be asked for
+    // ("0.0.0.0:9100", "[::]:9100").
+    const std::string host = opt.host.empty() ? std::string(kLoopback) : opt.host;
+    std::string error;
+    const Socket listener = openListener(host, opt.port, error);
+    if (listener == kNoSocket) {
+        log << L"Could not listen on " << utf8ToWide(host.data(), host.size()) << L":"
+            << utf8ToWide(opt.port.data(), opt.port.size()) << L": " << utf8ToWide(error.data(), error.size()) << std::endl;
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 1;
+    }
+    log << L"Serving OpenMetrics on http://" << utf8ToWide(host.data(), host.size()) << L":"
+        << utf8ToWide(opt.port.data(), opt.port.size()) << L"/metrics, collecting every " << opt.refresh.count()
+        << L" ms (Ctrl+C to stop)" << std::endl;
+
+    g_stop = false;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    ExporterOptions collect = opt;
+    collect.limits.cancel = &g_stop;
+    std::shared_ptr<const Page> latest;
+    std::thread refresher(refreshLoop, std::ref(src), std::cref(sections), std::cref(collect), &latest);
+
+    // A scrape is a single send of a ready buffer, so a few threads keep up;
+    // the per-connection deadline frees one held by a stalled client.
+    ClientQueue queue;
+    std::vector<std::thread> servers;
+    for (unsigned k = 0; k < kClientThreads; ++k) servers.push_back(std::thread(serveClients, &queue, &latest));
+    while (!g_stop) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = static_cast<long>(std::chrono::microseconds(kStopPoll).count());
+        if (select(static_cast<int>(listener + 1), &readable, nullptr, nullptr, &tv) <= 0) continue;
+        const Socket client = accept(listener, nullptr, nullptr);
+        if (client != kNoSocket && !queue.push(client)) closeSocket(client);
+    }
+
+    closeSocket(listener);
+    for (size_t k = 0; k < servers.size(); ++k) servers[k].join();
+    refresher.join();
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
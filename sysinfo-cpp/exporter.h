@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+
+// Splits a --serve address: "127.0.0.1:9100", "[::1]:9100", "0.0.0.0:9100"
+// (every interface) or ":9100" (127.0.0.1). False if there is no port.
+bool parseListenAddress(const char* text, std::string& host, std::string& port);
+
+struct ExporterOptions {
+    ExporterOptions() : refresh(std::chrono::seconds(15)), jobs(0) {}
+    std::string host;                  // empty: 127.0.0.1 only
+    std::string port;
+    std::chrono::milliseconds refresh; // from the start of one collection to the next
+    unsigned jobs;
+    CollectLimits limits;              // per collection; cancel is set by the exporter
+};
+
+// Long-lived node exporter. A background thread collects `sections` every
+// opt.refresh and renders them as OpenMetrics text (metrics.h) into a
+// complete HTTP response, which it then swaps in atomically. Scrapes of
+// GET /metrics are served by a few client threads straight from the
+// latest response: they never query the source and cost one copy to the
+// socket. Each connection gets two seconds in all, so a client trickling
+// its request can't hold a thread for longer.
+// Until the first collection finishes /metrics answers 503.
+//
+// Runs until SIGINT/SIGTERM. Returns 0, or 1 if the address can't be
+// bound. A query still stuck at exit is abandoned as in collectSections(),
+// so check abandonedWorkers() before destroying `src`.
+int runExporter(DataSource& src, const std::vector<SectionDef>& sections, const ExporterOptions& opt,
+                std::wostream& log);
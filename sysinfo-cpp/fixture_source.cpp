@@ -0,0 +1,215 @@
+#include "fixture_source.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+#include "profile.h"
+
+namespace {
+
+void trimRight(const char* b, const char*& e) {
+    while (e > b && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) --e;
+}
+
+bool directive(const char* b, const char* e, const char* prefix) {
+    size_t n = std::strlen(prefix);
+    return static_cast<size_t>(e - b) > n && std::memcmp(b, prefix, n) == 0;
+}
+
+// "120" or "0.5" milliseconds.
+std::chrono::microseconds milliseconds(const char* b, const char* e) {
+    return std::chrono::microseconds(static_cast<long long>(std::strtod(std::string(b, e).c_str(), NULL) * 1000.0));
+}
+
+bool is(const char* b, const char* e, const char* word) {
+    size_t n = std::strlen(word);
+    return static_cast<size_t>(e - b) == n && std::memcmp(b, word, n) == 0;
+}
+
+// Stores "value" of the given fixture type into the last row.
+void setTyped(ResultSet& rs, int col, const char* tb, const char* te, const char* vb, const char* ve) {
+    if (tb == te || is(tb, te, "str")) {
+        rs.setString(col, vb, ve - vb);
+    } else if (is(tb, te, "u64")) {
+        rs.setUint(col, std::strtoull(std::string(vb, ve).c_str(), NULL, 10));
+    } else if (is(tb, te, "i64")) {
+        rs.setInt(col, std::strtoll(std::string(vb, ve).c_str(), NULL, 10));
+    } else if (is(tb, te, "bool")) {
+        rs.setBool(col, is(vb, ve, "True") || is(vb, ve, "true") || is(vb, ve, "1"));
+    }
+    // "null" and unknown types leave the cell NULL.
+}
+
+} // namespace
+
+bool setFixtureProperty(ResultSet& rs, const char* line, size_t len) {
+    const char* b = line;
+    const char* e = line + len;
+    const char* eq = b;
+    while (eq < e && *eq != '=') ++eq;
+    if (eq == e) return false;
+    const char* colon = b;
+    while (colon < eq && *colon != ':') ++colon;
+    int col = rs.addColumn(b, colon - b);
+    const char* tb = colon < eq ? colon + 1 : eq;
+    setTyped(rs, col, tb, eq, eq + 1, e);
+    return true;
+}
+
+bool FixtureSource::load(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        std::wcerr << L"Could not open fixture " << utf8ToWide(path.data(), path.size()) << std::endl;
+        return false;
+    }
+    std::string text;
+    char buf[16384];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+    std::fclose(f);
+    parse(text.data(), text.size());
+    return true;
+}
+
+void FixtureSource::parse(const char* text, size_t len) {
+    ClassData* current = NULL;
+    bool rowOpen = false;
+    const char* p = text;
+    const char* end = p + len;
+    // Skip a UTF-8 byte order mark.
+    if (end - p >= 3 && (unsigned char)p[0] == 0xEF && (unsigned char)p[1] == 0xBB && (unsigned char)p[2] == 0xBF) p += 3;
+
+    while (p < end) {
+        const char* eol = p;
+        while (eol < end && *eol != '\n') ++eol;
+        const char* b = p;
+        const char* e = eol;
+        p = eol < end ? eol + 1 : end;
+        trimRight(b, e);
+        if (b == e || *b == '#') continue;
+
+        if (*b == '[') {
+            const char* close = b + 1;
+            while (close < e && *close != ']') ++close;
+            current = &m_classes[utf8ToWide(b + 1, close - b - 1)];
+            current->rows = ResultSet();
+            rowOpen = false;
+        } else if (!current) {
+            continue;
+        } else if (*b == '@') {
+            FakeEnumerator::Latency& lat = current->latency;
+            if (directive(b, e, "@delay ")) lat.startup = milliseconds(b + 7, e);
+            else if (directive(b, e, "@call-delay ")) lat.perCall = milliseconds(b + 12, e);
+            else if (directive(b, e, "@row-delay ")) lat.perObject = milliseconds(b + 11, e);
+            else if (directive(b, e, "@stall-after ")) lat.stallAfter = std::strtoul(std::string(b + 13, e).c_str(), NULL, 10);
+        } else if (is(b, e, "--")) {
+            rowOpen = false;
+        } else {
+            if (!std::memchr(b, '=', e - b)) continue;
+            if (!rowOpen) {
+                current->rows.addRow();
+                rowOpen = true;
+            }
+            setFixtureProperty(current->rows, b, e - b);
+        }
+    }
+}
+
+ResultSet FixtureSource::query(const std::wstring& wql, const QueryBudget& budget) {
+    ResultSet out;
+    query(wql, budget, out);
+    return out;
+}
+
+void FixtureSource::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& out) {
+    out.clear();
+    std::map<std::wstring, ClassData>::const_iterator it = m_classes.find(wqlClassName(wql));
+    if (it == m_classes.end()) return;
+    const ResultSet& rec = it->second.rows;
+
+    // Project onto the SELECT list, like WMI does: every named property
+    // becomes a column, NULL where the recording doesn't have it.
+    std::vector<int> from;
+    std::vector<std::wstring> cols = wqlColumns(wql);
+    if (cols.empty()) {
+        for (size_t c = 0; c < rec.columnCount(); ++c) {
+            out.addColumn(rec.columnName(static_cast<int>(c)));
+            from.push_back(static_cast<int>(c));
+        }
+    } else {
+        for (size_t c = 0; c < cols.size(); ++c) {
+            std::string name(cols[c].begin(), cols[c].end()); // property names are ASCII
+            out.addColumn(name);
+            from.push_back(rec.column(name.c_str()));
+        }
+    }
+    size_t r = 0;
+    std::function<void(size_t)> take = [&](size_t objects) {
+        for (size_t end = r + objects; r < end; ++r) {
+            if (r == 0) profileFirstRow();
+            out.addRow();
+            for (size_t c = 0; c < from.size(); ++c) {
+                out.setValue(static_cast<int>(c), rec.at(r, from[c]));
+            }
+        }
+    };
+    if (m_delays) {
+        FakeEnumerator e(rec.rowCount(), it->second.latency);
+        out.setStatus(enumerateBatched(e, m_batch, budget, take));
+    } else {
+        take(rec.rowCount());
+    }
+}
+
+ResultSet RecordingSource::query(const std::wstring& wql, const QueryBudget& budget) {
+    ResultSet rows = m_inner.query(wql, budget);
+    // A partial result would replay as if the machine had fewer devices.
+    if (rows.partial()) return rows;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_classes[wqlClassName(wql)] = rows.clone();
+    return rows;
+}
+
+bool RecordingSource::save(const std::string& path) const {
+    std::string text = "# Recorded by sysinfo --record\n";
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (std::map<std::wstring, ResultSet>::const_iterator it = m_classes.begin(); it != m_classes.end(); ++it) {
+            const ResultSet& rs = it->second;
+            text += "\n[";
+            text.append(it->first.begin(), it->first.end()); // class names are ASCII
+            text += "]\n";
+            for (size_t r = 0; r < rs.rowCount(); ++r) {
+                if (r) text += "--\n";
+                for (size_t c = 0; c < rs.columnCount(); ++c) {
+                    const Value& v = rs.at(r, static_cast<int>(c));
+                    text += rs.columnName(static_cast<int>(c));
+                    switch (v.type) {
+                    case ValueType::Int: text += ":i64=" + std::to_string(static_cast<long long>(v.i)); break;
+                    case ValueType::Uint: text += ":u64=" + std::to_string(static_cast<unsigned long long>(v.u)); break;
+                    case ValueType::Bool: text += v.b ? ":bool=True" : ":bool=False"; break;
+                    case ValueType::String:
+                        text += "=";
+                        // One property per line: flatten embedded line breaks.
+                        for (uint32_t k = 0; k < v.s.n; ++k) {
+                            char ch = v.s.p[k];
+                            text.push_back(ch == '\n' || ch == '\r' ? ' ' : ch);
+                        }
+                        break;
+                    default: text += ":null="; break;
+                    }
+                    text += "\n";
+                }
+            }
+        }
+    }
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "datasource.h"
+#include "enumerate.h"
+
+// Replays rows recorded from a real machine, keyed by WMI class name.
+// Fixture files are UTF-8 text:
+//
+//   # comment
+//   [Win32_DiskDrive]
+//   @delay 120          simulated query latency in milliseconds
+//   @call-delay 2       optional: cost of every round trip (ms)
+//   @row-delay 0.5      optional: cost of every row (ms)
+//   @stall-after 3      optional: later rows never arrive (hung provider)
+//   Model=Samsung SSD 980 PRO 1TB
+//   Size:u64=1000202273280
+//   --                  starts the next row
+//   Model=...
+//
+// A property is "Name=text" or "Name:type=value" with type one of str,
+// i64, u64, bool (True/False) or null. Only the columns named in the
+// SELECT list are returned. The WHERE clause is ignored; the recorded rows
+// come back as-is, so a fixture should be captured with the same filters.
+// Rows are replayed through a FakeEnumerator in batches, so the latencies
+// and the query budget behave as they would against WMI.
+class FixtureSource : public DataSource {
+public:
+    FixtureSource() : m_delays(true), m_batch(kDefaultEnumBatch) {}
+
+    // Parses the file; false (with a message on stderr) if it can't be read.
+    bool load(const std::string& path);
+    // Parses fixture text held in memory.
+    void parse(const char* text, size_t len);
+    // Benchmarks replay without the recorded @delay latencies.
+    void setDelays(bool enabled) { m_delays = enabled; }
+    // Rows fetched per simulated round trip.
+    void setBatchSize(size_t rows) { m_batch = rows; }
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+
+private:
+    struct ClassData {
+        ResultSet rows;
+        FakeEnumerator::Latency latency;
+    };
+    std::map<std::wstring, ClassData> m_classes;
+    bool m_delays;
+    size_t m_batch;
+};
+
+// Stores one fixture property line, "Name=text" or "Name:type=value", into
+// the last row of `rs`, adding the column if it's new. False if the line
+// has no '='.
+bool setFixtureProperty(ResultSet& rs, const char* line, size_t len);
+
+// Passes queries through to another source and keeps a copy of every
+// result by class, so a live run can be saved as a fixture.
+class RecordingSource : public DataSource {
+public:
+    explicit RecordingSource(DataSource& inner) : m_inner(inner) {}
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void threadAttach() { m_inner.threadAttach(); }
+    void threadDetach() { m_inner.threadDetach(); }
+
+    // Writes everything recorded so far in the format FixtureSource reads.
+    bool save(const std::string& path) const;
+
+private:
+    DataSource& m_inner;
+    mutable std::mutex m_mutex;
+    std::map<std::wstring, ResultSet> m_classes;
+};
@@ -0,0 +1,765 @@
+#include "history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <cwchar>
+#include <iomanip>
+#include <ostream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "collector.h"
+
+namespace {
+
+const char kMagic[4] = { 'S', 'Y', 'S', 'H' };
+const uint16_t kHistoryVersion = 2;
+const size_t kHeaderBytes = 64;
+const size_t kSegmentHeaderBytes = 64;
+// Worst-case bits of a tick's timestamp and of one value.
+const uint64_t kMaxTimeBits = 4 + 64;
+const uint64_t kMaxValueBits = 2 + 6 + 7 + 64;
+const unsigned kNoWindow = 64;
+// Blocks end at the first tick past a 10 minute boundary, but hold at least
+// 64 ticks so slow --watch intervals don't pay a rollup every few ticks.
+const int64_t kBlockMs = 10 * 60 * 1000;
+const uint32_t kMinBlockTicks = 64;
+// Fixed part of a block's description, and the most one rollup takes.
+const size_t kBlockBytes = 40;
+const size_t kMaxRollupBytes = 5 + 10 + 10 + 8;
+// Name room kept free for series that show up later in a segment.
+const size_t kSpareNameBytes = 1024;
+
+// Offsets in a segment header.
+const size_t kSeqAt = 0, kFirstAt = 8, kLastAt = 16, kTicksAt = 24, kSeriesAt = 28, kNamesAt = 32, kBlocksAt = 36,
+             kBitsAt = 40, kNamesRoomAt = 48, kOpenBitAt = 52, kOpenTimeAt = 56;
+// Offsets in a block's fixed part.
+const size_t kBlockFirstAt = 0, kBlockMinAt = 8, kBlockMaxAt = 16, kBlockTicksAt = 24, kBlockSeriesAt = 28,
+             kBlockStartAt = 32, kBlockRollupAt = 36;
+
+uint64_t getLE(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    for (int k = 0; k < bytes; ++k) v |= static_cast<uint64_t>(p[k]) << (8 * k);
+    return v;
+}
+
+void setLE(unsigned char* p, uint64_t v, int bytes) {
+    for (int k = 0; k < bytes; ++k) p[k] = static_cast<unsigned char>(v >> (8 * k));
+}
+
+unsigned leadingZeros(uint64_t v) { // v != 0
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return 63 - static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_clzll(v));
+#endif
+}
+
+unsigned trailingZeros(uint64_t v) { // v != 0
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+}
+
+uint64_t fromBigEndian(uint64_t v) {
+#ifdef _MSC_VER
+    return _byteswap_uint64(v); // Windows targets are little endian
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return v;
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>((v >> 1) ^ (0 - (v & 1)));
+}
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - (a % b < 0 ? 1 : 0);
+}
+
+// MSB-first bit appender over a segment's stream. Bytes are cleared as
+// they are first touched, since a recycled segment holds old bits.
+void putBits(unsigned char* base, uint64_t& pos, uint64_t v, unsigned n) {
+    while (n) {
+        const unsigned used = static_cast<unsigned>(pos & 7);
+        const unsigned room = 8 - used;
+        const unsigned take = n < room ? n : room;
+        const unsigned chunk = static_cast<unsigned>(v >> (n - take)) & ((1u << take) - 1);
+        unsigned char& b = base[pos >> 3];
+        if (!used) b = 0;
+        b = static_cast<unsigned char>(b | (chunk << (room - take)));
+        pos += take;
+        n -= take;
+    }
+}
+
+class BitReader {
+public:
+    BitReader(const unsigned char* base, uint64_t bits)
+        : m_base(base), m_bytes(static_cast<size_t>((bits + 7) / 8)), m_pos(0), m_end(bits) {}
+
+    bool bit() { return bits(1) != 0; }
+    // The next bits without consuming them; see window().
+    uint64_t peek() const { return window(); }
+    void skip(unsigned n) { m_pos += n; }
+    uint64_t bits(unsigned n) {
+        if (n > 56) {
+            const uint64_t high = bits(n - 32);
+            return (high << 32) | bits(32);
+        }
+        const uint64_t v = n ? window() >> (64 - n) : 0;
+        m_pos += n;
+        return v;
+    }
+    // Whether `n` more bits are there; checked once per field group.
+    bool has(uint64_t n) const { return m_end - m_pos >= n; }
+
+private:
+    // The next 57 or more bits, MSB first, from one 8-byte load where the
+    // stream has that many bytes left.
+    uint64_t window() const {
+        const size_t at = static_cast<size_t>(m_pos >> 3);
+        uint64_t w = 0;
+        if (at + 8 <= m_bytes) {
+            std::memcpy(&w, m_base + at, 8);
+            w = fromBigEndian(w);
+        } else {
+            for (size_t k = 0; k < 8; ++k) w = (w << 8) | (at + k < m_bytes ? m_base[at + k] : 0);
+        }
+        return w << (m_pos & 7);
+    }
+
+    const unsigned char* m_base;
+    size_t m_bytes;
+    uint64_t m_pos;
+    uint64_t m_end;
+};
+
+void putTimestamp(unsigned char* base, uint64_t& pos, int64_t dod) {
+    const uint64_t zz = zigzag(dod);
+    if (zz == 0) {
+        putBits(base, pos, 0, 1);
+    } else if (zz < (1u << 7)) {
+        putBits(base, pos, 2, 2);
+        putBits(base, pos, zz, 7);
+    } else if (zz < (1u << 9)) {
+        putBits(base, pos, 6, 3);
+        putBits(base, pos, zz, 9);
+    } else if (zz < (1u << 12)) {
+        putBits(base, pos, 14, 4);
+        putBits(base, pos, zz, 12);
+    } else {
+        putBits(base, pos, 15, 4);
+        putBits(base, pos, zz, 64);
+    }
+}
+
+bool readTimestamp(BitReader& in, int64_t& dod) {
+    if (!in.has(1)) return false;
+    const uint64_t w = in.peek();
+    if (!(w >> 63)) {
+        in.skip(1);
+        dod = 0;
+        return true;
+    }
+    unsigned prefix = 4, width = 64;
+    if (!((w >> 62) & 1)) prefix = 2, width = 7;
+    else if (!((w >> 61) & 1)) prefix = 3, width = 9;
+    else if (!((w >> 60) & 1)) width = 12;
+    if (!in.has(prefix + width)) return false;
+    in.skip(prefix);
+    dod = unzigzag(in.bits(width));
+    return true;
+}
+
+void putValue(unsigned char* base, uint64_t& pos, HistoryXorState& s, const uint64_t* value) {
+    if (!value) {
+        putBits(base, pos, 3, 2);
+        putBits(base, pos, 0, 6 + 7);
+        return;
+    }
+    const uint64_t x = s.prev ^ *value;
+    if (!x) {
+        putBits(base, pos, 0, 1);
+        return;
+    }
+    const unsigned leading = leadingZeros(x), trailing = trailingZeros(x);
+    if (s.leading != kNoWindow && leading >= s.leading && trailing >= s.trailing) {
+        putBits(base, pos, 2, 2);
+        putBits(base, pos, x >> s.trailing, 64 - s.leading - s.trailing);
+    } else {
+        const unsigned length = 64 - leading - trailing;
+        putBits(base, pos, 3, 2);
+        putBits(base, pos, leading, 6);
+        putBits(base, pos, length, 7);
+        putBits(base, pos, x >> trailing, length);
+        s.leading = leading;
+        s.trailing = trailing;
+    }
+    s.prev = *value;
+}
+
+// False on a truncated stream. `present` is false for "no value". Decodes
+// the control bits from one peek, as most values are a single '0'.
+bool readValue(BitReader& in, HistoryXorState& s, bool& present) {
+    if (!in.has(1)) return false;
+    present = true;
+    const uint64_t w = in.peek();
+    if (!(w >> 63)) {
+        in.skip(1);
+        return true;
+    }
+    if (!((w >> 62) & 1)) {
+        if (s.leading == kNoWindow) return false;
+        const unsigned length = 64 - s.leading - s.trailing;
+        if (!in.has(2 + length)) return false;
+        in.skip(2);
+        s.prev ^= in.bits(length) << s.trailing;
+        return true;
+    }
+    if (!in.has(2 + 6 + 7)) return false;
+    const unsigned leading = static_cast<unsigned>((w >> 56) & 63);
+    const unsigned length = static_cast<unsigned>((w >> 49) & 127);
+    in.skip(2 + 6 + 7);
+    if (!length) {
+        present = false;
+        return true;
+    }
+    if (leading + length > 64 || !in.has(length)) return false;
+    s.leading = leading;
+    s.trailing = 64 - leading - length;
+    s.prev ^= in.bits(length) << s.trailing;
+    return true;
+}
+
+void putVarint(unsigned char*& p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = static_cast<unsigned char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    *p++ = static_cast<unsigned char>(v);
+}
+
+bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p != end; shift += 7) {
+        const unsigned char b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Checks the file header and reads the geometry it declares.
+const char* readHeader(const unsigned char* p, size_t len, uint32_t& segmentBytes, uint32_t& segmentCount) {
+    if (len < kHeaderBytes || std::memcmp(p, kMagic, 4) != 0) return "not a sysinfo history file";
+    if (getLE(p + 4, 2) != kHistoryVersion) return "unsupported history version";
+    segmentBytes = static_cast<uint32_t>(getLE(p + 8, 4));
+    segmentCount = static_cast<uint32_t>(getLE(p + 12, 4));
+    if (segmentBytes <= kSegmentHeaderBytes || kHeaderBytes + uint64_t(segmentBytes) * segmentCount > len) {
+        return "corrupt history header";
+    }
+    return nullptr;
+}
+
+struct SegmentRef {
+    uint64_t sequence;
+    const unsigned char* p;
+    bool operator<(const SegmentRef& other) const { return sequence < other.sequence; }
+};
+
+// Used segments, oldest first.
+std::vector<SegmentRef> usedSegments(const unsigned char* p, uint32_t segmentBytes, uint32_t segmentCount) {
+    std::vector<SegmentRef> used;
+    for (uint32_t k = 0; k < segmentCount; ++k) {
+        const unsigned char* seg = p + kHeaderBytes + uint64_t(k) * segmentBytes;
+        SegmentRef ref = { getLE(seg + kSeqAt, 8), seg };
+        if (ref.sequence && getLE(seg + kTicksAt, 4)) used.push_back(ref);
+    }
+    std::sort(used.begin(), used.end());
+    return used;
+}
+
+// A block of a segment's stream as its description gives it. The open
+// block has no rollups and unbounded times.
+struct BlockRef {
+    int64_t first;
+    int64_t minTime;
+    int64_t maxTime;
+    uint32_t ticks;
+    uint32_t seriesCount;
+    uint64_t startBit;
+    const unsigned char* rollups;
+    const unsigned char* rollupsEnd;
+};
+
+// Reads the block description below `tail` and moves `tail` past it;
+// false if it overlaps the stream or contradicts the segment header.
+bool readBlock(const unsigned char*& tail, const unsigned char* streamEnd, uint32_t seriesCount, uint64_t bits,
+               BlockRef& block) {
+    if (tail - streamEnd < static_cast<ptrdiff_t>(kBlockBytes)) return false;
+    const unsigned char* d = tail - kBlockBytes;
+    block.first = static_cast<int64_t>(getLE(d + kBlockFirstAt, 8));
+    block.minTime = static_cast<int64_t>(getLE(d + kBlockMinAt, 8));
+    block.maxTime = static_cast<int64_t>(getLE(d + kBlockMaxAt, 8));
+    block.ticks = static_cast<uint32_t>(getLE(d + kBlockTicksAt, 4));
+    block.seriesCount = static_cast<uint32_t>(getLE(d + kBlockSeriesAt, 4));
+    block.startBit = getLE(d + kBlockStartAt, 4);
+    const uint64_t rollupBytes = getLE(d + kBlockRollupAt, 4);
+    if (block.seriesCount > seriesCount || block.startBit > bits || rollupBytes > static_cast<uint64_t>(d - streamEnd)) {
+        return false;
+    }
+    block.rollups = d - rollupBytes;
+    block.rollupsEnd = d;
+    tail = block.rollups;
+    return true;
+}
+
+// Adds a block's rollups to the bucket at `bucketStart` of each series.
+bool foldRollups(const BlockRef& block, const std::vector<long>& slot, int64_t bucketStart,
+                 std::vector<HistorySeries>& out) {
+    const unsigned char* r = block.rollups;
+    for (uint32_t s = 0; s < block.seriesCount; ++s) {
+        uint64_t count, min = 0, range = 0, sumBits = 0;
+        if (!getVarint(r, block.rollupsEnd, count)) return false;
+        if (count) {
+            if (!getVarint(r, block.rollupsEnd, min) || !getVarint(r, block.rollupsEnd, range) || block.rollupsEnd - r < 8) {
+                return false;
+            }
+            sumBits = getLE(r, 8);
+            r += 8;
+        }
+        if (!count || slot[s] < 0) continue;
+        std::vector<HistoryBucket>& buckets = out[slot[s]].buckets;
+        if (buckets.empty() || buckets.back().start != bucketStart) {
+            const HistoryBucket b = { bucketStart, min, min + range, 0.0, 0 };
+            buckets.push_back(b);
+        }
+        HistoryBucket& b = buckets.back();
+        double sum;
+        std::memcpy(&sum, &sumBits, 8);
+        b.min = std::min(b.min, min);
+        b.max = std::max(b.max, min + range);
+        b.sum += sum;
+        b.count += count;
+    }
+    return true;
+}
+
+// Decodes a block's ticks, `tick` being the first one's index in the
+// segment, and adds those in [from, to) to their buckets. False on a
+// truncated stream.
+bool decodeBlock(const unsigned char* stream, uint64_t bits, const BlockRef& block, uint32_t tick,
+                 const std::vector<uint32_t>& joined, const std::vector<long>& slot, int64_t from, int64_t to,
+                 int64_t stepMs, std::vector<HistoryXorState>& states, std::vector<HistorySeries>& out) {
+    const HistoryXorState fresh = { 0, kNoWindow, 0 };
+    states.assign(joined.size(), fresh);
+    BitReader in(stream, bits);
+    in.skip(static_cast<unsigned>(block.startBit));
+    int64_t time = block.first, delta = 0;
+    for (uint32_t t = 0; t < block.ticks; ++t) {
+        int64_t dod;
+        if (!readTimestamp(in, dod)) return false;
+        delta += dod;
+        time += delta;
+        const bool inRange = time >= from && time < to;
+        const int64_t bucketStart = inRange ? from + (time - from) / stepMs * stepMs : 0;
+        for (size_t s = 0; s < joined.size() && joined[s] <= tick + t; ++s) {
+            bool present;
+            if (!readValue(in, states[s], present)) return false;
+            if (!inRange || !present || slot[s] < 0) continue;
+            std::vector<HistoryBucket>& buckets = out[slot[s]].buckets;
+            const uint64_t v = states[s].prev;
+            if (buckets.empty() || buckets.back().start != bucketStart) {
+                const HistoryBucket b = { bucketStart, v, v, 0.0, 0 };
+                buckets.push_back(b);
+            }
+            HistoryBucket& b = buckets.back();
+            b.min = std::min(b.min, v);
+            b.max = std::max(b.max, v);
+            b.sum += static_cast<double>(v);
+            ++b.count;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+HistoryWriter::HistoryWriter()
+    : m_segmentBytes(0), m_segmentCount(0), m_sequence(0), m_segment(nullptr), m_names(nullptr), m_namesEnd(nullptr),
+      m_stream(nullptr), m_bits(0), m_tailBytes(0), m_ticks(0), m_blocks(0), m_prevTime(0), m_prevDelta(0),
+      m_truncated(false), m_blockBit(0), m_blockFirst(0), m_blockMin(0), m_blockMax(0), m_blockTicks(0) {}
+
+bool HistoryWriter::open(const std::string& path, std::string& error) {
+    const size_t size = kHeaderBytes + size_t(kHistorySegmentBytes) * kHistorySegmentCount;
+    if (!m_file.openWritable(path, size)) {
+        error = "cannot open the file for writing";
+        return false;
+    }
+    unsigned char* p = m_file.writableData();
+    if (getLE(p, 4) == 0) { // new file
+        std::memcpy(p, kMagic, 4);
+        setLE(p + 4, kHistoryVersion, 2);
+        setLE(p + 8, kHistorySegmentBytes, 4);
+        setLE(p + 12, kHistorySegmentCount, 4);
+    }
+    const char* bad = readHeader(p, m_file.size(), m_segmentBytes, m_segmentCount);
+    if (bad) {
+        error = bad;
+        m_file.close();
+        return false;
+    }
+    for (uint32_t k = 0; k < m_segmentCount; ++k) {
+        m_sequence = std::max(m_sequence, getLE(p + kHeaderBytes + uint64_t(k) * m_segmentBytes + kSeqAt, 8));
+    }
+    m_segment = nullptr;
+    return true;
+}
+
+bool HistoryWriter::startSegment(int64_t timeMs, const std::vector<HistoryPoint>& points) {
+    unsigned char* base = m_file.writableData();
+    if (!base) return false;
+    if (m_segment) closeBlock();
+    // The unused segment, or else the oldest.
+    unsigned char* seg = nullptr;
+    uint64_t oldest = UINT64_MAX;
+    for (uint32_t k = 0; k < m_segmentCount && oldest; ++k) {
+        unsigned char* s = base + kHeaderBytes + uint64_t(k) * m_segmentBytes;
+        const uint64_t sequence = getLE(s + kSeqAt, 8);
+        if (sequence < oldest) {
+            oldest = sequence;
+            seg = s;
+        }
+    }
+    setLE(seg + kSeqAt, 0, 8); // unused until it's consistent again
+
+    // Names may take half the segment; series beyond that aren't recorded.
+    m_segment = seg;
+    m_index.clear();
+    m_series.clear();
+    m_rollups.clear();
+    m_ticks = 0;
+    m_names = seg + kSegmentHeaderBytes;
+    m_namesEnd = m_names + (m_segmentBytes - kSegmentHeaderBytes) / 2;
+    m_truncated = false;
+    for (size_t k = 0; k < points.size() && !m_truncated; ++k) {
+        if (!m_index.count(points[k].series)) m_truncated = !addSeries(points[k].series);
+    }
+    const size_t namesBytes = static_cast<size_t>(m_names - (seg + kSegmentHeaderBytes));
+    const size_t namesRoom = std::min(namesBytes + std::max(namesBytes / 2, kSpareNameBytes),
+                                      static_cast<size_t>(m_namesEnd - (seg + kSegmentHeaderBytes)));
+    m_namesEnd = seg + kSegmentHeaderBytes + namesRoom;
+
+    setLE(seg + kFirstAt, static_cast<uint64_t>(timeMs), 8);
+    setLE(seg + kLastAt, static_cast<uint64_t>(timeMs), 8);
+    setLE(seg + kTicksAt, 0, 4);
+    setLE(seg + kSeriesAt, m_series.size(), 4);
+    setLE(seg + kNamesAt, namesBytes, 4);
+    setLE(seg + kBlocksAt, 0, 4);
+    setLE(seg + kBitsAt, 0, 8);
+    setLE(seg + kNamesRoomAt, namesRoom, 4);
+
+    m_stream = m_namesEnd;
+    m_bits = 0;
+    m_tailBytes = 0;
+    m_blocks = 0;
+    openBlock(timeMs);
+    setLE(seg + kSeqAt, ++m_sequence, 8);
+    return true;
+}
+
+bool HistoryWriter::addSeries(const std::string& name) {
+    if (m_names + 10 + name.size() + 5 > m_namesEnd) return false;
+    putVarint(m_names, name.size());
+    std::memcpy(m_names, name.data(), name.size());
+    m_names += name.size();
+    putVarint(m_names, m_ticks);
+    const size_t index = m_series.size();
+    m_index[name] = index;
+    const HistoryXorState fresh = { 0, kNoWindow, 0 };
+    m_series.push_back(fresh);
+    const HistoryBucket empty = { 0, UINT64_MAX, 0, 0.0, 0 };
+    m_rollups.push_back(empty);
+    return true;
+}
+
+void HistoryWriter::closeBlock() {
+    if (!m_blockTicks) return;
+    m_scratch.resize(kMaxRollupBytes * m_rollups.size());
+    unsigned char* p = m_scratch.data();
+    for (size_t s = 0; s < m_rollups.size(); ++s) {
+        const HistoryBucket& r = m_rollups[s];
+        putVarint(p, r.count);
+        if (!r.count) continue;
+        putVarint(p, r.min);
+        putVarint(p, r.max - r.min);
+        uint64_t sum;
+        std::memcpy(&sum, &r.sum, 8);
+        setLE(p, sum, 8);
+        p += 8;
+    }
+    // append() left room for this below the blocks already there.
+    const size_t rollupBytes = static_cast<size_t>(p - m_scratch.data());
+    unsigned char* block = m_segment + m_segmentBytes - m_tailBytes - kBlockBytes;
+    std::memcpy(block - rollupBytes, m_scratch.data(), rollupBytes);
+    setLE(block + kBlockFirstAt, static_cast<uint64_t>(m_blockFirst), 8);
+    setLE(block + kBlockMinAt, static_cast<uint64_t>(m_blockMin), 8);
+    setLE(block + kBlockMaxAt, static_cast<uint64_t>(m_blockMax), 8);
+    setLE(block + kBlockTicksAt, m_blockTicks, 4);
+    setLE(block + kBlockSeriesAt, m_rollups.size(), 4);
+    setLE(block + kBlockStartAt, m_blockBit, 4);
+    setLE(block + kBlockRollupAt, rollupBytes, 4);
+    m_tailBytes += kBlockBytes + rollupBytes;
+    setLE(m_segment + kBlocksAt, ++m_blocks, 4);
+    m_blockTicks = 0;
+}
+
+void HistoryWriter::openBlock(int64_t timeMs) {
+    const HistoryXorState fresh = { 0, kNoWindow, 0 };
+    const HistoryBucket empty = { 0, UINT64_MAX, 0, 0.0, 0 };
+    m_series.assign(m_series.size(), fresh);
+    m_rollups.assign(m_rollups.size(), empty);
+    m_blockBit = m_bits;
+    m_blockFirst = m_blockMin = m_blockMax = timeMs;
+    m_blockTicks = 0;
+    m_prevTime = timeMs;
+    m_prevDelta = 0;
+    setLE(m_segment + kOpenBitAt, m_blockBit, 4);
+    setLE(m_segment + kOpenTimeAt, static_cast<uint64_t>(timeMs), 8);
+}
+
+void HistoryWriter::append(int64_t timeMs, const std::vector<HistoryPoint>& points) {
+    bool restart = !m_segment;
+    for (size_t k = 0; k < points.size() && !restart && !m_truncated; ++k) {
+        if (!m_index.count(points[k].series)) restart = !addSeries(points[k].series);
+    }
+    if (!restart && m_blockTicks >= kMinBlockTicks && floorDiv(timeMs, kBlockMs) != floorDiv(m_blockFirst, kBlockMs)) {
+        closeBlock();
+        openBlock(timeMs);
+    }
+    // The tick at its worst, plus the description of the block it's in.
+    const uint64_t worst = kMaxTimeBits + kMaxValueBits * std::max(m_series.size(), points.size());
+    const uint64_t tail = m_tailBytes + kBlockBytes + kMaxRollupBytes * std::max(m_series.size(), points.size());
+    const uint64_t room = m_segment ? static_cast<uint64_t>(m_segment + m_segmentBytes - m_stream) : 0;
+    if (!restart && (m_bits + worst + 7) / 8 + tail > room) restart = true;
+    if (restart && !startSegment(timeMs, points)) return;
+
+    m_tick.assign(m_series.size(), nullptr);
+    for (size_t k = 0; k < points.size(); ++k) {
+        std::unordered_map<std::string, size_t>::const_iterator it = m_index.find(points[k].series);
+        if (it != m_index.end()) m_tick[it->second] = &points[k].value;
+    }
+
+    const int64_t delta = timeMs - m_prevTime;
+    putTimestamp(m_stream, m_bits, delta - m_prevDelta);
+    m_prevDelta = delta;
+    m_prevTime = timeMs;
+    for (size_t s = 0; s < m_series.size(); ++s) {
+        putValue(m_stream, m_bits, m_series[s], m_tick[s]);
+        if (!m_tick[s]) continue;
+        HistoryBucket& r = m_rollups[s];
+        const uint64_t v = *m_tick[s];
+        r.min = std::min(r.min, v);
+        r.max = std::max(r.max, v);
+        r.sum += static_cast<double>(v);
+        ++r.count;
+    }
+    m_blockMin = std::min(m_blockMin, timeMs);
+    m_blockMax = std::max(m_blockMax, timeMs);
+    ++m_blockTicks;
+
+    // The bits are in place; now let readers see them.
+    setLE(m_segment + kSeriesAt, m_series.size(), 4);
+    setLE(m_segment + kNamesAt, static_cast<uint64_t>(m_names - (m_segment + kSegmentHeaderBytes)), 4);
+    setLE(m_segment + kBitsAt, m_bits, 8);
+    setLE(m_segment + kLastAt, static_cast<uint64_t>(timeMs), 8);
+    setLE(m_segment + kTicksAt, ++m_ticks, 4);
+}
+
+bool historySpan(const void* data, size_t len, int64_t& first, int64_t& last) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint32_t segmentBytes, segmentCount;
+    if (readHeader(p, len, segmentBytes, segmentCount)) return false;
+    const std::vector<SegmentRef> used = usedSegments(p, segmentBytes, segmentCount);
+    if (used.empty()) return false;
+    first = INT64_MAX;
+    last = INT64_MIN;
+    for (size_t k = 0; k < used.size(); ++k) {
+        first = std::min(first, static_cast<int64_t>(getLE(used[k].p + kFirstAt, 8)));
+        last = std::max(last, static_cast<int64_t>(getLE(used[k].p + kLastAt, 8)));
+    }
+    return true;
+}
+
+bool queryHistory(const void* data, size_t len, const std::string& filter, int64_t from, int64_t to,
+                  int64_t stepMs, std::vector<HistorySeries>& out, std::string& error) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint32_t segmentBytes, segmentCount;
+    const char* bad = readHeader(p, len, segmentBytes, segmentCount);
+    if (bad) {
+        error = bad;
+        return false;
+    }
+    if (stepMs <= 0) stepMs = 1;
+    out.clear();
+    std::unordered_map<std::string, size_t> outIndex;
+    std::vector<long> slot; // output series of each series of a segment, or -1
+    std::vector<uint32_t> joined;
+    std::vector<HistoryXorState> states;
+    const std::vector<SegmentRef> used = usedSegments(p, segmentBytes, segmentCount);
+    for (size_t k = 0; k < used.size(); ++k) {
+        const unsigned char* seg = used[k].p;
+        const int64_t first = static_cast<int64_t>(getLE(seg + kFirstAt, 8));
+        const int64_t last = static_cast<int64_t>(getLE(seg + kLastAt, 8));
+        if (last < from || first >= to) continue;
+
+        const uint32_t ticks = static_cast<uint32_t>(getLE(seg + kTicksAt, 4));
+        const uint32_t seriesCount = static_cast<uint32_t>(getLE(seg + kSeriesAt, 4));
+        const uint64_t namesBytes = getLE(seg + kNamesAt, 4);
+        const uint32_t blocks = static_cast<uint32_t>(getLE(seg + kBlocksAt, 4));
+        const uint64_t bits = getLE(seg + kBitsAt, 8);
+        const uint64_t namesRoom = getLE(seg + kNamesRoomAt, 4);
+        if (namesBytes > namesRoom || namesRoom + kSegmentHeaderBytes > segmentBytes ||
+            bits > (segmentBytes - kSegmentHeaderBytes - namesRoom) * 8) {
+            error = "corrupt history segment";
+            return false;
+        }
+        const unsigned char* names = seg + kSegmentHeaderBytes;
+        const unsigned char* namesEnd = names + namesBytes;
+        const unsigned char* stream = seg + kSegmentHeaderBytes + namesRoom;
+        slot.assign(seriesCount, -1);
+        joined.assign(seriesCount, 0);
+        for (uint32_t s = 0; s < seriesCount; ++s) {
+            uint64_t n, at;
+            if (!getVarint(names, namesEnd, n) || n > static_cast<uint64_t>(namesEnd - names)) {
+                error = "corrupt history segment";
+                return false;
+            }
+            const std::string name(reinterpret_cast<const char*>(names), static_cast<size_t>(n));
+            names += n;
+            if (!getVarint(names, namesEnd, at)) {
+                error = "corrupt history segment";
+                return false;
+            }
+            joined[s] = static_cast<uint32_t>(std::min<uint64_t>(at, UINT32_MAX));
+            if (!filter.empty() && name.find(filter) == std::string::npos) continue;
+            std::unordered_map<std::string, size_t>::const_iterator it = outIndex.find(name);
+            if (it == outIndex.end()) {
+                it = outIndex.insert(std::make_pair(name, out.size())).first;
+                out.push_back(HistorySeries());
+                out.back().name = name;
+            }
+            slot[s] = static_cast<long>(it->second);
+        }
+
+        // The closed blocks, then the open one. A block whose ticks all
+        // fall in one bucket is folded in from its rollups.
+        const unsigned char* tail = seg + segmentBytes;
+        const unsigned char* streamEnd = stream + (bits + 7) / 8;
+        uint32_t tick = 0;
+        for (uint32_t b = 0; b <= blocks; ++b) {
+            BlockRef block;
+            if (b < blocks) {
+                if (!readBlock(tail, streamEnd, seriesCount, bits, block)) {
+                    error = "corrupt history segment";
+                    return false;
+                }
+            } else {
+                block.first = static_cast<int64_t>(getLE(seg + kOpenTimeAt, 8));
+                block.minTime = INT64_MIN;
+                block.maxTime = INT64_MAX;
+                block.ticks = ticks - std::min(tick, ticks);
+                block.seriesCount = seriesCount;
+                block.startBit = getLE(seg + kOpenBitAt, 4);
+                // Not rolled up until it closes.
+                block.rollups = nullptr;
+                block.rollupsEnd = nullptr;
+                if (block.startBit > bits) {
+                    error = "corrupt history segment";
+                    return false;
+                }
+            }
+            if (block.maxTime < from || block.minTime >= to) {
+                tick += block.ticks;
+                continue;
+            }
+            const int64_t bucketStart = block.minTime >= from ? from + (block.minTime - from) / stepMs * stepMs : 0;
+            if (block.rollups && block.minTime >= from && block.maxTime < to && block.maxTime - bucketStart < stepMs) {
+                if (!foldRollups(block, slot, bucketStart, out)) {
+                    error = "corrupt history segment";
+                    return false;
+                }
+                tick += block.ticks;
+                continue;
+            }
+            if (!decodeBlock(stream, bits, block, tick, joined, slot, from, to, stepMs, states, out)) {
+                error = "truncated history segment";
+                return false;
+            }
+            tick += block.ticks;
+        }
+    }
+
+    // Ticks come in time order unless the wall clock stepped back; fold any
+    // bucket that shows up twice.
+    for (size_t s = 0; s < out.size(); ++s) {
+        std::vector<HistoryBucket>& buckets = out[s].buckets;
+        bool sorted = true;
+        for (size_t b = 1; b < buckets.size() && sorted; ++b) sorted = buckets[b - 1].start < buckets[b].start;
+        if (sorted) continue;
+        std::stable_sort(buckets.begin(), buckets.end(),
+                         [](const HistoryBucket& a, const HistoryBucket& b) { return a.start < b.start; });
+        size_t w = 0;
+        for (size_t b = 1; b < buckets.size(); ++b) {
+            if (buckets[b].start == buckets[w].start) {
+                buckets[w].min = std::min(buckets[w].min, buckets[b].min);
+                buckets[w].max = std::max(buckets[w].max, buckets[b].max);
+                buckets[w].sum += buckets[b].sum;
+                buckets[w].count += buckets[b].count;
+            } else {
+                buckets[++w] = buckets[b];
+            }
+        }
+        buckets.resize(w + 1);
+    }
+    std::sort(out.begin(), out.end(), [](const HistorySeries& a, const HistorySeries& b) { return a.name < b.name; });
+    return true;
+}
+
+void printHistory(const std::vector<HistorySeries>& series, int64_t stepMs, std::wostream& out) {
+    for (size_t s = 0; s < series.size(); ++s) {
+        out << (s ? L"\n[" : L"[") << utf8ToWide(series[s].name.data(), series[s].name.size()) << L"]" << std::endl;
+        for (size_t b = 0; b < series[s].buckets.size(); ++b) {
+            const HistoryBucket& bucket = series[s].buckets[b];
+            const std::time_t when = static_cast<std::time_t>(bucket.start / 1000);
+            std::tm tm;
+#ifdef _WIN32
+            localtime_s(&tm, &when);
+#else
+            localtime_r(&when, &tm);
+#endif
+            wchar_t stamp[32];
+            const size_t n = std::wcsftime(stamp, sizeof(stamp) / sizeof(stamp[0]), L"%Y-%m-%d %H:%M:%S", &tm);
+            out << L"  " << std::wstring(stamp, n) << L"  min " << bucket.min << L"  mean " << std::fixed
+                << std::setprecision(2) << bucket.sum / static_cast<double>(bucket.count) << L"  max " << bucket.max
+                << L"  (" << bucket.count << (bucket.count == 1 ? L" sample)" : L" samples)") << std::endl;
+        }
+    }
+    if (series.empty()) out << L"No samples in range (buckets of " << stepMs << L" ms)." << std::endl;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Time series kept by `--watch --history <file>`: one value per series per
+// tick, in a memory-mapped file of fixed size.
+//
+//   file    := header, segment[segmentCount]
+//   header  := "SYSH" u16 version u16 reserved u32 segmentBytes
+//              u32 segmentCount, zeros up to 64 bytes
+//   segment := u64 sequence (0: unused), i64 firstTime, i64 lastTime,
+//              u32 ticks, u32 seriesCount, u32 namesBytes, u32 blocks,
+//              u64 bits, u32 namesRoom, u32 openBit, i64 openTime,
+//              names (series[seriesCount]) and spare room up to namesRoom,
+//              bit stream, ..., block[blocks] (the first one last)
+//   series  := str name, varint tick it joined at
+//   block   := rollup[seriesCount], i64 firstTime, i64 minTime,
+//              i64 maxTime, u32 ticks, u32 seriesCount, u32 startBit,
+//              u32 rollupBytes
+//   rollup  := varint count, and unless it is 0: varint min,
+//              varint max - min, f64 sum
+//   str     := varint byteLength, UTF-8 bytes
+//
+// Times are Unix milliseconds; integers are little endian. The bit stream
+// holds `ticks` ticks, each a timestamp and then one value per series that
+// has joined by then:
+//
+//   timestamp := delta-of-delta from the previous two ticks (the first
+//                tick of a block is at its firstTime with a delta of 0):
+//                '0' same delta | '10' 7 bits | '110' 9 bits |
+//                '1110' 12 bits | '1111' 64 bits, zigzag encoded
+//   value     := XOR with the series' previous value (0 at the start of
+//                a block): '0' unchanged | '10' meaningful bits in the
+//                previous window | '11' 6 bits leading zeros, 7 bits
+//                length, bits (length 0: no value this tick)
+//
+// Unchanged values cost one bit, so a tick of 50 idle disks is under 8
+// bytes and a week of 1 s ticks about 6 MB. The stream is cut into blocks
+// at 10 minute boundaries; each closed block is described at the end of
+// the segment by its ticks' min, max, sum and count per series, which a
+// query spanning the whole block folds in without decoding it. The open
+// block starts at openBit and openTime. Series seen for the first time join
+// the current segment while its spare name room lasts. Segments fill in
+// sequence; once all are used the oldest is recycled, so history rolls off
+// in whole segments and the file never grows. A segment's header is
+// updated after its bits, so a reader never decodes bits that aren't
+// there yet.
+
+const uint32_t kHistorySegmentBytes = 64 * 1024;
+const uint32_t kHistorySegmentCount = 128; // 8 MiB
+
+// One sample of a tick: "disk/C:/FreeSpace" = 123.
+struct HistoryPoint {
+    std::string series;
+    uint64_t value;
+};
+
+// Decoder state of one series: its last value and the bit window of the
+// last XOR written in full.
+struct HistoryXorState {
+    uint64_t prev;
+    unsigned leading;
+    unsigned trailing;
+};
+
+// A downsampling bucket of one series.
+struct HistoryBucket {
+    int64_t start; // Unix ms
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    uint64_t count;
+};
+
+class HistoryWriter {
+public:
+    HistoryWriter();
+
+    // Opens or creates the file. Appends always start a fresh segment.
+    bool open(const std::string& path, std::string& error);
+    // Records one tick. Series missing from `points` get no value; a
+    // series not yet in the current segment joins it, or starts a new one
+    // once its name room is used up.
+    void append(int64_t timeMs, const std::vector<HistoryPoint>& points);
+
+private:
+    // Claims the unused or oldest segment, with the series of `points`.
+    bool startSegment(int64_t timeMs, const std::vector<HistoryPoint>& points);
+    // Adds a series to the current segment; false if its name doesn't fit.
+    bool addSeries(const std::string& name);
+    // Writes the rollups of the block being filled to the segment's tail.
+    void closeBlock();
+    void openBlock(int64_t timeMs);
+
+    MappedFile m_file;
+    uint32_t m_segmentBytes;
+    uint32_t m_segmentCount;
+    uint64_t m_sequence; // of the newest segment
+    unsigned char* m_segment;
+    unsigned char* m_names; // end of the names written so far
+    unsigned char* m_namesEnd;
+    unsigned char* m_stream; // bit stream of m_segment
+    uint64_t m_bits;
+    size_t m_tailBytes; // of the closed blocks' descriptions
+    uint32_t m_ticks;
+    uint32_t m_blocks;
+    int64_t m_prevTime;
+    int64_t m_prevDelta;
+    std::vector<HistoryXorState> m_series;
+    bool m_truncated; // names didn't fit; the rest of the series are dropped
+    std::unordered_map<std::string, size_t> m_index;
+    std::vector<const uint64_t*> m_tick; // value per series, or null
+    // The block being filled: where it starts, its ticks' times and the
+    // rollup of each series (HistoryBucket::start unused).
+    uint64_t m_blockBit;
+    int64_t m_blockFirst;
+    int64_t m_blockMin;
+    int64_t m_blockMax;
+    uint32_t m_blockTicks;
+    std::vector<HistoryBucket> m_rollups;
+    std::vector<unsigned char> m_scratch;
+};
+
+struct HistorySeries {
+    std::string name;
+    std::vector<HistoryBucket> buckets; // in time order, empty ones left out
+};
+
+// Ticks in [from, to) of the series whose names contain `filter` (every
+// series if empty), folded into buckets of `stepMs` from `from`. Segments
+// outside the range are skipped without decoding. Series come out sorted
+// by name. False for a foreign or corrupt file.
+bool queryHistory(const void* data, size_t len, const std::string& filter, int64_t from, int64_t to,
+                  int64_t stepMs, std::vector<HistorySeries>& out, std::string& error);
+
+// Time span of the ticks in a history file; false if it holds none.
+bool historySpan(const void* data, size_t len, int64_t& first, int64_t& last);
+
+// One line per bucket: local time, min, mean, max and sample count.
+void printHistory(const std::vector<HistorySeries>& series, int64_t stepMs, std::wostream& out);
@@ -0,0 +1,1257 @@
+#include "linux_source.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <net/if.h>
+#include <sys/statvfs.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "processes.h"
+#include "procfs.h"
+#include "profile.h"
+#include "schema.h"
+#include "topology.h"
+
+namespace {
+
+// Writes into the columns of the current query. Properties that weren't
+// selected are dropped, and wants() lets collectors skip reading them.
+// An empty column list ("SELECT *") accepts every property.
+// The budget is checked at every row; once it runs out the result is
+// marked partial and everything after is dropped, with wants() turning
+// false so collectors stop reading files.
+class RowOut {
+public:
+    RowOut(ResultSet& rs, const std::vector<std::wstring>& cols, const QueryBudget& budget)
+        : m_rs(rs), m_all(cols.empty()), m_budget(budget) {
+        for (size_t c = 0; c < cols.size(); ++c) {
+            std::string name(cols[c].size(), '\0');
+            for (size_t k = 0; k < name.size(); ++k) name[k] = static_cast<char>(cols[c][k]);
+            m_rs.addColumn(name);
+        }
+    }
+
+    bool wants(const char* prop) const { return !m_rs.partial() && (m_all || m_rs.column(prop) >= 0); }
+    void row() {
+        if (m_rs.partial()) return;
+        QueryStatus status = m_budget.check();
+        if (status != QueryStatus::Complete) {
+            m_rs.setStatus(status);
+            return;
+        }
+        if (!m_rs.rowCount()) profileFirstRow();
+        m_rs.addRow();
+    }
+    size_t rows() const { return m_rs.rowCount(); }
+
+    void str(const char* prop, Slice v) {
+        int c = col(prop);
+        if (c >= 0) m_rs.setString(c, v.p, v.n);
+    }
+    void u64(const char* prop, uint64_t v) {
+        int c = col(prop);
+        if (c >= 0) m_rs.setUint(c, v);
+    }
+    void boolean(const char* prop, bool v) {
+        int c = col(prop);
+        if (c >= 0) m_rs.setBool(c, v);
+    }
+
+private:
+    int col(const char* prop) {
+        if (m_rs.partial()) return -1;
+        int c = m_rs.column(prop);
+        if (c < 0 && m_all) c = m_rs.addColumn(prop, std::strlen(prop));
+        return c;
+    }
+
+    ResultSet& m_rs;
+    bool m_all;
+    const QueryBudget& m_budget;
+};
+
+// Directory fd that closes itself.
+class Dir {
+public:
+    explicit Dir(const char* path, int at = AT_FDCWD) : m_fd(openat(at, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) {}
+    ~Dir() {
+        if (m_fd >= 0) close(m_fd);
+    }
+    Dir(const Dir&) = delete;
+    Dir& operator=(const Dir&) = delete;
+    int fd() const { return m_fd; }
+    bool ok() const { return m_fd >= 0; }
+
+private:
+    int m_fd;
+};
+
+bool exists(const char* path, int at = AT_FDCWD) {
+    return faccessat(at, path, F_OK, 0) == 0;
+}
+
+// "sda" < "sdb" < "sdaa", "nvme0n1p2" < "nvme0n1p10".
+bool naturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (std::isdigit(static_cast<unsigned char>(a[i])) && std::isdigit(static_cast<unsigned char>(b[j]))) {
+            size_t ie = i, je = j;
+            while (ie < a.size() && std::isdigit(static_cast<unsigned char>(a[ie]))) ++ie;
+            while (je < b.size() && std::isdigit(static_cast<unsigned char>(b[je]))) ++je;
+            unsigned long long x = std::strtoull(a.c_str() + i, NULL, 10);
+            unsigned long long y = std::strtoull(b.c_str() + j, NULL, 10);
+            if (x != y) return x < y;
+            i = ie;
+            j = je;
+        } else {
+            if (a[i] != b[j]) return a[i] < b[j];
+            ++i;
+            ++j;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+// Sorted names in a directory, without "." and "..".
+std::vector<std::string> listDir(const char* path) {
+    std::vector<std::string> names;
+    DIR* d = opendir(path);
+    if (!d) return names;
+    while (struct dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        names.push_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end(), naturalLess);
+    return names;
+}
+
+// Last path component of a symlink target, e.g. the PCI address a sysfs
+// "device" link points to.
+Slice linkBasename(int at, const char* path, char* buf, size_t size) {
+    ssize_t n = readlinkat(at, path, buf, size - 1);
+    if (n <= 0) return Slice();
+    buf[n] = '\0';
+    const char* slash = std::strrchr(buf, '/');
+    return slash ? Slice(slash + 1) : Slice(buf, n);
+}
+
+// A device's path as its uevents name it: where a /sys link leads,
+// without the "/sys" ("/devices/pci0000:00/0000:00:14.0/usb1/1-2").
+std::string devicePath(const std::string& sysLink) {
+    char buf[PATH_MAX];
+    if (!realpath(sysLink.c_str(), buf)) return std::string();
+    return std::strncmp(buf, "/sys/", 5) == 0 ? std::string(buf + 4) : std::string(buf);
+}
+
+std::string lastComponent(const std::string& path) {
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Value of KEY in a KEY=value file such as a sysfs uevent.
+bool keyValue(Slice text, const char* key, Slice& out) {
+    LineReader lines(text);
+    Slice line, k, v;
+    while (lines.next(line)) {
+        if (line.split('=', k, v) && k.equals(key)) {
+            out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Value of "key : value" in /proc/meminfo or /proc/cpuinfo style text.
+bool colonValue(Slice line, const char* key, Slice& out) {
+    Slice k;
+    return line.split(':', k, out) && k.equals(key);
+}
+
+std::string formatCimDateTime(time_t t) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[64]; // room for any int fields, not just four-digit years
+    std::snprintf(buf, sizeof(buf), "%04d%02d%02d%02d%02d%02d.000000+000",
+                  tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return buf;
+}
+
+// Decodes the octal escapes (\040 etc.) mountinfo uses for spaces.
+std::string unescapeMount(Slice s) {
+    std::string out;
+    out.reserve(s.n);
+    for (size_t k = 0; k < s.n; ++k) {
+        if (s.p[k] == '\\' && k + 3 < s.n) {
+            int v = 0;
+            bool octal = true;
+            for (int d = 1; d <= 3; ++d) {
+                char c = s.p[k + d];
+                if (c < '0' || c > '7') { octal = false; break; }
+                v = v * 8 + (c - '0');
+            }
+            if (octal) {
+                out.push_back(static_cast<char>(v));
+                k += 3;
+                continue;
+            }
+        }
+        out.push_back(s.p[k]);
+    }
+    return out;
+}
+
+struct MountEntry {
+    Slice majMin;
+    Slice mountPoint;
+    Slice fsType;
+    Slice source;
+};
+
+// Parses one /proc/self/mountinfo line:
+//   36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw
+bool parseMountLine(Slice line, MountEntry& m) {
+    Slice f[6];
+    const char* p = line.p;
+    const char* end = line.p + line.n;
+    for (int i = 0; i < 5; ++i) {
+        const char* b = p;
+        while (p < end && *p != ' ') ++p;
+        f[i] = Slice(b, p - b);
+        if (p < end) ++p;
+    }
+    // Skip optional fields up to the " - " separator.
+    while (p < end) {
+        const char* b = p;
+        while (p < end && *p != ' ') ++p;
+        bool sep = (p - b == 1 && *b == '-');
+        if (p < end) ++p;
+        if (sep) break;
+    }
+    const char* b = p;
+    while (p < end && *p != ' ') ++p;
+    m.fsType = Slice(b, p - b);
+    if (p < end) ++p;
+    b = p;
+    while (p < end && *p != ' ') ++p;
+    m.source = Slice(b, p - b);
+    m.majMin = f[2];
+    m.mountPoint = f[4];
+    return !m.fsType.empty();
+}
+
+// ---------------------------------------------------------------------------
+// SMBIOS (/sys/firmware/dmi/tables/DMI, root only)
+
+struct SmbiosStruct {
+    const unsigned char* data;
+    size_t len;            // formatted area
+    const unsigned char* strings;
+    const unsigned char* end;
+
+    unsigned byteAt(size_t off) const { return off < len ? data[off] : 0; }
+    unsigned wordAt(size_t off) const { return off + 1 < len ? data[off] | (data[off + 1] << 8) : 0; }
+    uint32_t dwordAt(size_t off) const {
+        return off + 3 < len ? data[off] | (data[off + 1] << 8) | (data[off + 2] << 16) | (static_cast<uint32_t>(data[off + 3]) << 24) : 0;
+    }
+    // String referenced by the byte at `off` (1-based index into the string set).
+    Slice string(size_t off) const {
+        unsigned idx = byteAt(off);
+        if (!idx) return Slice();
+        const unsigned char* s = strings;
+        for (unsigned k = 1; s < end && *s; ++k) {
+            const unsigned char* e = s;
+            while (e < end && *e) ++e;
+            if (k == idx) return Slice(reinterpret_cast<const char*>(s), e - s).trim();
+            s = e + 1;
+        }
+        return Slice();
+    }
+};
+
+// Calls fn for every structure of the given type in the table.
+template <class Fn>
+void forEachSmbios(const unsigned char* table, size_t size, unsigned type, Fn fn) {
+    const unsigned char* p = table;
+    const unsigned char* end = table + size;
+    while (p + 4 <= end) {
+        unsigned t = p[0];
+        size_t len = p[1];
+        if (len < 4 || p + len > end) break;
+        // The string set ends with a double NUL.
+        const unsigned char* s = p + len;
+        while (s + 1 < end && (s[0] || s[1])) ++s;
+        SmbiosStruct st = { p, len, p + len, s };
+        if (t == type) fn(st);
+        if (t == 127) break; // end-of-table
+        p = s + 2;
+    }
+}
+
+const char* kDmiTable = "/sys/firmware/dmi/tables/DMI";
+
+// ---------------------------------------------------------------------------
+// Collectors, one per WMI class
+
+void collectOperatingSystem(RowOut& out, FileReader& r) {
+    out.row();
+    Slice v, line;
+    if (out.wants("Caption")) {
+        if (r.read("/etc/os-release", v) || r.read("/usr/lib/os-release", v)) {
+            Slice name;
+            if (keyValue(v, "PRETTY_NAME", name)) out.str("Caption", name.stripQuotes());
+        }
+    }
+    if (out.wants("Version") && r.value("/proc/sys/kernel/osrelease", v)) out.str("Version", v);
+    if (out.wants("BuildNumber") && r.value("/proc/sys/kernel/version", v)) out.str("BuildNumber", v);
+    if (out.wants("OSArchitecture")) {
+        struct utsname u;
+        if (uname(&u) == 0) out.str("OSArchitecture", u.machine);
+    }
+    if (out.wants("SerialNumber") && r.value("/etc/machine-id", v)) out.str("SerialNumber", v);
+    if (out.wants("LastBootUpTime") && r.read("/proc/stat", v)) {
+        LineReader lines(v);
+        while (lines.next(line)) {
+            if (line.startsWith("btime ")) {
+                out.str("LastBootUpTime", formatCimDateTime(static_cast<time_t>(Slice(line.p + 6, line.n - 6).toU64())).c_str());
+                break;
+            }
+        }
+    }
+    if (out.wants("BootDevice") && r.read("/proc/self/mountinfo", v)) {
+        LineReader lines(v);
+        MountEntry m;
+        while (lines.next(line)) {
+            if (parseMountLine(line, m) && m.mountPoint.equals("/")) {
+                out.str("BootDevice", m.source);
+                break;
+            }
+        }
+    }
+    if (out.wants("Locale")) {
+        const char* names[] = { "LC_ALL", "LC_MESSAGES", "LANG" };
+        for (size_t k = 0; k < 3; ++k) {
+            const char* l = std::getenv(names[k]);
+            if (l && *l) {
+                out.str("Locale", l);
+                break;
+            }
+        }
+    }
+    if ((out.wants("TotalVisibleMemorySize") || out.wants("FreePhysicalMemory")) && r.read("/proc/meminfo", v)) {
+        // Both are in kB, like the WMI properties. MemAvailable matches
+        // Windows' notion of free (free + reclaimable cache) best.
+        uint64_t total = 0, avail = 0, free = 0;
+        LineReader lines(v);
+        Slice val;
+        while (lines.next(line)) {
+            if (colonValue(line, "MemTotal", val)) total = val.toU64();
+            else if (colonValue(line, "MemFree", val)) free = val.toU64();
+            else if (colonValue(line, "MemAvailable", val)) { avail = val.toU64(); break; }
+        }
+        out.u64("TotalVisibleMemorySize", total);
+        out.u64("FreePhysicalMemory", avail ? avail : free);
+    }
+}
+
+// Number of CPUs in a sysfs cpu list such as "0-3,8-11".
+unsigned cpuListCount(Slice list) {
+    unsigned count = 0;
+    const char* p = list.p;
+    const char* end = list.p + list.n;
+    while (p < end) {
+        unsigned long a = std::strtoul(p, const_cast<char**>(&p), 10);
+        unsigned long b = a;
+        if (p < end && *p == '-') b = std::strtoul(p + 1, const_cast<char**>(&p), 10);
+        count += static_cast<unsigned>(b - a + 1);
+        while (p < end && (*p == ',' || *p == '\n' || *p == ' ')) ++p;
+        if (p < end && (*p < '0' || *p > '9')) break;
+    }
+    return count;
+}
+
+struct Package {
+    Package() : id(0), firstCpu(0), logical(0), cores(0), mhz(0), virt(false), haveFlags(false) {}
+    unsigned id;
+    unsigned firstCpu;
+    unsigned logical;
+    unsigned cores;
+    unsigned mhz;
+    bool virt;
+    bool haveFlags;
+    std::string model;
+    std::string vendor;
+};
+
+void collectProcessor(RowOut& out, FileReader& r) {
+    Slice v, line, val;
+    if (!r.read("/proc/cpuinfo", v)) return;
+
+    std::vector<Package> pkgs;
+    // Fields of the current "processor" block; applied at the blank line.
+    unsigned cpu = 0, physId = 0, cores = 0, mhz = 0;
+    bool inBlock = false, virt = false, haveFlags = false;
+    Slice model, vendor;
+    LineReader lines(v);
+    bool more = true;
+    while (more) {
+        more = lines.next(line);
+        if (more && !line.trim().empty()) {
+            if (colonValue(line, "processor", val)) {
+                cpu = static_cast<unsigned>(val.toU64());
+                inBlock = true;
+            }
+            else if (colonValue(line, "physical id", val)) physId = static_cast<unsigned>(val.toU64());
+            else if (colonValue(line, "model name", val) || colonValue(line, "Processor", val)) model = val;
+            else if (colonValue(line, "vendor_id", val) || colonValue(line, "CPU implementer", val)) vendor = val;
+            else if (colonValue(line, "cpu cores", val)) cores = static_cast<unsigned>(val.toU64());
+            else if (colonValue(line, "cpu MHz", val)) mhz = static_cast<unsigned>(val.toU64());
+            else if (colonValue(line, "flags", val)) {
+                haveFlags = true;
+                for (const char* f = val.p; f + 3 <= val.p + val.n; ++f) {
+                    if ((f == val.p || f[-1] == ' ') && (std::memcmp(f, "vmx", 3) == 0 || std::memcmp(f, "svm", 3) == 0) &&
+                        (f + 3 == val.p + val.n || f[3] == ' ')) {
+                        virt = true;
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+        // A blank line (or the end) closes a "processor" block. ARM kernels
+        // append a global block without a processor key; skip that.
+        if (!inBlock) continue;
+        size_t k = 0;
+        while (k < pkgs.size() && pkgs[k].id != physId) ++k;
+        if (k == pkgs.size()) {
+            pkgs.push_back(Package());
+            pkgs[k].id = physId;
+            pkgs[k].firstCpu = cpu;
+            pkgs[k].model.assign(model.p, model.n);
+            pkgs[k].vendor.assign(vendor.p, vendor.n);
+            pkgs[k].cores = cores;
+            pkgs[k].mhz = mhz;
+            pkgs[k].virt = virt;
+            pkgs[k].haveFlags = haveFlags;
+        }
+        ++pkgs[k].logical;
+        cpu = physId = cores = mhz = 0;
+        inBlock = virt = haveFlags = false;
+        model = vendor = Slice();
+    }
+
+    std::string processorId;
+#if defined(__x86_64__) || defined(__i386__)
+    if (out.wants("ProcessorId")) {
+        unsigned a, b, c, d;
+        if (__get_cpuid(1, &a, &b, &c, &d)) {
+            char buf[20];
+            std::snprintf(buf, sizeof(buf), "%08X%08X", d, a);
+            processorId = buf;
+        }
+    }
+#endif
+
+    std::vector<std::string> sockets;
+    const unsigned char* dmi;
+    size_t dmiLen;
+    if (out.wants("SocketDesignation") && r.readBinary(kDmiTable, dmi, dmiLen)) {
+        forEachSmbios(dmi, dmiLen, 4, [&](const SmbiosStruct& s) {
+            Slice name = s.string(0x04);
+            sockets.push_back(std::string(name.p, name.n));
+        });
+    }
+
+    for (size_t k = 0; k < pkgs.size(); ++k) {
+        const Package& p = pkgs[k];
+        out.row();
+        if (!p.model.empty()) out.str("Name", Slice(p.model.data(), p.model.size()));
+        if (!p.vendor.empty()) out.str("Manufacturer", Slice(p.vendor.data(), p.vendor.size()));
+        out.u64("NumberOfCores", p.cores ? p.cores : p.logical);
+        out.u64("NumberOfLogicalProcessors", p.logical);
+        if (!processorId.empty()) out.str("ProcessorId", processorId.c_str());
+        if (k < sockets.size()) out.str("SocketDesignation", Slice(sockets[k].data(), sockets[k].size()));
+        if (p.haveFlags) out.boolean("VirtualizationFirmwareEnabled", p.virt);
+
+        char path[128];
+        Dir cpuDir((std::string("/sys/devices/system/cpu/cpu") + std::to_string(p.firstCpu)).c_str());
+        if (out.wants("MaxClockSpeed")) {
+            if (cpuDir.ok() && r.valueAt(cpuDir.fd(), "cpufreq/cpuinfo_max_freq", v)) {
+                out.u64("MaxClockSpeed", v.toU64() / 1000);
+            } else if (p.mhz) {
+                out.u64("MaxClockSpeed", p.mhz);
+            }
+        }
+        if (cpuDir.ok() && (out.wants("L2CacheSize") || out.wants("L3CacheSize"))) {
+            // Windows reports the per-package total: size of one instance
+            // times the number of instances in the package.
+            uint64_t l2 = 0, l3 = 0;
+            for (int idx = 0; idx < 16; ++idx) {
+                std::snprintf(path, sizeof(path), "cache/index%d/level", idx);
+                if (!r.valueAt(cpuDir.fd(), path, v)) break;
+                uint64_t level = v.toU64();
+                if (level != 2 && level != 3) continue;
+                std::snprintf(path, sizeof(path), "cache/index%d/size", idx);
+                if (!r.valueAt(cpuDir.fd(), path, v)) continue;
+                uint64_t kb = v.toU64();
+                if (v.n && (v.p[v.n - 1] == 'M')) kb *= 1024;
+                std::snprintf(path, sizeof(path), "cache/index%d/shared_cpu_list", idx);
+                unsigned sharing = r.valueAt(cpuDir.fd(), path, v) ? cpuListCount(v) : 1;
+                unsigned instances = sharing ? (p.logical + sharing - 1) / sharing : 1;
+                (level == 2 ? l2 : l3) += kb * (instances ? instances : 1);
+            }
+            if (l2) out.u64("L2CacheSize", l2);
+            if (l3) out.u64("L3CacheSize", l3);
+        }
+    }
+}
+
+// SMBIOS memory device form factor -> CIM_PhysicalMemory.FormFactor.
+unsigned cimFormFactor(unsigned smbios) {
+    switch (smbios) {
+    case 0x03: return 7;  // SIMM
+    case 0x09: return 8;  // DIMM
+    case 0x0C: return 11; // RIMM
+    case 0x0D: return 12; // SODIMM
+    case 0x01: return 1;  // Other
+    default: return 0;    // Unknown
+    }
+}
+
+void collectPhysicalMemory(RowOut& out, FileReader& r) {
+    const unsigned char* dmi;
+    size_t len;
+    if (r.readBinary(kDmiTable, dmi, len)) {
+        forEachSmbios(dmi, len, 17, [&](const SmbiosStruct& s) {
+            unsigned size = s.wordAt(0x0C);
+            if (size == 0 || size == 0xFFFF) return; // empty slot / unknown
+            uint64_t bytes;
+            if (size == 0x7FFF) bytes = static_cast<uint64_t>(s.dwordAt(0x1C) & 0x7FFFFFFF) << 20;
+            else if (size & 0x8000) bytes = static_cast<uint64_t>(size & 0x7FFF) << 10;
+            else bytes = static_cast<uint64_t>(size) << 20;
+            out.row();
+            Slice bank = s.string(0x11);
+            out.str("BankLabel", bank.empty() ? s.string(0x10) : bank);
+            out.str("DeviceLocator", s.string(0x10));
+            out.u64("Capacity", bytes);
+            if (s.wordAt(0x15)) out.u64("Speed", s.wordAt(0x15));
+            // SMBIOS memory type (26 = DDR4, 34 = DDR5), i.e. what Windows
+            // reports as SMBIOSMemoryType.
+            out.u64("MemoryType", s.byteAt(0x12));
+            out.u64("FormFactor", cimFormFactor(s.byteAt(0x0E)));
+            out.str("Manufacturer", s.string(0x17));
+            out.str("SerialNumber", s.string(0x18));
+            out.str("PartNumber", s.string(0x1A));
+        });
+        if (out.rows()) return;
+    }
+    // Without access to the DMI table report the installed total only.
+    Slice v, line, val;
+    if (!r.read("/proc/meminfo", v)) return;
+    LineReader lines(v);
+    while (lines.next(line)) {
+        if (colonValue(line, "MemTotal", val)) {
+            out.row();
+            out.str("BankLabel", "System RAM");
+            out.u64("Capacity", val.toU64() * 1024);
+            break;
+        }
+    }
+}
+
+void collectVideoController(RowOut& out, FileReader& r) {
+    std::vector<std::string> entries = listDir("/sys/class/drm");
+    Slice v;
+    char buf[256];
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const std::string& card = entries[i];
+        if (card.compare(0, 4, "card") != 0 || card.find('-') != std::string::npos) continue;
+        Dir dev(("/sys/class/drm/" + card + "/device").c_str());
+        if (!dev.ok()) continue;
+        out.row();
+
+        std::string driver, vendor, device;
+        if (r.readAt(dev.fd(), "uevent", v)) {
+            Slice d;
+            if (keyValue(v, "DRIVER", d)) driver.assign(d.p, d.n);
+        }
+        if (r.valueAt(dev.fd(), "vendor", v)) vendor.assign(v.p + (v.startsWith("0x") ? 2 : 0), v.n - (v.startsWith("0x") ? 2 : 0));
+        if (r.valueAt(dev.fd(), "device", v)) device.assign(v.p + (v.startsWith("0x") ? 2 : 0), v.n - (v.startsWith("0x") ? 2 : 0));
+        std::transform(vendor.begin(), vendor.end(), vendor.begin(), ::toupper);
+        std::transform(device.begin(), device.end(), device.begin(), ::toupper);
+
+        if (out.wants("Name") || out.wants("VideoProcessor")) {
+            std::string name = driver.empty() ? card : driver;
+            if (!vendor.empty()) name += " [" + vendor + ":" + device + "]";
+            out.str("Name", name.c_str());
+        }
+        if (out.wants("DriverVersion") && !driver.empty() &&
+            r.value(("/sys/module/" + driver + "/version").c_str(), v)) {
+            out.str("DriverVersion", v);
+        }
+        if (out.wants("AdapterRAM") && r.valueAt(dev.fd(), "mem_info_vram_total", v)) out.u64("AdapterRAM", v.toU64());
+        if (out.wants("PNPDeviceID")) {
+            Slice slot = linkBasename(AT_FDCWD, ("/sys/class/drm/" + card + "/device").c_str(), buf, sizeof(buf));
+            std::string id = vendor.empty() ? std::string(slot.p, slot.n)
+                                            : "PCI\\VEN_" + vendor + "&DEV_" + device + "\\" + std::string(slot.p, slot.n);
+            out.str("PNPDeviceID", id.c_str());
+        }
+        out.str("Status", "OK");
+
+        if (out.wants("CurrentHorizontalResolution") || out.wants("CurrentVerticalResolution")) {
+            // First connected connector of this card, e.g. card0-HDMI-A-1.
+            for (size_t j = 0; j < entries.size(); ++j) {
+                if (entries[j].compare(0, card.size() + 1, card + "-") != 0) continue;
+                Dir conn(("/sys/class/drm/" + entries[j]).c_str());
+                if (!conn.ok() || !r.valueAt(conn.fd(), "status", v) || !v.equals("connected")) continue;
+                if (!r.readAt(conn.fd(), "modes", v)) continue;
+                Slice mode, w, h;
+                LineReader modes(v);
+                if (modes.next(mode) && mode.split('x', w, h)) {
+                    out.u64("CurrentHorizontalResolution", w.toU64());
+                    out.u64("CurrentVerticalResolution", h.toU64());
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Physical block devices in the order that defines their disk index.
+std::vector<std::string> physicalDisks() {
+    std::vector<std::string> all = listDir("/sys/block");
+    std::vector<std::string> disks;
+    char path[300];
+    for (size_t i = 0; i < all.size(); ++i) {
+        // loop, ram, zram, dm-* and md* have no backing device; sr* are optical drives.
+        std::snprintf(path, sizeof(path), "/sys/block/%s/device", all[i].c_str());
+        if (all[i].compare(0, 2, "sr") == 0 || !exists(path)) continue;
+        disks.push_back(all[i]);
+    }
+    return disks;
+}
+
+// Partitions of a disk (entries with a "partition" attribute), natural order.
+std::vector<std::string> diskPartitions(const std::string& disk, int diskFd) {
+    std::vector<std::string> parts;
+    std::vector<std::string> entries = listDir(("/sys/block/" + disk).c_str());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].compare(0, disk.size(), disk) == 0 && exists((entries[i] + "/partition").c_str(), diskFd)) {
+            parts.push_back(entries[i]);
+        }
+    }
+    return parts;
+}
+
+struct BlockMount {
+    std::string majMin, mountPoint, fsType, source;
+};
+
+// Block-device backed filesystems, each device once at its first mount
+// point (bind mounts and btrfs subvolumes repeat it). These are the
+// logical disks.
+std::vector<BlockMount> blockMounts(FileReader& r) {
+    std::vector<BlockMount> mounts;
+    Slice v, line;
+    if (!r.read("/proc/self/mountinfo", v)) return mounts;
+    std::unordered_set<std::string> seen;
+    LineReader lines(v);
+    MountEntry m;
+    while (lines.next(line)) {
+        if (!parseMountLine(line, m) || !m.source.startsWith("/dev/") || m.source.startsWith("/dev/loop")) continue;
+        BlockMount mt;
+        mt.majMin.assign(m.majMin.p, m.majMin.n);
+        if (!seen.insert(mt.majMin).second) continue;
+        mt.mountPoint = unescapeMount(m.mountPoint);
+        mt.fsType.assign(m.fsType.p, m.fsType.n);
+        mt.source.assign(m.source.p, m.source.n);
+        mounts.push_back(mt);
+    }
+    return mounts;
+}
+
+// A disk without a partition table that holds a mounted filesystem, or
+// backs a volume (LVM, LUKS, RAID), itself. It counts as one partition
+// spanning the disk, as Windows reports a superfloppy, so that its
+// volumes have a partition to link to.
+bool wholeDiskVolume(FileReader& r, const std::string& disk, int diskFd, const std::vector<BlockMount>& mounts) {
+    if (!listDir(("/sys/block/" + disk + "/holders").c_str()).empty()) return true;
+    Slice v;
+    if (!r.valueAt(diskFd, "dev", v)) return false;
+    for (size_t k = 0; k < mounts.size(); ++k) {
+        if (v.equals(mounts[k].majMin.c_str())) return true;
+    }
+    return false;
+}
+
+const char* interfaceType(int at, const std::string& disk) {
+    char buf[512];
+    ssize_t n = readlinkat(at, disk.c_str(), buf, sizeof(buf) - 1);
+    if (n <= 0) return "Unknown";
+    buf[n] = '\0';
+    if (std::strstr(buf, "/usb")) return "USB";
+    if (std::strstr(buf, "/nvme")) return "NVMe";
+    if (std::strstr(buf, "/virtio")) return "Virtio";
+    if (std::strstr(buf, "/mmc")) return "SD";
+    if (std::strstr(buf, "/ata")) return "IDE"; // Windows reports SATA disks as IDE too
+    return "SCSI";
+}
+
+// One physical disk, `index` being its place in physicalDisks().
+void diskDrive(RowOut& out, FileReader& r, int blockFd, const std::string& disk, size_t index) {
+    Dir dir(disk.c_str(), blockFd);
+    if (!dir.ok()) return;
+    Slice v;
+    out.row();
+    out.u64("Index", index);
+    if (out.wants("Model")) {
+        out.str("Model", r.valueAt(dir.fd(), "device/model", v) ? v : Slice(disk.c_str()));
+    }
+    if (out.wants("SerialNumber")) {
+        if (r.valueAt(dir.fd(), "device/serial", v) || r.valueAt(dir.fd(), "serial", v) ||
+            r.valueAt(dir.fd(), "device/wwid", v)) {
+            out.str("SerialNumber", v);
+        }
+    }
+    if (out.wants("FirmwareRevision")) {
+        if (r.valueAt(dir.fd(), "device/firmware_rev", v) || r.valueAt(dir.fd(), "device/rev", v)) {
+            out.str("FirmwareRevision", v);
+        }
+    }
+    if (out.wants("InterfaceType")) out.str("InterfaceType", interfaceType(blockFd, disk));
+    if (out.wants("MediaType")) {
+        bool removable = r.valueAt(dir.fd(), "removable", v) && v.equals("1");
+        out.str("MediaType", removable ? "Removable Media" : "Fixed hard disk media");
+    }
+    if (out.wants("Size") && r.valueAt(dir.fd(), "size", v)) out.u64("Size", v.toU64() * 512);
+    if (out.wants("Partitions")) {
+        size_t parts = diskPartitions(disk, dir.fd()).size();
+        if (!parts && wholeDiskVolume(r, disk, dir.fd(), blockMounts(r))) parts = 1;
+        out.u64("Partitions", parts);
+    }
+    if (out.wants("Status")) {
+        // SCSI devices say "running", NVMe controllers "live".
+        if (!r.valueAt(dir.fd(), "device/state", v) || v.equals("running") || v.equals("live")) {
+            out.str("Status", "OK");
+        } else {
+            out.str("Status", v);
+        }
+    }
+    if (out.wants("PNPDeviceID")) out.str("PNPDeviceID", ("/dev/" + disk).c_str());
+}
+
+void collectDiskDrive(RowOut& out, FileReader& r) {
+    std::vector<std::string> disks = physicalDisks();
+    Dir block("/sys/block");
+    for (size_t i = 0; i < disks.size(); ++i) diskDrive(out, r, block.fd(), disks[i], i);
+}
+
+void collectDiskPartition(RowOut& out, FileReader& r) {
+    // Partitions mounted at /boot or /boot/efi count as boot partitions.
+    std::vector<std::string> bootDevs;
+    Slice v, line;
+    if ((out.wants("Bootable") || out.wants("BootPartition")) && r.read("/proc/self/mountinfo", v)) {
+        LineReader lines(v);
+        MountEntry m;
+        while (lines.next(line)) {
+            if (parseMountLine(line, m) && (m.mountPoint.equals("/boot") || m.mountPoint.equals("/boot/efi"))) {
+                bootDevs.push_back(std::string(m.majMin.p, m.majMin.n));
+            }
+        }
+    }
+
+    const std::vector<BlockMount> mounts = blockMounts(r);
+    std::vector<std::string> disks = physicalDisks();
+    Dir block("/sys/block");
+    char buf[64];
+    for (size_t i = 0; i < disks.size(); ++i) {
+        Dir dir(disks[i].c_str(), block.fd());
+        if (!dir.ok()) continue;
+        std::vector<std::string> parts = diskPartitions(disks[i], dir.fd());
+        // A whole-disk volume's partition is the disk's own directory.
+        const bool whole = parts.empty() && wholeDiskVolume(r, disks[i], dir.fd(), mounts);
+        if (whole) parts.push_back(".");
+        for (size_t k = 0; k < parts.size(); ++k) {
+            Dir part(parts[k].c_str(), dir.fd());
+            if (!part.ok()) continue;
+            out.row();
+            uint64_t number = r.valueAt(part.fd(), "partition", v) ? v.toU64() : k + 1;
+            // Windows numbers partitions from 0.
+            std::snprintf(buf, sizeof(buf), "Disk #%u, Partition #%u", static_cast<unsigned>(i),
+                          static_cast<unsigned>(number ? number - 1 : 0));
+            out.str("DeviceID", buf);
+            out.u64("DiskIndex", i);
+            out.str("Name", ("/dev/" + (whole ? disks[i] : parts[k])).c_str());
+            if (out.wants("Size") && r.valueAt(part.fd(), "size", v)) out.u64("Size", v.toU64() * 512);
+            if (out.wants("StartingOffset")) {
+                if (whole) out.u64("StartingOffset", 0);
+                else if (r.valueAt(part.fd(), "start", v)) out.u64("StartingOffset", v.toU64() * 512);
+            }
+            if (out.wants("Type") && r.readAt(part.fd(), "uevent", v)) {
+                Slice name;
+                if (keyValue(v, "PARTNAME", name)) out.str("Type", name);
+            }
+            if (out.wants("Bootable") || out.wants("BootPartition")) {
+                bool boot = false;
+                if (r.valueAt(part.fd(), "dev", v)) {
+                    for (size_t b = 0; b < bootDevs.size(); ++b) boot = boot || v.equals(bootDevs[b].c_str());
+                }
+                out.boolean("Bootable", boot);
+                out.boolean("BootPartition", boot);
+            }
+        }
+    }
+}
+
+void collectLogicalDisk(RowOut& out, FileReader& r) {
+    const std::vector<BlockMount> mounts = blockMounts(r);
+
+    // Filesystem labels come from the udev by-label links.
+    std::vector<std::pair<std::string, std::string> > labels;
+    if (out.wants("VolumeName")) {
+        std::vector<std::string> names = listDir("/dev/disk/by-label");
+        Dir byLabel("/dev/disk/by-label");
+        char buf[256];
+        for (size_t k = 0; k < names.size(); ++k) {
+            Slice target = linkBasename(byLabel.fd(), names[k].c_str(), buf, sizeof(buf));
+            labels.push_back(std::make_pair(std::string(target.p, target.n), unescapeMount(Slice(names[k].c_str()))));
+        }
+    }
+
+    for (size_t k = 0; k < mounts.size(); ++k) {
+        out.row();
+        out.str("DeviceID", mounts[k].mountPoint.c_str());
+        out.str("FileSystem", mounts[k].fsType.c_str());
+        if (out.wants("VolumeName")) {
+            const char* dev = std::strrchr(mounts[k].source.c_str(), '/') + 1;
+            for (size_t l = 0; l < labels.size(); ++l) {
+                if (labels[l].first == dev) {
+                    out.str("VolumeName", labels[l].second.c_str());
+                    break;
+                }
+            }
+        }
+        if (out.wants("Size") || out.wants("FreeSpace")) {
+            struct statvfs st;
+            if (statvfs(mounts[k].mountPoint.c_str(), &st) == 0) {
+                out.u64("Size", static_cast<uint64_t>(st.f_blocks) * st.f_frsize);
+                out.u64("FreeSpace", static_cast<uint64_t>(st.f_bavail) * st.f_frsize);
+            }
+        }
+    }
+}
+
+// Partitions backing a block device: itself if it is one, or a physical
+// disk used whole (see wholeDiskVolume()), else whatever its device-mapper
+// or md "slaves" resolve to (LVM, LUKS, RAID).
+void backingPartitions(const std::string& name, int depth, std::vector<std::string>& parts) {
+    char path[300];
+    std::snprintf(path, sizeof(path), "/sys/class/block/%s/partition", name.c_str());
+    bool partition = exists(path);
+    std::snprintf(path, sizeof(path), "/sys/block/%s/device", name.c_str());
+    partition = partition || exists(path);
+    if (partition) {
+        if (std::find(parts.begin(), parts.end(), name) == parts.end()) parts.push_back(name);
+        return;
+    }
+    if (depth >= 8) return;
+    std::snprintf(path, sizeof(path), "/sys/class/block/%s/slaves", name.c_str());
+    std::vector<std::string> slaves = listDir(path);
+    for (size_t k = 0; k < slaves.size(); ++k) backingPartitions(slaves[k], depth + 1, parts);
+}
+
+// Formats a WMI object path into `out`, escaping the key value as WMI does.
+void formatObjectPath(std::string& out, const char* host, const char* cls, const std::string& deviceId) {
+    out = "\\\\";
+    out += host;
+    out += "\\root\\cimv2:";
+    out += cls;
+    out += ".DeviceID=\"";
+    for (size_t k = 0; k < deviceId.size(); ++k) {
+        if (deviceId[k] == '"' || deviceId[k] == '\\') out.push_back('\\');
+        out.push_back(deviceId[k]);
+    }
+    out.push_back('"');
+}
+
+// Mounted filesystem -> the partitions under it, with the same DeviceIDs
+// as collectDiskPartition() and collectLogicalDisk().
+void collectLogicalDiskToPartition(RowOut& out, FileReader& r) {
+    const std::vector<BlockMount> mounts = blockMounts(r);
+    if (mounts.empty()) return;
+
+    std::unordered_map<std::string, size_t> diskIndex;
+    const std::vector<std::string> disks = physicalDisks();
+    for (size_t i = 0; i < disks.size(); ++i) diskIndex[disks[i]] = i;
+
+    struct utsname u;
+    const char* host = uname(&u) == 0 ? u.nodename : "localhost";
+    Dir devBlock("/sys/dev/block");
+    Slice v;
+    char buf[300];
+    std::string antecedent, dependent;
+    std::vector<std::string> parts;
+    for (size_t k = 0; k < mounts.size(); ++k) {
+        Slice name = linkBasename(devBlock.fd(), mounts[k].majMin.c_str(), buf, sizeof(buf));
+        if (!name.n) continue;
+        parts.clear();
+        backingPartitions(std::string(name.p, name.n), 0, parts);
+        formatObjectPath(dependent, host, "Win32_LogicalDisk", mounts[k].mountPoint);
+        for (size_t p = 0; p < parts.size(); ++p) {
+            // A whole disk is its own partition #0; a partition's sysfs
+            // directory sits inside its disk's.
+            std::unordered_map<std::string, size_t>::const_iterator idx = diskIndex.find(parts[p]);
+            if (idx == diskIndex.end()) {
+                std::snprintf(buf, sizeof(buf), "/sys/class/block/%s", parts[p].c_str());
+                char target[512];
+                ssize_t n = readlink(buf, target, sizeof(target) - 1);
+                if (n <= 0) continue;
+                target[n] = '\0';
+                char* slash = std::strrchr(target, '/');
+                if (!slash) continue;
+                *slash = '\0';
+                const char* disk = std::strrchr(target, '/');
+                idx = diskIndex.find(disk ? disk + 1 : target);
+                if (idx == diskIndex.end()) continue;
+            }
+            std::snprintf(buf, sizeof(buf), "/sys/class/block/%s/partition", parts[p].c_str());
+            uint64_t number = r.value(buf, v) ? v.toU64() : 1;
+            std::snprintf(buf, sizeof(buf), "Disk #%u, Partition #%u", static_cast<unsigned>(idx->second),
+                          static_cast<unsigned>(number ? number - 1 : 0));
+            formatObjectPath(antecedent, host, "Win32_DiskPartition", buf);
+            out.row();
+            out.str("Antecedent", antecedent.c_str());
+            out.str("Dependent", dependent.c_str());
+        }
+    }
+}
+
+// Copies the /sys/class/dmi/id attributes a schema names as its fields'
+// Linux sources into properties; no row without DMI.
+void collectDmi(RowOut& out, FileReader& r, const ClassSchema& schema) {
+    static const char kPrefix[] = "/sys/class/dmi/id/";
+    Dir id("/sys/class/dmi/id");
+    if (!id.ok()) return;
+    out.row();
+    Slice v;
+    for (size_t k = 0; k < schema.fieldCount; ++k) {
+        const FieldDef& field = schema.fields[k];
+        const char* source = field.linuxSource;
+        if (std::strncmp(source, kPrefix, sizeof(kPrefix) - 1) != 0 || std::strchr(source, ' ')) continue;
+        if (out.wants(field.property) && r.valueAt(id.fd(), source + sizeof(kPrefix) - 1, v)) out.str(field.property, v);
+    }
+}
+
+void collectBaseBoard(RowOut& out, FileReader& r) {
+    collectDmi(out, r, kBaseBoardSchema);
+}
+
+void collectBios(RowOut& out, FileReader& r) {
+    collectDmi(out, r, kBiosSchema);
+    Slice v;
+    if (out.rows() && out.wants("ReleaseDate") && r.value("/sys/class/dmi/id/bios_date", v) && v.n == 10) {
+        // MM/DD/YYYY -> CIM datetime, as WMI reports it.
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.4s%.2s%.2s000000.000000+000", v.p + 6, v.p, v.p + 3);
+        out.str("ReleaseDate", buf);
+    }
+}
+
+void collectComputerSystemProduct(RowOut& out, FileReader& r) {
+    collectDmi(out, r, kComputerSystemProductSchema);
+}
+
+void collectTpm(RowOut& out, FileReader& r) {
+    Dir tpm("/sys/class/tpm/tpm0");
+    if (!tpm.ok()) return;
+    out.row();
+    Slice v;
+    if (out.wants("SpecVersion")) {
+        bool v2 = r.valueAt(tpm.fd(), "tpm_version_major", v) && v.equals("2");
+        out.str("SpecVersion", v2 ? "2.0" : "1.2");
+    }
+    if (out.wants("ManufacturerID") && r.valueAt(tpm.fd(), "device/firmware_node/hid", v)) out.str("ManufacturerID", v);
+    if (out.wants("ManufacturerVersion") && r.valueAt(tpm.fd(), "device/description", v)) out.str("ManufacturerVersion", v);
+    if (out.wants("PhysicalPresenceVersionInfo") && r.valueAt(tpm.fd(), "ppi/version", v)) out.str("PhysicalPresenceVersionInfo", v);
+    // A TPM the kernel bound a driver to is enabled and activated.
+    out.boolean("IsEnabled_InitialValue", true);
+    out.boolean("IsActivated_InitialValue", true);
+}
+
+struct SoundCard {
+    unsigned index;
+    std::string name;
+    std::string driver;
+};
+
+std::vector<SoundCard> soundCards(FileReader& r) {
+    // /proc/asound/cards:
+    //  0 [PCH            ]: HDA-Intel - HDA Intel PCH
+    //                       HDA Intel PCH at 0xf7f10000 irq 32
+    std::vector<SoundCard> cards;
+    Slice v, line;
+    if (!r.read("/proc/asound/cards", v)) return cards;
+    LineReader lines(v);
+    while (lines.next(line)) {
+        Slice t = line.trim();
+        if (t.empty() || t.p[0] < '0' || t.p[0] > '9') continue;
+        const char* close = t.find(']');
+        if (!close) continue;
+        Slice rest(close + 1, t.p + t.n - close - 1);
+        Slice driverAndName, unused;
+        if (!rest.split(':', unused, driverAndName)) continue;
+        const char* dash = std::strstr(driverAndName.p, " - ");
+        Slice driver = driverAndName, name = driverAndName;
+        if (dash && dash < driverAndName.p + driverAndName.n) {
+            driver = Slice(driverAndName.p, dash - driverAndName.p).trim();
+            name = Slice(dash + 3, driverAndName.p + driverAndName.n - dash - 3).trim();
+        }
+        SoundCard card = { static_cast<unsigned>(t.toU64()), std::string(name.p, name.n), std::string(driver.p, driver.n) };
+        cards.push_back(card);
+    }
+    return cards;
+}
+
+void soundDevice(RowOut& out, const SoundCard& card) {
+    out.row();
+    out.str("Name", card.name.c_str());
+    out.str("Manufacturer", card.driver.c_str());
+    out.str("Status", "OK");
+    if (out.wants("PNPDeviceID")) {
+        char buf[256], target[256];
+        std::snprintf(buf, sizeof(buf), "/sys/class/sound/card%u/device", card.index);
+        Slice dev = linkBasename(AT_FDCWD, buf, target, sizeof(target));
+        if (!dev.empty()) out.str("PNPDeviceID", dev);
+    }
+}
+
+void collectSoundDevice(RowOut& out, FileReader& r) {
+    std::vector<SoundCard> cards = soundCards(r);
+    for (size_t k = 0; k < cards.size(); ++k) soundDevice(out, cards[k]);
+}
+
+// One entry of /sys/bus/usb/devices; "1-1.2:1.0" style entries are
+// interfaces, not devices, and add no row.
+void usbDevice(RowOut& out, FileReader& r, int baseFd, const std::string& entry) {
+    if (entry.find(':') != std::string::npos) return;
+    Dir dev(entry.c_str(), baseFd);
+    Slice v;
+    std::string vid, pid;
+    if (!dev.ok() || !r.valueAt(dev.fd(), "idVendor", v)) return;
+    vid.assign(v.p, v.n);
+    if (r.valueAt(dev.fd(), "idProduct", v)) pid.assign(v.p, v.n);
+    std::transform(vid.begin(), vid.end(), vid.begin(), ::toupper);
+    std::transform(pid.begin(), pid.end(), pid.begin(), ::toupper);
+    out.row();
+
+    if (out.wants("Name") || out.wants("Description")) {
+        bool rootHub = entry.compare(0, 3, "usb") == 0;
+        bool hub = r.valueAt(dev.fd(), "bDeviceClass", v) && v.equals("09");
+        std::string product;
+        if (r.valueAt(dev.fd(), "product", v)) product.assign(v.p, v.n);
+        const char* generic = rootHub ? "USB Root Hub" : hub ? "USB Hub" : "USB Device";
+        out.str("Name", product.empty() ? generic : product.c_str());
+        out.str("Description", rootHub || hub || product.empty() ? generic : product.c_str());
+    }
+    if (out.wants("Manufacturer") && r.valueAt(dev.fd(), "manufacturer", v)) out.str("Manufacturer", v);
+    out.str("Status", "OK");
+    if (out.wants("PNPDeviceID") || out.wants("DeviceID")) {
+        std::string instance = entry;
+        if (r.valueAt(dev.fd(), "serial", v)) instance.assign(v.p, v.n);
+        std::string id = "USB\\VID_" + vid + "&PID_" + pid + "\\" + instance;
+        out.str("PNPDeviceID", id.c_str());
+        out.str("DeviceID", id.c_str());
+    }
+}
+
+void collectUsb(RowOut& out, FileReader& r) {
+    std::vector<std::string> entries = listDir("/sys/bus/usb/devices");
+    Dir base("/sys/bus/usb/devices");
+    for (size_t i = 0; i < entries.size(); ++i) usbDevice(out, r, base.fd(), entries[i]);
+}
+
+// Physical adapters have a backing device; lo, bridges, veth, tun don't,
+// and add no row.
+void networkAdapter(RowOut& out, FileReader& r, int baseFd, const std::string& iface) {
+    Dir nic(iface.c_str(), baseFd);
+    if (!nic.ok() || !exists("device", nic.fd())) return;
+    Slice v;
+    char buf[256];
+    out.row();
+    out.str("Name", iface.c_str());
+    if (out.wants("MACAddress") && r.valueAt(nic.fd(), "address", v)) {
+        std::string mac(v.p, v.n);
+        std::transform(mac.begin(), mac.end(), mac.begin(), ::toupper);
+        out.str("MACAddress", mac.c_str());
+    }
+    if (out.wants("AdapterType") && r.valueAt(nic.fd(), "type", v)) {
+        uint64_t type = v.toU64();
+        out.str("AdapterType", type == 1 ? "Ethernet 802.3" : type == 32 ? "InfiniBand" : "Unknown");
+    }
+    // "speed" fails with EINVAL while the link is down.
+    if (out.wants("Speed") && r.valueAt(nic.fd(), "speed", v) && v.p[0] != '-') {
+        out.u64("Speed", v.toU64() * 1000000);
+    }
+    if (out.wants("Manufacturer")) {
+        Slice driver = linkBasename(nic.fd(), "device/driver", buf, sizeof(buf));
+        if (!driver.empty()) out.str("Manufacturer", driver);
+    }
+    if (out.wants("NetConnectionStatus")) {
+        // Win32 codes: 2 = Connected, 7 = Media disconnected.
+        bool carrier = r.valueAt(nic.fd(), "carrier", v) && v.equals("1");
+        bool up = r.valueAt(nic.fd(), "operstate", v) && (v.equals("up") || (v.equals("unknown") && carrier));
+        out.u64("NetConnectionStatus", up ? 2 : 7);
+    }
+    if (out.wants("NetEnabled") && r.valueAt(nic.fd(), "flags", v)) {
+        out.boolean("NetEnabled", (std::strtoul(std::string(v.p, v.n).c_str(), NULL, 16) & 0x1) != 0); // IFF_UP
+    }
+    if (out.wants("PNPDeviceID")) {
+        Slice dev = linkBasename(nic.fd(), "device", buf, sizeof(buf));
+        if (!dev.empty()) out.str("PNPDeviceID", dev);
+    }
+}
+
+void collectNetworkAdapter(RowOut& out, FileReader& r) {
+    std::vector<std::string> ifaces = listDir("/sys/class/net");
+    Dir base("/sys/class/net");
+    for (size_t i = 0; i < ifaces.size(); ++i) networkAdapter(out, r, base.fd(), ifaces[i]);
+}
+
+struct ClassCollector {
+    const wchar_t* wmiClass;
+    void (*collect)(RowOut&, FileReader&);
+};
+
+const ClassCollector kCollectors[] = {
+    { L"Win32_OperatingSystem", collectOperatingSystem },
+    { L"Win32_Processor", collectProcessor },
+    { L"Win32_PhysicalMemory", collectPhysicalMemory },
+    { L"Win32_VideoController", collectVideoController },
+    { L"Win32_DiskDrive", collectDiskDrive },
+    { L"Win32_DiskPartition", collectDiskPartition },
+    { L"Win32_LogicalDisk", collectLogicalDisk },
+    { L"Win32_LogicalDiskToPartition", collectLogicalDiskToPartition },
+    { L"Win32_BaseBoard", collectBaseBoard },
+    { L"Win32_BIOS", collectBios },
+    { L"Win32_ComputerSystemProduct", collectComputerSystemProduct },
+    { L"Win32_Tpm", collectTpm },
+    { L"Win32_SoundDevice", collectSoundDevice },
+    { L"Win32_PnPEntity", collectUsb },
+    { L"Win32_NetworkAdapter", collectNetworkAdapter },
+};
+
+} // namespace
+
+bool LinuxSource::queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget,
+                               ResultSet& rows, std::vector<std::string>& paths) {
+    const std::wstring cls = wqlClassName(wql);
+    const std::string name = lastComponent(path);
+    RowOut out(rows, wqlColumns(wql), budget);
+    FileReader reader;
+    reader.setBudget(&budget);
+    if (cls == L"Win32_PnPEntity") {
+        Dir base("/sys/bus/usb/devices");
+        std::vector<std::string> entries = path.empty() ? listDir("/sys/bus/usb/devices") : std::vector<std::string>(1, name);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const size_t before = out.rows();
+            usbDevice(out, reader, base.fd(), entries[i]);
+            if (out.rows() > before) paths.push_back(devicePath("/sys/bus/usb/devices/" + entries[i]));
+        }
+    } else if (cls == L"Win32_DiskDrive") {
+        // A partition's events stand for its disk, whose partition count
+        // they change.
+        const std::vector<std::string> disks = physicalDisks();
+        std::string disk = name;
+        if (!path.empty() && std::find(disks.begin(), disks.end(), disk) == disks.end()) {
+            disk = lastComponent(path.substr(0, path.size() - name.size() - 1));
+        }
+        Dir block("/sys/block");
+        for (size_t i = 0; i < disks.size(); ++i) {
+            if (!path.empty() && disks[i] != disk) continue;
+            const size_t before = out.rows();
+            diskDrive(out, reader, block.fd(), disks[i], i);
+            if (out.rows() > before) paths.push_back(devicePath("/sys/block/" + disks[i]));
+        }
+    } else if (cls == L"Win32_NetworkAdapter") {
+        // Link changes name the interface by index.
+        std::vector<std::string> ifaces;
+        char ifname[IF_NAMESIZE];
+        if (path.empty()) {
+            ifaces = listDir("/sys/class/net");
+        } else if (path.find_first_not_of("0123456789") != std::string::npos) {
+            ifaces.push_back(name);
+        } else if (if_indextoname(static_cast<unsigned>(std::strtoul(path.c_str(), NULL, 10)), ifname)) {
+            ifaces.push_back(ifname);
+        }
+        Dir base("/sys/class/net");
+        for (size_t i = 0; i < ifaces.size(); ++i) {
+            const size_t before = out.rows();
+            networkAdapter(out, reader, base.fd(), ifaces[i]);
+            if (out.rows() > before) paths.push_back(devicePath("/sys/class/net/" + ifaces[i]));
+        }
+    } else if (cls == L"Win32_SoundDevice") {
+        // A card's controls and PCM streams sit below it, ".../card0/pcmC0D0p".
+        const size_t at = path.find("/card");
+        const std::string card = at == std::string::npos ? std::string() : path.substr(at + 1, path.find('/', at + 1) - at - 1);
+        const std::vector<SoundCard> cards = soundCards(reader);
+        for (size_t k = 0; k < cards.size(); ++k) {
+            const std::string entry = "card" + std::to_string(static_cast<unsigned long long>(cards[k].index));
+            if (!path.empty() && entry != card) continue;
+            soundDevice(out, cards[k]);
+            if (!rows.partial()) paths.push_back(devicePath("/sys/class/sound/" + entry));
+        }
+    } else {
+        return false;
+    }
+    if (!rows.partial()) rows.setStatus(reader.status());
+    return true;
+}
+
+ResultSet LinuxSource::query(const std::wstring& wql, const QueryBudget& budget) {
+    ResultSet rs;
+    query(wql, budget, rs);
+    return rs;
+}
+
+void LinuxSource::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& rs) {
+    rs.clear();
+    std::wstring cls = wqlClassName(wql);
+    // The process list scans its own root on several threads, so it isn't
+    // a RowOut collector.
+    if (cls == L"Win32_Process") {
+        rs = queryProcesses(wql, m_procRoot, budget);
+        return;
+    }
+    // Neither is the topology, which joins several sysfs trees.
+    if (cls.compare(0, 8, L"Sysinfo_") == 0) {
+        rs = queryCpuTopology(wql, budget);
+        return;
+    }
+    for (size_t k = 0; k < sizeof(kCollectors) / sizeof(kCollectors[0]); ++k) {
+        if (cls == kCollectors[k].wmiClass) {
+            RowOut out(rs, wqlColumns(wql), budget);
+            FileReader reader;
+            reader.setBudget(&budget);
+            kCollectors[k].collect(out, reader);
+            // The last row may have lost values to a refused read.
+            if (!rs.partial()) rs.setStatus(reader.status());
+            break;
+        }
+    }
+}
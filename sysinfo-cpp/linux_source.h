@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "datasource.h"
+
+// Answers the sections' Win32_* queries from /proc and /sys, producing the
+// same columns WMI would so the renderers stay platform independent. Only
+// the properties named in the SELECT list are read.
+class LinuxSource : public DataSource {
+public:
+    LinuxSource() : m_procRoot("/proc") {}
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+    // USB devices, disks, network adapters and sound cards one at a time,
+    // by the sysfs device path their uevents carry (an interface index for
+    // link changes).
+    bool queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget, ResultSet& rows,
+                      std::vector<std::string>& paths);
+    // Where Win32_Process reads the process list, e.g. a generated tree of
+    // <pid>/stat files. Everything else still comes from /proc and /sys.
+    void setProcRoot(const std::string& path) { m_procRoot = path; }
+
+private:
+    std::string m_procRoot;
+};
@@ -1,565 +1,506 @@
-﻿#define NOMINMAX
+﻿#ifdef _WIN32
+#define NOMINMAX
 #include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <iomanip>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <vector>
-#include <map>
-#include <iphlpapi.h>
-#include <tchar.h>
-// #include <stdio.h> // Not strictly needed with iostream
-#include <winreg.h>
-#include <comdef.h> // For _bstr_t
-#include <Wbemidl.h>
-
-#pragma comment(lib, "iphlpapi.lib")
-#pragma comment(lib, "wbemuuid.lib")
-
-// Global WMI pointers
-IWbemLocator *g_pLoc = NULL;
-IWbemServices *g_pSvc = NULL;
+#include <thread>
+#include <utility>
+
+#include "collector.h"
+#include "devices.h"
+#include "diff.h"
+#include "enumerate.h"
+#include "exporter.h"
+#include "fixture_source.h"
+#include "history.h"
+#include "mapped_file.h"
+#include "probe.h"
+#include "profile.h"
+#include "reports.h"
+#include "report_bin.h"
+#include "report_json.h"
+#include "sampler.h"
+#include "sections.h"
+#include "session.h"
+#include "static_cache.h"
+#include "watch.h"
+
+#ifdef _WIN32
+// Keeps the console window open when started from Explorer, the only case
+// where the console belongs to this process alone. From a shell, or with
+// output captured by another program, there is nothing to wait for.
+void pauseIfOwnConsole() {
+    DWORD processes[2];
+    if (GetConsoleProcessList(processes, 2) != 1) return;
+    std::wcout << L"Press Enter to exit..." << std::endl;
+    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), L'\n'); // Clear potential leftover newline
+    std::wcin.get();
+}
+#endif
 
 // Set console output to UTF-8
 void setUTF8() {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
+#endif
     // The std::ios::sync_with_stdio(false) is good for performance with C++ streams,
     // but ensure std::wcout is used consistently.
     std::ios::sync_with_stdio(false);
+#ifdef _WIN32
     std::wcout.imbue(std::locale("")); // Ensure wcout uses user's default locale for formatting if needed, adapted for UTF-8 by SetConsoleOutputCP
-}
-
-// General WMI multi-row query
-std::vector<std::map<std::wstring, std::wstring>> queryWMIAll(const std::wstring& wql) {
-    std::vector<std::map<std::wstring, std::wstring>> results;
-    if (!g_pSvc) {
-        std::wcerr << L"WMI Service not initialized." << std::endl;
-        return results;
+#else
+    // wcout goes bad at the first character its locale can't encode, which
+    // would silently truncate the report under LANG=C; fall back to C.UTF-8.
+    std::locale loc = std::locale::classic();
+    try { loc = std::locale(""); } catch (const std::runtime_error&) {}
+    if (loc.name().find("UTF-8") == std::string::npos && loc.name().find("utf8") == std::string::npos) {
+        try { loc = std::locale("C.UTF-8"); } catch (const std::runtime_error&) {}
     }
+    std::wcout.imbue(loc);
+    std::wcerr.imbue(loc);
+#endif
+}
 
-    HRESULT hres;
-    IEnumWbemClassObject* pEnumerator = NULL;
-    
-    hres = g_pSvc->ExecQuery(
-        bstr_t(L"WQL"),
-        bstr_t(wql.c_str()),
-        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
-        NULL,
-        &pEnumerator
-    );
-
-    if (FAILED(hres)) {
-        // std::wcerr << L"WMI Query failed for: " << wql << L". Error: 0x" << std::hex << hres << std::endl;
-        return results;
-    }
-
-    IWbemClassObject *pclsObj = NULL;
-    ULONG uReturn = 0;
-
-    while (pEnumerator) {
-        hres = pEnumerator->Next(WBEM_INFINITE, 1, &pclsObj, &uReturn);
-        if (uReturn == 0 || FAILED(hres)) {
-            break;
-        }
-
-        std::map<std::wstring, std::wstring> row;
-        SAFEARRAY* pNames = NULL;
-        
-        // Get all property names
-        HRESULT hrGetNames = pclsObj->GetNames(NULL, WBEM_FLAG_ALWAYS | WBEM_FLAG_NONSYSTEM_ONLY, NULL, &pNames);
-        if (SUCCEEDED(hrGetNames) && pNames != NULL) {
-            LONG lLBound, lUBound;
-            SafeArrayGetLBound(pNames, 1, &lLBound);
-            SafeArrayGetUBound(pNames, 1, &lUBound);
-
-            for (LONG i = lLBound; i <= lUBound; ++i) {
-                BSTR bstrName = NULL; 
-                HRESULT hrElem = SafeArrayGetElement(pNames, &i, &bstrName);
+void printUsage() {
+    std::wcerr << L"Usage: sysinfo [--fixture <file>] [--jobs <n>] [--timing] [--watch <interval>]\n"
+               << L"               [--format=text|jsonl|bin] [--cache <file> | --no-cache] [--record <file>]\n"
+               << L"               [--profile[=<trace.json>]] [--sections=<id,...>] [--fields=<name,...>]\n"
+               << L"               [--timeout <interval>] [--deadline <interval>] [--batch <n>]\n"
+               << L"               [--utilization[=<interval>]] [--serve <host:port> [--refresh <interval>]]\n"
+               << L"               [--since <snapshot>] [--diff <old snapshot> <new snapshot>]\n"
+               << L"               [--history <file>] [--history query <file> [--last <interval>]\n"
+               << L"               [--step <interval>] [--series <text>]] [--proc-root <dir>]\n"
+               << L"               [--probe [--probe-dir <dir>] [--probe-limit <name>=<value>]...]\n"
+               << L"               [--replay-events <file>]\n"
+               << L"  --fixture <file>    replay recorded WMI rows instead of querying the system\n"
+               << L"  --jobs <n>          number of collector threads (default: one per query)\n"
+               << L"  --timing            print the collection wall time to stderr\n"
+               << L"  --watch <interval>  after the report, keep printing changes to free memory, free\n"
+               << L"                      disk space, link state and attached devices every <interval>\n"
+               << L"                      (e.g. 500ms, 5s, 1m, 2h, 7d; plain numbers are seconds);\n"
+               << L"                      USB, sound, network and disk devices are re-enumerated\n"
+               << L"                      only after the OS reports one of them changed\n"
+               << L"  --format=<fmt>      text (default), jsonl (one JSON record per section) or bin\n"
+               << L"                      (binary records, see report_bin.h); records carry raw\n"
+               << L"                      values and are written as soon as each section is ready\n"
+               << L"  --cache <file>      where to keep the static hardware snapshot (BIOS, board, UUID,\n"
+               << L"                      TPM, CPU, DIMMs), reused until the next reboot\n"
+               << L"  --no-cache          always query static hardware\n"
+               << L"  --record <file>     also save every query's rows as a fixture for --fixture and\n"
+               << L"                      sysinfo_bench\n"
+               << L"  --profile[=<file>]  time every query (wall time, time to first row, rows, bytes,\n"
+               << L"                      allocations), write a Chrome trace (default sysinfo-trace.json)\n"
+               << L"                      and append a summary table to the report\n"
+               << L"  --sections=<ids>    only collect these sections: system, cpu, topology, memory,\n"
+               << L"                      gpu, disk, board, bios, uuid, tpm, sound, usb, network, process\n"
+               << L"  --fields=<names>    only query and print these WMI properties (e.g.\n"
+               << L"                      FreeSpace,Size); sections without any of them are skipped\n"
+               << L"  --timeout <interval> give up on a single query after <interval> (default 20s);\n"
+               << L"                      its section is printed with whatever rows arrived\n"
+               << L"  --deadline <interval> give up on every query still running after <interval>\n"
+               << L"  --batch <n>         objects fetched per WMI round trip (default 32)\n"
+               << L"  --utilization[=<interval>] sample per-core CPU, memory, disk and network counters\n"
+               << L"                      while collecting and append their rates over <interval>\n"
+               << L"                      (default 1s) to the report\n"
+               << L"  --serve <host:port> run as an OpenMetrics exporter (e.g. :9100 on loopback,\n"
+               << L"                      0.0.0.0:9100 on every interface): collect in the background\n"
+               << L"                      and serve the latest data at /metrics\n"
+               << L"  --refresh <interval> how often --serve collects (default 15s); devices are\n"
+               << L"                      tracked by their change events as with --watch\n"
+               << L"  --since <snapshot>  list the devices added, removed or modified since a snapshot\n"
+               << L"                      written with --format=bin, instead of printing the report;\n"
+               << L"                      collects the snapshot's sections unless --sections is given\n"
+               << L"  --diff <old> <new>  the same between two snapshots, without collecting; both\n"
+               << L"                      exit 0 without changes, 1 with changes and 2 on errors\n"
+               << L"  --history <file>    with --watch, also record every numeric value of every tick\n"
+               << L"                      in a fixed-size history file (8 MiB, oldest ticks roll off)\n"
+               << L"  --history query <file> print a history file's series, downsampled to min, mean\n"
+               << L"                      and max per --step (default: 60 steps over the range)\n"
+               << L"  --last <interval>   with --history query, only the most recent <interval>\n"
+               << L"  --series <text>     with --history query, only series whose names contain <text>\n"
+               << L"                      (e.g. disk/C:)\n"
+               << L"  --proc-root <dir>   read the process list from <dir> instead of /proc (Linux),\n"
+               << L"                      e.g. a generated tree of <pid>/stat files\n"
+               << L"  --probe             instead of the report, measure cache latency, memory bandwidth\n"
+               << L"                      (all CPUs and each on its own) and disk reads, and print them\n"
+               << L"                      under the CPU, memory and disk sections with PASS or FAIL;\n"
+               << L"                      exits 1 when any check fails\n"
+               << L"  --probe-dir <dir>   where --probe writes its 256 MB test file (default: /var/tmp,\n"
+               << L"                      or the temp directory on Windows)\n"
+               << L"  --probe-limit <name>=<value> change a threshold: memory-peak (% of the DIMMs'\n"
+               << L"                      nominal bandwidth, default 50), core-spread (% of the median\n"
+               << L"                      CPU, 75), memory-latency (ns, 200), disk-seq (MB/s, 100),\n"
+               << L"                      disk-iops (100), nvme-seq (1000), nvme-iops (5000)\n"
+               << L"  --replay-events <file> play a scripted stream of device events (see devices.h)\n"
+               << L"                      instead of listening to the OS, e.g. with --fixture and\n"
+               << L"                      --watch to test hotplug handling without the hardware\n"
+               << L"  Ctrl+C during collection stops the queries and prints what was gathered." << std::endl;
+}
 
-                if (SUCCEEDED(hrElem) && bstrName != NULL) {
-                    VARIANT vtProp;
-                    VariantInit(&vtProp); // Initialize variant
+enum class OutputFormat { Text, Jsonl, Bin };
 
-                    HRESULT hrGet = pclsObj->Get(bstrName, 0, &vtProp, 0, 0);
-                    if (SUCCEEDED(hrGet)) {
-                        if (vtProp.vt == VT_BSTR) {
-                            row[bstrName] = (vtProp.bstrVal ? vtProp.bstrVal : L"");
-                        } else if (vtProp.vt == VT_I4) {
-                            row[bstrName] = std::to_wstring(vtProp.lVal);
-                        } else if (vtProp.vt == VT_UI4) {
-                            row[bstrName] = std::to_wstring(vtProp.ulVal);
-                        } else if (vtProp.vt == VT_I8) {
-                            row[bstrName] = std::to_wstring(vtProp.llVal);
-                        } else if (vtProp.vt == VT_UI8) {
-                            row[bstrName] = std::to_wstring(vtProp.ullVal);
-                        } else if (vtProp.vt == VT_BOOL) {
-                            row[bstrName] = (vtProp.boolVal == VARIANT_TRUE) ? L"True" : L"False";
-                        } else if (vtProp.vt == VT_NULL || vtProp.vt == VT_EMPTY) {
-                            row[bstrName] = L""; // Represent null/empty as empty string
-                        } else {
-                            // Potentially handle other types like datetime, arrays, etc. or mark as unhandled
-                            // row[bstrName] = L"[Unhandled Type:" + std::to_wstring(vtProp.vt) + L"]";
-                        }
-                    } else {
-                        row[std::wstring(bstrName)] = L"[Error Getting Value]";
-                    }
-                    VariantClear(&vtProp);
-                    SysFreeString(bstrName); // Free bstrName allocated by SafeArrayGetElement
-                }
-                // If SafeArrayGetElement failed or bstrName was NULL, bstrName was not freed (as it wasn't allocated or was invalid)
-            }
-            SafeArrayDestroy(pNames); // pNames was allocated by GetNames
-        }
-        pclsObj->Release();
-        pclsObj = NULL; 
-        results.push_back(row);
-    }
+// Set by the first Ctrl+C during collection; a second one kills the process.
+std::atomic<bool> g_cancel(false);
 
-    if (pEnumerator) pEnumerator->Release();
-    return results;
+void onCancelSignal(int) {
+    g_cancel = true;
+    std::signal(SIGINT, SIG_DFL);
 }
 
-// Unused wstr function, can be removed if not needed elsewhere
-// std::wstring wstr(const std::string& s) {
-//     int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, NULL, 0);
-//     std::wstring ws(len, 0);
-//     MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &ws[0], len);
-//     ws.resize(wcslen(ws.c_str())); // Ensure null termination is handled correctly for length
-//     return ws;
-// }
-
-// Utility function: safely get wstring from map
-std::wstring safeGet(const std::map<std::wstring, std::wstring>& m, const std::wstring& key) {
-    auto it = m.find(key);
-    if (it != m.end() && !it->second.empty()) {
-        return it->second;
+// Splits "a,b,c", dropping empty items.
+std::vector<std::string> splitList(const char* text) {
+    std::vector<std::string> items;
+    for (const char* p = text;;) {
+        const char* comma = std::strchr(p, ',');
+        std::string item = comma ? std::string(p, comma) : std::string(p);
+        if (!item.empty()) items.push_back(item);
+        if (!comma) return items;
+        p = comma + 1;
     }
-    return L"Unknown"; // Return "Unknown" if key not found or value is empty
 }
 
-// Utility function: safely convert wstring to uint64_t
-uint64_t safeStoull(const std::wstring& s) {
-    if (s == L"Unknown" || s.empty()) return 0;
-    try {
-        return std::stoull(s);
-    } catch (const std::invalid_argument& ia) {
-        // std::wcerr << L"Invalid argument for stoull: " << s << std::endl;
-        return 0;
-    } catch (const std::out_of_range& oor) {
-        // std::wcerr << L"Out of range for stoull: " << s << std::endl;
-        return 0;
-    }
-    return 0;
+// Parses "500ms", "5s", "2m", "1h", "7d" or "5" (seconds). False for zero
+// or garbage.
+bool parseInterval(const char* text, std::chrono::milliseconds& interval) {
+    char* end = NULL;
+    unsigned long n = std::strtoul(text, &end, 10);
+    if (end == text || n == 0) return false;
+    if (std::strcmp(end, "ms") == 0) interval = std::chrono::milliseconds(n);
+    else if (*end == '\0' || std::strcmp(end, "s") == 0) interval = std::chrono::seconds(n);
+    else if (std::strcmp(end, "m") == 0) interval = std::chrono::minutes(n);
+    else if (std::strcmp(end, "h") == 0) interval = std::chrono::hours(n);
+    else if (std::strcmp(end, "d") == 0) interval = std::chrono::hours(24 * n);
+    else return false;
+    return true;
 }
 
-void printSystemInfo() {
-    auto sys = queryWMIAll(L"SELECT Caption, Version, BuildNumber, OSArchitecture, SerialNumber, InstallDate, LastBootUpTime, RegisteredUser, Organization, BootDevice, WindowsDirectory, SystemDirectory, Locale, OSLanguage, CountryCode, TotalVisibleMemorySize, FreePhysicalMemory FROM Win32_OperatingSystem");
-    if (!sys.empty()) {
-        auto& s = sys[0];
-        std::wcout << L"[System Information]" << std::endl;
-        std::wcout << L"  System Name      : " << safeGet(s, L"Caption") << L" (" << safeGet(s, L"OSArchitecture") << L")" << std::endl;
-        std::wcout << L"  Version/Build    : " << safeGet(s, L"Version") << L" / " << safeGet(s, L"BuildNumber") << std::endl;
-        std::wcout << L"  Serial Number    : " << safeGet(s, L"SerialNumber") << std::endl;
-        std::wcout << L"  Install Date     : " << safeGet(s, L"InstallDate") << std::endl;
-        std::wcout << L"  Last Boot        : " << safeGet(s, L"LastBootUpTime") << std::endl;
-        std::wcout << L"  Registered User  : " << safeGet(s, L"RegisteredUser") << std::endl;
-        std::wcout << L"  Organization     : " << safeGet(s, L"Organization") << std::endl;
-        std::wcout << L"  Boot Device      : " << safeGet(s, L"BootDevice") << std::endl;
-        std::wcout << L"  Windows Dir      : " << safeGet(s, L"WindowsDirectory") << std::endl;
-        std::wcout << L"  System Dir       : " << safeGet(s, L"SystemDirectory") << std::endl;
-        std::wcout << L"  Locale/Country   : " << safeGet(s, L"Locale") << L" / " << safeGet(s, L"CountryCode") << L" (Lang: " << safeGet(s, L"OSLanguage") << L")" << std::endl;
-        // TotalVisibleMemorySize and FreePhysicalMemory are in kilobytes
-        uint64_t totalMemKB = safeStoull(safeGet(s, L"TotalVisibleMemorySize"));
-        uint64_t freeMemKB = safeStoull(safeGet(s, L"FreePhysicalMemory"));
-        std::wcout << L"  Total Memory (GB): " << std::fixed << std::setprecision(2) << (totalMemKB / (1024.0 * 1024.0)) << std::endl;
-        std::wcout << L"  Free Memory (GB) : " << std::fixed << std::setprecision(2) << (freeMemKB / (1024.0 * 1024.0)) << std::endl;
-    } else {
-        std::wcout << L"[System Information]" << std::endl;
-        std::wcout << L"  Could not retrieve system information." << std::endl;
-    }
-}
+int main(int argc, char* argv[]) {
+    setUTF8(); // Set console to UTF-8 early
 
-void printCPUInfo() {
-    auto cpus = queryWMIAll(L"SELECT Name, NumberOfCores, NumberOfLogicalProcessors, MaxClockSpeed, Manufacturer, ProcessorId, SocketDesignation, L2CacheSize, L3CacheSize, VirtualizationFirmwareEnabled FROM Win32_Processor");
-    std::wcout << L"\n[CPU Information]" << std::endl;
-    if (!cpus.empty()) {
-        for (size_t i = 0; i < cpus.size(); ++i) {
-            auto& c = cpus[i];
-            std::wcout << L"  Processor " << (i + 1) << L": " << safeGet(c, L"Name") << std::endl;
-            std::wcout << L"    Cores/Threads   : " << safeGet(c, L"NumberOfCores") << L" / " << safeGet(c, L"NumberOfLogicalProcessors") << std::endl;
-            std::wcout << L"    Max Clock (MHz) : " << safeGet(c, L"MaxClockSpeed") << std::endl;
-            std::wcout << L"    Manufacturer    : " << safeGet(c, L"Manufacturer") << std::endl;
-            std::wcout << L"    Processor ID    : " << safeGet(c, L"ProcessorId") << std::endl;
-            std::wcout << L"    Socket          : " << safeGet(c, L"SocketDesignation") << std::endl;
-            std::wcout << L"    L2 Cache (KB)   : " << safeGet(c, L"L2CacheSize") << std::endl;
-            std::wcout << L"    L3 Cache (KB)   : " << safeGet(c, L"L3CacheSize") << std::endl;
-            std::wcout << L"    Virtualization  : " << safeGet(c, L"VirtualizationFirmwareEnabled") << std::endl;
+    std::string fixturePath;
+    unsigned jobs = 0;
+    bool timing = false;
+    std::chrono::milliseconds watchInterval(0);
+    OutputFormat format = OutputFormat::Text;
+    std::string cachePath = defaultCachePath();
+    std::string recordPath;
+    std::string profilePath;
+    std::vector<std::string> sectionIds;
+    std::vector<std::string> fields;
+    CollectLimits limits;
+    limits.perQuery = std::chrono::seconds(20);
+    limits.cancel = &g_cancel;
+    size_t batch = kDefaultEnumBatch;
+    std::chrono::milliseconds utilizationWindow(0);
+    std::string serveAddress;
+    ExporterOptions serve;
+    std::string sincePath;
+    std::string historyPath, historyQueryPath, historySeries;
+    std::string procRoot;
+    std::string replayEventsPath;
+    bool probe = false;
+    ProbeOptions probeOptions;
+    std::chrono::milliseconds historyLast(0), historyStep(0);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--fixture") == 0 && i + 1 < argc) {
+            fixturePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::strtoul(argv[++i], NULL, 10));
+        } else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc && std::strtoul(argv[i + 1], NULL, 10) > 0) {
+            batch = std::strtoul(argv[++i], NULL, 10);
+        } else if (std::strcmp(argv[i], "--timeout") == 0 && i + 1 < argc && parseInterval(argv[i + 1], limits.perQuery)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--deadline") == 0 && i + 1 < argc && parseInterval(argv[i + 1], limits.total)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--utilization") == 0) {
+            utilizationWindow = std::chrono::seconds(1);
+        } else if (std::strncmp(argv[i], "--utilization=", 14) == 0 && parseInterval(argv[i] + 14, utilizationWindow)) {
+        } else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc && parseListenAddress(argv[i + 1], serve.host, serve.port)) {
+            serveAddress = argv[++i];
+        } else if (std::strcmp(argv[i], "--refresh") == 0 && i + 1 < argc && parseInterval(argv[i + 1], serve.refresh)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--diff") == 0 && i + 2 < argc) {
+            Snapshot before, after;
+            if (!before.open(argv[i + 1]) || !after.open(argv[i + 2])) {
+                const std::string& error = before.error().empty() ? after.error() : before.error();
+                std::wcerr << utf8ToWide(error.data(), error.size()) << std::endl;
+                return 2;
+            }
+            return compareSnapshots(before, after, std::wcout, std::wcerr);
+        } else if (std::strcmp(argv[i], "--since") == 0 && i + 1 < argc) {
+            sincePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--history") == 0 && i + 2 < argc && std::strcmp(argv[i + 1], "query") == 0) {
+            historyQueryPath = argv[i + 2];
+            i += 2;
+        } else if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            historyPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--last") == 0 && i + 1 < argc && parseInterval(argv[i + 1], historyLast)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc && parseInterval(argv[i + 1], historyStep)) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--series") == 0 && i + 1 < argc) {
+            historySeries = argv[++i];
+        } else if (std::strcmp(argv[i], "--proc-root") == 0 && i + 1 < argc) {
+            procRoot = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay-events") == 0 && i + 1 < argc) {
+            replayEventsPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--probe") == 0) {
+            probe = true;
+        } else if (std::strcmp(argv[i], "--probe-dir") == 0 && i + 1 < argc) {
+            probeOptions.dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--probe-limit") == 0 && i + 1 < argc && probeOptions.limits.set(argv[i + 1])) {
+            ++i;
+        } else if (std::strcmp(argv[i], "--timing") == 0) {
+            timing = true;
+        } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profilePath = "sysinfo-trace.json";
+        } else if (std::strncmp(argv[i], "--profile=", 10) == 0 && argv[i][10]) {
+            profilePath = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--sections=", 11) == 0) {
+            sectionIds = splitList(argv[i] + 11);
+        } else if (std::strncmp(argv[i], "--fields=", 9) == 0) {
+            fields = splitList(argv[i] + 9);
+        } else if (std::strcmp(argv[i], "--no-cache") == 0) {
+            cachePath.clear();
+        } else if (std::strcmp(argv[i], "--format=text") == 0) {
+            format = OutputFormat::Text;
+        } else if (std::strcmp(argv[i], "--format=jsonl") == 0) {
+            format = OutputFormat::Jsonl;
+        } else if (std::strcmp(argv[i], "--format=bin") == 0) {
+            format = OutputFormat::Bin;
+        } else if (std::strcmp(argv[i], "--watch") == 0 && i + 1 < argc && parseInterval(argv[i + 1], watchInterval)) {
+            ++i;
+        } else {
+            printUsage();
+            return 2;
         }
-    } else {
-        std::wcout << L"  Could not retrieve CPU information." << std::endl;
     }
-}
 
-void printMemoryInfo() {
-    auto mems = queryWMIAll(L"SELECT BankLabel, Capacity, Speed, Manufacturer, SerialNumber, PartNumber, MemoryType, FormFactor FROM Win32_PhysicalMemory");
-    std::wcout << L"\n[Memory Information]" << std::endl;
-    uint64_t totalCapacityBytes = 0;
-    if (!mems.empty()) {
-        for (size_t i = 0; i < mems.size(); ++i) {
-            auto& m = mems[i];
-            uint64_t capacityBytes = safeStoull(safeGet(m, L"Capacity"));
-            totalCapacityBytes += capacityBytes;
-            std::wcout << L"  Slot " << (i + 1) << L" (" << safeGet(m, L"BankLabel") << L"):" << std::endl;
-            std::wcout << L"    Capacity (GB)   : " << std::fixed << std::setprecision(2) << (capacityBytes / (1024.0 * 1024.0 * 1024.0)) << std::endl;
-            std::wcout << L"    Speed (MHz)     : " << safeGet(m, L"Speed") << std::endl;
-            std::wcout << L"    Type            : " << safeGet(m, L"MemoryType") << L" (FormFactor: " << safeGet(m, L"FormFactor") << L")" << std::endl;
-            std::wcout << L"    Manufacturer    : " << safeGet(m, L"Manufacturer") << std::endl;
-            std::wcout << L"    Serial Number   : " << safeGet(m, L"SerialNumber") << std::endl;
-            std::wcout << L"    Part Number     : " << safeGet(m, L"PartNumber") << std::endl;
-        }
-        std::wcout << L"  Total RAM (GB)     : " << std::fixed << std::setprecision(2) << (totalCapacityBytes / (1024.0 * 1024.0 * 1024.0)) << std::endl;
-    } else {
-        std::wcout << L"  Could not retrieve physical memory information." << std::endl;
+    if (!historyQueryPath.empty()) {
+        return printHistoryFile(historyQueryPath, historySeries, historyLast, historyStep, std::wcout, std::wcerr);
     }
-}
-
-void printGPUInfo() {
-    auto gpus = queryWMIAll(L"SELECT Name, DriverVersion, AdapterRAM, VideoProcessor, PNPDeviceID, Status, InfFilename, CurrentHorizontalResolution, CurrentVerticalResolution, CurrentRefreshRate FROM Win32_VideoController");
-    std::wcout << L"\n[GPU Information]" << std::endl;
-    if (!gpus.empty()) {
-        for (size_t i = 0; i < gpus.size(); ++i) {
-            auto& g = gpus[i];
-            std::wcout << L"  GPU " << (i + 1) << L": " << safeGet(g, L"Name") << std::endl;
-            std::wcout << L"    Driver Version  : " << safeGet(g, L"DriverVersion") << std::endl;
-            uint64_t adapterRAMBytes = safeStoull(safeGet(g, L"AdapterRAM"));
-            std::wcout << L"    VRAM (MB)       : " << (adapterRAMBytes / (1024 * 1024)) << std::endl;
-            std::wcout << L"    Video Processor : " << safeGet(g, L"VideoProcessor") << std::endl;
-            std::wcout << L"    Resolution      : " << safeGet(g, L"CurrentHorizontalResolution") << L"x" << safeGet(g, L"CurrentVerticalResolution") << L" @" << safeGet(g, L"CurrentRefreshRate") << L"Hz" << std::endl;
-            std::wcout << L"    Device ID       : " << safeGet(g, L"PNPDeviceID") << std::endl;
-            std::wcout << L"    Status          : " << safeGet(g, L"Status") << std::endl;
-            // std::wcout << L"    INF File        : " << safeGet(g, L"InfFilename") << std::endl; // Often less useful
+    if (probe && !fixturePath.empty()) {
+        std::wcerr << L"--probe measures this machine; it can't be used with --fixture" << std::endl;
+        return 2;
+    }
+    // Opened up front, so a bad path fails before the report rather than after.
+    std::unique_ptr<HistoryWriter> history;
+    if (!historyPath.empty() && !watchInterval.count()) {
+        std::wcerr << L"--history records --watch ticks; ignored without --watch" << std::endl;
+    } else if (!historyPath.empty()) {
+        history.reset(new HistoryWriter());
+        std::string error;
+        if (!history->open(historyPath, error)) {
+            std::wcerr << utf8ToWide(historyPath.data(), historyPath.size()) << L": "
+                       << utf8ToWide(error.data(), error.size()) << std::endl;
+            return 2;
         }
-    } else {
-        std::wcout << L"  Could not retrieve GPU information." << std::endl;
     }
-}
-
-void printDiskInfo() {
-    auto disks = queryWMIAll(L"SELECT Model, SerialNumber, FirmwareRevision, InterfaceType, MediaType, Size, Index, Partitions, Status, PNPDeviceID FROM Win32_DiskDrive");
-    auto parts = queryWMIAll(L"SELECT DeviceID, DiskIndex, Name, Size, Type, Bootable, BootPartition, StartingOffset FROM Win32_DiskPartition");
-    // Querying logical disks associated with partitions is more complex.
-    // For simplicity, we'll query all local fixed logical disks.
-    auto logics = queryWMIAll(L"SELECT DeviceID, VolumeName, FileSystem, FreeSpace, Size FROM Win32_LogicalDisk WHERE DriveType=3");
-
-    std::wcout << L"\n[Disk Information]" << std::endl;
-    if (!disks.empty()) {
-        for (size_t i = 0; i < disks.size(); ++i) {
-            auto& d = disks[i];
-            std::wstring diskIndexStr = safeGet(d, L"Index");
-            std::wcout << L"  Disk " << diskIndexStr << L": " << safeGet(d, L"Model") << std::endl;
-            std::wcout << L"    Serial Number   : " << safeGet(d, L"SerialNumber") << std::endl;
-            std::wcout << L"    Firmware Rev    : " << safeGet(d, L"FirmwareRevision") << std::endl;
-            std::wcout << L"    Interface Type  : " << safeGet(d, L"InterfaceType") << std::endl;
-            std::wcout << L"    Media Type      : " << safeGet(d, L"MediaType") << std::endl;
-            uint64_t diskSizeBytes = safeStoull(safeGet(d, L"Size"));
-            std::wcout << L"    Size (GB)       : " << std::fixed << std::setprecision(2) << (diskSizeBytes / (1024.0*1024.0*1024.0)) << std::endl;
-            std::wcout << L"    Partitions Cnt  : " << safeGet(d, L"Partitions") << std::endl;
-            std::wcout << L"    Status          : " << safeGet(d, L"Status") << std::endl;
-            // std::wcout << L"    Device ID       : " << safeGet(d, L"PNPDeviceID") << std::endl;
-
-            // Attempt to determine if SSD (heuristic, not foolproof)
-            std::wstring mediaType = safeGet(d, L"MediaType");
-            bool isSSD = (mediaType.find(L"SSD") != std::wstring::npos || 
-                          mediaType.find(L"Fixed hard disk media") == std::wstring::npos); // HDDs often report "Fixed hard disk media"
-            // A more reliable way requires checking Win32_PhysicalDisk and its SpindleSpeed, or other vendor-specific WMI classes.
-            // For now, this is a simple guess.
-            // std::wcout << L"    Is SSD (guess)  : " << (isSSD ? L"Yes" : L"No") << std::endl;
 
-
-            // List partitions for this disk
-            for (const auto& p : parts) {
-                if (safeGet(p, L"DiskIndex") == diskIndexStr) {
-                    std::wstring partDeviceID = safeGet(p, L"DeviceID"); // e.g., "Disk #0, Partition #1"
-                    uint64_t partSizeBytes = safeStoull(safeGet(p, L"Size"));
-                    std::wcout << L"    Partition: " << partDeviceID << L" (" << safeGet(p, L"Name") << L")" << std::endl;
-                    std::wcout << L"      Size (GB)       : " << std::fixed << std::setprecision(2) << (partSizeBytes / (1024.0*1024.0*1024.0)) << std::endl;
-                    std::wcout << L"      Type            : " << safeGet(p, L"Type") << std::endl;
-                    std::wcout << L"      Bootable        : " << safeGet(p, L"Bootable") << (safeGet(p, L"BootPartition") == L"True" ? L" (System Boot Partition)" : L"") << std::endl;
-                    std::wcout << L"      Offset (Bytes)  : " << safeGet(p, L"StartingOffset") << std::endl;
-
-                    // Try to find associated logical disks (simple matching, not fully robust)
-                    // A robust solution uses WMI Associators like Win32_LogicalDiskToPartition
-                    // Example WQL for associators: ASSOCIATORS OF {Win32_DiskPartition.DeviceID='Disk #0, Partition #1'} WHERE AssocClass = Win32_LogicalDiskToPartition
-                    // This is too complex for this quick fix. The current simple loop is kept but might not always link correctly.
-                    for (const auto& l : logics) {
-                        // This association is tricky. Win32_LogicalDisk doesn't directly expose partition DeviceID.
-                        // We'd typically query associators. A simple heuristic:
-                        // A logical disk's DeviceID (e.g., "C:") comes from a partition.
-                        // If we could query Win32_LogicalDiskToPartition, we could map p.DeviceID to l.DeviceID
-                        // The original code's find logic was incorrect.
-                        // For now, we'll skip direct logical disk listing under partition to avoid confusion from incorrect matching.
-                        // The logical disks will be listed separately if desired, or a more advanced WMI query is needed here.
-                    }
-                }
-            }
+    Snapshot since;
+    if (!sincePath.empty()) {
+        if (!since.open(sincePath)) {
+            std::wcerr << utf8ToWide(since.error().data(), since.error().size()) << std::endl;
+            return 2;
         }
-        // Separately list logical drives if not detailed under partitions
-        std::wcout << L"\n  Logical Drives (Fixed Disks):" << std::endl;
-        if (!logics.empty()) {
-            for (const auto& l : logics) {
-                uint64_t totalSizeBytes = safeStoull(safeGet(l, L"Size"));
-                uint64_t freeSizeBytes = safeStoull(safeGet(l, L"FreeSpace"));
-                std::wcout << L"    Drive " << safeGet(l, L"DeviceID") << L" (Label: " << safeGet(l, L"VolumeName") << L")" << std::endl;
-                std::wcout << L"      File System     : " << safeGet(l, L"FileSystem") << std::endl;
-                std::wcout << L"      Total Size (GB) : " << std::fixed << std::setprecision(2) << (totalSizeBytes / (1024.0*1024.0*1024.0)) << std::endl;
-                std::wcout << L"      Free Space (GB) : " << std::fixed << std::setprecision(2) << (freeSizeBytes / (1024.0*1024.0*1024.0)) << std::endl;
+        const std::vector<SnapshotSection>& sinceSections = since.sections();
+        const bool selectedSections = !sectionIds.empty();
+        // Compare like with like: what the snapshot has, unless told otherwise.
+        const std::vector<SectionDef>& known = allSections();
+        for (size_t k = 0; k < sinceSections.size() && !selectedSections; ++k) {
+            for (size_t d = 0; d < known.size(); ++d) {
+                if (sinceSections[k].id == known[d].id) sectionIds.push_back(sinceSections[k].id);
             }
-        } else {
-             std::wcout << L"    Could not retrieve logical drive information." << std::endl;
         }
-
-    } else {
-        std::wcout << L"  Could not retrieve disk drive information." << std::endl;
     }
-}
-
 
-void printBoardInfo() {
-    auto boards = queryWMIAll(L"SELECT Manufacturer, Product, SerialNumber, Version FROM Win32_BaseBoard");
-    std::wcout << L"\n[Motherboard Information]" << std::endl;
-    if (!boards.empty()) {
-        for (auto& b : boards) { // Usually only one baseboard
-            std::wcout << L"  Manufacturer     : " << safeGet(b, L"Manufacturer") << std::endl;
-            std::wcout << L"  Product          : " << safeGet(b, L"Product") << std::endl;
-            std::wcout << L"  Serial Number    : " << safeGet(b, L"SerialNumber") << std::endl;
-            std::wcout << L"  Version          : " << safeGet(b, L"Version") << std::endl;
-        }
-    } else {
-        std::wcout << L"  Could not retrieve motherboard information." << std::endl;
+    std::vector<SectionDef> sections = allSections();
+    std::string unknown;
+    if (!sectionIds.empty() && !selectSections(sections, sectionIds, unknown)) {
+        std::wcerr << L"Unknown section: " << utf8ToWide(unknown.data(), unknown.size()) << std::endl;
+        return 2;
+    }
+    if (!fields.empty() && !projectSections(sections, fields, unknown)) {
+        std::wcerr << L"No selected section has the property " << utf8ToWide(unknown.data(), unknown.size()) << std::endl;
+        return 2;
     }
-}
 
-void printBIOSInfo() {
-    auto bios = queryWMIAll(L"SELECT Manufacturer, SMBIOSBIOSVersion, ReleaseDate, SerialNumber, Version FROM Win32_BIOS");
-    std::wcout << L"\n[BIOS Information]" << std::endl;
-    if (!bios.empty()) {
-        for (auto& b : bios) { // Usually only one BIOS
-            std::wcout << L"  Manufacturer     : " << safeGet(b, L"Manufacturer") << std::endl;
-            std::wcout << L"  Version          : " << safeGet(b, L"SMBIOSBIOSVersion") << " (BIOS Version: " << safeGet(b, L"Version") << ")" << std::endl;
-            std::wcout << L"  Release Date     : " << safeGet(b, L"ReleaseDate") << std::endl;
-            std::wcout << L"  Serial Number    : " << safeGet(b, L"SerialNumber") << std::endl;
+    SessionOptions sessionOptions;
+    sessionOptions.fixturePath = fixturePath;
+    sessionOptions.cachePath = cachePath;
+    sessionOptions.batch = batch;
+    // Only the long-running modes ask for the same devices twice.
+    sessionOptions.trackDevices = watchInterval.count() || !serveAddress.empty();
+    sessionOptions.replayEventsPath = replayEventsPath;
+#ifdef _WIN32
+    if (!procRoot.empty()) std::wcerr << L"--proc-root is for Linux; ignored" << std::endl;
+#else
+    sessionOptions.procRoot = procRoot;
+#endif
+    std::unique_ptr<SysinfoSession> session(new SysinfoSession());
+    if (!session->open(sessionOptions)) {
+#ifdef _WIN32
+        if (fixturePath.empty()) {
+            std::wcerr << L"WMI Initialization Failed." << std::endl;
+            pauseIfOwnConsole();
         }
-    } else {
-        std::wcout << L"  Could not retrieve BIOS information." << std::endl;
+#endif
+        return 1;
     }
-}
-
-void printUUID() {
-    auto uuidInfo = queryWMIAll(L"SELECT UUID FROM Win32_ComputerSystemProduct");
-    std::wcout << L"\n[System UUID]" << std::endl;
-    if (!uuidInfo.empty()) {
-        std::wcout << L"  UUID: " << safeGet(uuidInfo[0], L"UUID") << std::endl;
-    } else {
-        std::wcout << L"  Could not retrieve system UUID." << std::endl;
+    CachingSource* cache = session->cache();
+    std::unique_ptr<ProfilingSource> profiler;
+    DataSource* collectFrom = &session->source();
+    if (!profilePath.empty()) {
+        // Above the cache, so cache hits show up as the cheap queries they are.
+        enableProfiling();
+        profiler.reset(new ProfilingSource(session->source()));
+        collectFrom = profiler.get();
     }
-}
-
-void printTPM() {
-    // Win32_Tpm might not be available on all systems or require admin rights for some properties.
-    auto tpmInfo = queryWMIAll(L"SELECT SpecVersion, ManufacturerID, ManufacturerVersion, IsEnabled_InitialValue, IsActivated_InitialValue, PhysicalPresenceVersionInfo FROM Win32_Tpm");
-    std::wcout << L"\n[TPM Information]" << std::endl;
-    if (!tpmInfo.empty()) {
-        for (auto& t : tpmInfo) { // Usually one TPM
-            std::wcout << L"  Spec Version     : " << safeGet(t, L"SpecVersion") << std::endl;
-            std::wcout << L"  Manufacturer ID  : " << safeGet(t, L"ManufacturerID") << std::endl;
-            std::wcout << L"  Manufacturer Ver : " << safeGet(t, L"ManufacturerVersion") << std::endl;
-            std::wcout << L"  Physical Presence: " << safeGet(t, L"PhysicalPresenceVersionInfo") << std::endl;
-            std::wcout << L"  Enabled          : " << safeGet(t, L"IsEnabled_InitialValue") << std::endl;
-            std::wcout << L"  Activated        : " << safeGet(t, L"IsActivated_InitialValue") << std::endl;
-        }
-    } else {
-        std::wcout << L"  TPM information not found or not accessible (Win32_Tpm class)." << std::endl;
-        // Attempt query from MSFT_Tpm namespace if available (newer systems)
-        // This requires connecting to "ROOT\\CIMV2\\Security\\MicrosoftTpm" which complicates the global g_pSvc.
-        // For now, we stick to Win32_Tpm.
+    std::unique_ptr<RecordingSource> recorder;
+    if (!recordPath.empty()) {
+        recorder.reset(new RecordingSource(*collectFrom));
+        collectFrom = recorder.get();
     }
-}
 
-void printSoundDevices() {
-    auto sndDevs = queryWMIAll(L"SELECT Name, Manufacturer, Status, PNPDeviceID FROM Win32_SoundDevice");
-    std::wcout << L"\n[Sound Device Information]" << std::endl;
-    if (!sndDevs.empty()) {
-        for (const auto& s : sndDevs) {
-            std::wcout << L"  Name             : " << safeGet(s, L"Name") << std::endl;
-            std::wcout << L"    Manufacturer   : " << safeGet(s, L"Manufacturer") << std::endl;
-            std::wcout << L"    Status         : " << safeGet(s, L"Status") << std::endl;
-            std::wcout << L"    Device ID      : " << safeGet(s, L"PNPDeviceID") << std::endl;
+    if (!serveAddress.empty()) {
+        serve.jobs = jobs;
+        serve.limits = limits;
+        const int rc = runExporter(*collectFrom, sections, serve, std::wcerr);
+        if (cache && !cache->save()) {
+            std::wcerr << L"Warning: could not write the static hardware cache to " << cache->path().c_str() << std::endl;
         }
-    } else {
-        std::wcout << L"  Could not retrieve sound device information." << std::endl;
-    }
-}
-
-void printUSBDevices() {
-    // Win32_USBControllerDevice is an association class. To get actual device info:
-    // 1. Query Win32_USBHub for hubs
-    // 2. Query Win32_PnPEntity for USB devices (WHERE Service = 'USBSTOR' or Name LIKE '%USB%')
-    // The original query might be slow or return less useful info.
-    // A more targeted query for connected USB devices (often PnPEntities):
-    auto usbDevs = queryWMIAll(L"SELECT Name, DeviceID, PNPDeviceID, Description, Status, Manufacturer FROM Win32_PnPEntity WHERE PNPClass = 'USB' OR Service = 'USBSTOR' OR Name LIKE '%USB Mass Storage%' OR Name LIKE '%USB Composite Device%'");
-    std::wcout << L"\n[USB Devices (from PnPEntity)]" << std::endl;
-    if (!usbDevs.empty()) {
-        for (const auto& u : usbDevs) {
-            std::wcout << L"  Name             : " << safeGet(u, L"Name") << std::endl;
-            std::wcout << L"    Description    : " << safeGet(u, L"Description") << std::endl;
-            std::wcout << L"    Manufacturer   : " << safeGet(u, L"Manufacturer") << std::endl;
-            std::wcout << L"    Status         : " << safeGet(u, L"Status") << std::endl;
-            std::wcout << L"    PNP Device ID  : " << safeGet(u, L"PNPDeviceID") << std::endl;
+        if (abandonedWorkers()) {
+            // As below: a stuck query may still return into the sources.
+            recorder.release();
+            profiler.release();
+            session.release();
         }
-    } else {
-        std::wcout << L"  Could not retrieve USB device information or no relevant USB PnP entities found." << std::endl;
+        return rc;
     }
-}
 
-void printNetworkAdapters() {
-    auto nics = queryWMIAll(L"SELECT Name, MACAddress, AdapterType, Speed, Manufacturer, NetConnectionStatus, PNPDeviceID, NetEnabled FROM Win32_NetworkAdapter WHERE PhysicalAdapter=True");
-    std::wcout << L"\n[Network Adapter Information (Physical)]" << std::endl;
-    if (!nics.empty()) {
-        for (const auto& n : nics) {
-            std::wcout << L"  Name             : " << safeGet(n, L"Name") << std::endl;
-            std::wcout << L"    MAC Address    : " << safeGet(n, L"MACAddress") << std::endl;
-            std::wcout << L"    Type           : " << safeGet(n, L"AdapterType") << std::endl;
-            uint64_t speedBps = safeStoull(safeGet(n, L"Speed"));
-            std::wcout << L"    Speed (Mbps)   : " << (speedBps / (1000*1000)) << std::endl;
-            std::wcout << L"    Manufacturer   : " << safeGet(n, L"Manufacturer") << std::endl;
-            std::wcout << L"    Enabled        : " << safeGet(n, L"NetEnabled") << std::endl;
-            std::wcout << L"    Status Code    : " << safeGet(n, L"NetConnectionStatus") << " (2=Connected, 7=Disconnected, etc.)" << std::endl;
-            // std::wcout << L"    Device ID      : " << safeGet(n, L"PNPDeviceID") << std::endl;
+    if (probe) {
+        std::signal(SIGINT, onCancelSignal);
+        const int rc = runProbe(*collectFrom, jobs, limits, probeOptions, std::wcout);
+        std::signal(SIGINT, SIG_DFL);
+        if (cache && !cache->save()) {
+            std::wcerr << L"Warning: could not write the static hardware cache to " << cache->path().c_str() << std::endl;
         }
-    } else {
-        std::wcout << L"  Could not retrieve physical network adapter information." << std::endl;
+        if (abandonedWorkers()) {
+            recorder.release();
+            profiler.release();
+            session.release();
+        }
+        return rc;
     }
-}
-
-bool initializeWMI() {
-    HRESULT hres;
 
-    hres = CoInitializeEx(0, COINIT_MULTITHREADED);
-    if (FAILED(hres)) {
-        std::wcerr << L"Failed to initialize COM library. Error code = 0x" << std::hex << hres << std::endl;
-        return false;
+    // Sampling runs alongside collection, so the window mostly overlaps it.
+    // Counters are live only: there is nothing to sample behind a fixture.
+    std::unique_ptr<Sampler> sampler;
+    if (utilizationWindow.count() && format == OutputFormat::Text && sincePath.empty()) {
+        if (!fixturePath.empty()) {
+            std::wcerr << L"--utilization samples the live system; ignored with --fixture" << std::endl;
+        } else {
+            // 64 samples per window keeps it well inside the ring.
+            sampler.reset(new Sampler(std::max(std::chrono::milliseconds(10), utilizationWindow / 64)));
+            sampler->start();
+        }
     }
 
-    hres = CoInitializeSecurity(
-        NULL,
-        -1,                          // COM authentication
-        NULL,                        // Authentication services
-        NULL,                        // Reserved
-        RPC_C_AUTHN_LEVEL_DEFAULT,   // Default authentication
-        RPC_C_IMP_LEVEL_IMPERSONATE, // Default Impersonation
-        NULL,                        // Authentication info
-        EOAC_NONE,                   // Additional capabilities
-        NULL                         // Reserved
-    );
-    if (FAILED(hres)) {
-        std::wcerr << L"Failed to initialize security. Error code = 0x" << std::hex << hres << std::endl;
-        CoUninitialize();
-        return false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::signal(SIGINT, onCancelSignal);
+    int sinceResult = 0;
+    if (!sincePath.empty()) {
+        sinceResult = compareWithSnapshot(*collectFrom, sections, jobs, limits, since, std::wcout, std::wcerr);
+    } else if (format != OutputFormat::Text) {
+        // stdout carries only records here: no banner, watch or prompt.
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY); // no CRLF translation
+#endif
+        writeRecords(*collectFrom, sections, jobs, format == OutputFormat::Jsonl ? RecordFormat::Jsonl : RecordFormat::Bin,
+                     limits, stdout);
+    } else {
+        std::wcout << L"Collecting system information, please wait..." << std::endl;
+        collectAndPrint(*collectFrom, sections, jobs, std::wcout, limits);
     }
-
-    hres = CoCreateInstance(
-        CLSID_WbemLocator,
-        0,
-        CLSCTX_INPROC_SERVER,
-        IID_IWbemLocator, (LPVOID *)&g_pLoc);
-    if (FAILED(hres)) {
-        std::wcerr << L"Failed to create IWbemLocator object. Error code = 0x" << std::hex << hres << std::endl;
-        CoUninitialize();
-        return false;
+    std::signal(SIGINT, SIG_DFL);
+    if (timing) {
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::wcerr << L"Collected " << sections.size() << L" sections in " << ms << L" ms";
+        if (cache) std::wcerr << L" (" << cache->hits() << L" static queries from cache)";
+        std::wcerr << std::endl;
     }
-
-    hres = g_pLoc->ConnectServer(
-        _bstr_t(L"ROOT\\CIMV2"), // Object path of WMI namespace
-        NULL,                    // User name. NULL = current user
-        NULL,                    // User password. NULL = current
-        0,                       // Locale. NULL indicates current
-        NULL,                    // Security flags.
-        0,                       // Authority (e.g. Kerberos)
-        0,                       // Context object
-        &g_pSvc                  // pointer to IWbemServices proxy
-    );
-    if (FAILED(hres)) {
-        std::wcerr << L"Could not connect to WMI namespace ROOT\\CIMV2. Error code = 0x" << std::hex << hres << std::endl;
-        g_pLoc->Release();
-        g_pLoc = NULL;
-        CoUninitialize();
-        return false;
+    if (profiler) {
+        const std::vector<QuerySpan> spans = profileSpans();
+        // Keep stdout to records for the structured formats.
+        printProfileSummary(spans, format == OutputFormat::Text ? std::wcout : std::wcerr);
+        if (!writeChromeTrace(profilePath, spans)) {
+            std::wcerr << L"Could not write trace " << utf8ToWide(profilePath.data(), profilePath.size()) << std::endl;
+        }
     }
-
-    hres = CoSetProxyBlanket(
-        g_pSvc,                        // Indicates the proxy to set
-        RPC_C_AUTHN_WINNT,           // RPC_C_AUTHN_xxx
-        RPC_C_AUTHZ_NONE,            // RPC_C_AUTHZ_xxx
-        NULL,                        // Server principal name
-        RPC_C_AUTHN_LEVEL_CALL,      // RPC_C_AUTHN_LEVEL_xxx
-        RPC_C_IMP_LEVEL_IMPERSONATE, // RPC_C_IMP_LEVEL_xxx
-        NULL,                        // client identity
-        EOAC_NONE                    // proxy capabilities
-    );
-    if (FAILED(hres)) {
-        std::wcerr << L"Could not set proxy blanket. Error code = 0x" << std::hex << hres << std::endl;
-        g_pSvc->Release();
-        g_pSvc = NULL;
-        g_pLoc->Release();
-        g_pLoc = NULL;
-        CoUninitialize();
-        return false;
+    if (recorder && !recorder->save(recordPath)) {
+        std::wcerr << L"Could not write fixture " << utf8ToWide(recordPath.data(), recordPath.size()) << std::endl;
     }
-    return true;
-}
-
-void uninitializeWMI() {
-    if (g_pSvc) {
-        g_pSvc->Release();
-        g_pSvc = NULL;
+    if (cache && !cache->save()) {
+        std::wcerr << L"Warning: could not write the static hardware cache to " << cache->path().c_str() << std::endl;
     }
-    if (g_pLoc) {
-        g_pLoc->Release();
-        g_pLoc = NULL;
+    if (abandonedWorkers()) {
+        // A stuck query may still return into the sources; leak them rather
+        // than destroy them under it, and don't start watching a hung system.
+        std::wcerr << L"Warning: " << abandonedWorkers() << L" queries did not stop in time and were abandoned" << std::endl;
+        recorder.release();
+        profiler.release();
+        session.release();
+        return 1;
     }
-    CoUninitialize();
-}
-
+    if (g_cancel) return 130;
+    if (!sincePath.empty()) return sinceResult;
 
-int main() {
-    setUTF8(); // Set console to UTF-8 early
+    if (format != OutputFormat::Text) return 0;
 
-    if (!initializeWMI()) {
-        std::wcerr << L"WMI Initialization Failed. Press any key to exit..." << std::endl;
-        std::cin.get(); // Use cin.get() for "press any key" as system("pause") can be problematic
-        return 1;
+    if (sampler) {
+        std::this_thread::sleep_until(start + utilizationWindow + sampler->period());
+        std::unique_ptr<Rates> rates(new Rates());
+        if (sampler->rates(utilizationWindow, *rates)) printUtilization(*rates, std::wcout);
+        sampler.reset();
     }
 
-    std::wcout << L"Collecting system information, please wait..." << std::endl;
-
-    printSystemInfo();
-    printCPUInfo();
-    printMemoryInfo();
-    printGPUInfo();
-    printDiskInfo(); // Suspected area of the original bug
-    printBoardInfo();
-    printBIOSInfo();
-    printUUID();
-    printTPM();
-    printSoundDevices();
-    printUSBDevices();
-    printNetworkAdapters();
+    if (watchInterval.count()) {
+        std::wcout << L"\nWatching for changes every " << watchInterval.count() << L" ms (Ctrl+C to stop)..." << std::endl;
+        runWatch(session->source(), volatileWatches(), watchInterval, timing, history.get(), std::wcout);
+        if (timing && session->devices()) {
+            const DeviceTable& devices = *session->devices();
+            std::wcerr << L"Device table: " << devices.events() << L" events, " << devices.lookups()
+                       << L" device lookups, " << devices.refreshes() << L" enumerations, " << devices.hits() << L" queries served from the table" << std::endl;
+        }
+        return 0;
+    }
 
-    uninitializeWMI();
+    session.reset();
 
-    std::wcout << L"\nInformation collection complete. Press any key to exit..." << std::endl;
-    // system("pause >nul"); // Original pause
-    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), L'\n'); // Clear potential leftover newline
-    std::wcin.get(); // Wait for user to press Enter
+#ifdef _WIN32
+    if (fixturePath.empty()) {
+        std::wcout << L"\nInformation collection complete." << std::endl;
+        pauseIfOwnConsole();
+    }
+#endif
 
     return 0;
-}
\ No newline at end of file
+}
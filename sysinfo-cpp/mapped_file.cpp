@@ -0,0 +1,253 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+#ifdef _WIN32
+const char kSeparators[] = "\\/";
+#else
+const char kSeparators[] = "/";
+#endif
+
+// mkdir -p for the directory part of `path`.
+void createParentDirs(const std::string& path) {
+    size_t pos = path.find_first_of(kSeparators, 1);
+    while (pos != std::string::npos) {
+        std::string dir = path.substr(0, pos);
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+        pos = path.find_first_of(kSeparators, pos + 1);
+    }
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_writable(false), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr) {}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+        close();
+        return false;
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0) return true; // can't map an empty file
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    m_data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!m_data) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::openWritable(const std::string& path, size_t size) {
+    close();
+    createParentDirs(path);
+    m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                         OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER current;
+    if (!GetFileSizeEx(m_file, &current)) {
+        close();
+        return false;
+    }
+    if (current.QuadPart == 0) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(m_file, end, NULL, FILE_BEGIN) || !SetEndOfFile(m_file)) {
+            close();
+            return false;
+        }
+        current = end;
+    }
+    m_size = static_cast<size_t>(current.QuadPart);
+    m_mapping = m_size ? CreateFileMappingA(m_file, NULL, PAGE_READWRITE, 0, 0, NULL) : nullptr;
+    m_data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+    if (!m_data) {
+        close();
+        return false;
+    }
+    m_writable = true;
+    return true;
+}
+
+void MappedFile::adviseSequential() {}
+
+void MappedFile::close() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+    m_size = 0;
+    m_writable = false;
+}
+
+bool writeFileAtomically(const std::string& path, const void* data, size_t len) {
+    createParentDirs(path);
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".tmp%d", _getpid());
+    const std::string tmp = path + suffix;
+    HANDLE h = CreateFileA(tmp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    bool ok = WriteFile(h, data, static_cast<DWORD>(len), &written, NULL) && written == len;
+    CloseHandle(h);
+    if (ok) ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    if (!ok) DeleteFileA(tmp.c_str());
+    return ok;
+}
+
+bool listFiles(const std::string& dir, std::vector<std::string>& out) {
+    WIN32_FIND_DATAA entry;
+    HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &entry);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    do {
+        const std::string name = entry.cFileName;
+        if (name == "." || name == "..") continue;
+        const std::string path = dir + "\\" + name;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            listFiles(path, out);
+        } else {
+            out.push_back(path);
+        }
+    } while (FindNextFileA(h, &entry));
+    FindClose(h);
+    return true;
+}
+
+#else
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_writable(false) {}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size) {
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            m_size = 0;
+            ::close(fd);
+            return false;
+        }
+        m_data = p;
+    }
+    ::close(fd); // the mapping keeps the file referenced
+    return true;
+}
+
+bool MappedFile::openWritable(const std::string& path, size_t size) {
+    close();
+    createParentDirs(path);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size == 0 && ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t length = st.st_size ? static_cast<size_t>(st.st_size) : size;
+    void* p = length ? mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    m_data = p;
+    m_size = length;
+    m_writable = true;
+    return true;
+}
+
+void MappedFile::adviseSequential() {
+    if (m_data) posix_madvise(m_data, m_size, POSIX_MADV_SEQUENTIAL | POSIX_MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+    if (m_data) munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_writable = false;
+}
+
+bool writeFileAtomically(const std::string& path, const void* data, size_t len) {
+    createParentDirs(path);
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".tmp%ld", static_cast<long>(getpid()));
+    const std::string tmp = path + suffix;
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const char* p = static_cast<const char*>(data);
+    size_t left = len;
+    while (left) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    bool ok = left == 0;
+    ok = (::close(fd) == 0) && ok;
+    if (ok) ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok) unlink(tmp.c_str());
+    return ok;
+}
+
+bool listFiles(const std::string& dir, std::vector<std::string>& out) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) return false;
+    while (struct dirent* entry = readdir(d)) {
+        const char* name = entry->d_name;
+        if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) continue;
+        const std::string path = dir + "/" + name;
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type == DT_DIR) {
+            listFiles(path, out);
+        } else if (type == DT_REG) {
+            out.push_back(path);
+        }
+    }
+    closedir(d);
+    return true;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
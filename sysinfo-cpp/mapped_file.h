@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a whole file. An empty file maps to
+// data() == nullptr with size() == 0.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file is missing or can't be mapped.
+    bool open(const std::string& path);
+    // Maps `path` read-write and shared, so stores reach the file. A missing
+    // file is created with `size` zero bytes; an existing one keeps its size.
+    bool openWritable(const std::string& path, size_t size);
+    void close();
+    // Hints that the mapping will be read once, front to back, so the
+    // kernel reads ahead aggressively. No-op where unsupported.
+    void adviseSequential();
+
+    const unsigned char* data() const { return static_cast<const unsigned char*>(m_data); }
+    // Null unless opened with openWritable().
+    unsigned char* writableData() { return m_writable ? static_cast<unsigned char*>(m_data) : nullptr; }
+    size_t size() const { return m_size; }
+
+private:
+    void* m_data;
+    size_t m_size;
+    bool m_writable;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+};
+
+// Writes `data` to `path` via a temporary file in the same directory and a
+// rename, so readers see either the old or the new content, never a mix.
+// Creates missing parent directories.
+bool writeFileAtomically(const std::string& path, const void* data, size_t len);
+
+// Appends the paths of the regular files under `dir`, recursively, in
+// directory order. False if `dir` can't be opened; unreadable
+// subdirectories are skipped.
+bool listFiles(const std::string& dir, std::vector<std::string>& out);
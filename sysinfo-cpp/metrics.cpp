@@ -0,0 +1,388 @@
+#include "metrics.h"
+
+#include <cstring>
+
+#include "processes.h"
+
+const char* const kOpenMetricsContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+void MetricsWriter::family(const char* name, const char* type, const char* help) {
+    m_buf += "# TYPE ";
+    m_buf += name;
+    m_buf.push_back(' ');
+    m_buf += type;
+    m_buf += "\n# HELP ";
+    m_buf += name;
+    m_buf.push_back(' ');
+    m_buf += help; // our own text: nothing to escape
+    m_buf.push_back('\n');
+    m_sampleName = name;
+    if (std::strcmp(type, "info") == 0) m_sampleName += "_info";
+    else if (std::strcmp(type, "counter") == 0) m_sampleName += "_total";
+}
+
+void MetricsWriter::sample() {
+    m_buf += m_sampleName;
+    m_labels = false;
+}
+
+void MetricsWriter::label(const char* name, const char* s, size_t n) {
+    m_buf.push_back(m_labels ? ',' : '{');
+    m_labels = true;
+    m_buf += name;
+    m_buf += "=\"";
+    escaped(s, n);
+    m_buf.push_back('"');
+}
+
+void MetricsWriter::label(const char* name, uint64_t v) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[19 - n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    label(name, digits + 20 - n, n);
+}
+
+void MetricsWriter::label(const char* name, const Value& v) {
+    switch (v.type) {
+    case ValueType::String: label(name, v.s.p, v.s.n); break;
+    case ValueType::Int:
+        if (v.i < 0) {
+            const std::string text = std::to_string(static_cast<long long>(v.i));
+            label(name, text.data(), text.size());
+        } else {
+            label(name, static_cast<uint64_t>(v.i));
+        }
+        break;
+    case ValueType::Uint: label(name, v.u); break;
+    case ValueType::Bool: v.b ? label(name, "true", 4) : label(name, "false", 5); break;
+    default: break;
+    }
+}
+
+void MetricsWriter::value(uint64_t v) {
+    if (m_labels) m_buf.push_back('}');
+    m_buf.push_back(' ');
+    u64(v);
+    m_buf.push_back('\n');
+}
+
+void MetricsWriter::value(double v, unsigned decimals) {
+    if (m_labels) m_buf.push_back('}');
+    m_buf.push_back(' ');
+    uint64_t scale = 1;
+    for (unsigned k = 0; k < decimals; ++k) scale *= 10;
+    const uint64_t scaled = v > 0 ? static_cast<uint64_t>(v * static_cast<double>(scale) + 0.5) : 0;
+    u64(scaled / scale);
+    if (decimals) {
+        m_buf.push_back('.');
+        uint64_t frac = scaled % scale;
+        for (uint64_t div = scale / 10; div; div /= 10) {
+            m_buf.push_back(static_cast<char>('0' + frac / div));
+            frac %= div;
+        }
+    }
+    m_buf.push_back('\n');
+}
+
+void MetricsWriter::eof() {
+    m_buf += "# EOF\n";
+}
+
+void MetricsWriter::escaped(const char* s, size_t n) {
+    const char* run = s;
+    for (const char* p = s; p != s + n; ++p) {
+        const char c = *p;
+        if (c != '\\' && c != '"' && c != '\n') continue;
+        m_buf.append(run, p);
+        m_buf.push_back('\\');
+        m_buf.push_back(c == '\n' ? 'n' : c);
+        run = p + 1;
+    }
+    m_buf.append(run, s + n);
+}
+
+void MetricsWriter::u64(uint64_t v) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) m_buf.push_back(digits[--n]);
+}
+
+namespace {
+
+// An info label taken from a column.
+struct LabelColumn {
+    const char* label;
+    const char* column;
+};
+
+// Labels identifying row `row`: `key` from `keyColumn`, or the row number
+// when the class has no key of its own (CPUs, DIMMs, GPUs). A null key
+// means a single-row class with no identifying label.
+void keyLabel(MetricsWriter& w, const ResultSet& rs, size_t row, const char* key, int keyCol) {
+    if (!key) return;
+    if (keyCol >= 0) {
+        w.label(key, rs.at(row, keyCol));
+    } else {
+        w.label(key, static_cast<uint64_t>(row));
+    }
+}
+
+// An info family with one sample per row.
+template <size_t N>
+void infoRows(MetricsWriter& w, const char* name, const char* help, const ResultSet& rs, const char* key,
+              const char* keyColumn, const LabelColumn (&labels)[N]) {
+    if (rs.empty()) return;
+    int cols[N];
+    bool any = false;
+    for (size_t k = 0; k < N; ++k) {
+        cols[k] = rs.column(labels[k].column);
+        any = any || cols[k] >= 0;
+    }
+    if (!any) return;
+    const int keyCol = keyColumn ? rs.column(keyColumn) : -1;
+    w.family(name, "info", help);
+    for (size_t r = 0; r < rs.rowCount(); ++r) {
+        w.sample();
+        keyLabel(w, rs, r, key, keyCol);
+        for (size_t k = 0; k < N; ++k) {
+            if (cols[k] >= 0) w.label(labels[k].label, rs.at(r, cols[k]));
+        }
+        w.value(static_cast<uint64_t>(1));
+    }
+}
+
+// A gauge family with one sample per row: `column` times `scale`. Rows
+// where the column is null are left out.
+void gaugeRows(MetricsWriter& w, const char* name, const char* help, const ResultSet& rs, const char* key,
+               const char* keyColumn, const char* column, uint64_t scale = 1) {
+    const int col = rs.column(column);
+    if (rs.empty() || col < 0) return;
+    const int keyCol = keyColumn ? rs.column(keyColumn) : -1;
+    w.family(name, "gauge", help);
+    for (size_t r = 0; r < rs.rowCount(); ++r) {
+        const Value& v = rs.at(r, col);
+        if (v.isNull()) continue;
+        w.sample();
+        keyLabel(w, rs, r, key, keyCol);
+        w.value(v.asUint() * scale);
+    }
+}
+
+void systemMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn os[] = {
+        { "name", "Caption" }, { "version", "Version" }, { "build", "BuildNumber" }, { "architecture", "OSArchitecture" },
+    };
+    infoRows(w, "sysinfo_os", "Operating system.", r[0], nullptr, nullptr, os);
+    gaugeRows(w, "sysinfo_memory_visible_bytes", "Physical memory usable by the OS.", r[0], nullptr, nullptr,
+              "TotalVisibleMemorySize", 1024);
+    gaugeRows(w, "sysinfo_memory_free_bytes", "Physical memory currently unused.", r[0], nullptr, nullptr,
+              "FreePhysicalMemory", 1024);
+}
+
+void cpuMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn cpu[] = {
+        { "name", "Name" }, { "manufacturer", "Manufacturer" }, { "socket", "SocketDesignation" },
+        { "processor_id", "ProcessorId" }, { "virtualization", "VirtualizationFirmwareEnabled" },
+    };
+    infoRows(w, "sysinfo_cpu", "Processor package.", r[0], "processor", nullptr, cpu);
+    gaugeRows(w, "sysinfo_cpu_cores", "Physical cores of a processor package.", r[0], "processor", nullptr, "NumberOfCores");
+    gaugeRows(w, "sysinfo_cpu_logical_processors", "Hardware threads of a processor package.", r[0], "processor", nullptr,
+              "NumberOfLogicalProcessors");
+    gaugeRows(w, "sysinfo_cpu_max_clock_hertz", "Maximum clock speed.", r[0], "processor", nullptr, "MaxClockSpeed", 1000000);
+    gaugeRows(w, "sysinfo_cpu_l2_cache_bytes", "L2 cache size.", r[0], "processor", nullptr, "L2CacheSize", 1024);
+    gaugeRows(w, "sysinfo_cpu_l3_cache_bytes", "L3 cache size.", r[0], "processor", nullptr, "L3CacheSize", 1024);
+}
+
+// r[0] packages, r[1] NUMA nodes, r[2] logical processors, r[3] caches.
+void topologyMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn package[] = { { "features", "Features" } };
+    infoRows(w, "sysinfo_cpu_package", "Processor package and the ISA extensions usable on it.", r[0], "package", "Package",
+             package);
+    static const LabelColumn node[] = {
+        { "cpus", "Cpus" }, { "core_cpus", "CoreCpus" }, { "affinity_mask", "AffinityMask" }, { "distances", "Distances" },
+    };
+    infoRows(w, "sysinfo_numa_node", "NUMA node and its suggested cpusets.", r[1], "node", "NodeId", node);
+    gaugeRows(w, "sysinfo_numa_node_memory_bytes", "Memory attached to a NUMA node.", r[1], "node", "NodeId", "MemorySize");
+    static const LabelColumn cpu[] = {
+        { "package", "Package" }, { "numa_node", "NumaNode" }, { "core", "Core" }, { "thread", "Thread" },
+        { "core_type", "CoreType" },
+    };
+    infoRows(w, "sysinfo_logical_processor", "Where a logical processor sits in the topology.", r[2], "cpu",
+             "ProcessorId", cpu);
+    static const LabelColumn cache[] = {
+        { "level", "Level" }, { "type", "Type" }, { "shared_cpus", "SharedCpus" },
+    };
+    infoRows(w, "sysinfo_cpu_cache", "Processor cache.", r[3], "cache", "DeviceID", cache);
+    gaugeRows(w, "sysinfo_cpu_cache_size_bytes", "Size of a processor cache.", r[3], "cache", "DeviceID", "Size");
+    gaugeRows(w, "sysinfo_cpu_cache_line_bytes", "Line size of a processor cache.", r[3], "cache", "DeviceID", "LineSize");
+    gaugeRows(w, "sysinfo_cpu_cache_ways", "Associativity of a processor cache.", r[3], "cache", "DeviceID",
+              "Associativity");
+}
+
+void memoryMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn dimm[] = {
+        { "bank", "BankLabel" }, { "manufacturer", "Manufacturer" }, { "part_number", "PartNumber" },
+        { "serial_number", "SerialNumber" },
+    };
+    infoRows(w, "sysinfo_memory_module", "Installed memory module.", r[0], "slot", nullptr, dimm);
+    gaugeRows(w, "sysinfo_memory_module_size_bytes", "Capacity of a memory module.", r[0], "slot", nullptr, "Capacity");
+    gaugeRows(w, "sysinfo_memory_module_speed_hertz", "Rated speed of a memory module.", r[0], "slot", nullptr, "Speed",
+              1000000);
+}
+
+void gpuMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn gpu[] = {
+        { "name", "Name" }, { "driver_version", "DriverVersion" }, { "processor", "VideoProcessor" },
+        { "device_id", "PNPDeviceID" }, { "status", "Status" },
+    };
+    infoRows(w, "sysinfo_gpu", "Video controller.", r[0], "gpu", nullptr, gpu);
+    gaugeRows(w, "sysinfo_gpu_memory_bytes", "Adapter memory reported by the driver.", r[0], "gpu", nullptr, "AdapterRAM");
+}
+
+void diskMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn disk[] = {
+        { "model", "Model" }, { "serial_number", "SerialNumber" }, { "firmware", "FirmwareRevision" },
+        { "interface", "InterfaceType" }, { "media_type", "MediaType" }, { "status", "Status" },
+    };
+    infoRows(w, "sysinfo_disk", "Physical disk.", r[0], "disk", "Index", disk);
+    gaugeRows(w, "sysinfo_disk_size_bytes", "Size of a physical disk.", r[0], "disk", "Index", "Size");
+    gaugeRows(w, "sysinfo_disk_partitions", "Partitions on a physical disk.", r[0], "disk", "Index", "Partitions");
+    gaugeRows(w, "sysinfo_partition_size_bytes", "Size of a partition.", r[1], "partition", "DeviceID", "Size");
+    static const LabelColumn volume[] = {
+        { "label", "VolumeName" }, { "filesystem", "FileSystem" },
+    };
+    infoRows(w, "sysinfo_volume", "Fixed volume.", r[2], "volume", "DeviceID", volume);
+    gaugeRows(w, "sysinfo_volume_size_bytes", "Size of a fixed volume.", r[2], "volume", "DeviceID", "Size");
+    gaugeRows(w, "sysinfo_volume_free_bytes", "Free space of a fixed volume.", r[2], "volume", "DeviceID", "FreeSpace");
+}
+
+void boardMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn board[] = {
+        { "manufacturer", "Manufacturer" }, { "product", "Product" }, { "serial_number", "SerialNumber" },
+        { "version", "Version" },
+    };
+    infoRows(w, "sysinfo_board", "Baseboard.", r[0], nullptr, nullptr, board);
+}
+
+void biosMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn bios[] = {
+        { "manufacturer", "Manufacturer" }, { "version", "SMBIOSBIOSVersion" }, { "release_date", "ReleaseDate" },
+        { "serial_number", "SerialNumber" },
+    };
+    infoRows(w, "sysinfo_bios", "System firmware.", r[0], nullptr, nullptr, bios);
+}
+
+void uuidMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn uuid[] = { { "uuid", "UUID" } };
+    infoRows(w, "sysinfo_system", "System product UUID.", r[0], nullptr, nullptr, uuid);
+}
+
+void tpmMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn tpm[] = {
+        { "spec_version", "SpecVersion" }, { "manufacturer_id", "ManufacturerID" },
+        { "manufacturer_version", "ManufacturerVersion" },
+    };
+    infoRows(w, "sysinfo_tpm", "Trusted Platform Module.", r[0], nullptr, nullptr, tpm);
+    gaugeRows(w, "sysinfo_tpm_enabled", "Whether the TPM is enabled.", r[0], nullptr, nullptr, "IsEnabled_InitialValue");
+    gaugeRows(w, "sysinfo_tpm_activated", "Whether the TPM is activated.", r[0], nullptr, nullptr, "IsActivated_InitialValue");
+}
+
+void soundMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn sound[] = {
+        { "name", "Name" }, { "manufacturer", "Manufacturer" }, { "status", "Status" },
+    };
+    infoRows(w, "sysinfo_sound_device", "Sound device.", r[0], "device_id", "PNPDeviceID", sound);
+}
+
+void usbMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    static const LabelColumn usb[] = {
+        { "name", "Name" }, { "description", "Description" }, { "manufacturer", "Manufacturer" }, { "status", "Status" },
+    };
+    infoRows(w, "sysinfo_usb_device", "USB device.", r[0], "device_id", "PNPDeviceID", usb);
+}
+
+void networkMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    const ResultSet& nics = r[0];
+    static const LabelColumn nic[] = {
+        { "mac", "MACAddress" }, { "type", "AdapterType" }, { "manufacturer", "Manufacturer" },
+    };
+    infoRows(w, "sysinfo_network_adapter", "Physical network adapter.", nics, "adapter", "Name", nic);
+    gaugeRows(w, "sysinfo_network_speed_bits_per_second", "Nominal link speed.", nics, "adapter", "Name", "Speed");
+    gaugeRows(w, "sysinfo_network_enabled", "Whether the adapter is enabled.", nics, "adapter", "Name", "NetEnabled");
+    // NetConnectionStatus 2 is "Connected"; the other codes are states of
+    // being down.
+    const int cName = nics.column("Name"), cStatus = nics.column("NetConnectionStatus");
+    if (nics.empty() || cStatus < 0) return;
+    w.family("sysinfo_network_up", "gauge", "Whether the adapter is connected.");
+    for (size_t i = 0; i < nics.rowCount(); ++i) {
+        if (nics.at(i, cStatus).isNull()) continue;
+        w.sample();
+        w.label("adapter", nics.at(i, cName));
+        w.value(static_cast<uint64_t>(nics.at(i, cStatus).asUint() == 2 ? 1 : 0));
+    }
+}
+
+// Totals and per-user rollups only: a sample per process would make the
+// exposition as big as the process table.
+void processMetrics(const std::vector<ResultSet>& r, MetricsWriter& w) {
+    if (r[0].empty()) return;
+    ProcessSummary summary;
+    summarizeProcesses(r[0], 0, summary);
+    w.family("sysinfo_processes", "gauge", "Running processes.");
+    w.sample();
+    w.value(static_cast<uint64_t>(summary.processes));
+    w.family("sysinfo_process_threads", "gauge", "Threads of all running processes.");
+    w.sample();
+    w.value(summary.threads);
+
+    struct UserGauge {
+        const char* name;
+        const char* help;
+    };
+    static const UserGauge gauges[] = {
+        { "sysinfo_user_processes", "Running processes of a user." },
+        { "sysinfo_user_working_set_bytes", "Working set of a user's processes." },
+        { "sysinfo_user_cpu_seconds", "CPU time used so far by a user's running processes." },
+    };
+    for (size_t g = 0; g < sizeof(gauges) / sizeof(gauges[0]); ++g) {
+        w.family(gauges[g].name, "gauge", gauges[g].help);
+        for (size_t k = 0; k < summary.users.size(); ++k) {
+            const UserRollup& user = summary.users[k];
+            w.sample();
+            if (!user.user.empty()) w.label("user", user.user.data(), user.user.size());
+            if (g == 0) w.value(user.processes);
+            else if (g == 1) w.value(user.workingSet);
+            else w.value(user.cpuTime / 1e7, 2);
+        }
+    }
+}
+
+struct SectionMetrics {
+    const char* section;
+    void (*append)(const std::vector<ResultSet>& results, MetricsWriter& w);
+};
+
+const SectionMetrics kSectionMetrics[] = {
+    { "system", systemMetrics }, { "cpu", cpuMetrics }, { "topology", topologyMetrics }, { "memory", memoryMetrics },
+    { "gpu", gpuMetrics }, { "disk", diskMetrics }, { "board", boardMetrics }, { "bios", biosMetrics },
+    { "uuid", uuidMetrics }, { "tpm", tpmMetrics }, { "sound", soundMetrics }, { "usb", usbMetrics },
+    { "network", networkMetrics }, { "process", processMetrics },
+};
+
+} // namespace
+
+void appendSectionMetrics(MetricsWriter& w, const char* section, const std::vector<ResultSet>& results) {
+    for (size_t k = 0; k < sizeof(kSectionMetrics) / sizeof(kSectionMetrics[0]); ++k) {
+        if (std::strcmp(kSectionMetrics[k].section, section) == 0) {
+            kSectionMetrics[k].append(results, w);
+            return;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "resultset.h"
+
+// Appends OpenMetrics text exposition to a growable UTF-8 buffer:
+//   # TYPE sysinfo_volume_free_bytes gauge
+//   # HELP sysinfo_volume_free_bytes Free space of a fixed volume.
+//   sysinfo_volume_free_bytes{volume="C:"} 123456789
+// Label values are ResultSet strings copied with escaping only and numbers
+// are formatted by hand, as in JsonWriter.
+class MetricsWriter {
+public:
+    MetricsWriter() : m_labels(false) {}
+
+    // Starts a metric family. `type` is "gauge", "counter" or "info";
+    // samples of an info family are named <name>_info and of a counter
+    // <name>_total.
+    void family(const char* name, const char* type, const char* help);
+    // Starts a sample of the current family: labels, then one value().
+    void sample();
+    void label(const char* name, const char* s, size_t n);
+    void label(const char* name, uint64_t v);
+    // Null values add no label.
+    void label(const char* name, const Value& v);
+    void value(uint64_t v);
+    // Non-negative decimal with a fixed number of fraction digits.
+    void value(double v, unsigned decimals);
+    // Ends the exposition.
+    void eof();
+
+    const std::string& buffer() const { return m_buf; }
+    std::string& buffer() { return m_buf; }
+    void clear() { m_buf.clear(); }
+
+private:
+    void escaped(const char* s, size_t n);
+    void u64(uint64_t v);
+
+    std::string m_buf;
+    std::string m_sampleName; // of the current family
+    bool m_labels;            // a label list is open
+};
+
+// Content-Type of the exposition.
+extern const char* const kOpenMetricsContentType;
+
+// Metric families for one gathered section, e.g. sysinfo_disk_size_bytes
+// for "disk" or sysinfo_bios_info for "bios". Missing columns (queries
+// narrowed by --fields or cut short) leave their metrics out. Sections
+// without metrics add nothing.
+void appendSectionMetrics(MetricsWriter& w, const char* section, const std::vector<ResultSet>& results);
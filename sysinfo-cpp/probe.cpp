@@ -0,0 +1,485 @@
+#include "probe.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <thread>
+
+#include "sections.h"
+#include "storage.h"
+
+namespace {
+
+const uint64_t kMiB = 1ull << 20;
+const size_t kLine = 64;
+
+// Working sets sized from the reported caches stay within these: large
+// enough to leave the caches behind, small enough not to page.
+const uint64_t kMinProbeBytes = 64 * kMiB;
+const uint64_t kMaxProbeBytes = 1024 * kMiB;
+
+// Unreported L1 data caches are 32 KiB or more; half of that stays in them.
+const uint64_t kL1ProbeBytes = 16 * 1024;
+
+const ProbeLimit kDefaultLimits[] = {
+    { "memory-peak", 50, false, L"%" },   // all-core read, of the DIMMs' nominal peak
+    { "core-spread", 75, false, L"%" },   // slowest CPU's read, of the median CPU's
+    { "memory-latency", 200, true, L"ns" }, // a random walk over 4 x L3
+    { "disk-seq", 100, false, L"MB/s" },
+    { "disk-iops", 100, false, L"IOPS" },
+    { "nvme-seq", 1000, false, L"MB/s" },
+    { "nvme-iops", 5000, false, L"IOPS" },
+};
+
+double nsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Scratch memory from allocateProbeMemory(), released on scope exit.
+class ProbeBuffer {
+public:
+    explicit ProbeBuffer(size_t bytes) : m_p(static_cast<char*>(allocateProbeMemory(bytes))), m_bytes(bytes) {
+        if (!m_p) throw std::bad_alloc();
+    }
+    ~ProbeBuffer() { freeProbeMemory(m_p, m_bytes); }
+    ProbeBuffer(const ProbeBuffer&) = delete;
+    ProbeBuffer& operator=(const ProbeBuffer&) = delete;
+    char* data() const { return m_p; }
+
+private:
+    char* m_p;
+    size_t m_bytes;
+};
+
+// Keeps the read kernels' results observable.
+std::atomic<uint64_t> g_sink(0);
+
+enum class BandwidthOp { Read, Write, Copy };
+
+void runOp(BandwidthOp op, char* p, size_t bytes) {
+    const BandwidthKernels& k = bandwidthKernels();
+    switch (op) {
+    case BandwidthOp::Read:
+        g_sink.fetch_xor(k.read(p, bytes), std::memory_order_relaxed);
+        break;
+    case BandwidthOp::Write:
+        k.write(p, bytes);
+        break;
+    case BandwidthOp::Copy:
+        k.copy(p + bytes / 2, p, bytes / 2);
+        break;
+    }
+}
+
+// Shared by the threads of one timed run. Each thread reports how long its
+// warm-up pass took; the run then does as many passes as fit the target on
+// the slowest of them.
+struct RunState {
+    RunState() : ready(0), warmupNs(0), passes(0) {}
+    std::atomic<unsigned> ready;
+    std::atomic<uint64_t> warmupNs;
+    std::atomic<uint64_t> passes; // 0 until every thread is ready
+};
+
+void runThread(unsigned cpu, size_t bytes, BandwidthOp op, RunState& state) {
+    pinThreadToCpu(cpu);
+    ProbeBuffer buf(bytes);
+    std::memset(buf.data(), 1, bytes); // first touch, on this CPU's node
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    runOp(op, buf.data(), bytes);
+    const uint64_t took = static_cast<uint64_t>(nsSince(start));
+    for (uint64_t seen = state.warmupNs.load(); took > seen && !state.warmupNs.compare_exchange_weak(seen, took);) {
+    }
+    ++state.ready;
+    uint64_t passes;
+    while (!(passes = state.passes.load())) std::this_thread::yield();
+    for (uint64_t k = 0; k < passes; ++k) runOp(op, buf.data(), bytes);
+}
+
+// One timed run of `op` with a thread pinned to each of `cpus`, each over
+// its own `bytes`, in 1e9 bytes/s. Copy counts the bytes read and written.
+double timedBandwidth(const std::vector<unsigned>& cpus, size_t bytes, BandwidthOp op, unsigned runMs) {
+    RunState state;
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < cpus.size(); ++k) {
+        threads.push_back(std::thread(runThread, cpus[k], bytes, op, std::ref(state)));
+    }
+    while (state.ready.load() < cpus.size()) std::this_thread::yield();
+    const uint64_t passes = std::max<uint64_t>(1, runMs * 1000000ull / std::max<uint64_t>(1, state.warmupNs.load()));
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    state.passes = passes;
+    for (size_t k = 0; k < threads.size(); ++k) threads[k].join();
+    return static_cast<double>(cpus.size()) * passes * bytes / nsSince(start);
+}
+
+// Small and reproducible; the walk only has to defeat the prefetchers.
+uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Nanoseconds per load of a pointer chase through every cache line of a
+// `bytes` buffer in a single random cycle (Sattolo's shuffle).
+double chaseNs(uint64_t bytes, unsigned runMs) {
+    const size_t lines = static_cast<size_t>(bytes / kLine);
+    std::vector<uint32_t> order(lines);
+    for (size_t k = 0; k < lines; ++k) order[k] = static_cast<uint32_t>(k);
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (size_t k = lines - 1; k > 0; --k) std::swap(order[k], order[xorshift(seed) % k]);
+    ProbeBuffer buf(static_cast<size_t>(bytes));
+    char* base = buf.data();
+    for (size_t k = 0; k < lines; ++k) {
+        *reinterpret_cast<char**>(base + order[k] * kLine) = base + order[(k + 1) % lines] * kLine;
+    }
+
+    char* p = base + order[0] * kLine;
+    for (size_t k = 0; k < lines; ++k) p = *reinterpret_cast<char**>(p); // one lap to settle the caches
+    const uint64_t budgetNs = runMs * 1000000ull;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t loads = 0;
+    double elapsed = 0;
+    do {
+        for (int k = 0; k < 8192; ++k) {
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+            p = *reinterpret_cast<char**>(p);
+        }
+        loads += 8192 * 8;
+        elapsed = nsSince(start);
+    } while (elapsed < budgetNs);
+    g_sink.fetch_xor(reinterpret_cast<uintptr_t>(p), std::memory_order_relaxed);
+    return elapsed / loads;
+}
+
+// What the report says the hardware should do.
+struct Nominal {
+    Nominal() : l2PerCore(0), l3(0), packages(0), dimms(0), peakGBs(0), ramBytes(0) {}
+    uint64_t l2PerCore, l3; // bytes; l3 per package
+    size_t packages;
+    size_t dimms;   // with a reported speed
+    double peakGBs; // their transfer rates times 8 bytes, one DIMM per channel
+    uint64_t ramBytes;
+};
+
+Nominal nominalOf(const ResultSet& cpus, const ResultSet& mems) {
+    Nominal n;
+    n.packages = cpus.rowCount();
+    if (n.packages) {
+        // Win32_Processor reports L2 for the whole package; split it per core.
+        const uint64_t cores = std::max<uint64_t>(1, safeU64(cpus, 0, cpus.column("NumberOfCores")));
+        n.l2PerCore = safeU64(cpus, 0, cpus.column("L2CacheSize")) * 1024 / cores;
+        n.l3 = safeU64(cpus, 0, cpus.column("L3CacheSize")) * 1024;
+    }
+    const int cSpeed = mems.column("Speed"), cCapacity = mems.column("Capacity");
+    for (size_t i = 0; i < mems.rowCount(); ++i) {
+        n.ramBytes += safeU64(mems, i, cCapacity);
+        const uint64_t speed = safeU64(mems, i, cSpeed); // MT/s
+        if (!speed) continue;
+        ++n.dimms;
+        n.peakGBs += speed * 8 / 1000.0;
+    }
+    return n;
+}
+
+uint64_t clampProbeBytes(uint64_t bytes, uint64_t cap) {
+    return std::min(std::max(bytes, kMinProbeBytes), cap) / kMiB * kMiB;
+}
+
+// Tallies judged measurements for the verdict.
+struct Tally {
+    Tally() : checks(0), failures(0) {}
+    unsigned checks, failures;
+};
+
+// "  PASS (min 50 %)" after a measurement.
+void judge(double value, const ProbeLimit& limit, Tally& tally, std::wostream& out) {
+    const bool pass = limit.atMost ? value <= limit.value : value >= limit.value;
+    ++tally.checks;
+    if (!pass) ++tally.failures;
+    out << (pass ? L"  PASS (" : L"  FAIL (") << (limit.atMost ? L"max " : L"min ") << std::defaultfloat
+        << std::setprecision(6) << limit.value << L" " << limit.unit << L")";
+}
+
+std::wostream& label(const std::wstring& text, std::wostream& out) {
+    return out << L"  " << std::left << std::setw(17) << text << std::right << L": ";
+}
+
+std::wstring sizeText(uint64_t bytes) {
+    return bytes < kMiB ? std::to_wstring(static_cast<unsigned long long>(bytes / 1024)) + L" KB"
+                        : std::to_wstring(static_cast<unsigned long long>(bytes / kMiB)) + L" MB";
+}
+
+void printLatency(const Nominal& n, const std::vector<LatencyPoint>& points, const ProbeLimits& limits, Tally& tally,
+                  std::wostream& out) {
+    out << L"\n[Cache Latency Probe]" << std::endl;
+    label(L"Nominal", out);
+    if (n.l2PerCore) out << L"L2 " << n.l2PerCore / 1024 << L" KB per core";
+    if (n.l2PerCore && n.l3) out << L", ";
+    if (n.l3) out << L"L3 " << n.l3 / 1024 << L" KB";
+    if (!n.l2PerCore && !n.l3) out << L"cache sizes not reported";
+    out << std::endl;
+    for (size_t k = 0; k < points.size(); ++k) {
+        const LatencyPoint& p = points[k];
+        label(sizeText(p.bytes) + L" (" + p.level + L")", out) << std::fixed << std::setprecision(1) << p.ns << L" ns";
+        if (std::wcscmp(p.level, L"memory") == 0) judge(p.ns, *limits.find("memory-latency"), tally, out);
+        out << std::endl;
+    }
+}
+
+void printBandwidth(const Nominal& n, const BandwidthProbe& bw, const ProbeLimits& limits, Tally& tally,
+                    std::wostream& out) {
+    out << L"\n[Memory Bandwidth Probe]" << std::endl;
+    label(L"Nominal", out);
+    if (n.dimms) {
+        out << n.dimms << L" DIMMs, " << std::fixed << std::setprecision(2) << n.peakGBs
+            << L" GB/s peak (one DIMM per channel)" << std::endl;
+    } else {
+        out << L"DIMM speeds not reported" << std::endl;
+    }
+    label(L"Kernels", out) << bandwidthKernels().name << L", " << sizeText(bw.bufferBytes) << L" over "
+                           << bw.cpus.size() << L" CPUs" << std::endl;
+    label(L"Read (GB/s)", out) << std::fixed << std::setprecision(2) << bw.readGBs;
+    if (n.dimms) {
+        const double percent = bw.readGBs * 100 / n.peakGBs;
+        out << L" (" << std::setprecision(0) << percent << L" % of peak)";
+        judge(percent, *limits.find("memory-peak"), tally, out);
+    }
+    out << std::endl;
+    label(L"Write (GB/s)", out) << std::fixed << std::setprecision(2) << bw.writeGBs << std::endl;
+    label(L"Copy (GB/s)", out) << std::fixed << std::setprecision(2) << bw.copyGBs << L" (read + write)" << std::endl;
+    if (bw.coreReadGBs.empty()) return;
+
+    std::vector<double> sorted(bw.coreReadGBs);
+    std::sort(sorted.begin(), sorted.end());
+    const double median = sorted[sorted.size() / 2];
+    label(L"Read per CPU", out) << std::fixed << std::setprecision(2) << sorted.front() << L" min, " << median
+                                << L" median, " << sorted.back() << L" max (GB/s)";
+    if (sorted.size() > 1 && median > 0) judge(sorted.front() * 100 / median, *limits.find("core-spread"), tally, out);
+    out << std::endl;
+    for (size_t k = 0; k < bw.coreReadGBs.size(); ++k) {
+        out << L"    CPU " << std::left << std::setw(11) << bw.cpus[k] << std::right << L": " << std::fixed
+            << std::setprecision(2) << bw.coreReadGBs[k] << std::endl;
+    }
+}
+
+bool containsNoCase(const std::wstring& text, const wchar_t* word) {
+    std::wstring lower(text);
+    for (size_t k = 0; k < lower.size(); ++k) lower[k] = std::towlower(lower[k]);
+    return lower.find(word) != std::wstring::npos;
+}
+
+// Whether volume `mount` (a mount point, or "C:") holds `path`.
+bool onVolume(const std::string& path, const std::string& mount) {
+    if (mount.empty() || path.size() < mount.size()) return false;
+#ifdef _WIN32
+    for (size_t k = 0; k < mount.size(); ++k) {
+        if (std::tolower(static_cast<unsigned char>(path[k])) != std::tolower(static_cast<unsigned char>(mount[k]))) return false;
+    }
+#else
+    if (path.compare(0, mount.size(), mount) != 0) return false;
+#endif
+    return path.size() == mount.size() || mount[mount.size() - 1] == '/' || path[mount.size()] == '/' ||
+           path[mount.size()] == '\\';
+}
+
+// Row of the disk drive holding `path`, through the volume with the
+// longest mount point that does; -1 when that volume is on no listed disk.
+int diskRowOf(const std::string& path, const std::vector<ResultSet>& r) {
+    const ResultSet& disks = r[0];
+    const ResultSet& logics = r[2];
+    const int cDeviceId = logics.column("DeviceID");
+    int volume = -1;
+    size_t best = 0;
+    for (size_t l = 0; l < logics.rowCount(); ++l) {
+        const Value& v = logics.at(l, cDeviceId);
+        if (v.type != ValueType::String) continue;
+        const std::string mount(v.s.p, v.s.n);
+        if (mount.size() >= best && onVolume(path, mount)) {
+            volume = static_cast<int>(l);
+            best = mount.size();
+        }
+    }
+    if (volume < 0) return -1;
+    const StorageTopology topo = buildStorageTopology(disks, r[1], r[3], logics);
+    for (size_t d = 0; d < topo.disks.size(); ++d) {
+        for (size_t p = 0; p < topo.disks[d].partitions.size(); ++p) {
+            const std::vector<size_t>& volumes = topo.disks[d].partitions[p].volumes;
+            if (std::find(volumes.begin(), volumes.end(), static_cast<size_t>(volume)) != volumes.end()) {
+                return static_cast<int>(topo.disks[d].row);
+            }
+        }
+    }
+    return -1;
+}
+
+void printDiskProbe(const std::vector<ResultSet>& r, const DiskProbe& disk, const ProbeLimits& limits, Tally& tally,
+                    std::wostream& out) {
+    out << L"\n[Disk Probe]" << std::endl;
+    const ResultSet& disks = r[0];
+    const int row = disk.path.empty() ? -1 : diskRowOf(disk.path, r);
+    bool nvme = false;
+    label(L"Disk", out);
+    if (row >= 0) {
+        const std::wstring model = safeGet(disks, row, disks.column("Model"));
+        const std::wstring bus = safeGet(disks, row, disks.column("InterfaceType"));
+        nvme = containsNoCase(model, L"nvme") || containsNoCase(bus, L"nvme");
+        out << safeGet(disks, row, disks.column("Index")) << L": " << model << L" (" << bus << L", " << std::fixed
+            << std::setprecision(2) << safeU64(disks, row, disks.column("Size")) / (1024.0 * 1024.0 * 1024.0) << L" GB)"
+            << std::endl;
+    } else {
+        out << L"not identified" << std::endl;
+    }
+    if (!disk.path.empty()) {
+        label(L"Test File", out) << utf8ToWide(disk.path.data(), disk.path.size()) << L" (" << sizeText(disk.fileBytes)
+                                 << L", direct I/O)" << std::endl;
+    }
+    if (!disk.error.empty()) {
+        // A disk that can't be read is no healthier than a slow one.
+        ++tally.checks;
+        ++tally.failures;
+        out << L"  Could not run the disk probe: " << utf8ToWide(disk.error.data(), disk.error.size()) << L"  FAIL"
+            << std::endl;
+        return;
+    }
+    label(L"Sequential Read", out) << std::fixed << std::setprecision(1) << disk.seqMBs << L" MB/s";
+    judge(disk.seqMBs, *limits.find(nvme ? "nvme-seq" : "disk-seq"), tally, out);
+    out << std::endl;
+    label(L"Random 4K Read", out) << std::fixed << std::setprecision(0) << disk.randomIops << L" IOPS";
+    judge(disk.randomIops, *limits.find(nvme ? "nvme-iops" : "disk-iops"), tally, out);
+    out << std::endl;
+}
+
+} // namespace
+
+ProbeLimits::ProbeLimits() : limits(kDefaultLimits, kDefaultLimits + sizeof(kDefaultLimits) / sizeof(kDefaultLimits[0])) {}
+
+bool ProbeLimits::set(const char* text) {
+    const char* eq = std::strchr(text, '=');
+    if (!eq) return false;
+    const std::string name(text, eq);
+    char* end = NULL;
+    const double value = std::strtod(eq + 1, &end);
+    if (end == eq + 1 || *end) return false;
+    for (size_t k = 0; k < limits.size(); ++k) {
+        if (name == limits[k].name) {
+            limits[k].value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+const ProbeLimit* ProbeLimits::find(const char* name) const {
+    for (size_t k = 0; k < limits.size(); ++k) {
+        if (std::strcmp(limits[k].name, name) == 0) return &limits[k];
+    }
+    return nullptr;
+}
+
+void probeLatency(const std::vector<uint64_t>& sizes, const std::vector<const wchar_t*>& levels, unsigned runMs,
+                  std::vector<LatencyPoint>& out) {
+    out.clear();
+    const std::vector<unsigned> cpus = probeCpus();
+    // On a thread of its own, so pinning it leaves the caller alone.
+    std::thread([&] {
+        if (!cpus.empty()) pinThreadToCpu(cpus[0]);
+        for (size_t k = 0; k < sizes.size(); ++k) {
+            const LatencyPoint p = { sizes[k], levels[k], chaseNs(sizes[k], runMs) };
+            out.push_back(p);
+        }
+    }).join();
+}
+
+void probeBandwidth(uint64_t allCoreBytes, uint64_t coreBytes, unsigned runMs, BandwidthProbe& out) {
+    out.cpus = probeCpus();
+    if (out.cpus.empty()) out.cpus.push_back(0);
+    out.bufferBytes = allCoreBytes;
+    // Each thread streams its share, so together they still outrun the caches.
+    const size_t share = static_cast<size_t>(std::max<uint64_t>(kMiB, allCoreBytes / out.cpus.size() / 4096 * 4096));
+    out.readGBs = timedBandwidth(out.cpus, share, BandwidthOp::Read, runMs);
+    out.writeGBs = timedBandwidth(out.cpus, share, BandwidthOp::Write, runMs);
+    out.copyGBs = timedBandwidth(out.cpus, share, BandwidthOp::Copy, runMs);
+    out.coreReadGBs.clear();
+    for (size_t k = 0; k < out.cpus.size(); ++k) {
+        out.coreReadGBs.push_back(timedBandwidth(std::vector<unsigned>(1, out.cpus[k]), static_cast<size_t>(coreBytes),
+                                                 BandwidthOp::Read, runMs));
+    }
+}
+
+int runProbe(DataSource& src, unsigned jobs, const CollectLimits& limits, const ProbeOptions& options,
+             std::wostream& out) {
+    std::vector<SectionDef> sections = allSections();
+    std::vector<std::string> ids;
+    ids.push_back("cpu");
+    ids.push_back("memory");
+    ids.push_back("disk");
+    std::string unknown;
+    selectSections(sections, ids, unknown);
+    std::vector<std::vector<ResultSet> > results(sections.size());
+    out << L"Collecting system information, please wait..." << std::endl;
+    collectSections(src, sections, jobs, [&](size_t i, std::vector<ResultSet>& r) { results[i].swap(r); }, limits);
+    if (limits.cancel && *limits.cancel) return 130;
+
+    const Nominal n = nominalOf(results[0][0], results[1][0]);
+    const uint64_t cap = std::max(kMinProbeBytes, std::min(kMaxProbeBytes, n.ramBytes ? n.ramBytes / 4 : kMaxProbeBytes));
+    std::vector<uint64_t> sizes(1, kL1ProbeBytes);
+    std::vector<const wchar_t*> levels(1, L"L1");
+    if (n.l2PerCore / 2 > sizes.back()) {
+        sizes.push_back(n.l2PerCore / 2);
+        levels.push_back(L"L2");
+    }
+    if (n.l3 / 2 > sizes.back()) {
+        sizes.push_back(n.l3 / 2);
+        levels.push_back(L"L3");
+    }
+    const uint64_t memoryBytes = clampProbeBytes(4 * std::max(n.l3, n.l2PerCore), cap);
+    if (memoryBytes > std::max(n.l3, sizes.back())) {
+        sizes.push_back(memoryBytes);
+        levels.push_back(L"memory");
+    }
+
+    out << L"Probing caches, memory and disk, please wait..." << std::endl;
+    std::vector<LatencyPoint> latency;
+    probeLatency(sizes, levels, options.runMs, latency);
+    BandwidthProbe bandwidth;
+    if (!limits.cancel || !*limits.cancel) {
+        const uint64_t l3 = n.l3 ? n.l3 : 64 * kMiB;
+        probeBandwidth(clampProbeBytes(4 * l3 * std::max<size_t>(1, n.packages), cap), clampProbeBytes(2 * l3, cap),
+                       options.runMs, bandwidth);
+    }
+    DiskProbe disk;
+    if (!limits.cancel || !*limits.cancel) probeDisk(options.dir, options.diskBytes, options.runMs, disk);
+    if (limits.cancel && *limits.cancel) return 130;
+
+    Tally tally;
+    printCPUInfo(results[0], out);
+    printLatency(n, latency, options.limits, tally, out);
+    printMemoryInfo(results[1], out);
+    printBandwidth(n, bandwidth, options.limits, tally, out);
+    printDiskInfo(results[2], out);
+    printDiskProbe(results[2], disk, options.limits, tally, out);
+    out << L"\n[Probe Verdict]" << std::endl;
+    label(L"Result", out);
+    if (tally.failures) {
+        out << L"FAIL (" << tally.failures << L" of " << tally.checks << L" checks)" << std::endl;
+    } else {
+        out << L"PASS (" << tally.checks << (tally.checks == 1 ? L" check)" : L" checks)") << std::endl;
+    }
+    return tally.failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+
+// --probe: short self-contained benchmarks of the caches, memory and a
+// disk, printed under the CPU, memory and disk sections they measure and
+// judged against what those sections say the hardware is.
+
+// Streaming kernels over 64-byte aligned buffers whose size is a multiple
+// of 256 bytes. Stores are non-temporal where the instruction set has them,
+// so write and copy measure memory rather than the caches.
+struct BandwidthKernels {
+    const wchar_t* name;                            // "AVX2", "SSE2" or "scalar"
+    uint64_t (*read)(const void* p, size_t bytes);  // folds every word, so no load is dropped
+    void (*write)(void* p, size_t bytes);
+    void (*copy)(void* dst, const void* src, size_t bytes);
+};
+
+// The widest kernels this CPU and OS support, picked at the first call.
+const BandwidthKernels& bandwidthKernels();
+
+// A --probe-limit: a threshold a measurement passes or fails.
+struct ProbeLimit {
+    const char* name;
+    double value;
+    bool atMost; // pass when the measurement is <= value, else >= value
+    const wchar_t* unit;
+};
+
+// The thresholds, defaults first, then whatever --probe-limit changed.
+struct ProbeLimits {
+    ProbeLimits();
+    // Parses "<name>=<value>"; false for an unknown name or a bad value.
+    bool set(const char* text);
+    const ProbeLimit* find(const char* name) const;
+
+    std::vector<ProbeLimit> limits;
+};
+
+struct ProbeOptions {
+    std::string dir;     // where the disk test file goes; empty: the temp directory
+    uint64_t diskBytes;  // size of that file
+    unsigned runMs;      // target length of one timed run
+    ProbeLimits limits;
+    ProbeOptions() : diskBytes(256ull << 20), runMs(200) {}
+};
+
+// Dependent loads over a random cyclic walk of cache lines.
+struct LatencyPoint {
+    uint64_t bytes;       // working set
+    const wchar_t* level; // what it was sized to fit: "L1", "L2", "L3", "memory"
+    double ns;            // per load
+};
+
+struct BandwidthProbe {
+    BandwidthProbe() : bufferBytes(0), readGBs(0), writeGBs(0), copyGBs(0) {}
+    uint64_t bufferBytes;              // all-core, over all threads
+    std::vector<unsigned> cpus;        // logical CPUs this process may run on
+    double readGBs, writeGBs, copyGBs; // one thread per CPU in `cpus`, 1e9 bytes/s
+    std::vector<double> coreReadGBs;   // one pinned thread at a time, per entry of `cpus`
+};
+
+struct DiskProbe {
+    DiskProbe() : fileBytes(0), seqMBs(0), randomIops(0) {}
+    std::string path;  // test file, absolute, UTF-8
+    std::string error; // why it didn't run; empty when it did
+    uint64_t fileBytes;
+    double seqMBs;     // 1 MiB reads, 1e6 bytes/s
+    double randomIops; // 4 KiB reads at random offsets, one at a time
+};
+
+// Latency at each working set of `sizes`, paired with `levels`.
+void probeLatency(const std::vector<uint64_t>& sizes, const std::vector<const wchar_t*>& levels, unsigned runMs,
+                  std::vector<LatencyPoint>& out);
+
+// All-core read, write and copy bandwidth with the threads' buffers adding
+// up to `allCoreBytes`, then read bandwidth of each CPU on its own over
+// `coreBytes`. Every thread is pinned and touches its buffer first.
+void probeBandwidth(uint64_t allCoreBytes, uint64_t coreBytes, unsigned runMs, BandwidthProbe& out);
+
+// Platform parts (probe_linux.cpp, probe_win.cpp).
+
+// Logical CPUs the process is allowed on, ascending.
+std::vector<unsigned> probeCpus();
+
+// Binds the calling thread to one logical CPU; false if it can't.
+bool pinThreadToCpu(unsigned cpu);
+
+// Page-aligned memory straight from the OS, not yet touched, so the first
+// thread to write a page decides its NUMA node. Linux backs it with huge
+// pages where it can, which keeps TLB misses out of the latency walk.
+// Null when out of memory.
+void* allocateProbeMemory(size_t bytes);
+void freeProbeMemory(void* p, size_t bytes);
+
+// Writes a `bytes` test file of incompressible data in `dir` with direct
+// (uncached) I/O, reads it back sequentially and at random, and deletes
+// it. Fails on file systems without direct I/O, and on tmpfs, which would
+// only measure memory.
+void probeDisk(const std::string& dir, uint64_t bytes, unsigned runMs, DiskProbe& out);
+
+// Collects the cpu, memory and disk sections, runs every probe and prints
+// each section with its results. Returns 0 when every judged measurement
+// passes, 1 when any fails and 130 when `limits` cancel the run.
+int runProbe(DataSource& src, unsigned jobs, const CollectLimits& limits, const ProbeOptions& options,
+             std::wostream& out);
@@ -0,0 +1,170 @@
+#include "probe.h"
+
+#include "x86_cpuid.h"
+#ifdef SYSINFO_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang compile a function for an instruction set the rest of the
+// file doesn't assume only when told to; MSVC takes the intrinsics as is.
+#if defined(SYSINFO_X86) && !defined(_MSC_VER)
+#define SYSINFO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SYSINFO_TARGET(isa)
+#endif
+
+namespace {
+
+uint64_t readScalar(const void* p, size_t bytes) {
+    const uint64_t* w = static_cast<const uint64_t*>(p);
+    uint64_t a = 0, b = 0, c = 0, d = 0;
+    for (size_t k = 0; k < bytes / 8; k += 4) {
+        a ^= w[k];
+        b ^= w[k + 1];
+        c ^= w[k + 2];
+        d ^= w[k + 3];
+    }
+    return a ^ b ^ c ^ d;
+}
+
+void writeScalar(void* p, size_t bytes) {
+    uint64_t* w = static_cast<uint64_t*>(p);
+    for (size_t k = 0; k < bytes / 8; ++k) w[k] = k;
+}
+
+void copyScalar(void* dst, const void* src, size_t bytes) {
+    const uint64_t* s = static_cast<const uint64_t*>(src);
+    uint64_t* d = static_cast<uint64_t*>(dst);
+    for (size_t k = 0; k < bytes / 8; ++k) d[k] = s[k];
+}
+
+#ifdef SYSINFO_X86
+
+SYSINFO_TARGET("sse2") uint64_t readSse2(const void* p, size_t bytes) {
+    const __m128i* v = static_cast<const __m128i*>(p);
+    __m128i a = _mm_setzero_si128(), b = a, c = a, d = a;
+    for (size_t k = 0; k < bytes / 16; k += 4) {
+        a = _mm_xor_si128(a, _mm_load_si128(v + k));
+        b = _mm_xor_si128(b, _mm_load_si128(v + k + 1));
+        c = _mm_xor_si128(c, _mm_load_si128(v + k + 2));
+        d = _mm_xor_si128(d, _mm_load_si128(v + k + 3));
+    }
+    a = _mm_xor_si128(_mm_xor_si128(a, b), _mm_xor_si128(c, d));
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), a);
+    return lanes[0] ^ lanes[1];
+}
+
+SYSINFO_TARGET("sse2") void writeSse2(void* p, size_t bytes) {
+    __m128i* v = static_cast<__m128i*>(p);
+    const __m128i x = _mm_set1_epi32(0x5A5A5A5A);
+    for (size_t k = 0; k < bytes / 16; k += 4) {
+        _mm_stream_si128(v + k, x);
+        _mm_stream_si128(v + k + 1, x);
+        _mm_stream_si128(v + k + 2, x);
+        _mm_stream_si128(v + k + 3, x);
+    }
+    _mm_sfence();
+}
+
+SYSINFO_TARGET("sse2") void copySse2(void* dst, const void* src, size_t bytes) {
+    const __m128i* s = static_cast<const __m128i*>(src);
+    __m128i* d = static_cast<__m128i*>(dst);
+    for (size_t k = 0; k < bytes / 16; k += 4) {
+        const __m128i a = _mm_load_si128(s + k), b = _mm_load_si128(s + k + 1);
+        const __m128i c = _mm_load_si128(s + k + 2), e = _mm_load_si128(s + k + 3);
+        _mm_stream_si128(d + k, a);
+        _mm_stream_si128(d + k + 1, b);
+        _mm_stream_si128(d + k + 2, c);
+        _mm_stream_si128(d + k + 3, e);
+    }
+    _mm_sfence();
+}
+
+SYSINFO_TARGET("avx2") uint64_t readAvx2(const void* p, size_t bytes) {
+    const __m256i* v = static_cast<const __m256i*>(p);
+    __m256i a = _mm256_setzero_si256(), b = a, c = a, d = a;
+    for (size_t k = 0; k < bytes / 32; k += 4) {
+        a = _mm256_xor_si256(a, _mm256_load_si256(v + k));
+        b = _mm256_xor_si256(b, _mm256_load_si256(v + k + 1));
+        c = _mm256_xor_si256(c, _mm256_load_si256(v + k + 2));
+        d = _mm256_xor_si256(d, _mm256_load_si256(v + k + 3));
+    }
+    a = _mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d));
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), a);
+    return lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3];
+}
+
+SYSINFO_TARGET("avx2") void writeAvx2(void* p, size_t bytes) {
+    __m256i* v = static_cast<__m256i*>(p);
+    const __m256i x = _mm256_set1_epi32(0x5A5A5A5A);
+    for (size_t k = 0; k < bytes / 32; k += 4) {
+        _mm256_stream_si256(v + k, x);
+        _mm256_stream_si256(v + k + 1, x);
+        _mm256_stream_si256(v + k + 2, x);
+        _mm256_stream_si256(v + k + 3, x);
+    }
+    _mm_sfence();
+}
+
+SYSINFO_TARGET("avx2") void copyAvx2(void* dst, const void* src, size_t bytes) {
+    const __m256i* s = static_cast<const __m256i*>(src);
+    __m256i* d = static_cast<__m256i*>(dst);
+    for (size_t k = 0; k < bytes / 32; k += 4) {
+        const __m256i a = _mm256_load_si256(s + k), b = _mm256_load_si256(s + k + 1);
+        const __m256i c = _mm256_load_si256(s + k + 2), e = _mm256_load_si256(s + k + 3);
+        _mm256_stream_si256(d + k, a);
+        _mm256_stream_si256(d + k + 1, b);
+        _mm256_stream_si256(d + k + 2, c);
+        _mm256_stream_si256(d + k + 3, e);
+    }
+    _mm_sfence();
+}
+
+// AVX2 needs the instructions (leaf 7 EBX bit 5) and an OS that saves the
+// YMM registers on a context switch (OSXSAVE, then XCR0 bits 1 and 2).
+bool hasAvx2() {
+    unsigned r[4];
+    cpuid(0, 0, r);
+    if (r[0] < 7) return false;
+    cpuid(1, 0, r);
+    const bool osxsave = (r[2] & (1u << 27)) != 0, avx = (r[2] & (1u << 28)) != 0;
+    if (!osxsave || !avx || (enabledXsaveFeatures() & 6) != 6) return false;
+    cpuid(7, 0, r);
+    return (r[1] & (1u << 5)) != 0;
+}
+
+bool hasSse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#else
+    unsigned r[4];
+    cpuid(1, 0, r);
+    return (r[3] & (1u << 26)) != 0;
+#endif
+}
+
+#endif // SYSINFO_X86
+
+BandwidthKernels pickKernels() {
+#ifdef SYSINFO_X86
+    if (hasAvx2()) {
+        const BandwidthKernels k = { L"AVX2", readAvx2, writeAvx2, copyAvx2 };
+        return k;
+    }
+    if (hasSse2()) {
+        const BandwidthKernels k = { L"SSE2", readSse2, writeSse2, copySse2 };
+        return k;
+    }
+#endif
+    const BandwidthKernels k = { L"scalar", readScalar, writeScalar, copyScalar };
+    return k;
+}
+
+} // namespace
+
+const BandwidthKernels& bandwidthKernels() {
+    static const BandwidthKernels kernels = pickKernels();
+    return kernels;
+}
@@ -0,0 +1,166 @@
+#include "probe.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/statfs.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+const size_t kBlock = 1 << 20;  // sequential reads and the writes
+const size_t kPage = 4096;      // random reads; covers every logical block size
+
+// statfs() f_type of the file systems that live in memory.
+const long kTmpfsMagic = 0x01021994;
+const long kRamfsMagic = 0x858458f6;
+
+std::string errorText(const char* what) {
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+double nsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// The probe itself, on an open file already switched to O_DIRECT.
+void directReads(int fd, void* block, uint64_t bytes, unsigned runMs, DiskProbe& out) {
+    // Random words, so compressing or deduplicating storage has to store it all.
+    uint64_t seed = 0x2545F4914F6CDD1Dull;
+    uint64_t* words = static_cast<uint64_t*>(block);
+    for (size_t k = 0; k < kBlock / 8; ++k) words[k] = xorshift(seed);
+    for (uint64_t off = 0; off < bytes; off += kBlock) {
+        words[0] = off;
+        if (pwrite(fd, block, kBlock, static_cast<off_t>(off)) != static_cast<ssize_t>(kBlock)) {
+            out.error = errno == EINVAL ? "the file system does not support direct I/O" : errorText("write");
+            return;
+        }
+    }
+    if (fdatasync(fd) != 0) {
+        out.error = errorText("fdatasync");
+        return;
+    }
+
+    const double budgetNs = runMs * 1e6;
+    uint64_t read = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    do {
+        for (uint64_t off = 0; off < bytes; off += kBlock, read += kBlock) {
+            if (pread(fd, block, kBlock, static_cast<off_t>(off)) != static_cast<ssize_t>(kBlock)) {
+                out.error = errorText("read");
+                return;
+            }
+        }
+    } while (nsSince(start) < budgetNs);
+    out.seqMBs = read * 1e3 / nsSince(start);
+
+    const uint64_t pages = bytes / kPage;
+    uint64_t reads = 0;
+    start = std::chrono::steady_clock::now();
+    do {
+        for (int k = 0; k < 16; ++k, ++reads) {
+            const off_t off = static_cast<off_t>(xorshift(seed) % pages * kPage);
+            if (pread(fd, block, kPage, off) != static_cast<ssize_t>(kPage)) {
+                out.error = errorText("read");
+                return;
+            }
+        }
+    } while (nsSince(start) < budgetNs);
+    out.randomIops = reads * 1e9 / nsSince(start);
+}
+
+} // namespace
+
+std::vector<unsigned> probeCpus() {
+    std::vector<unsigned> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (unsigned k = 0; k < CPU_SETSIZE; ++k) {
+            if (CPU_ISSET(k, &set)) cpus.push_back(k);
+        }
+    }
+    if (cpus.empty()) {
+        for (unsigned k = 0; k < std::max(1u, std::thread::hardware_concurrency()); ++k) cpus.push_back(k);
+    }
+    return cpus;
+}
+
+bool pinThreadToCpu(unsigned cpu) {
+    if (cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+void* allocateProbeMemory(size_t bytes) {
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE); // a hint; ignored where THP is off
+#endif
+    return p;
+}
+
+void freeProbeMemory(void* p, size_t bytes) {
+    if (p) munmap(p, bytes);
+}
+
+void probeDisk(const std::string& dir, uint64_t bytes, unsigned runMs, DiskProbe& out) {
+    // /tmp is often tmpfs, which has no direct I/O; /var/tmp is on a disk.
+    const std::string base = dir.empty() ? std::string("/var/tmp") : dir;
+    char real[PATH_MAX];
+    if (!realpath(base.c_str(), real)) {
+        out.error = errorText(base.c_str());
+        return;
+    }
+    std::string path = std::string(real) + (real[1] ? "/" : "") + "sysinfo-probe-XXXXXX";
+    const int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        out.error = errorText(path.c_str());
+        return;
+    }
+    unlink(path.c_str()); // gone whenever we stop, even on a crash
+    out.path = path;
+
+    struct statvfs fs;
+    if (fstatvfs(fd, &fs) == 0) bytes = std::min<uint64_t>(bytes, static_cast<uint64_t>(fs.f_bavail) * fs.f_frsize / 4);
+    bytes = bytes / kBlock * kBlock;
+    out.fileBytes = bytes;
+    struct statfs type;
+    const bool inMemory = fstatfs(fd, &type) == 0 && (type.f_type == kTmpfsMagic || type.f_type == kRamfsMagic);
+    void* block = nullptr;
+    if (inMemory) {
+        out.error = "the directory is on a file system in memory, not on a disk";
+    } else if (bytes < 16 * kBlock) {
+        out.error = "not enough free space";
+    } else if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) != 0) {
+        out.error = "the file system does not support direct I/O";
+    } else if (posix_memalign(&block, kPage, kBlock) != 0) {
+        out.error = "out of memory";
+        block = nullptr;
+    } else {
+        directReads(fd, block, bytes, runMs, out);
+    }
+    free(block);
+    close(fd);
+}
@@ -0,0 +1,181 @@
+#define NOMINMAX
+#include <windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "probe.h"
+
+namespace {
+
+const DWORD kBlock = 1 << 20; // sequential reads and the writes
+const DWORD kPage = 4096;     // random reads; covers every sector size
+
+std::string narrow(const wchar_t* s) {
+    const int len = WideCharToMultiByte(CP_UTF8, 0, s, -1, NULL, 0, NULL, NULL);
+    std::string out(len > 1 ? len - 1 : 0, '\0');
+    if (len > 1) WideCharToMultiByte(CP_UTF8, 0, s, -1, &out[0], len, NULL, NULL);
+    return out;
+}
+
+std::wstring widen(const std::string& s) {
+    const int len = MultiByteToWideChar(CP_UTF8, 0, s.data(), static_cast<int>(s.size()), NULL, 0);
+    std::wstring out(len > 0 ? len : 0, L'\0');
+    if (len > 0) MultiByteToWideChar(CP_UTF8, 0, s.data(), static_cast<int>(s.size()), &out[0], len);
+    return out;
+}
+
+std::string errorText(const char* what) {
+    wchar_t* text = NULL;
+    const DWORD err = GetLastError();
+    FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, err,
+                   0, reinterpret_cast<wchar_t*>(&text), 0, NULL);
+    std::string out = std::string(what) + ": " + (text ? narrow(text) : "error " + std::to_string(err));
+    if (text) LocalFree(text);
+    while (!out.empty() && (out.back() == '\n' || out.back() == '\r' || out.back() == ' ')) out.pop_back();
+    return out;
+}
+
+double nsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+uint64_t xorshift(uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+bool readAt(HANDLE file, void* buf, DWORD bytes, uint64_t off) {
+    OVERLAPPED at = {};
+    at.Offset = static_cast<DWORD>(off);
+    at.OffsetHigh = static_cast<DWORD>(off >> 32);
+    DWORD got = 0;
+    return ReadFile(file, buf, bytes, &got, &at) && got == bytes;
+}
+
+// The probe itself, on a file opened without buffering.
+void directReads(HANDLE file, void* block, uint64_t bytes, unsigned runMs, DiskProbe& out) {
+    // Random words, so compressing or deduplicating storage has to store it all.
+    uint64_t seed = 0x2545F4914F6CDD1Dull;
+    uint64_t* words = static_cast<uint64_t*>(block);
+    for (size_t k = 0; k < kBlock / 8; ++k) words[k] = xorshift(seed);
+    for (uint64_t off = 0; off < bytes; off += kBlock) {
+        words[0] = off;
+        DWORD wrote = 0;
+        if (!WriteFile(file, block, kBlock, &wrote, NULL) || wrote != kBlock) {
+            out.error = errorText("write");
+            return;
+        }
+    }
+    if (!FlushFileBuffers(file)) {
+        out.error = errorText("flush");
+        return;
+    }
+
+    const double budgetNs = runMs * 1e6;
+    uint64_t read = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    do {
+        for (uint64_t off = 0; off < bytes; off += kBlock, read += kBlock) {
+            if (!readAt(file, block, kBlock, off)) {
+                out.error = errorText("read");
+                return;
+            }
+        }
+    } while (nsSince(start) < budgetNs);
+    out.seqMBs = read * 1e3 / nsSince(start);
+
+    const uint64_t pages = bytes / kPage;
+    uint64_t reads = 0;
+    start = std::chrono::steady_clock::now();
+    do {
+        for (int k = 0; k < 16; ++k, ++reads) {
+            if (!readAt(file, block, kPage, xorshift(seed) % pages * kPage)) {
+                out.error = errorText("read");
+                return;
+            }
+        }
+    } while (nsSince(start) < budgetNs);
+    out.randomIops = reads * 1e9 / nsSince(start);
+}
+
+} // namespace
+
+// CPUs of the process's processor group; on machines with more than 64,
+// Windows keeps a process to one group unless it asks otherwise.
+std::vector<unsigned> probeCpus() {
+    std::vector<unsigned> cpus;
+    DWORD_PTR process = 0, system = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) {
+        for (unsigned k = 0; k < sizeof(DWORD_PTR) * 8; ++k) {
+            if (process & (DWORD_PTR(1) << k)) cpus.push_back(k);
+        }
+    }
+    if (cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+bool pinThreadToCpu(unsigned cpu) {
+    if (cpu >= sizeof(DWORD_PTR) * 8) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+}
+
+// Large pages need SeLockMemoryPrivilege, which hardly any account has.
+void* allocateProbeMemory(size_t bytes) {
+    return VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+void freeProbeMemory(void* p, size_t) {
+    if (p) VirtualFree(p, 0, MEM_RELEASE);
+}
+
+void probeDisk(const std::string& dir, uint64_t bytes, unsigned runMs, DiskProbe& out) {
+    wchar_t base[MAX_PATH + 1], full[MAX_PATH + 1], name[MAX_PATH + 1];
+    if (dir.empty()) {
+        if (!GetTempPathW(MAX_PATH + 1, base)) {
+            out.error = errorText("temp directory");
+            return;
+        }
+    } else {
+        const std::wstring wide = widen(dir);
+        if (wide.size() > MAX_PATH) {
+            out.error = dir + ": path too long";
+            return;
+        }
+        std::copy(wide.begin(), wide.end(), base);
+        base[wide.size()] = L'\0';
+    }
+    if (!GetFullPathNameW(base, MAX_PATH + 1, full, NULL) || !GetTempFileNameW(full, L"sip", 0, name)) {
+        out.error = errorText(dir.empty() ? "temp directory" : dir.c_str());
+        return;
+    }
+    out.path = narrow(name);
+    // Deleted on close, which also covers the process dying.
+    const HANDLE file = CreateFileW(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                    FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        out.error = errorText(out.path.c_str());
+        DeleteFileW(name);
+        return;
+    }
+
+    ULARGE_INTEGER freeBytes;
+    if (GetDiskFreeSpaceExW(full, &freeBytes, NULL, NULL)) bytes = std::min<uint64_t>(bytes, freeBytes.QuadPart / 4);
+    bytes = bytes / kBlock * kBlock;
+    out.fileBytes = bytes;
+    void* block = NULL;
+    if (bytes < 16 * kBlock) {
+        out.error = "not enough free space";
+    } else if (!(block = VirtualAlloc(NULL, kBlock, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))) {
+        out.error = "out of memory";
+    } else {
+        directReads(file, block, bytes, runMs, out);
+    }
+    if (block) VirtualFree(block, 0, MEM_RELEASE);
+    CloseHandle(file);
+}
@@ -0,0 +1,134 @@
+#include "processes.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "profile.h"
+
+namespace {
+
+enum ProcessColumn { ProcessId, ParentProcessId, Name, WorkingSetSize, UserModeTime, KernelModeTime, ThreadCount, Owner, kColumnCount };
+
+const char* const kColumnNames[kColumnCount] = {
+    "ProcessId", "ParentProcessId", "Name", "WorkingSetSize", "UserModeTime", "KernelModeTime", "ThreadCount", "Owner",
+};
+
+typedef std::pair<uint64_t, size_t> Ranked; // value, row
+
+// Larger value first, then the earlier row (lower pid).
+bool ranksBefore(const Ranked& a, const Ranked& b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+}
+
+// The `top` best ranked items of a stream, in a heap of at most `top`
+// entries with the worst on top: an item that doesn't beat it costs one
+// comparison.
+class TopN {
+public:
+    explicit TopN(size_t top) : m_top(top) { m_heap.reserve(top); }
+
+    void offer(uint64_t value, size_t row) {
+        if (!m_top) return;
+        const Ranked item(value, row);
+        if (m_heap.size() < m_top) {
+            m_heap.push_back(item);
+            std::push_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+        } else if (ranksBefore(item, m_heap.front())) {
+            std::pop_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+            m_heap.back() = item;
+            std::push_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+        }
+    }
+
+    // Rows, largest value first.
+    std::vector<size_t> rows() {
+        std::sort_heap(m_heap.begin(), m_heap.end(), ranksBefore);
+        std::vector<size_t> rows(m_heap.size());
+        for (size_t k = 0; k < m_heap.size(); ++k) rows[k] = m_heap[k].second;
+        return rows;
+    }
+
+private:
+    size_t m_top;
+    std::vector<Ranked> m_heap;
+};
+
+} // namespace
+
+ResultSet queryProcesses(const std::wstring& wql, const std::string& procRoot, const QueryBudget& budget) {
+    ResultSet rs;
+    int slot[kColumnCount];
+    std::fill(slot, slot + kColumnCount, -1);
+    const std::vector<std::wstring> cols = wqlColumns(wql);
+    for (size_t c = 0; c < (cols.empty() ? size_t(kColumnCount) : cols.size()); ++c) {
+        const std::string name = cols.empty() ? kColumnNames[c] : std::string(cols[c].begin(), cols[c].end()); // ASCII
+        const int col = rs.addColumn(name);
+        for (int k = 0; k < kColumnCount; ++k) {
+            if (name == kColumnNames[k]) slot[k] = col;
+        }
+    }
+
+    ProcessSnapshot snap;
+    snapshotProcesses(procRoot, slot[Owner] >= 0, budget, snap);
+    for (size_t k = 0; k < snap.processes.size(); ++k) {
+        const ProcessRecord& p = snap.processes[k];
+        if (k == 0) profileFirstRow();
+        rs.addRow();
+        if (slot[ProcessId] >= 0) rs.setUint(slot[ProcessId], p.pid);
+        if (slot[ParentProcessId] >= 0) rs.setUint(slot[ParentProcessId], p.parentPid);
+        if (slot[Name] >= 0) rs.setString(slot[Name], p.name.data(), p.name.size());
+        if (slot[WorkingSetSize] >= 0) rs.setUint(slot[WorkingSetSize], p.workingSet);
+        if (slot[UserModeTime] >= 0) rs.setUint(slot[UserModeTime], p.userTime);
+        if (slot[KernelModeTime] >= 0) rs.setUint(slot[KernelModeTime], p.kernelTime);
+        if (slot[ThreadCount] >= 0) rs.setUint(slot[ThreadCount], p.threads);
+        if (slot[Owner] >= 0 && p.owner != kNoOwner) {
+            const std::string& owner = snap.owners[p.owner];
+            rs.setString(slot[Owner], owner.data(), owner.size());
+        }
+    }
+    rs.setStatus(snap.status);
+    return rs;
+}
+
+void summarizeProcesses(const ResultSet& rs, size_t top, ProcessSummary& out) {
+    const int cWorkingSet = rs.column("WorkingSetSize"), cUser = rs.column("UserModeTime");
+    const int cKernel = rs.column("KernelModeTime"), cThreads = rs.column("ThreadCount"), cOwner = rs.column("Owner");
+    out.processes = rs.rowCount();
+    out.threads = 0;
+    out.workingSet = 0;
+    out.users.clear();
+
+    TopN byMemory(top), byCpu(top);
+    std::unordered_map<std::string, size_t> userIndex;
+    std::string owner;
+    for (size_t r = 0; r < rs.rowCount(); ++r) {
+        const uint64_t workingSet = rs.at(r, cWorkingSet).asUint();
+        const uint64_t cpu = rs.at(r, cUser).asUint() + rs.at(r, cKernel).asUint();
+        const uint64_t threads = rs.at(r, cThreads).asUint();
+        out.threads += threads;
+        out.workingSet += workingSet;
+        byMemory.offer(workingSet, r);
+        byCpu.offer(cpu, r);
+
+        const Value& v = rs.at(r, cOwner);
+        if (v.type == ValueType::String) owner.assign(v.s.p, v.s.n);
+        else owner.clear();
+        std::unordered_map<std::string, size_t>::iterator it = userIndex.find(owner);
+        if (it == userIndex.end()) {
+            it = userIndex.insert(std::make_pair(owner, out.users.size())).first;
+            const UserRollup fresh = { owner, 0, 0, 0, 0 };
+            out.users.push_back(fresh);
+        }
+        UserRollup& user = out.users[it->second];
+        ++user.processes;
+        user.threads += threads;
+        user.workingSet += workingSet;
+        user.cpuTime += cpu;
+    }
+    out.topMemory = byMemory.rows();
+    out.topCpu = byCpu.rows();
+    std::sort(out.users.begin(), out.users.end(), [](const UserRollup& a, const UserRollup& b) {
+        return a.workingSet != b.workingSet ? a.workingSet > b.workingSet : a.user < b.user;
+    });
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "datasource.h"
+
+// The process list: a native snapshot answered as Win32_Process rows, and
+// the top-N and per-user view the report and the exporter show of it.
+
+// One process, in Win32_Process units.
+struct ProcessRecord {
+    uint32_t pid;
+    uint32_t parentPid;
+    uint32_t threads;
+    uint32_t owner;      // index into ProcessSnapshot::owners, or kNoOwner
+    uint64_t workingSet; // bytes
+    uint64_t userTime;   // 100 ns
+    uint64_t kernelTime; // 100 ns
+    std::string name;
+};
+
+const uint32_t kNoOwner = 0xFFFFFFFF;
+
+struct ProcessSnapshot {
+    ProcessSnapshot() : status(QueryStatus::Complete) {}
+    std::vector<ProcessRecord> processes; // by pid
+    std::vector<std::string> owners;      // "user" or "DOMAIN\user", UTF-8
+    QueryStatus status;
+};
+
+// Reads every process once. Linux scans `procRoot` (normally "/proc") on
+// several threads, one pread of <pid>/stat each; Windows takes a single
+// NtQuerySystemInformation snapshot and ignores `procRoot`. Owners are
+// looked up only with `owners`, once per distinct user. Processes that
+// exit during the scan are left out.
+void snapshotProcesses(const std::string& procRoot, bool owners, const QueryBudget& budget, ProcessSnapshot& out);
+
+// Answers "SELECT ... FROM Win32_Process" from a snapshot, with WMI's
+// column names and units. Owner (what Win32_Process::GetOwner() returns,
+// not a WMI property) is available too.
+ResultSet queryProcesses(const std::wstring& wql, const std::string& procRoot, const QueryBudget& budget);
+
+const size_t kTopProcesses = 10;
+
+struct UserRollup {
+    std::string user; // empty when not known
+    uint64_t processes;
+    uint64_t threads;
+    uint64_t workingSet;
+    uint64_t cpuTime; // 100 ns
+};
+
+struct ProcessSummary {
+    size_t processes;
+    uint64_t threads;
+    uint64_t workingSet;
+    std::vector<size_t> topMemory; // rows, largest working set first
+    std::vector<size_t> topCpu;    // rows, most CPU time first
+    std::vector<UserRollup> users; // largest working set first
+};
+
+// Totals, the `top` largest processes by working set and by CPU time
+// (bounded heaps, so O(rows log top)) and per-user rollups of a
+// Win32_Process result. Missing columns count as zero.
+void summarizeProcesses(const ResultSet& rs, size_t top, ProcessSummary& out);
@@ -0,0 +1,186 @@
+#include "processes.h"
+
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// Pids per scanning thread; below this a second thread costs more than it
+// saves.
+const size_t kPidsPerThread = 4096;
+const unsigned kMaxScanThreads = 16;
+
+// struct linux_dirent64, which glibc doesn't declare.
+struct LinuxDirent64 {
+    uint64_t ino;
+    int64_t off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+};
+
+// The numeric entries of a /proc directory, sorted. getdents64 hands over
+// a buffer of entries per system call where readdir() takes one call per
+// entry to get at them.
+bool listPids(int dirfd, std::vector<uint32_t>& pids) {
+    std::vector<char> buf(64 * 1024);
+    for (;;) {
+        const long n = syscall(SYS_getdents64, dirfd, &buf[0], buf.size());
+        if (n < 0) return false;
+        if (n == 0) break;
+        for (long off = 0; off < n;) {
+            const LinuxDirent64* d = reinterpret_cast<const LinuxDirent64*>(&buf[off]);
+            off += d->reclen;
+            uint64_t pid = 0;
+            const char* s = d->name;
+            for (; *s >= '0' && *s <= '9' && pid <= 0xFFFFFFFFu; ++s) pid = pid * 10 + static_cast<unsigned>(*s - '0');
+            if (s != d->name && !*s && pid <= 0xFFFFFFFFu) pids.push_back(static_cast<uint32_t>(pid));
+        }
+    }
+    std::sort(pids.begin(), pids.end());
+    return true;
+}
+
+struct StatUnits {
+    uint64_t ticksPerSecond;
+    uint64_t pageSize;
+};
+
+// "pid (comm) state ppid pgrp ... utime stime ... num_threads ... rss ...".
+// comm may hold spaces and parentheses, so it ends at the last ')'.
+bool parseStat(const char* p, size_t n, const StatUnits& units, ProcessRecord& rec) {
+    const char* open = static_cast<const char*>(std::memchr(p, '(', n));
+    const char* close = p + n;
+    while (close > p && close[-1] != ')') --close;
+    if (!open || close <= open + 1) return false;
+    rec.name.assign(open + 1, close - 1);
+
+    // Fields after the name, from 0 = state: 1 ppid, 11 utime, 12 stime,
+    // 17 num_threads, 21 rss (pages).
+    uint64_t field[22] = {};
+    const char* s = close;
+    const char* end = p + n;
+    for (int k = 0; k < 22; ++k) {
+        while (s < end && *s == ' ') ++s;
+        if (s == end) return false;
+        uint64_t v = 0;
+        for (; s < end && *s >= '0' && *s <= '9'; ++s) v = v * 10 + static_cast<unsigned>(*s - '0');
+        while (s < end && *s != ' ') ++s; // state letter, negative values
+        field[k] = v;
+    }
+    rec.parentPid = static_cast<uint32_t>(field[1]);
+    rec.userTime = field[11] * 10000000 / units.ticksPerSecond;
+    rec.kernelTime = field[12] * 10000000 / units.ticksPerSecond;
+    rec.threads = static_cast<uint32_t>(field[17]);
+    rec.workingSet = field[21] * units.pageSize;
+    return true;
+}
+
+// What one scanning thread found. `owner` holds the uid until
+// snapshotProcesses() replaces it with an owner index.
+struct ScanShard {
+    ScanShard() : status(QueryStatus::Complete) {}
+    std::vector<ProcessRecord> processes;
+    QueryStatus status;
+};
+
+// Reads the processes of one run of pids: one open and one pread of
+// <pid>/stat each, into a buffer reused across them.
+void scanPids(int procFd, const uint32_t* pids, size_t count, bool owners, const StatUnits& units,
+              const QueryBudget& budget, ScanShard& shard) {
+    char path[32];
+    char buf[1024];
+    shard.processes.reserve(count);
+    ProcessRecord rec;
+    for (size_t k = 0; k < count; ++k) {
+        if ((k & 255) == 0 && (shard.status = budget.check()) != QueryStatus::Complete) return;
+        std::snprintf(path, sizeof(path), "%u/stat", pids[k]);
+        const int fd = openat(procFd, path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue; // exited since the listing
+        const ssize_t n = pread(fd, buf, sizeof(buf), 0);
+        close(fd);
+        if (n <= 0 || !parseStat(buf, static_cast<size_t>(n), units, rec)) continue;
+        rec.pid = pids[k];
+        rec.owner = kNoOwner;
+        if (owners) {
+            struct stat st;
+            std::snprintf(path, sizeof(path), "%u", pids[k]);
+            if (fstatat(procFd, path, &st, 0) == 0) rec.owner = static_cast<uint32_t>(st.st_uid);
+        }
+        shard.processes.push_back(rec);
+    }
+}
+
+std::string userName(uid_t uid) {
+    struct passwd pw;
+    struct passwd* found = nullptr;
+    char buf[1024];
+    if (getpwuid_r(uid, &pw, buf, sizeof(buf), &found) == 0 && found) return found->pw_name;
+    return std::to_string(static_cast<unsigned long long>(uid));
+}
+
+} // namespace
+
+void snapshotProcesses(const std::string& procRoot, bool owners, const QueryBudget& budget, ProcessSnapshot& out) {
+    out.processes.clear();
+    out.owners.clear();
+    out.status = QueryStatus::Complete;
+    const int procFd = open(procRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd < 0) return;
+    std::vector<uint32_t> pids;
+    listPids(procFd, pids);
+
+    StatUnits units;
+    const long ticks = sysconf(_SC_CLK_TCK), page = sysconf(_SC_PAGESIZE);
+    units.ticksPerSecond = ticks > 0 ? static_cast<uint64_t>(ticks) : 100;
+    units.pageSize = page > 0 ? static_cast<uint64_t>(page) : 4096;
+
+    // Contiguous runs of pids per thread keep the merged list in pid order.
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(std::min(threads, kMaxScanThreads), pids.size() / kPidsPerThread + 1));
+    std::vector<ScanShard> shards(threads);
+    std::vector<std::thread> workers;
+    const size_t per = (pids.size() + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; ++t) {
+        const size_t begin = std::min(pids.size(), t * per), count = std::min(pids.size(), begin + per) - begin;
+        const uint32_t* run = pids.empty() ? nullptr : &pids[begin];
+        if (t + 1 == threads) {
+            scanPids(procFd, run, count, owners, units, budget, shards[t]);
+        } else {
+            workers.push_back(std::thread(scanPids, procFd, run, count, owners, std::cref(units), std::cref(budget),
+                                          std::ref(shards[t])));
+        }
+    }
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    close(procFd);
+
+    size_t total = 0;
+    for (unsigned t = 0; t < threads; ++t) total += shards[t].processes.size();
+    out.processes.reserve(total);
+    std::unordered_map<uint32_t, uint32_t> ownerOf; // uid -> index into owners
+    for (unsigned t = 0; t < threads; ++t) {
+        if (shards[t].status != QueryStatus::Complete) out.status = shards[t].status;
+        for (size_t k = 0; k < shards[t].processes.size(); ++k) {
+            ProcessRecord& p = shards[t].processes[k];
+            if (p.owner != kNoOwner) {
+                std::unordered_map<uint32_t, uint32_t>::iterator it = ownerOf.find(p.owner);
+                if (it == ownerOf.end()) {
+                    it = ownerOf.insert(std::make_pair(p.owner, static_cast<uint32_t>(out.owners.size()))).first;
+                    out.owners.push_back(userName(static_cast<uid_t>(p.owner)));
+                }
+                p.owner = it->second;
+            }
+            out.processes.push_back(std::move(p));
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#define NOMINMAX
+#include <windows.h>
+#include <winternl.h>
+#include <sddl.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "processes.h"
+
+#pragma comment(lib, "advapi32.lib")
+
+namespace {
+
+const ULONG kSystemProcessInformation = 5;
+const LONG kStatusInfoLengthMismatch = static_cast<LONG>(0xC0000004);
+
+// SYSTEM_PROCESS_INFORMATION as ntdll fills it in; winternl.h declares
+// most of these fields as reserved.
+struct ProcessEntry {
+    ULONG nextEntryOffset;
+    ULONG numberOfThreads;
+    LARGE_INTEGER workingSetPrivateSize;
+    ULONG hardFaultCount;
+    ULONG numberOfThreadsHighWatermark;
+    ULONGLONG cycleTime;
+    LARGE_INTEGER createTime;
+    LARGE_INTEGER userTime;   // 100 ns
+    LARGE_INTEGER kernelTime; // 100 ns
+    UNICODE_STRING imageName;
+    LONG basePriority;
+    HANDLE uniqueProcessId;
+    HANDLE inheritedFromUniqueProcessId;
+    ULONG handleCount;
+    ULONG sessionId;
+    ULONG_PTR uniqueProcessKey;
+    SIZE_T peakVirtualSize;
+    SIZE_T virtualSize;
+    ULONG pageFaultCount;
+    SIZE_T peakWorkingSetSize;
+    SIZE_T workingSetSize;
+};
+
+typedef LONG(WINAPI* NtQuerySystemInformationFn)(ULONG, PVOID, ULONG, PULONG);
+
+std::string narrow(const wchar_t* s, size_t n) {
+    if (!n) return std::string();
+    const int len = WideCharToMultiByte(CP_UTF8, 0, s, static_cast<int>(n), NULL, 0, NULL, NULL);
+    std::string out(len > 0 ? len : 0, '\0');
+    if (len > 0) WideCharToMultiByte(CP_UTF8, 0, s, static_cast<int>(n), &out[0], len, NULL, NULL);
+    return out;
+}
+
+// Owner of a process as "DOMAIN\user", through its token. Accounts are
+// looked up once per SID; processes we may not open have none.
+class OwnerCache {
+public:
+    explicit OwnerCache(std::vector<std::string>& owners) : m_owners(owners) {}
+
+    uint32_t ownerOf(DWORD pid) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!process) return kNoOwner;
+        HANDLE token = NULL;
+        uint32_t owner = kNoOwner;
+        DWORD len = 0;
+        if (OpenProcessToken(process, TOKEN_QUERY, &token) &&
+            GetTokenInformation(token, TokenUser, m_buf, sizeof(m_buf), &len)) {
+            owner = lookup(reinterpret_cast<TOKEN_USER*>(m_buf)->User.Sid);
+        }
+        if (token) CloseHandle(token);
+        CloseHandle(process);
+        return owner;
+    }
+
+private:
+    uint32_t lookup(PSID sid) {
+        LPWSTR text = NULL;
+        if (!ConvertSidToStringSidW(sid, &text)) return kNoOwner;
+        const std::wstring key(text);
+        LocalFree(text);
+        std::unordered_map<std::wstring, uint32_t>::const_iterator it = m_index.find(key);
+        if (it != m_index.end()) return it->second;
+
+        wchar_t name[256], domain[256];
+        DWORD nameLen = 256, domainLen = 256;
+        SID_NAME_USE use;
+        std::string owner = narrow(key.data(), key.size()); // unresolvable: the SID itself
+        if (LookupAccountSidW(NULL, sid, name, &nameLen, domain, &domainLen, &use)) {
+            owner = narrow(domain, domainLen) + "\\" + narrow(name, nameLen);
+        }
+        const uint32_t index = static_cast<uint32_t>(m_owners.size());
+        m_owners.push_back(owner);
+        m_index[key] = index;
+        return index;
+    }
+
+    std::vector<std::string>& m_owners;
+    std::unordered_map<std::wstring, uint32_t> m_index;
+    unsigned char m_buf[SECURITY_MAX_SID_SIZE + sizeof(TOKEN_USER)];
+};
+
+} // namespace
+
+void snapshotProcesses(const std::string&, bool owners, const QueryBudget& budget, ProcessSnapshot& out) {
+    out.processes.clear();
+    out.owners.clear();
+    out.status = QueryStatus::Complete;
+    static const NtQuerySystemInformationFn query = reinterpret_cast<NtQuerySystemInformationFn>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation"));
+    if (!query) return;
+
+    // One call returns every process; retry while the list outgrows the buffer.
+    std::vector<unsigned char> buf(1 << 20);
+    for (;;) {
+        ULONG needed = 0;
+        const LONG status = query(kSystemProcessInformation, &buf[0], static_cast<ULONG>(buf.size()), &needed);
+        if (status == kStatusInfoLengthMismatch) {
+            buf.resize(std::max<size_t>(buf.size() * 2, needed + 64 * 1024));
+            continue;
+        }
+        if (status < 0) return;
+        break;
+    }
+
+    OwnerCache cache(out.owners);
+    for (size_t off = 0;;) {
+        const ProcessEntry& e = *reinterpret_cast<const ProcessEntry*>(&buf[off]);
+        ProcessRecord rec;
+        rec.pid = static_cast<uint32_t>(reinterpret_cast<ULONG_PTR>(e.uniqueProcessId));
+        rec.parentPid = static_cast<uint32_t>(reinterpret_cast<ULONG_PTR>(e.inheritedFromUniqueProcessId));
+        rec.threads = e.numberOfThreads;
+        rec.workingSet = e.workingSetSize;
+        rec.userTime = static_cast<uint64_t>(e.userTime.QuadPart);
+        rec.kernelTime = static_cast<uint64_t>(e.kernelTime.QuadPart);
+        // The idle process has no image name; WMI calls it this.
+        rec.name = rec.pid == 0 ? "System Idle Process" : narrow(e.imageName.Buffer, e.imageName.Length / sizeof(wchar_t));
+        rec.owner = kNoOwner;
+        if (owners) {
+            // Token lookups are the slow part; stop them at the budget.
+            if ((out.processes.size() & 255) == 0) out.status = budget.check();
+            if (out.status != QueryStatus::Complete) break;
+            rec.owner = cache.ownerOf(rec.pid);
+        }
+        out.processes.push_back(rec);
+        if (!e.nextEntryOffset) break;
+        off += e.nextEntryOffset;
+    }
+    std::sort(out.processes.begin(), out.processes.end(),
+              [](const ProcessRecord& a, const ProcessRecord& b) { return a.pid < b.pid; });
+}
@@ -0,0 +1,109 @@
+#include "procfs.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+} // namespace
+
+Slice Slice::trim() const {
+    const char* b = p;
+    const char* e = p + n;
+    while (b < e && isSpace(*b)) ++b;
+    while (e > b && (isSpace(e[-1]) || e[-1] == '\0')) --e;
+    return Slice(b, e - b);
+}
+
+Slice Slice::stripQuotes() const {
+    Slice t = trim();
+    if (t.n >= 2 && (t.p[0] == '"' || t.p[0] == '\'') && t.p[t.n - 1] == t.p[0]) {
+        return Slice(t.p + 1, t.n - 2);
+    }
+    return t;
+}
+
+uint64_t Slice::toU64() const {
+    size_t k = 0;
+    while (k < n && isSpace(p[k])) ++k;
+    uint64_t v = 0;
+    for (; k < n && p[k] >= '0' && p[k] <= '9'; ++k) v = v * 10 + (p[k] - '0');
+    return v;
+}
+
+bool Slice::split(char sep, Slice& key, Slice& value) const {
+    const char* s = find(sep);
+    if (!s) return false;
+    key = Slice(p, s - p).trim();
+    value = Slice(s + 1, p + n - s - 1).trim();
+    return true;
+}
+
+bool LineReader::next(Slice& line) {
+    if (m_p >= m_end) return false;
+    const char* nl = static_cast<const char*>(std::memchr(m_p, '\n', m_end - m_p));
+    const char* e = nl ? nl : m_end;
+    line = Slice(m_p, e - m_p);
+    m_p = nl ? nl + 1 : m_end;
+    return true;
+}
+
+FileReader::FileReader() : m_buf(m_inline), m_cap(sizeof(m_inline)), m_budget(nullptr), m_status(QueryStatus::Complete) {}
+
+FileReader::~FileReader() {
+    if (m_buf != m_inline) std::free(m_buf);
+}
+
+bool FileReader::fill(int fd, size_t& len) {
+    len = 0;
+    for (;;) {
+        if (len == m_cap) {
+            // procfs files report st_size 0, so grow on demand.
+            size_t cap = m_cap * 4;
+            char* buf = static_cast<char*>(m_buf == m_inline ? std::malloc(cap) : std::realloc(m_buf, cap));
+            if (!buf) return false;
+            if (m_buf == m_inline) std::memcpy(buf, m_inline, len);
+            m_buf = buf;
+            m_cap = cap;
+        }
+        ssize_t r = pread(fd, m_buf + len, m_cap - len, static_cast<off_t>(len));
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (r == 0) return true;
+        len += static_cast<size_t>(r);
+    }
+}
+
+bool FileReader::readAt(int dirfd, const char* path, Slice& out) {
+    if (m_budget && (m_status = m_budget->check()) != QueryStatus::Complete) return false;
+    int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    size_t len;
+    bool ok = fill(fd, len);
+    close(fd);
+    if (!ok) return false;
+    out = Slice(m_buf, len);
+    return true;
+}
+
+bool FileReader::valueAt(int dirfd, const char* path, Slice& out) {
+    if (!readAt(dirfd, path, out)) return false;
+    out = out.trim();
+    return !out.empty();
+}
+
+bool FileReader::readBinary(const char* path, const unsigned char*& data, size_t& len) {
+    Slice s;
+    if (!read(path, s)) return false;
+    data = reinterpret_cast<const unsigned char*>(s.p);
+    len = s.n;
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+
+#include "datasource.h"
+
+// Non-owning view of bytes in a FileReader buffer (or any other text).
+struct Slice {
+    const char* p;
+    size_t n;
+
+    Slice() : p(""), n(0) {}
+    Slice(const char* s) : p(s), n(std::strlen(s)) {}
+    Slice(const char* s, size_t len) : p(s), n(len) {}
+
+    bool empty() const { return n == 0; }
+    bool equals(const char* s) const { return std::strlen(s) == n && std::memcmp(p, s, n) == 0; }
+    bool startsWith(const char* s) const {
+        size_t k = std::strlen(s);
+        return k <= n && std::memcmp(p, s, k) == 0;
+    }
+    const char* find(char c) const { return static_cast<const char*>(std::memchr(p, c, n)); }
+    Slice trim() const;
+    Slice stripQuotes() const;
+    // Value of the leading decimal digits (after whitespace); 0 if none.
+    uint64_t toU64() const;
+    // Splits "key<sep>value" at the first separator and trims both halves.
+    bool split(char sep, Slice& key, Slice& value) const;
+};
+
+// Iterates the lines of a buffer without copying them.
+class LineReader {
+public:
+    explicit LineReader(Slice text) : m_p(text.p), m_end(text.p + text.n) {}
+    bool next(Slice& line);
+
+private:
+    const char* m_p;
+    const char* m_end;
+};
+
+// Reads whole /proc and /sys files with open + pread into one reusable
+// buffer: a small inline block that grows on the heap only for big files
+// like /proc/cpuinfo. A returned Slice stays valid until the next read.
+class FileReader {
+public:
+    FileReader();
+    ~FileReader();
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    // Once `budget` has run out every read fails, so a collector walking
+    // many slow sysfs files gives up between them.
+    void setBudget(const QueryBudget* budget) { m_budget = budget; }
+    // Complete unless a read was refused for the budget.
+    QueryStatus status() const { return m_status; }
+
+    bool read(const char* path, Slice& out) { return readAt(AT_FDCWD, path, out); }
+    bool readAt(int dirfd, const char* path, Slice& out);
+    // Single-line attribute (sysfs style), surrounding whitespace removed.
+    // False if the file is missing, unreadable or empty.
+    bool value(const char* path, Slice& out) { return valueAt(AT_FDCWD, path, out); }
+    bool valueAt(int dirfd, const char* path, Slice& out);
+
+    // Raw bytes of a binary file (e.g. the SMBIOS table).
+    bool readBinary(const char* path, const unsigned char*& data, size_t& len);
+
+private:
+    bool fill(int fd, size_t& len);
+
+    char m_inline[4096];
+    char* m_buf;
+    size_t m_cap;
+    const QueryBudget* m_budget;
+    QueryStatus m_status;
+};
@@ -0,0 +1,189 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+
+#include "report_json.h"
+
+thread_local uint64_t t_heapAllocs = 0;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct ThreadBuffer {
+    unsigned id;
+    std::vector<QuerySpan> spans;
+};
+
+// Buffers are registered once per thread and outlive it, so spans can be
+// read after the workers have exited.
+std::mutex g_registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer> > g_buffers;
+std::atomic<bool> g_enabled(false);
+Clock::time_point g_origin;
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+thread_local QuerySpan* t_open = nullptr;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_origin).count());
+}
+
+ThreadBuffer& threadBuffer() {
+    if (!t_buffer) {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        g_buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+        t_buffer = g_buffers.back().get();
+        t_buffer->id = static_cast<unsigned>(g_buffers.size());
+        t_buffer->spans.reserve(32);
+    }
+    return *t_buffer;
+}
+
+bool startsBefore(const QuerySpan& a, const QuerySpan& b) {
+    return a.startNs < b.startNs;
+}
+
+bool slower(const QuerySpan& a, const QuerySpan& b) {
+    return a.endNs - a.startNs > b.endNs - b.startNs;
+}
+
+} // namespace
+
+void enableProfiling() {
+    g_origin = Clock::now();
+    g_enabled = true;
+}
+
+void profileFirstRow() {
+    QuerySpan* span = t_open;
+    if (span && !span->firstRowNs) span->firstRowNs = nowNs();
+}
+
+ResultSet ProfilingSource::query(const std::wstring& wql, const QueryBudget& budget) {
+    if (!g_enabled) return m_inner.query(wql, budget);
+
+    ThreadBuffer& buf = threadBuffer();
+    QuerySpan span = QuerySpan();
+    span.thread = buf.id;
+    t_open = &span;
+    const uint64_t allocs0 = t_heapAllocs;
+    span.startNs = nowNs();
+    ResultSet rows = m_inner.query(wql, budget);
+    span.endNs = nowNs();
+    span.allocs = t_heapAllocs - allocs0;
+    t_open = nullptr;
+
+    span.rows = rows.rowCount();
+    span.properties = rows.rowCount() * rows.columnCount();
+    span.bytes = rows.arena().bytesUsed();
+    span.status = rows.status();
+    std::wstring cls = wqlClassName(wql);
+    span.name.assign(cls.begin(), cls.end()); // WQL is ASCII
+    span.wql.assign(wql.begin(), wql.end());
+    buf.spans.push_back(std::move(span));
+    return rows;
+}
+
+std::vector<QuerySpan> profileSpans() {
+    std::vector<QuerySpan> all;
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for (size_t k = 0; k < g_buffers.size(); ++k) {
+        all.insert(all.end(), g_buffers[k]->spans.begin(), g_buffers[k]->spans.end());
+    }
+    std::stable_sort(all.begin(), all.end(), startsBefore);
+    return all;
+}
+
+bool writeChromeTrace(const std::string& path, const std::vector<QuerySpan>& spans) {
+    JsonWriter w;
+    w.beginObject();
+    w.key("displayTimeUnit");
+    w.string("ms");
+    w.key("traceEvents");
+    w.beginArray();
+    unsigned threads = 0;
+    for (size_t k = 0; k < spans.size(); ++k) threads = std::max(threads, spans[k].thread);
+    for (unsigned t = 1; t <= threads; ++t) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "worker %u", t);
+        w.beginObject();
+        w.key("ph"); w.string("M");
+        w.key("name"); w.string("thread_name");
+        w.key("pid"); w.u64(1);
+        w.key("tid"); w.u64(t);
+        w.key("args"); w.beginObject(); w.key("name"); w.string(name); w.endObject();
+        w.endObject();
+    }
+    for (size_t k = 0; k < spans.size(); ++k) {
+        const QuerySpan& s = spans[k];
+        w.beginObject();
+        w.key("ph"); w.string("X");
+        w.key("cat"); w.string("query");
+        w.key("name"); w.string(s.name.c_str());
+        w.key("pid"); w.u64(1);
+        w.key("tid"); w.u64(s.thread);
+        w.key("ts"); w.fixed(s.startNs / 1000.0, 3);
+        w.key("dur"); w.fixed((s.endNs - s.startNs) / 1000.0, 3);
+        w.key("args");
+        w.beginObject();
+        w.key("wql"); w.string(s.wql.c_str());
+        w.key("rows"); w.u64(s.rows);
+        w.key("properties"); w.u64(s.properties);
+        w.key("bytes"); w.u64(s.bytes);
+        w.key("allocs"); w.u64(s.allocs);
+        if (s.status != QueryStatus::Complete) {
+            w.key("status"); w.string(queryStatusName(s.status));
+        }
+        if (s.firstRowNs) {
+            w.key("first_row_us"); w.fixed((s.firstRowNs - s.startNs) / 1000.0, 3);
+        }
+        w.endObject();
+        w.endObject();
+        if (s.firstRowNs) {
+            // Nested under the query: how long the provider took to answer.
+            w.beginObject();
+            w.key("ph"); w.string("X");
+            w.key("cat"); w.string("first_row");
+            w.key("name"); w.string("wait for first row");
+            w.key("pid"); w.u64(1);
+            w.key("tid"); w.u64(s.thread);
+            w.key("ts"); w.fixed(s.startNs / 1000.0, 3);
+            w.key("dur"); w.fixed((s.firstRowNs - s.startNs) / 1000.0, 3);
+            w.endObject();
+        }
+    }
+    w.endArray();
+    w.endObject();
+    w.newline();
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(w.buffer().data(), 1, w.buffer().size(), f) == w.buffer().size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok;
+}
+
+void printProfileSummary(const std::vector<QuerySpan>& spans, std::wostream& out) {
+    std::vector<QuerySpan> sorted(spans);
+    std::stable_sort(sorted.begin(), sorted.end(), slower);
+    out << L"\n[Query Profile] (slowest first)" << std::endl;
+    out << L"    Wall ms  1st row ms    Rows   Props     Bytes  Allocs  Thread  Class" << std::endl;
+    for (size_t k = 0; k < sorted.size(); ++k) {
+        const QuerySpan& s = sorted[k];
+        out << std::fixed << std::setprecision(2) << std::setw(11) << (s.endNs - s.startNs) / 1e6;
+        if (s.firstRowNs) out << std::setw(12) << (s.firstRowNs - s.startNs) / 1e6;
+        else out << std::setw(12) << L"-";
+        out << std::setw(8) << s.rows << std::setw(8) << s.properties << std::setw(10) << s.bytes
+            << std::setw(8) << s.allocs << std::setw(8) << s.thread << L"  "
+            << std::wstring(s.name.begin(), s.name.end()) << std::endl;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "datasource.h"
+
+// One query as seen by the sections. Times are nanoseconds on a monotonic
+// clock since profiling was enabled; firstRowNs is 0 if no row arrived.
+struct QuerySpan {
+    std::string name; // WMI class
+    std::string wql;
+    unsigned thread;  // small id, in order of each thread's first query
+    uint64_t startNs;
+    uint64_t firstRowNs;
+    uint64_t endNs;
+    uint64_t rows;
+    uint64_t properties; // cells: rows x selected properties
+    uint64_t bytes;      // string payload converted into the result arena
+    uint64_t allocs;     // C++ heap allocations on the querying thread
+    QueryStatus status;
+};
+
+// Heap allocations made by the current thread. The sysinfo executable
+// counts them with a replaced operator new (alloc_hook.cpp); elsewhere it
+// stays 0.
+extern thread_local uint64_t t_heapAllocs;
+
+// Starts the profiling clock. Spans are only recorded after this.
+void enableProfiling();
+
+// Data sources call this when the first row of a query arrives. Costs a
+// thread-local load when no span is open.
+void profileFirstRow();
+
+// Records a span around every query of the wrapped source into a buffer
+// owned by the calling thread, so the hot path takes no locks.
+class ProfilingSource : public DataSource {
+public:
+    explicit ProfilingSource(DataSource& inner) : m_inner(inner) {}
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void threadAttach() { m_inner.threadAttach(); }
+    void threadDetach() { m_inner.threadDetach(); }
+
+private:
+    DataSource& m_inner;
+};
+
+// Every recorded span, ordered by start time. Call once the threads that
+// recorded them are done (e.g. after collectSections() returns).
+std::vector<QuerySpan> profileSpans();
+
+// Chrome trace event JSON (chrome://tracing, Perfetto): one complete event
+// per query with its counters as args, plus its wait for the first row.
+bool writeChromeTrace(const std::string& path, const std::vector<QuerySpan>& spans);
+
+// Table of the spans, slowest first.
+void printProfileSummary(const std::vector<QuerySpan>& spans, std::wostream& out);
@@ -0,0 +1,317 @@
+#include "report_bin.h"
+
+#include <cstring>
+
+namespace {
+
+const char kMagic[4] = { 'S', 'Y', 'S', 'B' };
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void putString(std::string& out, const char* s, size_t n) {
+    putVarint(out, n);
+    out.append(s, n);
+}
+
+void putLE(std::string& out, uint64_t v, int bytes) {
+    for (int k = 0; k < bytes; ++k) out.push_back(static_cast<char>((v >> (8 * k)) & 0xFF));
+}
+
+// Bounds-checked cursor over one record.
+class Cursor {
+public:
+    Cursor(const unsigned char* p, const unsigned char* end) : m_p(p), m_end(end) {}
+
+    bool varint(uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_p == m_end) return false;
+            unsigned char b = *m_p++;
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+    bool fixed(uint64_t& v, int bytes) {
+        if (m_end - m_p < bytes) return false;
+        v = 0;
+        for (int k = 0; k < bytes; ++k) v |= static_cast<uint64_t>(m_p[k]) << (8 * k);
+        m_p += bytes;
+        return true;
+    }
+    bool byte(unsigned char& b) {
+        if (m_p == m_end) return false;
+        b = *m_p++;
+        return true;
+    }
+    bool string(const char*& s, size_t& n) {
+        uint64_t len;
+        if (!varint(len) || len > static_cast<uint64_t>(m_end - m_p)) return false;
+        s = reinterpret_cast<const char*>(m_p);
+        n = static_cast<size_t>(len);
+        m_p += n;
+        return true;
+    }
+    // Counts are bounded by the remaining bytes so corrupt input can't
+    // trigger huge allocations.
+    bool count(uint64_t& v) { return varint(v) && v <= static_cast<uint64_t>(m_end - m_p); }
+
+private:
+    const unsigned char* m_p;
+    const unsigned char* m_end;
+};
+
+uint64_t readLE(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    for (int k = 0; k < bytes; ++k) v |= static_cast<uint64_t>(p[k]) << (8 * k);
+    return v;
+}
+
+// Decodes one cell; a string points into the input. Returns what's wrong
+// with it, or nullptr.
+const char* readCell(Cursor& in, Value& v) {
+    unsigned char type, b;
+    uint64_t u;
+    const char* s;
+    size_t n;
+    if (!in.byte(type)) return "truncated cell";
+    v.type = static_cast<ValueType>(type);
+    switch (v.type) {
+    case ValueType::Null: return nullptr;
+    case ValueType::Int:
+        if (!in.varint(u)) return "truncated cell";
+        v.i = static_cast<int64_t>((u >> 1) ^ (0 - (u & 1)));
+        return nullptr;
+    case ValueType::Uint:
+        if (!in.varint(v.u)) return "truncated cell";
+        return nullptr;
+    case ValueType::Bool:
+        if (!in.byte(b)) return "truncated cell";
+        v.b = b != 0;
+        return nullptr;
+    case ValueType::String:
+        if (!in.string(s, n) || n > UINT32_MAX) return "truncated cell";
+        v.s.p = s;
+        v.s.n = static_cast<uint32_t>(n);
+        return nullptr;
+    default:
+        return "unknown cell type";
+    }
+}
+
+// The digest and id that start a record.
+const char* readRecordHeader(Cursor& in, uint16_t version, uint64_t& digest, const char*& id, size_t& idLen,
+                             uint64_t& queries) {
+    digest = 0;
+    if (version >= 3 && !in.fixed(digest, 8)) return "corrupt record";
+    if (!in.string(id, idLen) || !in.count(queries)) return "corrupt record";
+    return nullptr;
+}
+
+// Everything of a query before its cells.
+const char* readQueryHeader(Cursor& in, uint16_t version, StrRef& cls, QueryStatus& status,
+                            std::vector<StrRef>& columns, uint64_t& rows) {
+    const char* s;
+    size_t n;
+    uint64_t count;
+    if (!in.string(s, n)) return "corrupt query header";
+    cls.p = s;
+    cls.n = static_cast<uint32_t>(n);
+    status = QueryStatus::Complete;
+    if (version >= 2) {
+        unsigned char b;
+        if (!in.byte(b) || b > static_cast<unsigned char>(QueryStatus::Cancelled)) return "corrupt query status";
+        status = static_cast<QueryStatus>(b);
+    }
+    if (!in.count(count)) return "corrupt query header";
+    columns.resize(static_cast<size_t>(count));
+    for (size_t c = 0; c < columns.size(); ++c) {
+        if (!in.string(s, n)) return "corrupt column name";
+        columns[c].p = s;
+        columns[c].n = static_cast<uint32_t>(n);
+    }
+    if (!in.count(rows)) return "corrupt row count";
+    return nullptr;
+}
+
+// Checks the file header; returns what's wrong with it, or nullptr.
+const char* readHeader(const unsigned char* p, size_t len, uint16_t& version) {
+    if (len < 8 || std::memcmp(p, kMagic, 4) != 0) return "not a sysinfo binary report";
+    version = static_cast<uint16_t>(readLE(p + 4, 2));
+    if (version > kReportBinVersion) return "report version is newer than this reader";
+    return nullptr;
+}
+
+} // namespace
+
+void appendBinHeader(std::string& out) {
+    out.append(kMagic, 4);
+    putLE(out, kReportBinVersion, 2);
+    putLE(out, 0, 2);
+}
+
+void appendBinSection(std::string& out, const char* section, const std::vector<std::string>& classes,
+                      const std::vector<ResultSet>& results, uint64_t digest) {
+    const size_t lengthAt = out.size();
+    putLE(out, 0, 4); // patched below
+    putLE(out, digest, 8);
+    putString(out, section, std::strlen(section));
+    putVarint(out, results.size());
+    for (size_t q = 0; q < results.size(); ++q) {
+        const ResultSet& rs = results[q];
+        const std::string cls = q < classes.size() ? classes[q] : std::string();
+        putString(out, cls.data(), cls.size());
+        out.push_back(static_cast<char>(rs.status()));
+        putVarint(out, rs.columnCount());
+        for (size_t c = 0; c < rs.columnCount(); ++c) {
+            const std::string& name = rs.columnName(static_cast<int>(c));
+            putString(out, name.data(), name.size());
+        }
+        // Rows without columns carry no data; writing none keeps the
+        // reader's row count bounded by the record size.
+        const size_t rows = rs.columnCount() ? rs.rowCount() : 0;
+        putVarint(out, rows);
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t c = 0; c < rs.columnCount(); ++c) {
+                const Value& v = rs.at(r, static_cast<int>(c));
+                out.push_back(static_cast<char>(v.type));
+                switch (v.type) {
+                case ValueType::Int: putVarint(out, (static_cast<uint64_t>(v.i) << 1) ^ static_cast<uint64_t>(v.i >> 63)); break;
+                case ValueType::Uint: putVarint(out, v.u); break;
+                case ValueType::Bool: out.push_back(v.b ? 1 : 0); break;
+                case ValueType::String: putString(out, v.s.p, v.s.n); break;
+                default: break;
+                }
+            }
+        }
+    }
+    const uint64_t length = out.size() - lengthAt - 4;
+    for (int k = 0; k < 4; ++k) out[lengthAt + k] = static_cast<char>((length >> (8 * k)) & 0xFF);
+}
+
+bool BinReportReader::fail(const char* what) {
+    m_error = what;
+    m_p = m_end;
+    return false;
+}
+
+bool BinReportReader::open(const void* data, size_t len) {
+    m_p = static_cast<const unsigned char*>(data);
+    m_end = m_p + len;
+    m_error.clear();
+    const char* bad = readHeader(m_p, len, m_version);
+    if (bad) return fail(bad);
+    m_p += 8;
+    return true;
+}
+
+bool BinReportReader::skip() {
+    if (m_end - m_p < 4) return m_p == m_end ? false : fail("truncated record header");
+    uint64_t length = readLE(m_p, 4);
+    if (length > static_cast<uint64_t>(m_end - m_p - 4)) return fail("truncated record");
+    m_p += 4 + length;
+    return true;
+}
+
+bool BinReportReader::peek(std::string& id, uint64_t& digest) {
+    if (m_end - m_p < 4) return m_p == m_end ? false : fail("truncated record header");
+    uint64_t length = readLE(m_p, 4);
+    if (length > static_cast<uint64_t>(m_end - m_p - 4)) return fail("truncated record");
+    Cursor in(m_p + 4, m_p + 4 + length);
+    const char* s;
+    size_t n;
+    uint64_t queries;
+    const char* bad = readRecordHeader(in, m_version, digest, s, n, queries);
+    if (bad) return fail(bad);
+    id.assign(s, n);
+    return true;
+}
+
+bool BinReportReader::next(ReportSection& section) {
+    if (m_end - m_p < 4) return m_p == m_end ? false : fail("truncated record header");
+    uint64_t length = readLE(m_p, 4);
+    if (length > static_cast<uint64_t>(m_end - m_p - 4)) return fail("truncated record");
+    Cursor in(m_p + 4, m_p + 4 + length);
+    m_p += 4 + length;
+
+    const char* s;
+    size_t n;
+    uint64_t digest, queries;
+    const char* bad = readRecordHeader(in, m_version, digest, s, n, queries);
+    if (bad) return fail(bad);
+    section.id.assign(s, n);
+    section.classes.assign(static_cast<size_t>(queries), std::string());
+    section.results.clear();
+    section.results.resize(static_cast<size_t>(queries));
+    std::vector<StrRef> columns;
+    for (size_t q = 0; q < queries; ++q) {
+        ResultSet& rs = section.results[q];
+        StrRef cls;
+        QueryStatus status;
+        uint64_t rows;
+        if ((bad = readQueryHeader(in, m_version, cls, status, columns, rows)) != nullptr) return fail(bad);
+        section.classes[q].assign(cls.p, cls.n);
+        rs.setStatus(status);
+        for (size_t c = 0; c < columns.size(); ++c) rs.addColumn(columns[c].p, columns[c].n);
+        for (uint64_t r = 0; r < rows; ++r) {
+            rs.addRow();
+            for (size_t c = 0; c < columns.size(); ++c) {
+                Value v;
+                if ((bad = readCell(in, v)) != nullptr) return fail(bad);
+                rs.setValue(static_cast<int>(c), v);
+            }
+        }
+    }
+    return true;
+}
+
+bool scanBinReport(const void* data, size_t len, BinReportVisitor& visitor, std::string& error) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + len;
+    uint16_t version = 0;
+    const char* bad = readHeader(p, len, version);
+    std::vector<StrRef> columns;
+    for (p += 8; !bad && p != end;) {
+        if (end - p < 4) {
+            bad = "truncated record header";
+            break;
+        }
+        const uint64_t length = readLE(p, 4);
+        if (length > static_cast<uint64_t>(end - p - 4)) {
+            bad = "truncated record";
+            break;
+        }
+        Cursor in(p + 4, p + 4 + length);
+        p += 4 + length;
+
+        const char* s;
+        size_t n;
+        uint64_t digest, queries;
+        if ((bad = readRecordHeader(in, version, digest, s, n, queries)) != nullptr) break;
+        StrRef id = { s, static_cast<uint32_t>(n) };
+        if (!visitor.section(id)) continue; // the length prefix skips it
+        for (uint64_t q = 0; !bad && q < queries; ++q) {
+            StrRef cls;
+            QueryStatus status;
+            uint64_t rows;
+            if ((bad = readQueryHeader(in, version, cls, status, columns, rows)) != nullptr) break;
+            const bool wanted = visitor.query(cls, status, columns);
+            for (uint64_t r = 0; !bad && r < rows; ++r) {
+                if (wanted) visitor.row();
+                for (size_t c = 0; c < columns.size(); ++c) {
+                    Value v;
+                    if ((bad = readCell(in, v)) != nullptr) break;
+                    if (wanted) visitor.cell(c, v);
+                }
+            }
+        }
+    }
+    if (bad) error = bad;
+    return !bad;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "resultset.h"
+
+// Compact binary report, written by `sysinfo --format=bin`:
+//
+//   file    := "SYSB" u16 version u16 reserved record*
+//   record  := u32 length, then `length` bytes of
+//              u64 digest (version 3+),
+//              str section, varint queryCount, query[queryCount]
+//   query   := str class, u8 QueryStatus (version 2+),
+//              varint columnCount, str column[columnCount],
+//              varint rowCount, cell[rowCount * columnCount] (row-major)
+//   cell    := u8 ValueType, then Int: zigzag varint | Uint: varint |
+//              Bool: u8 | String: str | Null: nothing
+//   str     := varint byteLength, UTF-8 bytes
+//
+// Fixed-width integers are little endian, varints are LEB128. Records are
+// length-prefixed so readers can skip sections they don't need.
+// `digest` is the section's content hash (sectionDigest() in diff.h), so
+// snapshots can be compared without decoding unchanged sections; 0 if
+// the writer didn't hash it.
+// Version 1 files (no status byte) still decode, as complete results, and
+// version 2 files (no digest) decode too.
+const uint16_t kReportBinVersion = 3;
+
+// A decoded record.
+struct ReportSection {
+    std::string id;
+    std::vector<std::string> classes; // classes[i] is the WMI class of results[i]
+    std::vector<ResultSet> results;
+};
+
+void appendBinHeader(std::string& out);
+void appendBinSection(std::string& out, const char* section, const std::vector<std::string>& classes,
+                      const std::vector<ResultSet>& results, uint64_t digest = 0);
+
+// Decodes a binary report held in memory (e.g. a mapped file). The buffer
+// must outlive the reader; decoded strings are copied into each
+// ResultSet's arena.
+class BinReportReader {
+public:
+    BinReportReader() : m_p(nullptr), m_end(nullptr), m_version(0) {}
+
+    // Checks the header. False for foreign data or a newer major version.
+    bool open(const void* data, size_t len);
+    // Decodes the next record; false at the end or on corrupt input
+    // (error() tells them apart).
+    bool next(ReportSection& section);
+    // Skips the next record without decoding it.
+    bool skip();
+    // Id and digest of the next record, which stays next. The digest is 0
+    // before version 3.
+    bool peek(std::string& id, uint64_t& digest);
+
+    uint16_t version() const { return m_version; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const char* what);
+
+    const unsigned char* m_p;
+    const unsigned char* m_end;
+    uint16_t m_version;
+    std::string m_error;
+};
+
+// Receives a binary report as scanBinReport() walks it. Strings point into
+// the scanned buffer and live as long as it does; nothing is copied.
+class BinReportVisitor {
+public:
+    virtual ~BinReportVisitor() {}
+    // Start of a record; false skips it without decoding.
+    virtual bool section(StrRef id) = 0;
+    // Start of a query in the current record; false skips its rows.
+    virtual bool query(StrRef cls, QueryStatus status, const std::vector<StrRef>& columns) = 0;
+    virtual void row() {}
+    // Cell `column` (an index into the query's columns) of the current row.
+    virtual void cell(size_t column, const Value& v) = 0;
+};
+
+// Zero-copy alternative to BinReportReader for tools that aggregate many
+// reports. False (with `error` set) for foreign or corrupt data; the
+// visitor may have seen a prefix of it by then.
+bool scanBinReport(const void* data, size_t len, BinReportVisitor& visitor, std::string& error);
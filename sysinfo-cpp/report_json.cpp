@@ -0,0 +1,220 @@
+#include "report_json.h"
+
+#include <cstring>
+
+namespace {
+
+// Length of the valid UTF-8 sequence at s (at most `left` bytes), or 0.
+size_t utf8SequenceLength(const unsigned char* s, size_t left) {
+    unsigned char c = s[0];
+    size_t n;
+    uint32_t min;
+    if (c < 0x80) return 1;
+    if ((c & 0xE0) == 0xC0) { n = 2; min = 0x80; }
+    else if ((c & 0xF0) == 0xE0) { n = 3; min = 0x800; }
+    else if ((c & 0xF8) == 0xF0) { n = 4; min = 0x10000; }
+    else return 0;
+    if (n > left) return 0;
+    uint32_t cp = c & (0x7F >> n);
+    for (size_t k = 1; k < n; ++k) {
+        if ((s[k] & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (s[k] & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+    return n;
+}
+
+} // namespace
+
+void JsonWriter::separator() {
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+    if (m_first.empty()) return;
+    if (m_first.back()) m_first.back() = false;
+    else m_buf.push_back(',');
+}
+
+void JsonWriter::beginObject() {
+    separator();
+    m_buf.push_back('{');
+    m_first.push_back(true);
+}
+
+void JsonWriter::endObject() {
+    m_buf.push_back('}');
+    m_first.pop_back();
+}
+
+void JsonWriter::beginArray() {
+    separator();
+    m_buf.push_back('[');
+    m_first.push_back(true);
+}
+
+void JsonWriter::endArray() {
+    m_buf.push_back(']');
+    m_first.pop_back();
+}
+
+void JsonWriter::key(const char* k) {
+    key(k, std::strlen(k));
+}
+
+void JsonWriter::key(const char* k, size_t n) {
+    string(k, n);
+    m_buf.push_back(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::string(const char* s) {
+    string(s, std::strlen(s));
+}
+
+void JsonWriter::string(const char* s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    separator();
+    m_buf.push_back('"');
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    size_t k = 0;
+    while (k < n) {
+        // Copy runs of plain ASCII in one go.
+        size_t run = k;
+        while (run < n && p[run] >= 0x20 && p[run] < 0x80 && p[run] != '"' && p[run] != '\\') ++run;
+        m_buf.append(s + k, run - k);
+        k = run;
+        if (k == n) break;
+
+        unsigned char c = p[k];
+        if (c == '"' || c == '\\') {
+            m_buf.push_back('\\');
+            m_buf.push_back(static_cast<char>(c));
+            ++k;
+        } else if (c < 0x20) {
+            switch (c) {
+            case '\n': m_buf.append("\\n", 2); break;
+            case '\r': m_buf.append("\\r", 2); break;
+            case '\t': m_buf.append("\\t", 2); break;
+            default:
+                m_buf.append("\\u00", 4);
+                m_buf.push_back(hex[c >> 4]);
+                m_buf.push_back(hex[c & 15]);
+            }
+            ++k;
+        } else {
+            // Firmware strings are not always valid UTF-8; keep the output
+            // parseable by replacing broken sequences with U+FFFD.
+            size_t len = utf8SequenceLength(p + k, n - k);
+            if (len) {
+                m_buf.append(s + k, len);
+                k += len;
+            } else {
+                m_buf.append("\xEF\xBF\xBD", 3);
+                ++k;
+            }
+        }
+    }
+    m_buf.push_back('"');
+}
+
+void JsonWriter::u64(uint64_t v) {
+    separator();
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) m_buf.push_back(digits[--n]);
+}
+
+void JsonWriter::i64(int64_t v) {
+    if (v < 0) {
+        separator();
+        m_buf.push_back('-');
+        m_afterKey = true; // the digits follow without a separator
+        u64(0 - static_cast<uint64_t>(v));
+    } else {
+        u64(static_cast<uint64_t>(v));
+    }
+}
+
+void JsonWriter::fixed(double v, unsigned decimals) {
+    uint64_t scale = 1;
+    for (unsigned k = 0; k < decimals; ++k) scale *= 10;
+    const uint64_t scaled = v > 0 ? static_cast<uint64_t>(v * static_cast<double>(scale) + 0.5) : 0;
+    u64(scaled / scale);
+    if (!decimals) return;
+    m_buf.push_back('.');
+    uint64_t frac = scaled % scale;
+    for (uint64_t div = scale / 10; div; div /= 10) {
+        m_buf.push_back(static_cast<char>('0' + frac / div));
+        frac %= div;
+    }
+}
+
+void JsonWriter::boolean(bool v) {
+    separator();
+    if (v) m_buf.append("true", 4);
+    else m_buf.append("false", 5);
+}
+
+void JsonWriter::null() {
+    separator();
+    m_buf.append("null", 4);
+}
+
+void JsonWriter::value(const Value& v) {
+    switch (v.type) {
+    case ValueType::Int: i64(v.i); break;
+    case ValueType::Uint: u64(v.u); break;
+    case ValueType::Bool: boolean(v.b); break;
+    case ValueType::String: string(v.s.p, v.s.n); break;
+    default: null(); break;
+    }
+}
+
+void JsonWriter::clear() {
+    m_buf.clear();
+    m_first.clear();
+    m_afterKey = false;
+}
+
+void appendJsonSection(JsonWriter& w, const char* section, const std::vector<std::string>& classes,
+                       const std::vector<ResultSet>& results) {
+    w.beginObject();
+    w.key("section");
+    w.string(section);
+    w.key("schema");
+    w.u64(kReportJsonSchema);
+    w.key("results");
+    w.beginArray();
+    for (size_t q = 0; q < results.size(); ++q) {
+        const ResultSet& rs = results[q];
+        w.beginObject();
+        w.key("class");
+        w.string(q < classes.size() ? classes[q].c_str() : "");
+        if (rs.partial()) {
+            // Only present when the query stopped early; rows are what arrived.
+            w.key("status");
+            w.string(queryStatusName(rs.status()));
+        }
+        w.key("rows");
+        w.beginArray();
+        for (size_t r = 0; r < rs.rowCount(); ++r) {
+            w.beginObject();
+            for (size_t c = 0; c < rs.columnCount(); ++c) {
+                const std::string& name = rs.columnName(static_cast<int>(c));
+                w.key(name.data(), name.size());
+                w.value(rs.at(r, static_cast<int>(c)));
+            }
+            w.endObject();
+        }
+        w.endArray();
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    w.newline();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "resultset.h"
+
+// Appends compact JSON to a growable UTF-8 buffer. ResultSet strings are
+// already UTF-8 and are copied with escaping only, and numbers are
+// formatted by hand, so no wide strings or locale are involved. Commas
+// are inserted automatically.
+class JsonWriter {
+public:
+    JsonWriter() : m_afterKey(false) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const char* k);
+    void key(const char* k, size_t n);
+
+    void string(const char* s, size_t n);
+    void string(const char* s);
+    void u64(uint64_t v);
+    void i64(int64_t v);
+    // Non-negative decimal with a fixed number of fraction digits.
+    void fixed(double v, unsigned decimals);
+    void boolean(bool v);
+    void null();
+    void value(const Value& v);
+    // Ends a JSON Lines record.
+    void newline() { m_buf.push_back('\n'); }
+
+    const std::string& buffer() const { return m_buf; }
+    // Drops the content but keeps the capacity for the next record.
+    void clear();
+
+private:
+    void separator();
+
+    std::string m_buf;
+    std::vector<bool> m_first; // per open container: nothing written yet
+    bool m_afterKey;
+};
+
+// Version of the record layout below; bumped on incompatible changes.
+const unsigned kReportJsonSchema = 1;
+
+// One JSON Lines record for a gathered section, with raw typed values:
+//   {"section":"cpu","schema":1,"results":[{"class":"Win32_Processor",
+//    "rows":[{"Name":"...","NumberOfCores":8,...}]}]}
+// classes[i] names the WMI class of results[i].
+void appendJsonSection(JsonWriter& w, const char* section, const std::vector<std::string>& classes,
+                       const std::vector<ResultSet>& results);
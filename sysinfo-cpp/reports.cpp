@@ -0,0 +1,147 @@
+#include "reports.h"
+
+#include <algorithm>
+#include <ostream>
+#include <utility>
+
+#include "history.h"
+#include "report_bin.h"
+#include "report_json.h"
+
+namespace {
+
+// WMI class of every query of a section, for the structured records.
+std::vector<std::vector<std::string> > sectionClasses(const std::vector<SectionDef>& sections) {
+    std::vector<std::vector<std::string> > classes(sections.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        for (size_t q = 0; q < sections[i].queries.size(); ++q) {
+            if (sections[i].queries[q].empty()) continue; // skipped by --fields
+            std::wstring cls = wqlClassName(sections[i].queries[q]);
+            classes[i].push_back(std::string(cls.begin(), cls.end())); // class names are ASCII
+        }
+    }
+    return classes;
+}
+
+void printError(const std::string& path, const std::string& error, std::wostream& err) {
+    err << utf8ToWide(path.data(), path.size()) << L": " << utf8ToWide(error.data(), error.size()) << std::endl;
+}
+
+// Decodes the changed sections of both sides and prints the device
+// changes. `newFile` is null when `after` was collected just now.
+int reportChanges(const MappedFile& oldFile, std::vector<SnapshotSection>& before, const MappedFile* newFile,
+                  std::vector<SnapshotSection>& after, std::wostream& out, std::wostream& err) {
+    const size_t compared = markChangedSections(before, after);
+    std::string error;
+    if (!loadChangedSections(oldFile.data(), oldFile.size(), before, error) ||
+        (newFile && !loadChangedSections(newFile->data(), newFile->size(), after, error))) {
+        err << L"Could not decode snapshot: " << utf8ToWide(error.data(), error.size()) << std::endl;
+        return 2;
+    }
+    const std::vector<DeviceChange> changes = diffSnapshots(before, after);
+    printChanges(changes, compared, out);
+    for (size_t k = 0; k < changes.size(); ++k) {
+        if (changes[k].kind != DeviceChange::Incomplete) return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+void writeRecords(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs, RecordFormat format,
+                  const CollectLimits& limits, std::FILE* out) {
+    const std::vector<std::vector<std::string> > classes = sectionClasses(sections);
+    JsonWriter json;
+    std::string bin;
+    if (format == RecordFormat::Bin) appendBinHeader(bin);
+    collectSections(src, sections, jobs, [&](size_t i, std::vector<ResultSet>& results) {
+        if (classes[i].size() != results.size()) {
+            // Queries skipped by --fields get no entry in the record.
+            std::vector<ResultSet> run;
+            for (size_t q = 0; q < results.size(); ++q) {
+                if (!sections[i].queries[q].empty()) run.push_back(std::move(results[q]));
+            }
+            results.swap(run);
+        }
+        const std::string* buf = &bin;
+        if (format == RecordFormat::Jsonl) {
+            appendJsonSection(json, sections[i].id, classes[i], results);
+            buf = &json.buffer();
+        } else {
+            appendBinSection(bin, sections[i].id, classes[i], results, sectionDigest(classes[i], results));
+        }
+        std::fwrite(buf->data(), 1, buf->size(), out);
+        std::fflush(out);
+        json.clear();
+        bin.clear();
+    }, limits);
+}
+
+bool Snapshot::open(const std::string& path) {
+    if (!m_file.open(path)) {
+        m_error = path + ": cannot open the file";
+        return false;
+    }
+    std::string error;
+    if (!indexSnapshot(m_file.data(), m_file.size(), m_sections, error)) {
+        m_error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+int compareSnapshots(Snapshot& before, Snapshot& after, std::wostream& out, std::wostream& err) {
+    return reportChanges(before.file(), before.sections(), &after.file(), after.sections(), out, err);
+}
+
+int compareWithSnapshot(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs,
+                        const CollectLimits& limits, Snapshot& before, std::wostream& out, std::wostream& err) {
+    const std::vector<std::vector<std::string> > classes = sectionClasses(sections);
+    std::vector<SnapshotSection> after(sections.size());
+    collectSections(src, sections, jobs, [&](size_t i, std::vector<ResultSet>& results) {
+        SnapshotSection& now = after[i];
+        now.id = sections[i].id;
+        now.data.id = now.id;
+        now.data.classes = classes[i];
+        for (size_t q = 0; q < results.size(); ++q) {
+            if (!sections[i].queries[q].empty()) now.data.results.push_back(std::move(results[q])); // as in the records
+        }
+        now.digest = sectionDigest(now.data.classes, now.data.results);
+        now.loaded = true;
+    }, limits);
+    // Sections left out by --sections aren't compared.
+    std::vector<SnapshotSection> compared;
+    for (size_t k = 0; k < before.sections().size(); ++k) {
+        for (size_t i = 0; i < sections.size(); ++i) {
+            if (before.sections()[k].id == sections[i].id) compared.push_back(std::move(before.sections()[k]));
+        }
+    }
+    return reportChanges(before.file(), compared, nullptr, after, out, err);
+}
+
+int printHistoryFile(const std::string& path, const std::string& filter, std::chrono::milliseconds last,
+                     std::chrono::milliseconds step, std::wostream& out, std::wostream& err) {
+    MappedFile file;
+    std::vector<HistorySeries> series;
+    std::string error;
+    int64_t first = 0, newest = 0;
+    if (!file.open(path)) {
+        error = "cannot open the file";
+    } else if (!historySpan(file.data(), file.size(), first, newest)) {
+        if (queryHistory(file.data(), file.size(), filter, 0, 0, 1, series, error)) {
+            out << L"No samples recorded." << std::endl;
+            return 0;
+        }
+    } else {
+        const int64_t to = newest + 1;
+        const int64_t from = last.count() ? std::max(first, to - static_cast<int64_t>(last.count())) : first;
+        int64_t stepMs = step.count();
+        if (!stepMs) stepMs = std::max<int64_t>(1000, ((to - from + 59) / 60 + 999) / 1000 * 1000);
+        if (queryHistory(file.data(), file.size(), filter, from, to, stepMs, series, error)) {
+            printHistory(series, stepMs, out);
+            return 0;
+        }
+    }
+    printError(path, error, err);
+    return 2;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+#include "datasource.h"
+#include "diff.h"
+#include "mapped_file.h"
+
+// The executable's whole-run operations, as libsysinfo calls: structured
+// records of a collection, comparisons with binary snapshots (--diff,
+// --since) and history queries. The comparisons return the exit codes the
+// executable passes on: 0 for no changes, 1 for device changes, 2 if a
+// file can't be read or decoded.
+
+enum class RecordFormat { Jsonl, Bin };
+
+// Collects `sections` and writes each as a --format=jsonl or --format=bin
+// record to `out` as soon as it is in (a binary header first). Queries
+// left empty by --fields get no entry in the record.
+void writeRecords(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs, RecordFormat format,
+                  const CollectLimits& limits, std::FILE* out);
+
+// A binary report mapped for comparing, with its sections indexed.
+class Snapshot {
+public:
+    // False with error() set if the file can't be read or isn't a report.
+    bool open(const std::string& path);
+    const std::string& error() const { return m_error; }
+
+    const MappedFile& file() const { return m_file; }
+    // Decoded as the comparisons need them.
+    std::vector<SnapshotSection>& sections() { return m_sections; }
+
+private:
+    MappedFile m_file;
+    std::vector<SnapshotSection> m_sections;
+    std::string m_error;
+};
+
+// Prints the device changes from `before` to `after` to `out`; decoding
+// errors go to `err`.
+int compareSnapshots(Snapshot& before, Snapshot& after, std::wostream& out, std::wostream& err);
+
+// Collects `sections` and prints their device changes since `before`.
+// Sections of the snapshot that aren't collected aren't compared.
+int compareWithSnapshot(DataSource& src, const std::vector<SectionDef>& sections, unsigned jobs,
+                        const CollectLimits& limits, Snapshot& before, std::wostream& out, std::wostream& err);
+
+// Prints the series of the history file at `path` matching `filter`, over
+// its last `last` (everything if zero), in buckets of `step` (about 60
+// whole-second buckets over the range if zero). 0, or 2 after printing to
+// `err` why the file can't be read.
+int printHistoryFile(const std::string& path, const std::string& filter, std::chrono::milliseconds last,
+                     std::chrono::milliseconds step, std::wostream& out, std::wostream& err);
@@ -0,0 +1,309 @@
+#include "resultset.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+Arena::Arena(size_t blockSize)
+    : m_next(0), m_cur(nullptr), m_last(nullptr), m_left(0), m_blockSize(blockSize), m_used(0) {}
+
+Arena::~Arena() {
+    for (size_t i = 0; i < m_blocks.size(); ++i) std::free(m_blocks[i]);
+    for (size_t i = 0; i < m_large.size(); ++i) std::free(m_large[i]);
+}
+
+Arena::Arena(Arena&& other) noexcept
+    : m_blocks(std::move(other.m_blocks)), m_large(std::move(other.m_large)), m_next(other.m_next),
+      m_cur(other.m_cur), m_last(other.m_last), m_left(other.m_left), m_blockSize(other.m_blockSize),
+      m_used(other.m_used) {
+    other.m_blocks.clear();
+    other.m_large.clear();
+    other.m_next = 0;
+    other.m_cur = nullptr;
+    other.m_last = nullptr;
+    other.m_left = 0;
+    other.m_used = 0;
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        std::swap(m_blocks, other.m_blocks);
+        std::swap(m_large, other.m_large);
+        std::swap(m_next, other.m_next);
+        std::swap(m_cur, other.m_cur);
+        std::swap(m_last, other.m_last);
+        std::swap(m_left, other.m_left);
+        std::swap(m_blockSize, other.m_blockSize);
+        std::swap(m_used, other.m_used);
+    }
+    return *this;
+}
+
+char* Arena::alloc(size_t n) {
+    if (n > m_left) {
+        // Oversized requests get a block of their own so the current block
+        // keeps its free tail.
+        const bool large = n > m_blockSize / 4;
+        if (large || m_next == m_blocks.size()) {
+            char* block = static_cast<char*>(std::malloc(large ? n : m_blockSize));
+            if (!block) throw std::bad_alloc();
+            if (large) {
+                m_large.push_back(block);
+                m_used += n;
+                m_last = nullptr;
+                return block;
+            }
+            m_blocks.push_back(block);
+        }
+        m_cur = m_blocks[m_next++];
+        m_left = m_blockSize;
+    }
+    char* p = m_cur;
+    m_last = p;
+    m_cur += n;
+    m_left -= n;
+    m_used += n;
+    return p;
+}
+
+void Arena::trimLast(size_t reserved, size_t used) {
+    // Only the tail of the current block can be given back; a dedicated
+    // oversized block just keeps its slack.
+    if (m_last && m_last + reserved == m_cur) {
+        m_cur -= reserved - used;
+        m_left += reserved - used;
+    }
+    m_used -= reserved - used;
+}
+
+void Arena::reset() {
+    for (size_t i = 0; i < m_large.size(); ++i) std::free(m_large[i]);
+    m_large.clear();
+    m_next = 0;
+    m_cur = nullptr;
+    m_last = nullptr;
+    m_left = 0;
+    m_used = 0;
+}
+
+const char* Arena::copy(const char* s, size_t n) {
+    char* p = alloc(n ? n : 1);
+    if (n) std::memcpy(p, s, n);
+    return p;
+}
+
+uint64_t Value::asUint() const {
+    switch (type) {
+    case ValueType::Int: return static_cast<uint64_t>(i);
+    case ValueType::Uint: return u;
+    case ValueType::Bool: return b ? 1 : 0;
+    case ValueType::String: {
+        uint64_t v = 0;
+        if (s.n == 0) return 0;
+        for (uint32_t k = 0; k < s.n; ++k) {
+            unsigned d = static_cast<unsigned char>(s.p[k]) - '0';
+            if (d > 9) return 0;
+            if (v > (UINT64_MAX - d) / 10) return 0;
+            v = v * 10 + d;
+        }
+        return v;
+    }
+    default: return 0;
+    }
+}
+
+bool Value::equals(const Value& other) const {
+    if (type != other.type) return false;
+    switch (type) {
+    case ValueType::Int: return i == other.i;
+    case ValueType::Uint: return u == other.u;
+    case ValueType::Bool: return b == other.b;
+    case ValueType::String: return s.n == other.s.n && std::memcmp(s.p, other.s.p, s.n) == 0;
+    default: return true;
+    }
+}
+
+const char* queryStatusName(QueryStatus status) {
+    switch (status) {
+    case QueryStatus::TimedOut: return "timed_out";
+    case QueryStatus::Cancelled: return "cancelled";
+    default: return "complete";
+    }
+}
+
+ResultSet::ResultSet(ResultSet&& other) noexcept
+    : m_columns(std::move(other.m_columns)), m_cells(std::move(other.m_cells)),
+      m_rows(other.m_rows), m_status(other.m_status), m_arena(std::move(other.m_arena)) {
+    other.m_rows = 0;
+    other.m_status = QueryStatus::Complete;
+}
+
+ResultSet& ResultSet::operator=(ResultSet&& other) noexcept {
+    if (this != &other) {
+        m_columns.swap(other.m_columns);
+        m_cells.swap(other.m_cells);
+        std::swap(m_rows, other.m_rows);
+        std::swap(m_status, other.m_status);
+        m_arena = std::move(other.m_arena);
+    }
+    return *this;
+}
+
+int ResultSet::addColumn(const char* name, size_t len) {
+    for (size_t c = 0; c < m_columns.size(); ++c) {
+        if (m_columns[c].size() == len && std::memcmp(m_columns[c].data(), name, len) == 0) {
+            return static_cast<int>(c);
+        }
+    }
+    size_t oldWidth = m_columns.size();
+    m_columns.push_back(std::string(name, len));
+    if (m_rows) {
+        Value null;
+        null.type = ValueType::Null;
+        null.u = 0;
+        std::vector<Value> widened;
+        widened.reserve(m_rows * (oldWidth + 1));
+        for (size_t r = 0; r < m_rows; ++r) {
+            widened.insert(widened.end(), m_cells.begin() + r * oldWidth, m_cells.begin() + (r + 1) * oldWidth);
+            widened.push_back(null);
+        }
+        m_cells.swap(widened);
+    }
+    return static_cast<int>(oldWidth);
+}
+
+int ResultSet::column(const char* name) const {
+    size_t len = std::strlen(name);
+    for (size_t c = 0; c < m_columns.size(); ++c) {
+        if (m_columns[c].size() == len && std::memcmp(m_columns[c].data(), name, len) == 0) {
+            return static_cast<int>(c);
+        }
+    }
+    return -1;
+}
+
+void ResultSet::addRow() {
+    Value null;
+    null.type = ValueType::Null;
+    null.u = 0;
+    m_cells.resize(m_cells.size() + m_columns.size(), null);
+    ++m_rows;
+}
+
+void ResultSet::setInt(int col, int64_t v) {
+    Value& c = cell(col);
+    c.type = ValueType::Int;
+    c.i = v;
+}
+
+void ResultSet::setUint(int col, uint64_t v) {
+    Value& c = cell(col);
+    c.type = ValueType::Uint;
+    c.u = v;
+}
+
+void ResultSet::setBool(int col, bool v) {
+    Value& c = cell(col);
+    c.type = ValueType::Bool;
+    c.b = v;
+}
+
+void ResultSet::setString(int col, const char* s, size_t n) {
+    Value& c = cell(col);
+    c.type = ValueType::String;
+    c.s.p = m_arena.copy(s, n);
+    c.s.n = static_cast<uint32_t>(n);
+}
+
+void ResultSet::setWide(int col, const wchar_t* s, size_t n) {
+    size_t reserved = n * (sizeof(wchar_t) == 2 ? 3 : 4);
+    char* out = m_arena.alloc(reserved ? reserved : 1);
+    size_t o = 0;
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t cp = static_cast<uint32_t>(s[k]);
+        if (sizeof(wchar_t) == 2 && cp >= 0xD800 && cp < 0xDC00 && k + 1 < n &&
+            static_cast<uint32_t>(s[k + 1]) >= 0xDC00 && static_cast<uint32_t>(s[k + 1]) < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<uint32_t>(s[k + 1]) - 0xDC00);
+            ++k;
+        } else if ((cp >= 0xD800 && cp < 0xE000) || cp > 0x10FFFF) {
+            cp = 0xFFFD;
+        }
+        if (cp < 0x80) {
+            out[o++] = static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out[o++] = static_cast<char>(0xC0 | (cp >> 6));
+            out[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out[o++] = static_cast<char>(0xE0 | (cp >> 12));
+            out[o++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out[o++] = static_cast<char>(0xF0 | (cp >> 18));
+            out[o++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out[o++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out[o++] = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    if (reserved) m_arena.trimLast(reserved, o);
+    Value& c = cell(col);
+    c.type = ValueType::String;
+    c.s.p = out;
+    c.s.n = static_cast<uint32_t>(o);
+}
+
+void ResultSet::setValue(int col, const Value& v) {
+    if (v.type == ValueType::String) {
+        setString(col, v.s.p, v.s.n);
+    } else {
+        cell(col) = v;
+    }
+}
+
+void ResultSet::setValue(size_t row, int col, const Value& v) {
+    Value& c = m_cells[row * m_columns.size() + col];
+    c = v;
+    if (v.type == ValueType::String) c.s.p = m_arena.copy(v.s.p, v.s.n);
+}
+
+void ResultSet::removeRow(size_t row) {
+    const size_t width = m_columns.size();
+    if (row + 1 < m_rows) {
+        std::copy(m_cells.end() - width, m_cells.end(), m_cells.begin() + row * width);
+    }
+    m_cells.resize(m_cells.size() - width);
+    --m_rows;
+}
+
+ResultSet ResultSet::clone() const {
+    ResultSet copy;
+    copy.assign(*this);
+    return copy;
+}
+
+void ResultSet::clear() {
+    m_columns.clear();
+    m_cells.clear();
+    m_rows = 0;
+    m_status = QueryStatus::Complete;
+    m_arena.reset();
+}
+
+void ResultSet::assign(const ResultSet& other) {
+    if (this == &other) return;
+    clear();
+    m_columns = other.m_columns;
+    m_status = other.m_status;
+    m_cells.reserve(other.m_cells.size());
+    for (size_t r = 0; r < other.m_rows; ++r) {
+        addRow();
+        for (size_t c = 0; c < m_columns.size(); ++c) setValue(static_cast<int>(c), other.at(r, static_cast<int>(c)));
+    }
+}
+
+const Value& ResultSet::at(size_t row, int col) const {
+    static const Value null = Value();
+    if (col < 0 || row >= m_rows) return null;
+    return m_cells[row * m_columns.size() + col];
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump allocator holding the string payload of one query result. Nothing
+// is freed individually; all blocks go away with the arena, or are
+// rewound by reset() to be filled again.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 4096);
+    ~Arena();
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    char* alloc(size_t n);
+    // Returns the unused tail of the most recent alloc() of `reserved` bytes.
+    void trimLast(size_t reserved, size_t used);
+    const char* copy(const char* s, size_t n);
+    // Forgets every allocation. Full-size blocks are kept for the next
+    // ones; oversized ones are freed.
+    void reset();
+
+    size_t blockCount() const { return m_blocks.size() + m_large.size(); }
+    size_t bytesUsed() const { return m_used; }
+
+private:
+    std::vector<char*> m_blocks; // full-size, in the order they are filled
+    std::vector<char*> m_large;  // one oversized allocation each
+    size_t m_next;               // the next of m_blocks to fill
+    char* m_cur;
+    char* m_last; // start of the most recent allocation in the current block
+    size_t m_left;
+    size_t m_blockSize;
+    size_t m_used;
+};
+
+enum class ValueType : uint8_t {
+    Null,
+    Int,
+    Uint,
+    Bool,
+    String // UTF-8 in the owning ResultSet's arena
+};
+
+struct StrRef {
+    const char* p;
+    uint32_t n;
+};
+
+struct Value {
+    ValueType type;
+    union {
+        int64_t i;
+        uint64_t u;
+        bool b;
+        StrRef s;
+    };
+
+    bool isNull() const { return type == ValueType::Null; }
+    bool isTrue() const { return type == ValueType::Bool && b; }
+    // Numeric view; strings holding a decimal number are parsed, anything
+    // else is 0.
+    uint64_t asUint() const;
+    // Same type and content; strings compare by bytes.
+    bool equals(const Value& other) const;
+};
+
+// How a query ended. A result that isn't Complete holds the rows that
+// arrived before its source gave up.
+enum class QueryStatus : uint8_t {
+    Complete,
+    TimedOut,
+    Cancelled
+};
+
+// "complete", "timed_out" or "cancelled", as written to structured output.
+const char* queryStatusName(QueryStatus status);
+
+// Rows of one query. Property names are interned once as column ids and
+// every cell is a typed Value, stored row-major. Look columns up with
+// column() once per result and index cells with at().
+class ResultSet {
+public:
+    ResultSet() : m_rows(0), m_status(QueryStatus::Complete) {}
+    ResultSet(ResultSet&& other) noexcept;
+    ResultSet& operator=(ResultSet&& other) noexcept;
+    ResultSet(const ResultSet&) = delete;
+    ResultSet& operator=(const ResultSet&) = delete;
+
+    // Interns a column name and returns its index. Adding a column after
+    // rows exist widens every row with NULLs.
+    int addColumn(const char* name, size_t len);
+    int addColumn(const std::string& name) { return addColumn(name.data(), name.size()); }
+    // Index of a column, or -1. Linear over a handful of names; call once
+    // per result, not per cell.
+    int column(const char* name) const;
+    size_t columnCount() const { return m_columns.size(); }
+    const std::string& columnName(int col) const { return m_columns[col]; }
+
+    size_t rowCount() const { return m_rows; }
+    bool empty() const { return m_rows == 0; }
+    // Appends a row of NULLs; the set* functions fill the last row.
+    void addRow();
+
+    void setInt(int col, int64_t v);
+    void setUint(int col, uint64_t v);
+    void setBool(int col, bool v);
+    void setString(int col, const char* s, size_t n);
+    // Stores UTF-16/32 text converted to UTF-8 straight into the arena.
+    void setWide(int col, const wchar_t* s, size_t n);
+    // Copies a value from another result, string payload included.
+    void setValue(int col, const Value& v);
+    // The same for a cell of any row. A replaced string stays in the arena
+    // until the result is cloned.
+    void setValue(size_t row, int col, const Value& v);
+    // Drops a row; the last row takes its place.
+    void removeRow(size_t row);
+
+    QueryStatus status() const { return m_status; }
+    void setStatus(QueryStatus status) { m_status = status; }
+    bool partial() const { return m_status != QueryStatus::Complete; }
+
+    // Deep copy with its own arena (results are move-only otherwise).
+    ResultSet clone() const;
+    // Back to no columns and no rows, keeping the cell and arena storage
+    // for the next rows; sources fill a caller's result this way.
+    void clear();
+    // A deep copy of `other` into this result's storage.
+    void assign(const ResultSet& other);
+
+    // NULL for col == -1, so callers can pass an unresolved column.
+    const Value& at(size_t row, int col) const;
+
+    Arena& arena() { return m_arena; }
+    const Arena& arena() const { return m_arena; }
+
+private:
+    Value& cell(int col) { return m_cells[(m_rows - 1) * m_columns.size() + col]; }
+
+    std::vector<std::string> m_columns;
+    std::vector<Value> m_cells;
+    size_t m_rows;
+    QueryStatus m_status;
+    Arena m_arena;
+};
@@ -0,0 +1,159 @@
+#include "sampler.h"
+
+#include <iomanip>
+#include <ostream>
+
+namespace {
+
+uint64_t delta(uint64_t prev, uint64_t cur) {
+    return cur > prev ? cur - prev : 0;
+}
+
+double busyPercent(const CounterSample::Cpu& prev, const CounterSample::Cpu& cur) {
+    const uint64_t total = delta(prev.total, cur.total);
+    return total ? 100.0 * delta(prev.busy, cur.busy) / total : 0.0;
+}
+
+// Index of the entry named `name` in `list`, trying `hint` first since
+// devices rarely move between samples; -1 if absent.
+template <class Entry>
+int findByName(const Entry* list, uint32_t count, const char* name, uint32_t hint) {
+    if (hint < count && std::strcmp(list[hint].name, name) == 0) return static_cast<int>(hint);
+    for (uint32_t k = 0; k < count; ++k) {
+        if (std::strcmp(list[k].name, name) == 0) return static_cast<int>(k);
+    }
+    return -1;
+}
+
+std::wstring wide(const char* s) {
+    return std::wstring(s, s + std::strlen(s)); // device names are ASCII
+}
+
+} // namespace
+
+void computeRates(const CounterSample& prev, const CounterSample& cur, Rates& out) {
+    const double seconds = cur.timeNs > prev.timeNs ? (cur.timeNs - prev.timeNs) / 1e9 : 0.0;
+    const double perSec = seconds > 0 ? 1.0 / seconds : 0.0;
+    out.seconds = seconds;
+
+    out.cpuAllBusy = busyPercent(prev.cpuAll, cur.cpuAll);
+    out.cpuCount = cur.cpuCount < prev.cpuCount ? cur.cpuCount : prev.cpuCount;
+    for (uint32_t k = 0; k < out.cpuCount; ++k) out.cpuBusy[k] = busyPercent(prev.cpu[k], cur.cpu[k]);
+
+    out.memTotal = cur.memTotal;
+    out.memAvailable = cur.memAvailable;
+    out.memUsed = cur.memTotal ? 100.0 * (cur.memTotal - (cur.memAvailable < cur.memTotal ? cur.memAvailable : cur.memTotal)) / cur.memTotal : 0.0;
+    out.swapUsed = cur.swapTotal ? 100.0 * (cur.swapTotal - (cur.swapFree < cur.swapTotal ? cur.swapFree : cur.swapTotal)) / cur.swapTotal : 0.0;
+    out.hasMemStall = prev.hasMemStall && cur.hasMemStall;
+    out.memStall = out.hasMemStall && seconds > 0 ? delta(prev.memStallUs, cur.memStallUs) / (seconds * 1e4) : 0.0;
+    out.hasPageIns = prev.hasPageIns && cur.hasPageIns;
+    out.pageInsPerSec = out.hasPageIns ? delta(prev.pageIns, cur.pageIns) * perSec : 0.0;
+
+    out.diskCount = 0;
+    for (uint32_t k = 0; k < cur.diskCount; ++k) {
+        const CounterSample::Disk& c = cur.disk[k];
+        const int p = findByName(prev.disk, prev.diskCount, c.name, k);
+        if (p < 0) continue;
+        const CounterSample::Disk& b = prev.disk[p];
+        Rates::Disk& r = out.disk[out.diskCount++];
+        std::memcpy(r.name, c.name, sizeof(r.name));
+        r.readsPerSec = delta(b.reads, c.reads) * perSec;
+        r.writesPerSec = delta(b.writes, c.writes) * perSec;
+        r.readBytesPerSec = delta(b.readBytes, c.readBytes) * perSec;
+        r.writeBytesPerSec = delta(b.writeBytes, c.writeBytes) * perSec;
+    }
+
+    out.nicCount = 0;
+    for (uint32_t k = 0; k < cur.nicCount; ++k) {
+        const CounterSample::Nic& c = cur.nic[k];
+        const int p = findByName(prev.nic, prev.nicCount, c.name, k);
+        if (p < 0) continue;
+        Rates::Nic& r = out.nic[out.nicCount++];
+        std::memcpy(r.name, c.name, sizeof(r.name));
+        r.rxBytesPerSec = delta(prev.nic[p].rxBytes, c.rxBytes) * perSec;
+        r.txBytesPerSec = delta(prev.nic[p].txBytes, c.txBytes) * perSec;
+    }
+}
+
+Sampler::Sampler(std::chrono::milliseconds period)
+    : m_period(period), m_ring(new SampleRing<CounterSample, kRingSize>()), m_stopping(false) {}
+
+Sampler::~Sampler() {
+    stop();
+}
+
+void Sampler::start() {
+    if (m_thread.joinable()) return;
+    m_stopping = false;
+    m_thread = std::thread(&Sampler::run, this);
+}
+
+void Sampler::stop() {
+    m_stopping = true;
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void Sampler::run() {
+    CounterReader reader;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (!m_stopping) {
+        CounterSample& sample = m_ring->beginWrite();
+        if (reader.read(sample)) {
+            m_ring->publish();
+        } else {
+            m_ring->discard();
+        }
+        // A missed tick (e.g. the machine was suspended) restarts the
+        // schedule rather than sampling back-to-back to catch up.
+        next += m_period;
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (next < now) next = now + m_period;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+bool Sampler::rates(std::chrono::milliseconds window, Rates& out) const {
+    const uint64_t published = m_ring->published();
+    if (published < 2) return false;
+    const uint64_t newest = published - 1;
+    uint64_t back = m_period.count() ? static_cast<uint64_t>(window.count() / m_period.count()) : 1;
+    if (back == 0) back = 1;
+    // The oldest slot is the next to be overwritten; leave it alone.
+    const uint64_t reach = newest < kRingSize - 2 ? newest : kRingSize - 2;
+    if (back > reach) back = reach;
+    // Two samples are ~20 KB: keep them off the (small, on Windows) stack
+    // of whatever thread asks, without allocating per call.
+    static thread_local std::unique_ptr<CounterSample[]> scratch;
+    if (!scratch) scratch.reset(new CounterSample[2]);
+    if (!m_ring->read(newest - back, scratch[0]) || !m_ring->read(newest, scratch[1])) return false;
+    computeRates(scratch[0], scratch[1], out);
+    return true;
+}
+
+void printUtilization(const Rates& r, std::wostream& out) {
+    out << L"\n[Live Utilization (" << std::fixed << std::setprecision(2) << r.seconds << L" s)]" << std::endl;
+    out << L"  CPU (all cores)  : " << std::fixed << std::setprecision(2) << r.cpuAllBusy << L" % busy" << std::endl;
+    for (uint32_t k = 0; k < r.cpuCount; ++k) {
+        out << L"    Core " << std::left << std::setw(10) << k << std::right << L": " << std::fixed << std::setprecision(2)
+            << r.cpuBusy[k] << L" %" << std::endl;
+    }
+    out << L"  Memory Used      : " << std::fixed << std::setprecision(2) << r.memUsed << L" % (available "
+        << (r.memAvailable / (1024.0 * 1024.0 * 1024.0)) << L" of " << (r.memTotal / (1024.0 * 1024.0 * 1024.0)) << L" GB)"
+        << std::endl;
+    out << L"  Swap Used        : " << std::fixed << std::setprecision(2) << r.swapUsed << L" %" << std::endl;
+    if (r.hasMemStall) out << L"  Memory Stall     : " << std::fixed << std::setprecision(2) << r.memStall << L" % of time" << std::endl;
+    if (r.hasPageIns) out << L"  Page Ins/s       : " << std::fixed << std::setprecision(2) << r.pageInsPerSec << std::endl;
+    for (uint32_t k = 0; k < r.diskCount; ++k) {
+        const Rates::Disk& d = r.disk[k];
+        out << L"  Disk " << wide(d.name) << std::endl;
+        out << L"    IOPS (r/w)     : " << std::fixed << std::setprecision(2) << d.readsPerSec << L" / " << d.writesPerSec << std::endl;
+        out << L"    MB/s (r/w)     : " << std::fixed << std::setprecision(2) << d.readBytesPerSec / 1e6 << L" / "
+            << d.writeBytesPerSec / 1e6 << std::endl;
+    }
+    for (uint32_t k = 0; k < r.nicCount; ++k) {
+        const Rates::Nic& n = r.nic[k];
+        out << L"  Network " << wide(n.name) << std::endl;
+        out << L"    MB/s (rx/tx)   : " << std::fixed << std::setprecision(2) << n.rxBytesPerSec / 1e6 << L" / "
+            << n.txBytesPerSec / 1e6 << std::endl;
+    }
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <memory>
+#include <thread>
+
+// Live utilisation: per-core busy %, memory pressure, per-disk IOPS and
+// bytes/s, per-NIC rx/tx bytes/s. A background thread reads the raw
+// cumulative counters into a fixed ring of samples; rates are the deltas
+// between two samples. Samples and rates are fixed-size, so steady-state
+// sampling allocates nothing.
+
+const size_t kMaxSampledCpus = 256;
+const size_t kMaxSampledDisks = 64;
+const size_t kMaxSampledNics = 32;
+const size_t kSampleNameLen = 32;
+
+// Raw counters at one instant, as the OS reports them (cumulative since
+// boot unless noted). Units only need to be consistent between samples.
+struct CounterSample {
+    uint64_t timeNs; // steady clock
+
+    struct Cpu {
+        uint64_t busy;  // time not idle
+        uint64_t total; // all time
+    };
+    uint32_t cpuCount;
+    Cpu cpuAll;
+    Cpu cpu[kMaxSampledCpus];
+
+    uint64_t memTotal;     // bytes, current value
+    uint64_t memAvailable; // bytes, current value
+    uint64_t swapTotal;    // bytes, current value
+    uint64_t swapFree;     // bytes, current value
+    uint64_t memStallUs;   // time some task waited for memory (Linux PSI)
+    uint64_t pageIns;      // pages read from disk to resolve faults (Windows)
+    bool hasMemStall;
+    bool hasPageIns;
+
+    struct Disk {
+        char name[kSampleNameLen];
+        uint64_t reads, writes;          // completed I/Os
+        uint64_t readBytes, writeBytes;
+    };
+    uint32_t diskCount;
+    Disk disk[kMaxSampledDisks];
+
+    struct Nic {
+        char name[kSampleNameLen];
+        uint64_t rxBytes, txBytes;
+    };
+    uint32_t nicCount;
+    Nic nic[kMaxSampledNics];
+};
+
+// Per-second rates between two samples.
+struct Rates {
+    double seconds; // between the two samples
+
+    uint32_t cpuCount;
+    double cpuAllBusy; // percent
+    double cpuBusy[kMaxSampledCpus];
+
+    uint64_t memTotal, memAvailable;
+    double memUsed;  // percent
+    double swapUsed; // percent
+    double memStall; // percent of the interval; valid with hasMemStall
+    double pageInsPerSec; // valid with hasPageIns
+    bool hasMemStall;
+    bool hasPageIns;
+
+    struct Disk {
+        char name[kSampleNameLen];
+        double readsPerSec, writesPerSec;
+        double readBytesPerSec, writeBytesPerSec;
+    };
+    uint32_t diskCount;
+    Disk disk[kMaxSampledDisks];
+
+    struct Nic {
+        char name[kSampleNameLen];
+        double rxBytesPerSec, txBytesPerSec;
+    };
+    uint32_t nicCount;
+    Nic nic[kMaxSampledNics];
+};
+
+// Rates from `prev` to `cur`. Devices are matched by name, so one that
+// appeared in between is left out and a counter that went backwards (a
+// reset) counts as zero.
+void computeRates(const CounterSample& prev, const CounterSample& cur, Rates& out);
+
+// Reads the platform's counters: /proc on Linux, PDH on Windows.
+class CounterReader {
+public:
+    CounterReader();
+    ~CounterReader();
+    CounterReader(const CounterReader&) = delete;
+    CounterReader& operator=(const CounterReader&) = delete;
+
+    // Fills `out` (timeNs included); false if nothing could be read.
+    bool read(CounterSample& out);
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
+
+// Single-writer ring of the last N values. The writer never waits;
+// readers copy a slot out and retry if the writer lapped them meanwhile
+// (a sequence lock per slot).
+template <class T, size_t N>
+class SampleRing {
+public:
+    SampleRing() : m_next(0) {
+        for (size_t k = 0; k < N; ++k) {
+            m_slots[k].seq.store(0, std::memory_order_relaxed);
+            m_slots[k].index = kNone;
+        }
+    }
+
+    // Writer: the slot for the next value, then publish() or discard() it.
+    // The value it held before is gone either way.
+    T& beginWrite() {
+        Slot& s = m_slots[m_next.load(std::memory_order_relaxed) % N];
+        s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // odd: being written
+        std::atomic_thread_fence(std::memory_order_release);
+        s.index = kNone;
+        return s.value;
+    }
+    void publish() {
+        const uint64_t n = m_next.load(std::memory_order_relaxed);
+        Slot& s = m_slots[n % N];
+        s.index = n;
+        s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release); // even: stable
+        m_next.store(n + 1, std::memory_order_release);
+    }
+    void discard() {
+        Slot& s = m_slots[m_next.load(std::memory_order_relaxed) % N];
+        s.seq.store(s.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Number of values ever published.
+    uint64_t published() const { return m_next.load(std::memory_order_acquire); }
+
+    // Copies value `index` into `out`; false if it was overwritten or
+    // isn't published yet.
+    bool read(uint64_t index, T& out) const {
+        if (index >= published()) return false;
+        const Slot& s = m_slots[index % N];
+        for (;;) {
+            const uint64_t before = s.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            const uint64_t held = s.index;
+            std::memcpy(static_cast<void*>(&out), &s.value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) != before) continue;
+            return held == index;
+        }
+    }
+
+private:
+    static const uint64_t kNone = ~uint64_t(0);
+
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        uint64_t index; // which value the slot holds; kNone while written
+        T value;
+    };
+    Slot m_slots[N];
+    std::atomic<uint64_t> m_next;
+};
+
+// Samples the counters every `period` on a background thread.
+class Sampler {
+public:
+    static const size_t kRingSize = 128;
+
+    explicit Sampler(std::chrono::milliseconds period);
+    ~Sampler();
+
+    void start();
+    void stop();
+
+    // Rates between the newest sample and the one about `window` older
+    // (or the oldest still in the ring). False until two samples exist.
+    // Safe to call from any thread while sampling runs.
+    bool rates(std::chrono::milliseconds window, Rates& out) const;
+
+    std::chrono::milliseconds period() const { return m_period; }
+
+private:
+    void run();
+
+    std::chrono::milliseconds m_period;
+    std::unique_ptr<SampleRing<CounterSample, kRingSize> > m_ring;
+    std::atomic<bool> m_stopping;
+    std::thread m_thread;
+};
+
+// Prints the "[Live Utilization]" section for `rates`.
+void printUtilization(const Rates& rates, std::wostream& out);
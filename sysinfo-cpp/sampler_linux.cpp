@@ -0,0 +1,162 @@
+#include "sampler.h"
+
+#include <string>
+#include <sys/stat.h>
+#include <utility>
+#include <vector>
+
+#include "procfs.h"
+
+namespace {
+
+// Whitespace-separated tokens of a line.
+class Fields {
+public:
+    explicit Fields(Slice line) : m_p(line.p), m_end(line.p + line.n) {}
+    bool next(Slice& out) {
+        while (m_p < m_end && (*m_p == ' ' || *m_p == '\t')) ++m_p;
+        if (m_p == m_end) return false;
+        const char* b = m_p;
+        while (m_p < m_end && *m_p != ' ' && *m_p != '\t') ++m_p;
+        out = Slice(b, m_p - b);
+        return true;
+    }
+    uint64_t u64() {
+        Slice s;
+        return next(s) ? s.toU64() : 0;
+    }
+
+private:
+    const char* m_p;
+    const char* m_end;
+};
+
+void copyName(char (&dst)[kSampleNameLen], Slice name) {
+    const size_t n = name.n < kSampleNameLen - 1 ? name.n : kSampleNameLen - 1;
+    std::memcpy(dst, name.p, n);
+    dst[n] = '\0';
+}
+
+// "cpu  user nice system idle iowait irq softirq steal ..." in jiffies;
+// guest time is already part of user.
+CounterSample::Cpu cpuTimes(Fields& f) {
+    uint64_t t[8];
+    for (int k = 0; k < 8; ++k) t[k] = f.u64();
+    CounterSample::Cpu c;
+    c.total = t[0] + t[1] + t[2] + t[3] + t[4] + t[5] + t[6] + t[7];
+    c.busy = c.total - t[3] - t[4];
+    return c;
+}
+
+} // namespace
+
+struct CounterReader::State {
+    FileReader reader;
+    // /proc/diskstats lists partitions and virtual devices too; whether a
+    // name is a whole, real disk is looked up once.
+    std::vector<std::pair<std::string, bool> > diskKinds;
+
+    bool isWholeDisk(Slice name) {
+        for (size_t k = 0; k < diskKinds.size(); ++k) {
+            if (name.equals(diskKinds[k].first.c_str())) return diskKinds[k].second;
+        }
+        const std::string n(name.p, name.n);
+        struct stat st;
+        const bool whole = n.compare(0, 4, "loop") != 0 && n.compare(0, 3, "ram") != 0 &&
+                           stat(("/sys/block/" + n).c_str(), &st) == 0;
+        diskKinds.push_back(std::make_pair(n, whole));
+        return whole;
+    }
+};
+
+CounterReader::CounterReader() : m_state(new State()) {}
+
+CounterReader::~CounterReader() {}
+
+bool CounterReader::read(CounterSample& out) {
+    FileReader& r = m_state->reader;
+    Slice text, line, tok;
+    out.timeNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    if (!r.read("/proc/stat", text)) return false;
+    out.cpuCount = 0;
+    out.cpuAll.busy = out.cpuAll.total = 0;
+    for (LineReader lines(text); lines.next(line) && line.startsWith("cpu");) {
+        Fields f(line);
+        f.next(tok);
+        if (tok.n == 3) {
+            out.cpuAll = cpuTimes(f);
+        } else if (out.cpuCount < kMaxSampledCpus) {
+            out.cpu[out.cpuCount++] = cpuTimes(f);
+        }
+    }
+
+    out.memTotal = out.memAvailable = out.swapTotal = out.swapFree = 0;
+    if (r.read("/proc/meminfo", text)) {
+        Slice key, value;
+        for (LineReader lines(text); lines.next(line);) {
+            if (!line.split(':', key, value)) continue;
+            uint64_t* field = key.equals("MemTotal") ? &out.memTotal
+                            : key.equals("MemAvailable") ? &out.memAvailable
+                            : key.equals("SwapTotal") ? &out.swapTotal
+                            : key.equals("SwapFree") ? &out.swapFree
+                            : nullptr;
+            if (field) *field = value.toU64() * 1024;
+        }
+    }
+
+    // "some avg10=0.00 avg60=0.00 avg300=0.00 total=<us>"
+    out.hasMemStall = false;
+    out.memStallUs = 0;
+    if (r.read("/proc/pressure/memory", text) && LineReader(text).next(line) && line.startsWith("some")) {
+        Fields f(line);
+        while (f.next(tok)) {
+            if (tok.startsWith("total=")) {
+                out.memStallUs = Slice(tok.p + 6, tok.n - 6).toU64();
+                out.hasMemStall = true;
+            }
+        }
+    }
+    out.hasPageIns = false;
+    out.pageIns = 0;
+
+    // "major minor name reads merged sectors ms writes merged sectors ..."
+    // Sectors are always 512 bytes here, whatever the device's.
+    out.diskCount = 0;
+    if (r.read("/proc/diskstats", text)) {
+        for (LineReader lines(text); lines.next(line) && out.diskCount < kMaxSampledDisks;) {
+            Fields f(line);
+            Slice name;
+            f.next(tok);
+            f.next(tok);
+            if (!f.next(name) || !m_state->isWholeDisk(name)) continue;
+            CounterSample::Disk& d = out.disk[out.diskCount++];
+            copyName(d.name, name);
+            d.reads = f.u64();
+            f.u64();
+            d.readBytes = f.u64() * 512;
+            f.u64();
+            d.writes = f.u64();
+            f.u64();
+            d.writeBytes = f.u64() * 512;
+        }
+    }
+
+    // Two header lines, then "  eth0: rxBytes packets errs drop fifo frame
+    // compressed multicast txBytes ..."
+    out.nicCount = 0;
+    if (r.read("/proc/net/dev", text)) {
+        Slice name, counters;
+        for (LineReader lines(text); lines.next(line) && out.nicCount < kMaxSampledNics;) {
+            if (!line.split(':', name, counters) || name.equals("lo")) continue;
+            Fields f(counters);
+            CounterSample::Nic& n = out.nic[out.nicCount++];
+            copyName(n.name, name);
+            n.rxBytes = f.u64();
+            for (int k = 0; k < 7; ++k) f.u64();
+            n.txBytes = f.u64();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,194 @@
+#define NOMINMAX
+#include <windows.h>
+#include <pdh.h>
+
+#include <cwchar>
+#include <vector>
+
+#include "sampler.h"
+
+#pragma comment(lib, "pdh.lib")
+
+namespace {
+
+void copyName(char (&dst)[kSampleNameLen], const wchar_t* name) {
+    size_t n = 0;
+    for (; name[n] && n < kSampleNameLen - 1; ++n) dst[n] = name[n] < 0x80 ? static_cast<char>(name[n]) : '?';
+    dst[n] = '\0';
+}
+
+bool isTotal(const wchar_t* instance) {
+    return std::wcscmp(instance, L"_Total") == 0;
+}
+
+} // namespace
+
+// Raw (uncooked) PDH counters: cumulative values we difference ourselves,
+// so one collection per sample and no PDH rate computation.
+struct CounterReader::State {
+    PDH_HQUERY query;
+    PDH_HCOUNTER cpuTime;
+    PDH_HCOUNTER diskReads, diskWrites, diskReadBytes, diskWriteBytes;
+    PDH_HCOUNTER nicRx, nicTx;
+    PDH_HCOUNTER pageIns;
+    // Reused between samples; grows only when instances appear.
+    std::vector<unsigned char> buffer;
+
+    State() : query(NULL), cpuTime(NULL), diskReads(NULL), diskWrites(NULL), diskReadBytes(NULL),
+              diskWriteBytes(NULL), nicRx(NULL), nicTx(NULL), pageIns(NULL) {
+        if (PdhOpenQueryW(NULL, 0, &query) != ERROR_SUCCESS) {
+            query = NULL;
+            return;
+        }
+        add(L"\\Processor(*)\\% Processor Time", cpuTime);
+        add(L"\\PhysicalDisk(*)\\Disk Reads/sec", diskReads);
+        add(L"\\PhysicalDisk(*)\\Disk Writes/sec", diskWrites);
+        add(L"\\PhysicalDisk(*)\\Disk Read Bytes/sec", diskReadBytes);
+        add(L"\\PhysicalDisk(*)\\Disk Write Bytes/sec", diskWriteBytes);
+        add(L"\\Network Interface(*)\\Bytes Received/sec", nicRx);
+        add(L"\\Network Interface(*)\\Bytes Sent/sec", nicTx);
+        add(L"\\Memory\\Pages Input/sec", pageIns);
+    }
+    ~State() {
+        if (query) PdhCloseQuery(query);
+    }
+
+    void add(const wchar_t* path, PDH_HCOUNTER& counter) {
+        if (PdhAddEnglishCounterW(query, path, 0, &counter) != ERROR_SUCCESS) counter = NULL;
+    }
+
+    // Raw values of every instance of `counter`; the array points into
+    // `buffer` and stays valid until the next call.
+    bool instances(PDH_HCOUNTER counter, PDH_RAW_COUNTER_ITEM_W*& items, DWORD& count) {
+        if (!counter) return false;
+        for (;;) {
+            DWORD size = static_cast<DWORD>(buffer.size());
+            count = 0;
+            PDH_STATUS st = PdhGetRawCounterArrayW(counter, &size, &count,
+                                                   size ? reinterpret_cast<PDH_RAW_COUNTER_ITEM_W*>(&buffer[0]) : NULL);
+            if (st == PDH_MORE_DATA) {
+                buffer.resize(size);
+                continue;
+            }
+            items = reinterpret_cast<PDH_RAW_COUNTER_ITEM_W*>(buffer.empty() ? NULL : &buffer[0]);
+            return st == ERROR_SUCCESS;
+        }
+    }
+
+    // Raw value of `counter` for `instance`, which the counter array of the
+    // same object usually lists at the same position.
+    bool valueFor(PDH_HCOUNTER counter, const wchar_t* instance, DWORD hint, uint64_t& out) {
+        PDH_RAW_COUNTER_ITEM_W* items;
+        DWORD count;
+        if (!instances(counter, items, count)) return false;
+        if (hint < count && std::wcscmp(items[hint].szName, instance) == 0) {
+            out = static_cast<uint64_t>(items[hint].RawValue.FirstValue);
+            return true;
+        }
+        for (DWORD k = 0; k < count; ++k) {
+            if (std::wcscmp(items[k].szName, instance) == 0) {
+                out = static_cast<uint64_t>(items[k].RawValue.FirstValue);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+CounterReader::CounterReader() : m_state(new State()) {}
+
+CounterReader::~CounterReader() {}
+
+bool CounterReader::read(CounterSample& out) {
+    State& s = *m_state;
+    out.timeNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    if (!s.query || PdhCollectQueryData(s.query) != ERROR_SUCCESS) return false;
+
+    PDH_RAW_COUNTER_ITEM_W* items;
+    DWORD count;
+
+    // % Processor Time is an inverse timer: FirstValue is idle time and
+    // SecondValue the timestamp, both in 100 ns units. Instances are
+    // "0", "1", ... and "_Total" (or "0,0", "0,1" with processor groups
+    // under Processor Information, which we don't use).
+    out.cpuCount = 0;
+    out.cpuAll.busy = out.cpuAll.total = 0;
+    if (s.instances(s.cpuTime, items, count)) {
+        for (DWORD k = 0; k < count; ++k) {
+            const uint64_t total = static_cast<uint64_t>(items[k].RawValue.SecondValue);
+            const uint64_t idle = static_cast<uint64_t>(items[k].RawValue.FirstValue);
+            CounterSample::Cpu c;
+            c.total = total;
+            c.busy = total > idle ? total - idle : 0;
+            if (isTotal(items[k].szName)) {
+                out.cpuAll = c;
+                continue;
+            }
+            const unsigned long n = std::wcstoul(items[k].szName, NULL, 10);
+            if (n < kMaxSampledCpus) {
+                out.cpu[n] = c;
+                if (n + 1 > out.cpuCount) out.cpuCount = static_cast<uint32_t>(n + 1);
+            }
+        }
+    }
+
+    MEMORYSTATUSEX mem;
+    mem.dwLength = sizeof(mem);
+    if (GlobalMemoryStatusEx(&mem)) {
+        out.memTotal = mem.ullTotalPhys;
+        out.memAvailable = mem.ullAvailPhys;
+        // The page file includes physical memory; what's beyond it is swap.
+        out.swapTotal = mem.ullTotalPageFile > mem.ullTotalPhys ? mem.ullTotalPageFile - mem.ullTotalPhys : 0;
+        const uint64_t committed = mem.ullTotalPageFile - mem.ullAvailPageFile;
+        const uint64_t inSwap = committed > mem.ullTotalPhys ? committed - mem.ullTotalPhys : 0;
+        out.swapFree = out.swapTotal > inSwap ? out.swapTotal - inSwap : 0;
+    } else {
+        out.memTotal = out.memAvailable = out.swapTotal = out.swapFree = 0;
+    }
+    out.hasMemStall = false;
+    out.memStallUs = 0;
+    PDH_RAW_COUNTER raw;
+    out.hasPageIns = s.pageIns && PdhGetRawCounterValue(s.pageIns, NULL, &raw) == ERROR_SUCCESS;
+    out.pageIns = out.hasPageIns ? static_cast<uint64_t>(raw.FirstValue) : 0;
+
+    // Instances are "0 C:", "1 D: E:", ...; the counters of one object
+    // list them in the same order.
+    out.diskCount = 0;
+    if (s.instances(s.diskReads, items, count)) {
+        // The other disk counters reuse the buffer, so keep the names.
+        wchar_t names[kMaxSampledDisks][128];
+        for (DWORD k = 0; k < count && out.diskCount < kMaxSampledDisks; ++k) {
+            if (isTotal(items[k].szName)) continue;
+            CounterSample::Disk& d = out.disk[out.diskCount];
+            copyName(d.name, items[k].szName);
+            wcsncpy_s(names[out.diskCount], items[k].szName, _TRUNCATE);
+            d.reads = static_cast<uint64_t>(items[k].RawValue.FirstValue);
+            ++out.diskCount;
+        }
+        for (uint32_t k = 0; k < out.diskCount; ++k) {
+            CounterSample::Disk& d = out.disk[k];
+            d.writes = d.readBytes = d.writeBytes = 0;
+            s.valueFor(s.diskWrites, names[k], k, d.writes);
+            s.valueFor(s.diskReadBytes, names[k], k, d.readBytes);
+            s.valueFor(s.diskWriteBytes, names[k], k, d.writeBytes);
+        }
+    }
+
+    out.nicCount = 0;
+    if (s.instances(s.nicRx, items, count)) {
+        wchar_t names[kMaxSampledNics][128];
+        for (DWORD k = 0; k < count && out.nicCount < kMaxSampledNics; ++k) {
+            CounterSample::Nic& n = out.nic[out.nicCount];
+            copyName(n.name, items[k].szName);
+            wcsncpy_s(names[out.nicCount], items[k].szName, _TRUNCATE);
+            n.rxBytes = static_cast<uint64_t>(items[k].RawValue.FirstValue);
+            ++out.nicCount;
+        }
+        for (uint32_t k = 0; k < out.nicCount; ++k) {
+            out.nic[k].txBytes = 0;
+            s.valueFor(s.nicTx, names[k], k, out.nic[k].txBytes);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,310 @@
+#include "schema.h"
+
+#include <iomanip>
+#include <ostream>
+
+#include "sections.h"
+
+namespace {
+
+const FieldDef kOperatingSystemFields[] = {
+    { "Caption", L"  System Name      : ", nullptr, nullptr, FieldFormat::Text, "/etc/os-release PRETTY_NAME", false },
+    { "OSArchitecture", nullptr, L" (", L")", FieldFormat::Text, "uname machine", false },
+    { "Version", L"  Version/Build    : ", nullptr, nullptr, FieldFormat::Text, "/proc/sys/kernel/osrelease", false },
+    { "BuildNumber", nullptr, L" / ", nullptr, FieldFormat::Text, "/proc/sys/kernel/version", false },
+    { "SerialNumber", L"  Serial Number    : ", nullptr, nullptr, FieldFormat::Text, "/etc/machine-id", false },
+    { "InstallDate", L"  Install Date     : ", nullptr, nullptr, FieldFormat::Text, "not available", false },
+    { "LastBootUpTime", L"  Last Boot        : ", nullptr, nullptr, FieldFormat::Text, "/proc/stat btime", true },
+    { "RegisteredUser", L"  Registered User  : ", nullptr, nullptr, FieldFormat::Text, "not available", false },
+    { "Organization", L"  Organization     : ", nullptr, nullptr, FieldFormat::Text, "not available", false },
+    { "BootDevice", L"  Boot Device      : ", nullptr, nullptr, FieldFormat::Text, "/proc/self/mountinfo source of /", false },
+    { "WindowsDirectory", L"  Windows Dir      : ", nullptr, nullptr, FieldFormat::Text, "not available", false },
+    { "SystemDirectory", L"  System Dir       : ", nullptr, nullptr, FieldFormat::Text, "not available", false },
+    { "Locale", L"  Locale/Country   : ", nullptr, nullptr, FieldFormat::Text, "LC_ALL, LC_MESSAGES or LANG", false },
+    { "CountryCode", nullptr, L" / ", nullptr, FieldFormat::Text, "not available", false },
+    { "OSLanguage", nullptr, L" (Lang: ", L")", FieldFormat::Text, "not available", false },
+    { "TotalVisibleMemorySize", L"  Total Memory (GB): ", nullptr, nullptr, FieldFormat::KiBAsGiB, "/proc/meminfo MemTotal", false },
+    { "FreePhysicalMemory", L"  Free Memory (GB) : ", nullptr, nullptr, FieldFormat::KiBAsGiB, "/proc/meminfo MemAvailable", true },
+};
+
+const FieldDef kProcessorFields[] = {
+    { "Name", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/cpuinfo model name", false },
+    { "NumberOfCores", L"    Cores/Threads   : ", nullptr, nullptr, FieldFormat::Text, "/proc/cpuinfo core id per package", false },
+    { "NumberOfLogicalProcessors", nullptr, L" / ", nullptr, FieldFormat::Text, "/proc/cpuinfo processors per package", false },
+    { "MaxClockSpeed", L"    Max Clock (MHz) : ", nullptr, nullptr, FieldFormat::Text, "cpufreq/cpuinfo_max_freq, else /proc/cpuinfo cpu MHz", false },
+    { "Manufacturer", L"    Manufacturer    : ", nullptr, nullptr, FieldFormat::Text, "/proc/cpuinfo vendor_id", false },
+    { "ProcessorId", L"    Processor ID    : ", nullptr, nullptr, FieldFormat::Text, "cpuid leaf 1", false },
+    { "SocketDesignation", L"    Socket          : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 4", false },
+    { "L2CacheSize", L"    L2 Cache (KB)   : ", nullptr, nullptr, FieldFormat::Text, "cpu0/cache/index*/size per package", false },
+    { "L3CacheSize", L"    L3 Cache (KB)   : ", nullptr, nullptr, FieldFormat::Text, "cpu0/cache/index*/size per package", false },
+    { "VirtualizationFirmwareEnabled", L"    Virtualization  : ", nullptr, nullptr, FieldFormat::Text, "/proc/cpuinfo vmx or svm flag", false },
+};
+
+const FieldDef kPhysicalMemoryFields[] = {
+    { "BankLabel", nullptr, nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17, else \"System RAM\"", false },
+    { "DeviceLocator", L"    Locator         : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17", false },
+    { "Capacity", L"    Capacity (GB)   : ", nullptr, nullptr, FieldFormat::BytesAsGiB, "SMBIOS type 17, else /proc/meminfo MemTotal", false },
+    { "Speed", L"    Speed (MHz)     : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17", false },
+    { "MemoryType", L"    Type            : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17", false },
+    { "FormFactor", nullptr, L" (FormFactor: ", L")", FieldFormat::Text, "SMBIOS type 17", false },
+    { "Manufacturer", L"    Manufacturer    : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17", false },
+    { "SerialNumber", L"    Serial Number   : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17", false },
+    { "PartNumber", L"    Part Number     : ", nullptr, nullptr, FieldFormat::Text, "SMBIOS type 17", false },
+};
+
+const FieldDef kVideoControllerFields[] = {
+    { "Name", nullptr, nullptr, nullptr, FieldFormat::Text, "PCI display device vendor:device", false },
+    { "DriverVersion", L"    Driver Version  : ", nullptr, nullptr, FieldFormat::Text, "/sys/module/<driver>/version", false },
+    { "AdapterRAM", L"    VRAM (MB)       : ", nullptr, nullptr, FieldFormat::BytesAsMiB, "mem_info_vram_total", false },
+    { "VideoProcessor", L"    Video Processor : ", nullptr, nullptr, FieldFormat::Text, "PCI display device vendor:device", false },
+    { "CurrentHorizontalResolution", L"    Resolution      : ", nullptr, nullptr, FieldFormat::Text, "DRM connector modes", true },
+    { "CurrentVerticalResolution", nullptr, L"x", nullptr, FieldFormat::Text, "DRM connector modes", true },
+    { "CurrentRefreshRate", nullptr, L" @", L"Hz", FieldFormat::Text, "not available", true },
+    { "PNPDeviceID", L"    Device ID       : ", nullptr, nullptr, FieldFormat::Text, "PCI vendor, device and slot", false },
+    { "Status", L"    Status          : ", nullptr, nullptr, FieldFormat::Text, "\"OK\" when bound to a driver", true },
+};
+
+const FieldDef kDiskDriveFields[] = {
+    { "Index", nullptr, nullptr, nullptr, FieldFormat::Text, "position in /sys/block", false },
+    { "Model", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/block/<disk>/device/model", false },
+    { "SerialNumber", L"    Serial Number   : ", nullptr, nullptr, FieldFormat::Text, "device/serial, serial or device/wwid", false },
+    { "FirmwareRevision", L"    Firmware Rev    : ", nullptr, nullptr, FieldFormat::Text, "device/firmware_rev or device/rev", false },
+    { "InterfaceType", L"    Interface Type  : ", nullptr, nullptr, FieldFormat::Text, "bus in the device path", false },
+    { "MediaType", L"    Media Type      : ", nullptr, nullptr, FieldFormat::Text, "/sys/block/<disk>/removable", false },
+    { "Size", L"    Size (GB)       : ", nullptr, nullptr, FieldFormat::BytesAsGiB, "/sys/block/<disk>/size", false },
+    { "Partitions", L"    Partitions Cnt  : ", nullptr, nullptr, FieldFormat::Text, "partition subdirectories", false },
+    { "Status", L"    Status          : ", nullptr, nullptr, FieldFormat::Text, "device/state", true },
+};
+
+const FieldDef kDiskPartitionFields[] = {
+    { "DeviceID", nullptr, nullptr, nullptr, FieldFormat::Text, "disk index and partition number", false },
+    { "DiskIndex", nullptr, nullptr, nullptr, FieldFormat::Text, "position of the disk in /sys/block", false },
+    { "Name", nullptr, nullptr, nullptr, FieldFormat::Text, "/dev/<partition>", false },
+    { "Size", L"      Size (GB)       : ", nullptr, nullptr, FieldFormat::BytesAsGiB, "/sys/block/<disk>/<partition>/size", false },
+    { "Type", L"      Type            : ", nullptr, nullptr, FieldFormat::Text, "uevent PARTNAME", false },
+    { "Bootable", L"      Bootable        : ", nullptr, nullptr, FieldFormat::Text, "mounted at /boot or /boot/efi", false },
+    { "BootPartition", nullptr, L" (System Boot Partition)", nullptr, FieldFormat::TrueMark, "mounted at /boot or /boot/efi", false },
+    { "StartingOffset", L"      Offset (Bytes)  : ", nullptr, nullptr, FieldFormat::Text, "/sys/block/<disk>/<partition>/start", false },
+};
+
+// Volume lines are printed under a caller-supplied indent.
+const FieldDef kLogicalDiskFields[] = {
+    { "DeviceID", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/self/mountinfo mount point", false },
+    { "VolumeName", nullptr, nullptr, nullptr, FieldFormat::Text, "/dev/disk/by-label", false },
+    { "FileSystem", L"  File System     : ", nullptr, nullptr, FieldFormat::Text, "/proc/self/mountinfo type", false },
+    { "Size", L"  Total Size (GB) : ", nullptr, nullptr, FieldFormat::BytesAsGiB, "statvfs", false },
+    { "FreeSpace", L"  Free Space (GB) : ", nullptr, nullptr, FieldFormat::BytesAsGiB, "statvfs", true },
+};
+
+const FieldDef kLogicalDiskToPartitionFields[] = {
+    { "Antecedent", nullptr, nullptr, nullptr, FieldFormat::Text, "partitions backing the mount, through dm/md slaves", false },
+    { "Dependent", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/self/mountinfo mount point", false },
+};
+
+const FieldDef kBaseBoardFields[] = {
+    { "Manufacturer", L"  Manufacturer     : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/board_vendor", false },
+    { "Product", L"  Product          : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/board_name", false },
+    { "SerialNumber", L"  Serial Number    : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/board_serial", false }, // root only
+    { "Version", L"  Version          : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/board_version", false },
+};
+
+const FieldDef kBiosFields[] = {
+    { "Manufacturer", L"  Manufacturer     : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/bios_vendor", false },
+    { "SMBIOSBIOSVersion", L"  Version          : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/bios_version", false },
+    { "Version", nullptr, L" (BIOS Version: ", L")", FieldFormat::Text, "/sys/class/dmi/id/bios_release", false },
+    { "ReleaseDate", L"  Release Date     : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/bios_date as a CIM datetime", false },
+    { "SerialNumber", L"  Serial Number    : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/product_serial", false }, // root only
+};
+
+const FieldDef kComputerSystemProductFields[] = {
+    { "UUID", L"  UUID: ", nullptr, nullptr, FieldFormat::Text, "/sys/class/dmi/id/product_uuid", false }, // root only
+};
+
+const FieldDef kTpmFields[] = {
+    { "SpecVersion", L"  Spec Version     : ", nullptr, nullptr, FieldFormat::Text, "tpm0/tpm_version_major", false },
+    { "ManufacturerID", L"  Manufacturer ID  : ", nullptr, nullptr, FieldFormat::Text, "tpm0/device/firmware_node/hid", false },
+    { "ManufacturerVersion", L"  Manufacturer Ver : ", nullptr, nullptr, FieldFormat::Text, "tpm0/device/description", false },
+    { "PhysicalPresenceVersionInfo", L"  Physical Presence: ", nullptr, nullptr, FieldFormat::Text, "tpm0/ppi/version", false },
+    { "IsEnabled_InitialValue", L"  Enabled          : ", nullptr, nullptr, FieldFormat::Text, "true when tpm0 exists", false },
+    { "IsActivated_InitialValue", L"  Activated        : ", nullptr, nullptr, FieldFormat::Text, "true when tpm0 exists", false },
+};
+
+const FieldDef kSoundDeviceFields[] = {
+    { "Name", L"  Name             : ", nullptr, nullptr, FieldFormat::Text, "/proc/asound/cards long name", false },
+    { "Manufacturer", L"    Manufacturer   : ", nullptr, nullptr, FieldFormat::Text, "/proc/asound/cards driver", false },
+    { "Status", L"    Status         : ", nullptr, nullptr, FieldFormat::Text, "\"OK\" when listed", true },
+    { "PNPDeviceID", L"    Device ID      : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/sound/card<n>/device", false },
+};
+
+const FieldDef kUsbDeviceFields[] = {
+    { "Name", L"  Name             : ", nullptr, nullptr, FieldFormat::Text, "/sys/bus/usb/devices/<dev>/product", false },
+    { "Description", L"    Description    : ", nullptr, nullptr, FieldFormat::Text, "product, or a generic hub/device name", false },
+    { "Manufacturer", L"    Manufacturer   : ", nullptr, nullptr, FieldFormat::Text, "/sys/bus/usb/devices/<dev>/manufacturer", false },
+    { "Status", L"    Status         : ", nullptr, nullptr, FieldFormat::Text, "\"OK\" when listed", true },
+    { "PNPDeviceID", L"    PNP Device ID  : ", nullptr, nullptr, FieldFormat::Text, "USB\\VID_<idVendor>&PID_<idProduct>\\<serial>", false },
+};
+
+const FieldDef kNetworkAdapterFields[] = {
+    { "Name", L"  Name             : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/net entry with a device", false },
+    { "MACAddress", L"    MAC Address    : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/net/<if>/address", false },
+    { "AdapterType", L"    Type           : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/net/<if>/type", false },
+    { "Speed", L"    Speed (Mbps)   : ", nullptr, nullptr, FieldFormat::BpsAsMbps, "/sys/class/net/<if>/speed", true },
+    { "Manufacturer", L"    Manufacturer   : ", nullptr, nullptr, FieldFormat::Text, "device/driver module name", false },
+    { "NetEnabled", L"    Enabled        : ", nullptr, nullptr, FieldFormat::Text, "/sys/class/net/<if>/flags IFF_UP", true },
+    { "NetConnectionStatus", L"    Status Code    : ", nullptr, L" (2=Connected, 7=Disconnected, etc.)", FieldFormat::Text, "operstate and carrier", true },
+};
+
+// Laid out as tables by printProcesses(). Every field is a reading: the
+// process list is not hardware, and --diff leaves it alone.
+const FieldDef kProcessFields[] = {
+    { "ProcessId", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/<pid>", true },
+    { "Name", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/<pid>/stat comm", true },
+    { "WorkingSetSize", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/<pid>/stat rss", true },
+    { "UserModeTime", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/<pid>/stat utime", true },
+    { "KernelModeTime", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/<pid>/stat stime", true },
+    { "ThreadCount", nullptr, nullptr, nullptr, FieldFormat::Text, "/proc/<pid>/stat num_threads", true },
+    { "Owner", nullptr, nullptr, nullptr, FieldFormat::Text, "owner of /proc/<pid>, by getpwuid_r", true },
+};
+
+// Laid out as a tree by printTopology(); answered by queryCpuTopology()
+// on both platforms (topology.h).
+const FieldDef kPackageFields[] = {
+    { "Package", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/topology/physical_package_id", false },
+    { "Cores", nullptr, nullptr, nullptr, FieldFormat::Text, "distinct core_id of the package", false },
+    { "LogicalProcessors", nullptr, nullptr, nullptr, FieldFormat::Text, "online CPUs of the package", false },
+    { "NumaNodes", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/node/node<n>/cpulist", false },
+    { "Features", nullptr, nullptr, nullptr, FieldFormat::Text, "cpuid leaves 1, 7 and 0x80000001, masked by xgetbv", false },
+};
+
+const FieldDef kNumaNodeFields[] = {
+    { "NodeId", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/node/online", false },
+    { "Cpus", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/node/node<n>/cpulist", false },
+    { "CoreCpus", nullptr, nullptr, nullptr, FieldFormat::Text, "first thread_siblings_list entry of each core", false },
+    { "AffinityMask", nullptr, nullptr, nullptr, FieldFormat::Text, "node<n>/cpulist as a hex mask", false },
+    { "MemorySize", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/node/node<n>/meminfo MemTotal", false },
+    { "Distances", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/node/node<n>/distance", false },
+};
+
+const FieldDef kLogicalProcessorFields[] = {
+    { "ProcessorId", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/online", false },
+    { "Package", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/topology/physical_package_id", false },
+    { "NumaNode", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/node/node<n>/cpulist", false },
+    { "Core", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/topology/core_id", false },
+    { "Thread", nullptr, nullptr, nullptr, FieldFormat::Text, "position in topology/thread_siblings_list", false },
+    { "CoreType", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/cpu_core/cpus, /sys/devices/cpu_atom/cpus", false },
+};
+
+const FieldDef kCacheFields[] = {
+    { "DeviceID", nullptr, nullptr, nullptr, FieldFormat::Text, "level, type and first CPU sharing it", false },
+    { "Level", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/cache/index<k>/level", false },
+    { "Type", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/cache/index<k>/type", false },
+    { "Size", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/cache/index<k>/size", false },
+    { "LineSize", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/cache/index<k>/coherency_line_size", false },
+    { "Associativity", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/cache/index<k>/ways_of_associativity", false },
+    { "SharedCpus", nullptr, nullptr, nullptr, FieldFormat::Text, "/sys/devices/system/cpu/cpu<n>/cache/index<k>/shared_cpu_list", false },
+};
+
+} // namespace
+
+const ClassSchema kOperatingSystemSchema = { L"Win32_OperatingSystem", nullptr, kOperatingSystemFields, fieldCount(kOperatingSystemFields), nullptr };
+const ClassSchema kProcessorSchema = { L"Win32_Processor", nullptr, kProcessorFields, fieldCount(kProcessorFields), "SocketDesignation" };
+const ClassSchema kPhysicalMemorySchema = { L"Win32_PhysicalMemory", nullptr, kPhysicalMemoryFields, fieldCount(kPhysicalMemoryFields), "BankLabel,DeviceLocator" };
+const ClassSchema kVideoControllerSchema = { L"Win32_VideoController", nullptr, kVideoControllerFields, fieldCount(kVideoControllerFields), "PNPDeviceID" };
+const ClassSchema kDiskDriveSchema = { L"Win32_DiskDrive", nullptr, kDiskDriveFields, fieldCount(kDiskDriveFields), "SerialNumber" };
+const ClassSchema kDiskPartitionSchema = { L"Win32_DiskPartition", nullptr, kDiskPartitionFields, fieldCount(kDiskPartitionFields), "DeviceID" };
+const ClassSchema kLogicalDiskSchema = { L"Win32_LogicalDisk", L"DriveType=3", kLogicalDiskFields, fieldCount(kLogicalDiskFields), "DeviceID" };
+// Which partitions each logical disk lives on, for the disk tree.
+const ClassSchema kLogicalDiskToPartitionSchema = { L"Win32_LogicalDiskToPartition", nullptr, kLogicalDiskToPartitionFields, fieldCount(kLogicalDiskToPartitionFields), "Dependent" };
+const ClassSchema kBaseBoardSchema = { L"Win32_BaseBoard", nullptr, kBaseBoardFields, fieldCount(kBaseBoardFields), nullptr };
+const ClassSchema kBiosSchema = { L"Win32_BIOS", nullptr, kBiosFields, fieldCount(kBiosFields), nullptr };
+const ClassSchema kComputerSystemProductSchema = { L"Win32_ComputerSystemProduct", nullptr, kComputerSystemProductFields, fieldCount(kComputerSystemProductFields), nullptr };
+// Win32_Tpm might not be available on all systems or require admin rights for some properties.
+const ClassSchema kTpmSchema = { L"Win32_Tpm", nullptr, kTpmFields, fieldCount(kTpmFields), nullptr };
+const ClassSchema kSoundDeviceSchema = { L"Win32_SoundDevice", nullptr, kSoundDeviceFields, fieldCount(kSoundDeviceFields), "PNPDeviceID" };
+// Win32_USBControllerDevice is an association class; connected USB devices
+// are easier to find as PnP entities.
+const ClassSchema kUsbDeviceSchema = { L"Win32_PnPEntity",
+    L"PNPClass = 'USB' OR Service = 'USBSTOR' OR Name LIKE '%USB Mass Storage%' OR Name LIKE '%USB Composite Device%'",
+    kUsbDeviceFields, fieldCount(kUsbDeviceFields), "PNPDeviceID" };
+const ClassSchema kNetworkAdapterSchema = { L"Win32_NetworkAdapter", L"PhysicalAdapter=True", kNetworkAdapterFields, fieldCount(kNetworkAdapterFields), "MACAddress" };
+// Answered from a native snapshot on both platforms (processes.h).
+const ClassSchema kProcessSchema = { L"Win32_Process", nullptr, kProcessFields, fieldCount(kProcessFields), "ProcessId" };
+// Not WMI classes: the processor topology, answered natively (topology.h).
+const ClassSchema kPackageSchema = { L"Sysinfo_Package", nullptr, kPackageFields, fieldCount(kPackageFields), "Package" };
+const ClassSchema kNumaNodeSchema = { L"Sysinfo_NumaNode", nullptr, kNumaNodeFields, fieldCount(kNumaNodeFields), "NodeId" };
+const ClassSchema kLogicalProcessorSchema = { L"Sysinfo_LogicalProcessor", nullptr, kLogicalProcessorFields, fieldCount(kLogicalProcessorFields), "ProcessorId" };
+const ClassSchema kCacheSchema = { L"Sysinfo_Cache", nullptr, kCacheFields, fieldCount(kCacheFields), "DeviceID" };
+
+const ClassSchema* findClassSchema(const std::wstring& cls) {
+    static const ClassSchema* const all[] = {
+        &kOperatingSystemSchema, &kProcessorSchema, &kPhysicalMemorySchema, &kVideoControllerSchema,
+        &kDiskDriveSchema, &kDiskPartitionSchema, &kLogicalDiskSchema, &kLogicalDiskToPartitionSchema,
+        &kBaseBoardSchema, &kBiosSchema, &kComputerSystemProductSchema, &kTpmSchema,
+        &kSoundDeviceSchema, &kUsbDeviceSchema, &kNetworkAdapterSchema, &kProcessSchema, &kPackageSchema, &kNumaNodeSchema,
+        &kLogicalProcessorSchema, &kCacheSchema,
+    };
+    for (size_t k = 0; k < sizeof(all) / sizeof(all[0]); ++k) {
+        if (cls == all[k]->cls) return all[k];
+    }
+    return nullptr;
+}
+
+std::wstring schemaQuery(const ClassSchema& schema) {
+    std::wstring wql = L"SELECT ";
+    for (size_t f = 0; f < schema.fieldCount; ++f) {
+        if (f) wql += L", ";
+        for (const char* p = schema.fields[f].property; *p; ++p) wql.push_back(static_cast<wchar_t>(*p)); // ASCII
+    }
+    wql += L" FROM ";
+    wql += schema.cls;
+    if (schema.where) {
+        wql += L" WHERE ";
+        wql += schema.where;
+    }
+    return wql;
+}
+
+FieldSlots::FieldSlots(const ClassSchema& schema, const ResultSet& rs) {
+    for (size_t f = 0; f < schema.fieldCount; ++f) m_slots[f] = rs.column(schema.fields[f].property);
+}
+
+void printFields(const ClassSchema& schema, const FieldSlots& slots, const ResultSet& rs, size_t row,
+                 const wchar_t* indent, std::wostream& out) {
+    bool shown = false; // the current line is being printed
+    for (size_t f = 0; f < schema.fieldCount; ++f) {
+        const FieldDef& field = schema.fields[f];
+        if (field.label) {
+            if (shown) out << std::endl;
+            shown = false;
+            for (size_t g = f; g < schema.fieldCount && !shown; ++g) {
+                if (g > f && !schema.fields[g].before) break;
+                shown = slots[g] >= 0;
+            }
+            if (shown) out << indent << field.label;
+        } else if (!field.before) {
+            if (shown) out << std::endl;
+            shown = false;
+        }
+        if (!shown) continue;
+
+        const int col = slots[f];
+        if (field.format == FieldFormat::TrueMark) {
+            if (rs.at(row, col).isTrue()) out << field.before;
+            continue;
+        }
+        if (field.before) out << field.before;
+        switch (field.format) {
+        case FieldFormat::KiBAsGiB:
+            out << std::fixed << std::setprecision(2) << (safeU64(rs, row, col) / (1024.0 * 1024.0));
+            break;
+        case FieldFormat::BytesAsGiB:
+            out << std::fixed << std::setprecision(2) << (safeU64(rs, row, col) / (1024.0 * 1024.0 * 1024.0));
+            break;
+        case FieldFormat::BytesAsMiB: out << (safeU64(rs, row, col) / (1024 * 1024)); break;
+        case FieldFormat::BpsAsMbps: out << (safeU64(rs, row, col) / (1000 * 1000)); break;
+        default: out << safeGet(rs, row, col); break;
+        }
+        if (field.after) out << field.after;
+    }
+    if (shown) out << std::endl;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "resultset.h"
+
+// Declarative description of what the report reads from each WMI class.
+// A section's query text, the column slots its renderer uses and the
+// properties that reach the structured output all come from one table per
+// class, so a property is queried exactly when something prints it.
+
+// How the text report shows a property.
+enum class FieldFormat : uint8_t {
+    Text,       // as reported; "Unknown" when null or empty
+    KiBAsGiB,   // kilobytes, shown as GB with two decimals
+    BytesAsGiB, // bytes, shown as GB with two decimals
+    BytesAsMiB, // bytes, shown as whole MB
+    BpsAsMbps,  // bits per second, shown as whole Mbps
+    TrueMark    // shows `before` when the value is true, nothing otherwise
+};
+
+// One property of a class. Detail lines are laid out by the table: a field
+// with a label starts a line, one with only `before` continues the line
+// above, and one with neither is queried for the section's own code (row
+// titles, keys for joining rows) and not printed as a detail.
+struct FieldDef {
+    const char* property;    // WMI property and ResultSet column
+    const wchar_t* label;    // line start, indent and padding included
+    const wchar_t* before;   // printed before the value
+    const wchar_t* after;    // printed after the value
+    FieldFormat format;
+    // Where LinuxSource gets the value. A bare sysfs path is copied
+    // verbatim; anything else says how its collector derives it.
+    const char* linuxSource;
+    // A measurement (free space, link state) rather than a property of the
+    // hardware; left out of the content hashes --diff compares (diff.h).
+    bool reading;
+};
+
+const size_t kMaxSchemaFields = 24;
+
+// Field count of a table, checked against kMaxSchemaFields at compile time.
+template <size_t N>
+constexpr size_t fieldCount(const FieldDef (&)[N]) {
+    static_assert(N <= kMaxSchemaFields, "too many fields for FieldSlots");
+    return N;
+}
+
+// A WMI class as one query selects it.
+struct ClassSchema {
+    const wchar_t* cls;
+    const wchar_t* where; // WHERE clause without the keyword, or null
+    const FieldDef* fields;
+    size_t fieldCount;
+    // Property that tells one device from another across snapshots, or
+    // null for classes with a single row. Several properties are separated
+    // by commas ("BankLabel,DeviceLocator") and make up the key together.
+    const char* key;
+};
+
+extern const ClassSchema kOperatingSystemSchema;
+extern const ClassSchema kProcessorSchema;
+extern const ClassSchema kPhysicalMemorySchema;
+extern const ClassSchema kVideoControllerSchema;
+extern const ClassSchema kDiskDriveSchema;
+extern const ClassSchema kDiskPartitionSchema;
+extern const ClassSchema kLogicalDiskSchema;
+extern const ClassSchema kLogicalDiskToPartitionSchema;
+extern const ClassSchema kBaseBoardSchema;
+extern const ClassSchema kBiosSchema;
+extern const ClassSchema kComputerSystemProductSchema;
+extern const ClassSchema kTpmSchema;
+extern const ClassSchema kSoundDeviceSchema;
+extern const ClassSchema kUsbDeviceSchema;
+extern const ClassSchema kNetworkAdapterSchema;
+extern const ClassSchema kProcessSchema;
+extern const ClassSchema kPackageSchema;
+extern const ClassSchema kNumaNodeSchema;
+extern const ClassSchema kLogicalProcessorSchema;
+extern const ClassSchema kCacheSchema;
+
+// The schema for a WMI class, or null.
+const ClassSchema* findClassSchema(const std::wstring& cls);
+
+// "SELECT <every field> FROM <class> [WHERE ...]".
+std::wstring schemaQuery(const ClassSchema& schema);
+
+// Column of every field of a schema in one result (-1 where the result
+// lacks it, e.g. under --fields), resolved once and then indexed per cell.
+class FieldSlots {
+public:
+    FieldSlots(const ClassSchema& schema, const ResultSet& rs);
+    int operator[](size_t field) const { return m_slots[field]; }
+
+private:
+    int m_slots[kMaxSchemaFields];
+};
+
+// Prints the detail lines of row `row`, each prefixed with `indent`. A line
+// is printed when any of its fields has a column.
+void printFields(const ClassSchema& schema, const FieldSlots& slots, const ResultSet& rs, size_t row,
+                 const wchar_t* indent, std::wostream& out);
@@ -0,0 +1,615 @@
+#include "sections.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <iomanip>
+#include <ostream>
+
+#include "processes.h"
+#include "schema.h"
+#include "storage.h"
+#include "topology.h"
+
+namespace {
+
+// Properties kept under --fields whenever their query runs, because the
+// section needs them to lay out rows. `needs` pulls in the query a row is
+// nested under: volumes hang off partitions through the association, and
+// partitions off their disk.
+struct ProjectionKey {
+    const wchar_t* cls;
+    const wchar_t* key;
+    const wchar_t* needs; // class of another query of the section, or null
+};
+
+const ProjectionKey kProjectionKeys[] = {
+    { L"Win32_DiskDrive", L"Index", nullptr },
+    { L"Win32_DiskPartition", L"DiskIndex", L"Win32_DiskDrive" },
+    { L"Win32_DiskPartition", L"DeviceID", nullptr },
+    { L"Win32_LogicalDiskToPartition", L"Antecedent", L"Win32_DiskPartition" },
+    { L"Win32_LogicalDiskToPartition", L"Dependent", nullptr },
+    { L"Win32_LogicalDisk", L"DeviceID", L"Win32_LogicalDiskToPartition" },
+    { L"Sysinfo_Package", L"Package", nullptr },
+    { L"Sysinfo_NumaNode", L"NodeId", nullptr },
+    { L"Sysinfo_LogicalProcessor", L"ProcessorId", nullptr },
+    { L"Sysinfo_LogicalProcessor", L"Package", nullptr },
+    { L"Sysinfo_LogicalProcessor", L"NumaNode", nullptr },
+    { L"Sysinfo_LogicalProcessor", L"Core", nullptr },
+    { L"Sysinfo_Cache", L"Level", nullptr },
+    { L"Sysinfo_Cache", L"Type", nullptr },
+    { L"Sysinfo_Cache", L"SharedCpus", nullptr },
+};
+
+const size_t kProjectionKeyCount = sizeof(kProjectionKeys) / sizeof(kProjectionKeys[0]);
+
+bool sameName(const std::wstring& prop, const std::string& field) {
+    if (prop.size() != field.size()) return false;
+    for (size_t k = 0; k < prop.size(); ++k) {
+        if (std::towlower(prop[k]) != std::towlower(static_cast<unsigned char>(field[k]))) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// Utility function: safely get a cell as text ("Unknown" if missing or empty)
+std::wstring safeGet(const ResultSet& rs, size_t row, int col) {
+    const Value& v = rs.at(row, col);
+    switch (v.type) {
+    case ValueType::String:
+        if (v.s.n) return utf8ToWide(v.s.p, v.s.n);
+        break;
+    case ValueType::Int:
+        return std::to_wstring(static_cast<long long>(v.i));
+    case ValueType::Uint:
+        return std::to_wstring(static_cast<unsigned long long>(v.u));
+    case ValueType::Bool:
+        return v.b ? L"True" : L"False";
+    default:
+        break;
+    }
+    return L"Unknown"; // Return "Unknown" if the property is NULL or empty
+}
+
+// Utility function: numeric value of a cell (0 if missing or not a number)
+uint64_t safeU64(const ResultSet& rs, size_t row, int col) {
+    return rs.at(row, col).asUint();
+}
+
+void printSystemInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& sys = r[0];
+    out << L"[System Information]" << std::endl;
+    if (!sys.empty()) {
+        printFields(kOperatingSystemSchema, FieldSlots(kOperatingSystemSchema, sys), sys, 0, L"", out);
+    } else {
+        out << L"  Could not retrieve system information." << std::endl;
+    }
+}
+
+void printCPUInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& cpus = r[0];
+    out << L"\n[CPU Information]" << std::endl;
+    if (!cpus.empty()) {
+        const FieldSlots slots(kProcessorSchema, cpus);
+        const int cName = cpus.column("Name");
+        for (size_t i = 0; i < cpus.rowCount(); ++i) {
+            out << L"  Processor " << (i + 1);
+            if (cName >= 0) out << L": " << safeGet(cpus, i, cName);
+            out << std::endl;
+            printFields(kProcessorSchema, slots, cpus, i, L"", out);
+        }
+    } else {
+        out << L"  Could not retrieve CPU information." << std::endl;
+    }
+}
+
+void printMemoryInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& mems = r[0];
+    out << L"\n[Memory Information]" << std::endl;
+    uint64_t totalCapacityBytes = 0;
+    if (!mems.empty()) {
+        const FieldSlots slots(kPhysicalMemorySchema, mems);
+        const int cCapacity = mems.column("Capacity"), cBank = mems.column("BankLabel");
+        for (size_t i = 0; i < mems.rowCount(); ++i) {
+            totalCapacityBytes += safeU64(mems, i, cCapacity);
+            out << L"  Slot " << (i + 1);
+            if (cBank >= 0) out << L" (" << safeGet(mems, i, cBank) << L")";
+            out << L":" << std::endl;
+            printFields(kPhysicalMemorySchema, slots, mems, i, L"", out);
+        }
+        if (cCapacity >= 0) out << L"  Total RAM (GB)     : " << std::fixed << std::setprecision(2) << (totalCapacityBytes / (1024.0 * 1024.0 * 1024.0)) << std::endl;
+    } else {
+        out << L"  Could not retrieve physical memory information." << std::endl;
+    }
+}
+
+void printGPUInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& gpus = r[0];
+    out << L"\n[GPU Information]" << std::endl;
+    if (!gpus.empty()) {
+        const FieldSlots slots(kVideoControllerSchema, gpus);
+        const int cName = gpus.column("Name");
+        for (size_t i = 0; i < gpus.rowCount(); ++i) {
+            out << L"  GPU " << (i + 1);
+            if (cName >= 0) out << L": " << safeGet(gpus, i, cName);
+            out << std::endl;
+            printFields(kVideoControllerSchema, slots, gpus, i, L"", out);
+        }
+    } else {
+        out << L"  Could not retrieve GPU information." << std::endl;
+    }
+}
+
+namespace {
+
+void printPartition(const ResultSet& parts, const FieldSlots& slots, size_t p, std::wostream& out) {
+    const int pDeviceId = parts.column("DeviceID"), pName = parts.column("Name");
+    out << L"    Partition:";
+    if (pDeviceId >= 0) out << L" " << safeGet(parts, p, pDeviceId);
+    if (pName >= 0) out << L" (" << safeGet(parts, p, pName) << L")";
+    out << std::endl;
+    printFields(kDiskPartitionSchema, slots, parts, p, L"", out);
+}
+
+// A logical disk, either nested under its partition or in the flat list.
+void printVolume(const ResultSet& logics, const FieldSlots& slots, size_t l, const wchar_t* indent, std::wostream& out) {
+    const int lDeviceId = logics.column("DeviceID"), lLabel = logics.column("VolumeName");
+    out << indent << L"Volume " << safeGet(logics, l, lDeviceId);
+    if (lLabel >= 0) out << L" (Label: " << safeGet(logics, l, lLabel) << L")";
+    out << std::endl;
+    printFields(kLogicalDiskSchema, slots, logics, l, indent, out);
+}
+
+} // namespace
+
+void printDiskInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& disks = r[0];
+    const ResultSet& parts = r[1];
+    const ResultSet& logics = r[2];
+    const ResultSet& links = r[3];
+
+    out << L"\n[Disk Information]" << std::endl;
+    // Under --fields a query may have been skipped, leaving it without columns.
+    if (disks.columnCount() && disks.empty()) {
+        out << L"  Could not retrieve disk drive information." << std::endl;
+        return;
+    }
+    const StorageTopology topo = buildStorageTopology(disks, parts, links, logics);
+    const FieldSlots diskSlots(kDiskDriveSchema, disks), partSlots(kDiskPartitionSchema, parts),
+                     volumeSlots(kLogicalDiskSchema, logics);
+    const int cIndex = disks.column("Index"), cModel = disks.column("Model");
+    for (size_t d = 0; d < topo.disks.size(); ++d) {
+        const StorageTopology::Disk& disk = topo.disks[d];
+        const size_t i = disk.row;
+        out << L"  Disk " << safeGet(disks, i, cIndex);
+        if (cModel >= 0) out << L": " << safeGet(disks, i, cModel);
+        out << std::endl;
+        printFields(kDiskDriveSchema, diskSlots, disks, i, L"", out);
+        // Telling SSDs from HDDs reliably requires Win32_PhysicalDisk (MSFT_PhysicalDisk.MediaType/SpindleSpeed);
+        // MediaType here is "Fixed hard disk media" for both.
+
+        for (size_t k = 0; k < disk.partitions.size(); ++k) {
+            printPartition(parts, partSlots, disk.partitions[k].row, out);
+            for (size_t v = 0; v < disk.partitions[k].volumes.size(); ++v) {
+                printVolume(logics, volumeSlots, disk.partitions[k].volumes[v], L"      ", out);
+            }
+        }
+    }
+    if (!topo.orphanPartitions.empty() && disks.columnCount()) {
+        out << L"\n  Partitions On Unlisted Disks:" << std::endl;
+        for (size_t k = 0; k < topo.orphanPartitions.size(); ++k) printPartition(parts, partSlots, topo.orphanPartitions[k], out);
+    }
+
+    // Volumes not on any listed partition (network or spanned volumes, or
+    // all of them when the association is unavailable) follow the tree.
+    if (!logics.columnCount() || (!logics.empty() && topo.unmappedVolumes.empty())) return;
+    if (topo.unmappedVolumes.size() == logics.rowCount()) {
+        out << L"\n  Logical Drives (Fixed Disks):" << std::endl;
+    } else {
+        out << L"\n  Other Logical Drives:" << std::endl;
+    }
+    if (!logics.empty()) {
+        for (size_t k = 0; k < topo.unmappedVolumes.size(); ++k) printVolume(logics, volumeSlots, topo.unmappedVolumes[k], L"    ", out);
+    } else {
+         out << L"    Could not retrieve logical drive information." << std::endl;
+    }
+}
+
+namespace {
+
+// Sections whose rows are nothing but their detail lines.
+void printRows(const ClassSchema& schema, const ResultSet& rs, std::wostream& out) {
+    const FieldSlots slots(schema, rs);
+    for (size_t i = 0; i < rs.rowCount(); ++i) printFields(schema, slots, rs, i, L"", out);
+}
+
+} // namespace
+
+void printBoardInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& boards = r[0];
+    out << L"\n[Motherboard Information]" << std::endl;
+    if (!boards.empty()) {
+        printRows(kBaseBoardSchema, boards, out); // Usually only one baseboard
+    } else {
+        out << L"  Could not retrieve motherboard information." << std::endl;
+    }
+}
+
+void printBIOSInfo(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& bios = r[0];
+    out << L"\n[BIOS Information]" << std::endl;
+    if (!bios.empty()) {
+        printRows(kBiosSchema, bios, out); // Usually only one BIOS
+    } else {
+        out << L"  Could not retrieve BIOS information." << std::endl;
+    }
+}
+
+void printUUID(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& uuidInfo = r[0];
+    out << L"\n[System UUID]" << std::endl;
+    if (!uuidInfo.empty()) {
+        printFields(kComputerSystemProductSchema, FieldSlots(kComputerSystemProductSchema, uuidInfo), uuidInfo, 0, L"", out);
+    } else {
+        out << L"  Could not retrieve system UUID." << std::endl;
+    }
+}
+
+void printTPM(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& tpmInfo = r[0];
+    out << L"\n[TPM Information]" << std::endl;
+    if (!tpmInfo.empty()) {
+        printRows(kTpmSchema, tpmInfo, out); // Usually one TPM
+    } else {
+        out << L"  TPM information not found or not accessible (Win32_Tpm class)." << std::endl;
+        // Attempt query from MSFT_Tpm namespace if available (newer systems)
+        // This requires connecting to "ROOT\\CIMV2\\Security\\MicrosoftTpm" which complicates the shared WMI connection.
+        // For now, we stick to Win32_Tpm.
+    }
+}
+
+void printSoundDevices(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& sndDevs = r[0];
+    out << L"\n[Sound Device Information]" << std::endl;
+    if (!sndDevs.empty()) {
+        printRows(kSoundDeviceSchema, sndDevs, out);
+    } else {
+        out << L"  Could not retrieve sound device information." << std::endl;
+    }
+}
+
+void printUSBDevices(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& usbDevs = r[0];
+    out << L"\n[USB Devices (from PnPEntity)]" << std::endl;
+    if (!usbDevs.empty()) {
+        printRows(kUsbDeviceSchema, usbDevs, out);
+    } else {
+        out << L"  Could not retrieve USB device information or no relevant USB PnP entities found." << std::endl;
+    }
+}
+
+void printNetworkAdapters(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& nics = r[0];
+    out << L"\n[Network Adapter Information (Physical)]" << std::endl;
+    if (!nics.empty()) {
+        printRows(kNetworkAdapterSchema, nics, out);
+    } else {
+        out << L"  Could not retrieve physical network adapter information." << std::endl;
+    }
+}
+
+namespace {
+
+// One row of a top-N table: pid, working set, CPU time, owner and name.
+void printProcessRow(const ResultSet& procs, size_t row, std::wostream& out) {
+    const uint64_t cpu = safeU64(procs, row, procs.column("UserModeTime")) + safeU64(procs, row, procs.column("KernelModeTime"));
+    const Value& owner = procs.at(row, procs.column("Owner"));
+    out << L"    " << std::setw(8) << safeGet(procs, row, procs.column("ProcessId")) << std::setw(11)
+        << safeU64(procs, row, procs.column("WorkingSetSize")) / (1024 * 1024) << std::setw(11) << std::fixed
+        << std::setprecision(1) << cpu / 1e7 << L"  " << std::left << std::setw(16)
+        << (owner.isNull() ? std::wstring(L"-") : safeGet(procs, row, procs.column("Owner"))) << std::right
+        << safeGet(procs, row, procs.column("Name")) << std::endl;
+}
+
+void printProcessTable(const wchar_t* title, const ResultSet& procs, const std::vector<size_t>& rows, std::wostream& out) {
+    out << L"  " << title << std::endl;
+    out << L"    " << std::setw(8) << L"PID" << std::setw(11) << L"RSS (MB)" << std::setw(11) << L"CPU (s)" << L"  "
+        << std::left << std::setw(16) << L"User" << std::right << L"Name" << std::endl;
+    for (size_t k = 0; k < rows.size(); ++k) printProcessRow(procs, rows[k], out);
+}
+
+} // namespace
+
+void printProcesses(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& procs = r[0];
+    out << L"\n[Processes]" << std::endl;
+    if (procs.empty()) {
+        out << L"  Could not retrieve the process list." << std::endl;
+        return;
+    }
+    ProcessSummary summary;
+    summarizeProcesses(procs, kTopProcesses, summary);
+    out << L"  Processes        : " << summary.processes << L" (" << summary.threads << L" threads)" << std::endl;
+    out << L"  Working Set (GB) : " << std::fixed << std::setprecision(2)
+        << summary.workingSet / (1024.0 * 1024.0 * 1024.0) << std::endl;
+    printProcessTable(L"Top by working set:", procs, summary.topMemory, out);
+    printProcessTable(L"Top by CPU time:", procs, summary.topCpu, out);
+    out << L"  By user:" << std::endl;
+    out << L"    " << std::left << std::setw(16) << L"User" << std::right << std::setw(8) << L"Procs" << std::setw(9)
+        << L"Threads" << std::setw(11) << L"RSS (MB)" << std::setw(11) << L"CPU (s)" << std::endl;
+    for (size_t k = 0; k < summary.users.size(); ++k) {
+        const UserRollup& user = summary.users[k];
+        const std::wstring name = user.user.empty() ? std::wstring(L"-") : utf8ToWide(user.user.data(), user.user.size());
+        out << L"    " << std::left << std::setw(16) << name << std::right << std::setw(8) << user.processes
+            << std::setw(9) << user.threads << std::setw(11) << user.workingSet / (1024 * 1024) << std::setw(11)
+            << std::fixed << std::setprecision(1) << user.cpuTime / 1e7 << std::endl;
+    }
+}
+
+namespace {
+
+std::vector<unsigned> cellCpus(const ResultSet& rs, size_t row, int col) {
+    std::vector<unsigned> cpus;
+    const Value& v = rs.at(row, col);
+    if (v.type == ValueType::String) parseCpuList(v.s.p, v.s.n, cpus);
+    return cpus;
+}
+
+std::wstring cpusetText(const std::vector<unsigned>& cpus) {
+    const std::string list = cpuListText(cpus), mask = cpuMaskText(cpus);
+    return std::wstring(list.begin(), list.end()) + L" (" + std::wstring(mask.begin(), mask.end()) + L")";
+}
+
+std::wstring sizeText(uint64_t bytes) {
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) return std::to_wstring(bytes >> 20) + L" MB";
+    return std::to_wstring(bytes >> 10) + L" KB";
+}
+
+// Logical processors of the LogicalProcessor rows, grouped by core.
+struct TopologyCore {
+    uint64_t package;
+    uint64_t node;
+    uint64_t core;
+    std::vector<unsigned> cpus;
+    std::wstring type;
+};
+
+std::vector<TopologyCore> topologyCores(const ResultSet& lps) {
+    const int cId = lps.column("ProcessorId"), cPackage = lps.column("Package"), cNode = lps.column("NumaNode");
+    const int cCore = lps.column("Core"), cType = lps.column("CoreType");
+    std::vector<TopologyCore> cores;
+    for (size_t i = 0; i < lps.rowCount(); ++i) {
+        const uint64_t package = safeU64(lps, i, cPackage), core = safeU64(lps, i, cCore);
+        size_t k = 0;
+        while (k < cores.size() && (cores[k].package != package || cores[k].core != core)) ++k;
+        if (k == cores.size()) {
+            const TopologyCore c = { package, safeU64(lps, i, cNode), core, std::vector<unsigned>(),
+                                     lps.at(i, cType).isNull() ? std::wstring() : safeGet(lps, i, cType) };
+            cores.push_back(c);
+        }
+        cores[k].cpus.push_back(static_cast<unsigned>(safeU64(lps, i, cId)));
+    }
+    return cores;
+}
+
+} // namespace
+
+void printTopology(const std::vector<ResultSet>& r, std::wostream& out) {
+    const ResultSet& packages = r[0];
+    const ResultSet& nodes = r[1];
+    const ResultSet& lps = r[2];
+    const ResultSet& caches = r[3];
+    out << L"\n[CPU Topology]" << std::endl;
+    if (packages.empty() && nodes.empty() && lps.empty() && caches.empty()) {
+        out << L"  Could not retrieve the processor topology." << std::endl;
+        return;
+    }
+    const std::vector<TopologyCore> cores = topologyCores(lps);
+    const int pPackage = packages.column("Package"), pCores = packages.column("Cores");
+    const int pLogical = packages.column("LogicalProcessors"), pFeatures = packages.column("Features");
+    const int nId = nodes.column("NodeId"), nCpus = nodes.column("Cpus"), nMemory = nodes.column("MemorySize");
+    const int nDistances = nodes.column("Distances"), nCoreCpus = nodes.column("CoreCpus");
+
+    // Package -> NUMA nodes -> cores -> SMT threads. A node spanning
+    // packages (or a package spanning nodes) shows up under each.
+    for (size_t p = 0; p < packages.rowCount(); ++p) {
+        const uint64_t package = safeU64(packages, p, pPackage);
+        out << L"  " << std::left << std::setw(17) << (L"Package " + std::to_wstring(package)) << std::right << L": "
+            << safeGet(packages, p, pCores) << (safeU64(packages, p, pCores) == 1 ? L" core, " : L" cores, ")
+            << safeGet(packages, p, pLogical)
+            << (safeU64(packages, p, pLogical) == 1 ? L" logical processor" : L" logical processors") << std::endl;
+        if (!packages.at(p, pFeatures).isNull()) out << L"    Features       : " << safeGet(packages, p, pFeatures) << std::endl;
+        for (size_t n = 0; n < nodes.rowCount(); ++n) {
+            const uint64_t node = safeU64(nodes, n, nId);
+            bool here = false;
+            for (size_t c = 0; c < cores.size() && !here; ++c) here = cores[c].package == package && cores[c].node == node;
+            if (!here) continue;
+            out << L"    " << std::left << std::setw(15) << (L"NUMA Node " + std::to_wstring(node)) << std::right << L": "
+                << (cellCpus(nodes, n, nCpus).size() == 1 ? L"CPU " : L"CPUs ") << safeGet(nodes, n, nCpus);
+            if (!nodes.at(n, nMemory).isNull()) {
+                out << L", " << std::fixed << std::setprecision(2) << safeU64(nodes, n, nMemory) / (1024.0 * 1024.0 * 1024.0)
+                    << L" GB";
+            }
+            if (nodes.rowCount() > 1 && !nodes.at(n, nDistances).isNull()) out << L", distances " << safeGet(nodes, n, nDistances);
+            out << std::endl;
+            for (size_t c = 0; c < cores.size(); ++c) {
+                if (cores[c].package != package || cores[c].node != node) continue;
+                const std::string list = cpuListText(cores[c].cpus);
+                out << L"      " << std::left << std::setw(13) << (L"Core " + std::to_wstring(cores[c].core)) << std::right
+                    << (cores[c].cpus.size() == 1 ? L": CPU " : L": CPUs ") << std::wstring(list.begin(), list.end());
+                if (!cores[c].type.empty()) out << L" (" << cores[c].type << L")";
+                out << std::endl;
+            }
+        }
+    }
+
+    // One line per kind of cache: level, type, size and how many CPUs
+    // share each instance (hybrid CPUs have two kinds of L2).
+    const int cLevel = caches.column("Level"), cType = caches.column("Type"), cSize = caches.column("Size");
+    const int cLine = caches.column("LineSize"), cWays = caches.column("Associativity"), cShared = caches.column("SharedCpus");
+    std::vector<size_t> kinds, instances;
+    for (size_t i = 0; i < caches.rowCount(); ++i) {
+        size_t k = 0;
+        while (k < kinds.size() &&
+               (safeU64(caches, kinds[k], cLevel) != safeU64(caches, i, cLevel) ||
+                safeGet(caches, kinds[k], cType) != safeGet(caches, i, cType) ||
+                safeU64(caches, kinds[k], cSize) != safeU64(caches, i, cSize) ||
+                cellCpus(caches, kinds[k], cShared).size() != cellCpus(caches, i, cShared).size())) {
+            ++k;
+        }
+        if (k == kinds.size()) {
+            kinds.push_back(i);
+            instances.push_back(0);
+        }
+        ++instances[k];
+    }
+    for (size_t k = 0; k < kinds.size(); ++k) {
+        const size_t i = kinds[k];
+        const std::wstring type = safeGet(caches, i, cType);
+        std::wstring label = L"L" + safeGet(caches, i, cLevel) + L" Cache";
+        if (type == L"Data") label += L" (data)";
+        else if (type == L"Instruction") label += L" (instr)";
+        const size_t shared = cellCpus(caches, i, cShared).size();
+        out << L"  " << std::left << std::setw(17) << label << std::right << L": " << sizeText(safeU64(caches, i, cSize));
+        if (!caches.at(i, cWays).isNull()) out << L", " << safeGet(caches, i, cWays) << L"-way";
+        if (!caches.at(i, cLine).isNull()) out << L", " << safeGet(caches, i, cLine) << L"-byte lines";
+        out << L", " << instances[k] << (instances[k] == 1 ? L" instance" : L" instances") << L" of " << shared
+            << (shared == 1 ? L" CPU" : L" CPUs") << std::endl;
+    }
+
+    // Ready for taskset -c, numactl --physcpubind, cpuset.cpus or
+    // start /affinity: each node whole, one thread per core, and the
+    // performance cores of hybrid CPUs.
+    if (nodes.rowCount()) out << L"  Suggested cpusets:" << std::endl;
+    for (size_t n = 0; n < nodes.rowCount(); ++n) {
+        const uint64_t node = safeU64(nodes, n, nId);
+        const std::vector<unsigned> cpus = cellCpus(nodes, n, nCpus);
+        out << L"    " << std::left << std::setw(15) << (L"NUMA Node " + std::to_wstring(node)) << std::right << L": ";
+        if (cpus.empty()) {
+            out << L"memory only" << std::endl;
+            continue;
+        }
+        out << cpusetText(cpus) << std::endl;
+        const std::vector<unsigned> coreCpus = cellCpus(nodes, n, nCoreCpus);
+        if (!coreCpus.empty() && coreCpus.size() < cpus.size()) {
+            out << L"      One per core : " << cpusetText(coreCpus) << std::endl;
+        }
+        std::vector<unsigned> performance;
+        bool hybrid = false;
+        for (size_t c = 0; c < cores.size(); ++c) {
+            if (cores[c].node != node || cores[c].type.empty()) continue;
+            hybrid = true;
+            if (cores[c].type == L"Performance") performance.insert(performance.end(), cores[c].cpus.begin(), cores[c].cpus.end());
+        }
+        if (hybrid && !performance.empty()) {
+            std::sort(performance.begin(), performance.end());
+            out << L"      Performance  : " << cpusetText(performance) << std::endl;
+        }
+    }
+}
+
+const std::vector<SectionDef>& allSections() {
+    static const std::vector<SectionDef> sections = {
+        { "system", { schemaQuery(kOperatingSystemSchema) }, printSystemInfo },
+        { "cpu", { schemaQuery(kProcessorSchema) }, printCPUInfo },
+        { "topology", {
+            schemaQuery(kPackageSchema),
+            schemaQuery(kNumaNodeSchema),
+            schemaQuery(kLogicalProcessorSchema),
+            schemaQuery(kCacheSchema) }, printTopology },
+        { "memory", { schemaQuery(kPhysicalMemorySchema) }, printMemoryInfo },
+        { "gpu", { schemaQuery(kVideoControllerSchema) }, printGPUInfo },
+        { "disk", {
+            schemaQuery(kDiskDriveSchema),
+            schemaQuery(kDiskPartitionSchema),
+            schemaQuery(kLogicalDiskSchema),
+            schemaQuery(kLogicalDiskToPartitionSchema) }, printDiskInfo },
+        { "board", { schemaQuery(kBaseBoardSchema) }, printBoardInfo },
+        { "bios", { schemaQuery(kBiosSchema) }, printBIOSInfo },
+        { "uuid", { schemaQuery(kComputerSystemProductSchema) }, printUUID },
+        { "tpm", { schemaQuery(kTpmSchema) }, printTPM },
+        { "sound", { schemaQuery(kSoundDeviceSchema) }, printSoundDevices },
+        { "usb", { schemaQuery(kUsbDeviceSchema) }, printUSBDevices },
+        { "network", { schemaQuery(kNetworkAdapterSchema) }, printNetworkAdapters },
+        { "process", { schemaQuery(kProcessSchema) }, printProcesses },
+    };
+    return sections;
+}
+
+bool selectSections(std::vector<SectionDef>& sections, const std::vector<std::string>& ids, std::string& unknown) {
+    for (size_t k = 0; k < ids.size(); ++k) {
+        bool found = false;
+        for (size_t i = 0; i < sections.size() && !found; ++i) found = ids[k] == sections[i].id;
+        if (!found) {
+            unknown = ids[k];
+            return false;
+        }
+    }
+    std::vector<SectionDef> kept;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (std::find(ids.begin(), ids.end(), std::string(sections[i].id)) != ids.end()) kept.push_back(sections[i]);
+    }
+    sections.swap(kept);
+    return true;
+}
+
+bool projectSections(std::vector<SectionDef>& sections, const std::vector<std::string>& fields, std::string& unknown) {
+    std::vector<bool> used(fields.size(), false);
+    std::vector<SectionDef> kept;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        SectionDef def = sections[i];
+        std::vector<std::vector<std::wstring> > columns(def.queries.size());
+        std::vector<bool> runs(def.queries.size(), false);
+        bool any = false;
+        for (size_t q = 0; q < def.queries.size(); ++q) {
+            const std::vector<std::wstring> selected = wqlColumns(def.queries[q]);
+            for (size_t c = 0; c < selected.size(); ++c) {
+                for (size_t f = 0; f < fields.size(); ++f) {
+                    if (!sameName(selected[c], fields[f])) continue;
+                    columns[q].push_back(selected[c]);
+                    used[f] = true;
+                    break;
+                }
+            }
+            runs[q] = !columns[q].empty();
+            any = any || runs[q];
+        }
+        if (!any) continue;
+
+        std::vector<std::wstring> classes(def.queries.size());
+        for (size_t q = 0; q < def.queries.size(); ++q) classes[q] = wqlClassName(def.queries[q]);
+        for (bool grew = true; grew;) {
+            grew = false;
+            for (size_t q = 0; q < def.queries.size(); ++q) {
+                for (size_t k = 0; k < kProjectionKeyCount && runs[q]; ++k) {
+                    if (!kProjectionKeys[k].needs || classes[q] != kProjectionKeys[k].cls) continue;
+                    for (size_t o = 0; o < def.queries.size(); ++o) {
+                        if (!runs[o] && classes[o] == kProjectionKeys[k].needs) runs[o] = grew = true;
+                    }
+                }
+            }
+        }
+        for (size_t q = 0; q < def.queries.size(); ++q) {
+            if (!runs[q]) {
+                def.queries[q].clear();
+                continue;
+            }
+            for (size_t k = 0; k < kProjectionKeyCount; ++k) {
+                const std::wstring key = kProjectionKeys[k].key;
+                if (classes[q] == kProjectionKeys[k].cls && std::find(columns[q].begin(), columns[q].end(), key) == columns[q].end()) {
+                    columns[q].insert(columns[q].begin(), key);
+                }
+            }
+            def.queries[q] = wqlWithColumns(def.queries[q], columns[q]);
+        }
+        kept.push_back(def);
+    }
+    for (size_t f = 0; f < fields.size(); ++f) {
+        if (!used[f]) {
+            unknown = fields[f];
+            return false;
+        }
+    }
+    sections.swap(kept);
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+
+// Utility function: safely get a cell as text ("Unknown" if NULL or empty)
+std::wstring safeGet(const ResultSet& rs, size_t row, int col);
+
+// Utility function: numeric value of a cell (0 if NULL or not a number)
+uint64_t safeU64(const ResultSet& rs, size_t row, int col);
+
+void printSystemInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printCPUInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printTopology(const std::vector<ResultSet>& r, std::wostream& out);
+void printMemoryInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printGPUInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printDiskInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printBoardInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printBIOSInfo(const std::vector<ResultSet>& r, std::wostream& out);
+void printUUID(const std::vector<ResultSet>& r, std::wostream& out);
+void printTPM(const std::vector<ResultSet>& r, std::wostream& out);
+void printSoundDevices(const std::vector<ResultSet>& r, std::wostream& out);
+void printUSBDevices(const std::vector<ResultSet>& r, std::wostream& out);
+void printNetworkAdapters(const std::vector<ResultSet>& r, std::wostream& out);
+void printProcesses(const std::vector<ResultSet>& r, std::wostream& out);
+
+// Every section of the report, in print order.
+const std::vector<SectionDef>& allSections();
+
+// Keeps only the sections named in `ids`, in table order. Returns false and
+// sets `unknown` to the first id that names no section.
+bool selectSections(std::vector<SectionDef>& sections, const std::vector<std::string>& ids, std::string& unknown);
+
+// Narrows each query's SELECT list to the requested properties (matched
+// case-insensitively) plus the keys its section lays rows out by. Queries
+// left with nothing to print are emptied so they are never run, and
+// sections left with no query are dropped. Returns false and sets
+// `unknown` to the first field no remaining section selects.
+bool projectSections(std::vector<SectionDef>& sections, const std::vector<std::string>& fields, std::string& unknown);
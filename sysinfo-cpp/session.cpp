@@ -0,0 +1,164 @@
+#include "session.h"
+
+#include <cstring>
+#include <ostream>
+
+#include "devices.h"
+#include "diff.h"
+#include "fixture_source.h"
+#include "report_bin.h"
+#include "sections.h"
+#include "static_cache.h"
+#ifdef _WIN32
+#include "wmi_source.h"
+#else
+#include "linux_source.h"
+#endif
+
+namespace {
+
+// Joins the source for one call. Cheap when the thread already has: COM
+// only counts a repeated CoInitializeEx.
+class AttachedThread {
+public:
+    explicit AttachedThread(DataSource& src) : m_src(src) { m_src.threadAttach(); }
+    ~AttachedThread() { m_src.threadDetach(); }
+
+private:
+    DataSource& m_src;
+};
+
+// Rows for the encoders, one vector per calling thread, refilled by each
+// call so a thread polling sections reuses its cells and arenas.
+std::vector<ResultSet>& scratchResults() {
+    static thread_local std::vector<ResultSet> results;
+    return results;
+}
+
+} // namespace
+
+const SectionDef* findSection(const char* id) {
+    const std::vector<SectionDef>& sections = allSections();
+    for (size_t k = 0; k < sections.size(); ++k) {
+        if (std::strcmp(sections[k].id, id) == 0) return &sections[k];
+    }
+    return nullptr;
+}
+
+std::vector<std::string> sectionQueryClasses(const SectionDef& def) {
+    std::vector<std::string> classes;
+    for (size_t q = 0; q < def.queries.size(); ++q) {
+        const std::wstring cls = wqlClassName(def.queries[q]);
+        classes.push_back(std::string(cls.begin(), cls.end())); // class names are ASCII
+    }
+    return classes;
+}
+
+SysinfoSession::SysinfoSession() : m_cache(nullptr), m_devices(nullptr) {}
+
+SysinfoSession::~SysinfoSession() {
+    if (m_cache) m_cache->save();
+}
+
+bool SysinfoSession::open(const SessionOptions& options) {
+    if (!openSource(options)) return false;
+    if (!options.trackDevices && options.replayEventsPath.empty()) return true;
+
+    std::unique_ptr<DeviceEventSource> events;
+    if (!options.replayEventsPath.empty()) {
+        DeviceReplay* replay = new DeviceReplay(std::move(m_source));
+        m_source.reset(replay);
+        if (!replay->load(options.replayEventsPath)) {
+            m_error = "cannot load event stream " + options.replayEventsPath;
+            return false;
+        }
+        events = replay->events();
+    } else {
+        events = openDeviceEvents();
+        if (!events) return true; // no notifications: keep enumerating
+    }
+    m_devices = new DeviceTable(std::move(m_source), std::move(events));
+    m_source.reset(m_devices);
+    m_devices->start();
+    return true;
+}
+
+bool SysinfoSession::openSource(const SessionOptions& options) {
+    if (!options.fixturePath.empty()) {
+        FixtureSource* fixture = new FixtureSource();
+        m_source.reset(fixture);
+        if (!fixture->load(options.fixturePath)) {
+            m_error = "cannot load fixture " + options.fixturePath;
+            return false;
+        }
+        fixture->setBatchSize(options.batch);
+        return true; // recorded fixtures are replayed as-is, only live data is cached
+    }
+#ifdef _WIN32
+    WmiSource* wmi = new WmiSource();
+    m_source.reset(wmi);
+    wmi->setBatchSize(options.batch);
+    if (!wmi->initialize()) {
+        m_error = "WMI initialization failed";
+        return false;
+    }
+#else
+    LinuxSource* procfs = new LinuxSource();
+    m_source.reset(procfs);
+    if (!options.procRoot.empty()) procfs->setProcRoot(options.procRoot);
+#endif
+    if (!options.cachePath.empty()) {
+        m_cache = new CachingSource(std::move(m_source), options.cachePath);
+        m_source.reset(m_cache);
+        AttachedThread attached(*m_source);
+        m_cache->load();
+    }
+    return true;
+}
+
+ResultSet SysinfoSession::query(const std::wstring& wql, const QueryBudget& budget) {
+    AttachedThread attached(*m_source);
+    return m_source->query(wql, budget);
+}
+
+void SysinfoSession::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into) {
+    AttachedThread attached(*m_source);
+    m_source->query(wql, budget, into);
+}
+
+bool SysinfoSession::collect(const char* id, std::vector<ResultSet>& results, const QueryBudget& budget) {
+    const SectionDef* def = findSection(id);
+    if (!def) return false;
+    results.resize(def->queries.size());
+    AttachedThread attached(*m_source);
+    for (size_t q = 0; q < def->queries.size(); ++q) m_source->query(def->queries[q], budget, results[q]);
+    return true;
+}
+
+bool SysinfoSession::appendJson(const char* id, JsonWriter& w, const QueryBudget& budget) {
+    std::vector<ResultSet>& results = scratchResults();
+    if (!collect(id, results, budget)) return false;
+    appendJsonSection(w, id, sectionQueryClasses(*findSection(id)), results);
+    return true;
+}
+
+bool SysinfoSession::appendBin(const char* id, std::string& out, const QueryBudget& budget) {
+    std::vector<ResultSet>& results = scratchResults();
+    if (!collect(id, results, budget)) return false;
+    const std::vector<std::string> classes = sectionQueryClasses(*findSection(id));
+    appendBinSection(out, id, classes, results, sectionDigest(classes, results));
+    return true;
+}
+
+bool SysinfoSession::print(const char* id, std::wostream& out, const QueryBudget& budget) {
+    std::vector<ResultSet>& results = scratchResults();
+    if (!collect(id, results, budget)) return false;
+    const SectionDef& def = *findSection(id);
+    def.print(results, out);
+    for (size_t q = 0; q < results.size(); ++q) {
+        if (!results[q].partial()) continue;
+        const std::wstring cls = wqlClassName(def.queries[q]);
+        out << L"  [" << cls << L": incomplete, query " << queryStatusName(results[q].status()) << L"]" << std::endl;
+    }
+    return true;
+}
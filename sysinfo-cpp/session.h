@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "collector.h"
+#include "datasource.h"
+#include "enumerate.h"
+#include "report_json.h"
+
+class CachingSource;
+class DeviceTable;
+
+// libsysinfo: the collectors behind one long-lived data source, for agents
+// that query in process instead of running the executable and scraping
+// its output. WMI is connected once per session (or /proc and /sys are
+// read directly), and the static hardware cache stays warm between calls.
+
+struct SessionOptions {
+    SessionOptions() : batch(kDefaultEnumBatch), trackDevices(false) {}
+
+    std::string fixturePath; // replay a recorded fixture instead of the live system
+    std::string cachePath;   // static hardware snapshot (static_cache.h); empty: no cache
+    std::string procRoot;    // where Linux reads the process list; empty: /proc
+    size_t batch;            // objects per WMI round trip or fixture batch
+    // Serve USB, sound, network and disk drive queries from a table kept
+    // current by the OS's device notifications (devices.h), for callers
+    // that ask for them again and again.
+    bool trackDevices;
+    std::string replayEventsPath; // drive the table from a scripted event stream instead
+};
+
+// The section of allSections() called `id`, or null.
+const SectionDef* findSection(const char* id);
+
+// WMI class of each query of a section, as the structured records name them.
+std::vector<std::string> sectionQueryClasses(const SectionDef& def);
+
+// Every member is safe to call from several threads at once, as the
+// collector's workers call the source. Calls run on the calling thread: no
+// worker pool is started, so a query costs what the source does.
+class SysinfoSession {
+public:
+    SysinfoSession();
+    // Saves the cache if a query missed it.
+    ~SysinfoSession();
+    SysinfoSession(const SysinfoSession&) = delete;
+    SysinfoSession& operator=(const SysinfoSession&) = delete;
+
+    // Connects the source, loads the cache and starts listening for
+    // device events. False with error() set on failure; call once, before
+    // anything else.
+    bool open(const SessionOptions& options);
+    const std::string& error() const { return m_error; }
+
+    // What the queries go to: the cache when there is one. For the
+    // executable, which stacks profiling and recording on top.
+    DataSource& source() { return *m_source; }
+    CachingSource* cache() { return m_cache; }
+    DeviceTable* devices() { return m_devices; }
+
+    // Runs one "SELECT ... FROM ..." on the session.
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget = QueryBudget());
+    // The same into `into`, reusing its storage (DataSource::query()).
+    void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+
+    // Gathers section `id` (see allSections()) into `results`, one per
+    // query. Each slot is cleared and refilled in place, so a caller that
+    // passes the same vector again reuses its cells and arenas. False for
+    // an unknown id.
+    bool collect(const char* id, std::vector<ResultSet>& results, const QueryBudget& budget = QueryBudget());
+
+    // collect() encoded as the --format=jsonl or --format=bin record,
+    // appended to `w` or `out`.
+    bool appendJson(const char* id, JsonWriter& w, const QueryBudget& budget = QueryBudget());
+    bool appendBin(const char* id, std::string& out, const QueryBudget& budget = QueryBudget());
+
+    // collect() rendered as the text report's section.
+    bool print(const char* id, std::wostream& out, const QueryBudget& budget = QueryBudget());
+
+private:
+    // The live system or a fixture, behind the cache.
+    bool openSource(const SessionOptions& options);
+
+    std::unique_ptr<DataSource> m_source;
+    CachingSource* m_cache; // in m_source when there is one
+    DeviceTable* m_devices; // m_source when tracking devices
+    std::string m_error;
+};
@@ -0,0 +1,157 @@
+#include "static_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "report_bin.h"
+
+namespace {
+
+// Bump when the cached queries or their row shapes change.
+const uint64_t kCacheSchema = 1;
+
+const wchar_t* const kStaticClasses[] = {
+    L"Win32_BIOS",
+    L"Win32_BaseBoard",
+    L"Win32_ComputerSystemProduct",
+    L"Win32_Tpm",
+    L"Win32_Processor",
+    L"Win32_PhysicalMemory",
+};
+
+bool isStatic(const std::wstring& wql) {
+    std::wstring cls = wqlClassName(wql);
+    for (size_t k = 0; k < sizeof(kStaticClasses) / sizeof(kStaticClasses[0]); ++k) {
+        if (cls == kStaticClasses[k]) return true;
+    }
+    return false;
+}
+
+// The section queries are ASCII, so a plain narrowing is lossless.
+std::string narrow(const std::wstring& s) {
+    return std::string(s.begin(), s.end());
+}
+
+std::string currentBootId(DataSource& src) {
+#ifdef _WIN32
+    ResultSet rs = src.query(L"SELECT LastBootUpTime FROM Win32_OperatingSystem");
+    const Value& v = rs.at(0, rs.column("LastBootUpTime"));
+    return v.type == ValueType::String ? std::string(v.s.p, v.s.n) : std::string();
+#else
+    (void)src;
+    std::string id;
+    if (FILE* fp = std::fopen("/proc/sys/kernel/random/boot_id", "r")) {
+        char buf[64];
+        if (std::fgets(buf, sizeof(buf), fp)) id = buf;
+        std::fclose(fp);
+    }
+    while (!id.empty() && (id.back() == '\n' || id.back() == ' ')) id.pop_back();
+    return id;
+#endif
+}
+
+} // namespace
+
+CachingSource::CachingSource(std::unique_ptr<DataSource> inner, const std::string& path)
+    : m_inner(std::move(inner)), m_path(path), m_hits(0), m_dirty(false) {}
+
+void CachingSource::load() {
+    m_bootId = currentBootId(*m_inner);
+    if (m_bootId.empty()) return; // no identity, no caching
+
+    MappedFile file;
+    if (!file.open(m_path)) return;
+    BinReportReader reader;
+    if (!reader.open(file.data(), file.size())) return;
+
+    ReportSection section;
+    if (!reader.next(section) || section.id != "@cache" || section.results.size() != 1) return;
+    const ResultSet& meta = section.results[0];
+    const Value& boot = meta.at(0, meta.column("Boot"));
+    if (meta.at(0, meta.column("Schema")).asUint() != kCacheSchema || boot.type != ValueType::String ||
+        std::string(boot.s.p, boot.s.n) != m_bootId) {
+        m_dirty = true; // stale: replace it after this run
+        return;
+    }
+
+    std::map<std::wstring, ResultSet> entries;
+    while (reader.next(section)) {
+        if (section.results.size() != 1) return;
+        entries[std::wstring(section.id.begin(), section.id.end())] = std::move(section.results[0]);
+    }
+    if (!reader.error().empty()) {
+        m_dirty = true;
+        return;
+    }
+    m_entries.swap(entries);
+}
+
+ResultSet CachingSource::query(const std::wstring& wql, const QueryBudget& budget) {
+    ResultSet rows;
+    query(wql, budget, rows);
+    return rows;
+}
+
+void CachingSource::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& rows) {
+    if (m_bootId.empty() || !isStatic(wql)) {
+        m_inner->query(wql, budget, rows);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::wstring, ResultSet>::const_iterator it = m_entries.find(wql);
+        if (it != m_entries.end()) {
+            ++m_hits;
+            rows.assign(it->second);
+            return;
+        }
+    }
+    m_inner->query(wql, budget, rows);
+    // Empty results are often transient (a busy provider, no admin
+    // rights for Win32_Tpm); ask again next run instead of pinning them.
+    // So are partial ones.
+    if (!rows.empty() && !rows.partial()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries[wql] = rows.clone();
+        m_dirty = true;
+    }
+}
+
+bool CachingSource::save() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_dirty || m_bootId.empty() || m_path.empty()) return true;
+
+    std::string out;
+    appendBinHeader(out);
+    std::vector<ResultSet> results(1);
+    ResultSet& meta = results[0];
+    meta.addColumn("Schema");
+    meta.addColumn("Boot");
+    meta.addRow();
+    meta.setUint(0, kCacheSchema);
+    meta.setString(1, m_bootId.data(), m_bootId.size());
+    appendBinSection(out, "@cache", std::vector<std::string>(1), results);
+
+    for (std::map<std::wstring, ResultSet>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        results[0] = it->second.clone();
+        appendBinSection(out, narrow(it->first).c_str(), std::vector<std::string>(1, narrow(wqlClassName(it->first))),
+                         results);
+    }
+    m_dirty = false;
+    return writeFileAtomically(m_path, out.data(), out.size());
+}
+
+std::string defaultCachePath() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    return base && *base ? std::string(base) + "\\sysinfo\\static.cache" : std::string();
+#else
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg == '/') return std::string(xdg) + "/sysinfo/static.cache";
+    const char* home = std::getenv("HOME");
+    return home && *home ? std::string(home) + "/.cache/sysinfo/static.cache" : std::string();
+#endif
+}
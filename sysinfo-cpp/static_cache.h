@@ -0,0 +1,55 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "datasource.h"
+
+// Serves queries for hardware that can't change while the machine is up
+// (BIOS, baseboard, system UUID, TPM, CPU, DIMMs) from a snapshot file and
+// forwards everything else to the wrapped source.
+//
+// The snapshot is a binary report (report_bin.h): a "@cache" record with
+// the schema version and boot identity, then one record per cached query
+// with the WQL text as its id. It is only trusted when both match; the
+// boot identity is /proc/sys/kernel/random/boot_id on Linux and
+// Win32_OperatingSystem.LastBootUpTime on Windows.
+class CachingSource : public DataSource {
+public:
+    CachingSource(std::unique_ptr<DataSource> inner, const std::string& path);
+
+    // Maps the snapshot and keeps its entries if it belongs to this boot.
+    // Call once before collecting, on a thread that may query the wrapped
+    // source.
+    void load();
+    // Rewrites the snapshot (atomically) if any static query missed.
+    bool save();
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+    bool queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget, ResultSet& rows,
+                      std::vector<std::string>& paths) {
+        return m_inner->queryDevices(wql, path, budget, rows, paths);
+    }
+    void threadAttach() { m_inner->threadAttach(); }
+    void threadDetach() { m_inner->threadDetach(); }
+
+    size_t hits() const { return m_hits; }
+    const std::string& path() const { return m_path; }
+
+private:
+    std::unique_ptr<DataSource> m_inner;
+    std::string m_path;
+    std::string m_bootId;
+    std::mutex m_mutex;
+    std::map<std::wstring, ResultSet> m_entries;
+    size_t m_hits;
+    bool m_dirty;
+};
+
+// Per-user snapshot location: %LOCALAPPDATA%\sysinfo\static.cache on
+// Windows, $XDG_CACHE_HOME/sysinfo/static.cache (default ~/.cache)
+// elsewhere. Empty if no suitable directory is known.
+std::string defaultCachePath();
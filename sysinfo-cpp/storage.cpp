@@ -0,0 +1,98 @@
+#include "storage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+std::string stringCell(const ResultSet& rs, size_t row, int col) {
+    const Value& v = rs.at(row, col);
+    if (v.type != ValueType::String) return std::string();
+    return std::string(v.s.p, v.s.n);
+}
+
+} // namespace
+
+std::string objectPathDeviceId(const char* path, size_t len) {
+    static const char kKey[] = "DeviceID=\"";
+    const size_t keyLen = sizeof(kKey) - 1;
+    const char* end = path + len;
+    const char* p = std::search(path, end, kKey, kKey + keyLen);
+    if (p == end) return std::string();
+    std::string id;
+    for (p += keyLen; p < end && *p != '"'; ++p) {
+        if (*p == '\\' && p + 1 < end) ++p;
+        id.push_back(*p);
+    }
+    return id;
+}
+
+StorageTopology buildStorageTopology(const ResultSet& drives, const ResultSet& partitions,
+                                     const ResultSet& links, const ResultSet& volumes) {
+    StorageTopology topo;
+
+    const int cIndex = drives.column("Index");
+    std::unordered_map<uint64_t, size_t> diskByIndex;
+    diskByIndex.reserve(drives.rowCount());
+    topo.disks.resize(drives.rowCount());
+    for (size_t i = 0; i < drives.rowCount(); ++i) {
+        topo.disks[i].row = i;
+        const Value& v = drives.at(i, cIndex);
+        if (!v.isNull()) diskByIndex.insert(std::make_pair(v.asUint(), i)); // first drive wins on duplicates
+    }
+
+    // Partition DeviceID -> (disk, slot in that disk's list).
+    const int pDisk = partitions.column("DiskIndex"), pDeviceId = partitions.column("DeviceID");
+    std::unordered_map<std::string, std::pair<size_t, size_t> > partById;
+    partById.reserve(partitions.rowCount());
+    for (size_t p = 0; p < partitions.rowCount(); ++p) {
+        const Value& v = partitions.at(p, pDisk);
+        std::unordered_map<uint64_t, size_t>::const_iterator disk = v.isNull() ? diskByIndex.end() : diskByIndex.find(v.asUint());
+        if (disk == diskByIndex.end()) {
+            topo.orphanPartitions.push_back(p);
+            continue;
+        }
+        std::vector<StorageTopology::Partition>& list = topo.disks[disk->second].partitions;
+        StorageTopology::Partition part;
+        part.row = p;
+        list.push_back(part);
+        if (pDeviceId >= 0) {
+            partById.insert(std::make_pair(stringCell(partitions, p, pDeviceId), std::make_pair(disk->second, list.size() - 1)));
+        }
+    }
+
+    const int lDeviceId = volumes.column("DeviceID");
+    std::unordered_map<std::string, size_t> volumeById;
+    volumeById.reserve(volumes.rowCount());
+    for (size_t l = 0; l < volumes.rowCount(); ++l) {
+        if (lDeviceId >= 0) volumeById.insert(std::make_pair(stringCell(volumes, l, lDeviceId), l));
+    }
+
+    std::vector<bool> mapped(volumes.rowCount(), false);
+    const int aPart = links.column("Antecedent"), aVolume = links.column("Dependent");
+    for (size_t k = 0; k < links.rowCount(); ++k) {
+        const Value& pv = links.at(k, aPart);
+        const Value& vv = links.at(k, aVolume);
+        if (pv.type != ValueType::String || vv.type != ValueType::String) continue;
+        std::unordered_map<std::string, std::pair<size_t, size_t> >::const_iterator part = partById.find(objectPathDeviceId(pv.s.p, pv.s.n));
+        std::unordered_map<std::string, size_t>::const_iterator volume = volumeById.find(objectPathDeviceId(vv.s.p, vv.s.n));
+        if (part == partById.end() || volume == volumeById.end()) continue;
+        std::vector<size_t>& list = topo.disks[part->second.first].partitions[part->second.second].volumes;
+        if (std::find(list.begin(), list.end(), volume->second) != list.end()) continue;
+        list.push_back(volume->second);
+        mapped[volume->second] = true;
+    }
+
+    for (size_t i = 0; i < topo.disks.size(); ++i) {
+        for (size_t p = 0; p < topo.disks[i].partitions.size(); ++p) {
+            std::vector<size_t>& list = topo.disks[i].partitions[p].volumes;
+            std::sort(list.begin(), list.end());
+        }
+    }
+    for (size_t l = 0; l < mapped.size(); ++l) {
+        if (!mapped[l]) topo.unmappedVolumes.push_back(l);
+    }
+    return topo;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "resultset.h"
+
+// Disk -> partition -> volume tree over the rows of Win32_DiskDrive,
+// Win32_DiskPartition, Win32_LogicalDiskToPartition and Win32_LogicalDisk.
+// Entries are row indices into those result sets.
+struct StorageTopology {
+    struct Partition {
+        size_t row;
+        std::vector<size_t> volumes; // in volume row order
+    };
+    struct Disk {
+        size_t row;
+        std::vector<Partition> partitions; // in partition row order
+    };
+    std::vector<Disk> disks;              // in drive row order
+    std::vector<size_t> orphanPartitions; // DiskIndex matches no drive
+    std::vector<size_t> unmappedVolumes;  // on no listed partition
+};
+
+// Builds the tree in one pass over each result set, joining through hash
+// indexes on the drive Index and on partition and volume DeviceIDs. A
+// volume spanning several partitions appears under each of them.
+StorageTopology buildStorageTopology(const ResultSet& drives, const ResultSet& partitions,
+                                     const ResultSet& links, const ResultSet& volumes);
+
+// DeviceID key of a WMI object path such as
+//   \\HOST\root\cimv2:Win32_DiskPartition.DeviceID="Disk #0, Partition #1"
+// with backslash escapes removed; empty if the path has no DeviceID.
+std::string objectPathDeviceId(const char* path, size_t len);
@@ -0,0 +1,122 @@
+#include "sysinfo_c.h"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "diff.h"
+#include "report_bin.h"
+#include "session.h"
+
+struct sysinfo_session {
+    SysinfoSession session;
+};
+
+namespace {
+
+QueryBudget budgetFor(unsigned timeoutMs) {
+    if (!timeoutMs) return QueryBudget();
+    return QueryBudget(QueryBudget::Clock::now() + std::chrono::milliseconds(timeoutMs), nullptr);
+}
+
+// Rows and encoding scratch, one per calling thread. It keeps its
+// capacity, so a thread that polls the same sections allocates little
+// once it has seen the largest of them: the rows are refilled in place.
+struct Scratch {
+    std::vector<ResultSet> results;
+    JsonWriter json;
+    std::string bin;
+};
+
+Scratch& scratch() {
+    static thread_local Scratch s;
+    s.json.clear();
+    s.bin.clear();
+    return s;
+}
+
+bool anyPartial(const std::vector<ResultSet>& results) {
+    for (size_t k = 0; k < results.size(); ++k) {
+        if (results[k].partial()) return true;
+    }
+    return false;
+}
+
+// Encodes `results` as `format` and copies the record out.
+int writeRecord(const char* section, const std::vector<std::string>& classes, const std::vector<ResultSet>& results,
+                int format, char* buf, size_t cap, size_t* len) {
+    Scratch& s = scratch();
+    const std::string* record = &s.bin;
+    if (format == SYSINFO_FORMAT_JSON) {
+        appendJsonSection(s.json, section, classes, results);
+        record = &s.json.buffer();
+    } else {
+        appendBinSection(s.bin, section, classes, results, sectionDigest(classes, results));
+    }
+    *len = record->size();
+    if (record->size() > cap) return SYSINFO_ERR_BUFFER_TOO_SMALL;
+    if (!record->empty()) std::memcpy(buf, record->data(), record->size());
+    return anyPartial(results) ? SYSINFO_INCOMPLETE : SYSINFO_OK;
+}
+
+bool validFormat(int format) {
+    return format == SYSINFO_FORMAT_JSON || format == SYSINFO_FORMAT_BIN;
+}
+
+} // namespace
+
+int sysinfo_open(const char* cache_path, sysinfo_session** out) {
+    if (!out) return SYSINFO_ERR_ARGUMENT;
+    *out = nullptr;
+    try {
+        sysinfo_session* s = new sysinfo_session();
+        SessionOptions options;
+        if (cache_path) options.cachePath = cache_path;
+        options.trackDevices = true;
+        if (!s->session.open(options)) {
+            delete s;
+            return SYSINFO_ERR_OPEN;
+        }
+        *out = s;
+        return SYSINFO_OK;
+    } catch (const std::bad_alloc&) {
+        return SYSINFO_ERR_INTERNAL;
+    }
+}
+
+void sysinfo_close(sysinfo_session* session) {
+    delete session;
+}
+
+int sysinfo_section(sysinfo_session* session, const char* section, int format, unsigned timeout_ms, char* buf,
+                    size_t cap, size_t* len) {
+    if (!session || !section || !len || (!buf && cap) || !validFormat(format)) return SYSINFO_ERR_ARGUMENT;
+    try {
+        const SectionDef* def = findSection(section);
+        if (!def) return SYSINFO_ERR_UNKNOWN_SECTION;
+        std::vector<ResultSet>& results = scratch().results;
+        session->session.collect(section, results, budgetFor(timeout_ms));
+        return writeRecord(section, sectionQueryClasses(*def), results, format, buf, cap, len);
+    } catch (const std::bad_alloc&) {
+        return SYSINFO_ERR_INTERNAL;
+    }
+}
+
+int sysinfo_query(sysinfo_session* session, const char* wql, int format, unsigned timeout_ms, char* buf, size_t cap,
+                  size_t* len) {
+    if (!session || !wql || !len || (!buf && cap) || !validFormat(format)) return SYSINFO_ERR_ARGUMENT;
+    try {
+        const std::wstring text = utf8ToWide(wql, std::strlen(wql));
+        const std::wstring cls = wqlClassName(text);
+        if (cls.empty()) return SYSINFO_ERR_ARGUMENT;
+        std::vector<ResultSet>& results = scratch().results;
+        results.resize(1);
+        session->session.query(text, budgetFor(timeout_ms), results[0]);
+        return writeRecord("query", std::vector<std::string>(1, std::string(cls.begin(), cls.end())), results, format,
+                           buf, cap, len);
+    } catch (const std::bad_alloc&) {
+        return SYSINFO_ERR_INTERNAL;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef SYSINFO_C_H
+#define SYSINFO_C_H
+#include <stddef.h>
+
+/* C interface to libsysinfo (session.h), for agents written in other
+ * languages. A session is opened once and may be used from any number of
+ * threads at the same time. Results are written into buffers the caller
+ * owns, in the record formats of --format=jsonl and --format=bin. */
+
+#if defined(SYSINFO_SHARED_LIBRARY)
+#if defined(_WIN32)
+#if defined(SYSINFO_BUILDING_LIBRARY)
+#define SYSINFO_API __declspec(dllexport)
+#else
+#define SYSINFO_API __declspec(dllimport)
+#endif
+#else
+#define SYSINFO_API __attribute__((visibility("default")))
+#endif
+#else
+#define SYSINFO_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sysinfo_session sysinfo_session;
+
+enum sysinfo_status {
+    SYSINFO_OK = 0,
+    SYSINFO_INCOMPLETE = 1,          /* written, but a query ran out of time: some rows are missing */
+    SYSINFO_ERR_ARGUMENT = -1,       /* a null pointer or an unknown format */
+    SYSINFO_ERR_UNKNOWN_SECTION = -2,
+    SYSINFO_ERR_BUFFER_TOO_SMALL = -3, /* nothing written; *len is the size needed */
+    SYSINFO_ERR_OPEN = -4,           /* WMI could not be initialised (details on stderr) */
+    SYSINFO_ERR_INTERNAL = -5        /* out of memory */
+};
+
+enum sysinfo_format {
+    SYSINFO_FORMAT_JSON = 0, /* one JSON Lines record, newline included */
+    SYSINFO_FORMAT_BIN = 1   /* one length-prefixed record of report_bin.h, without the file header */
+};
+
+/* Opens a session on the live system. `cache_path` is where the static
+ * hardware snapshot is kept between runs, or NULL for none. USB and sound
+ * devices, network adapters and disk drives are answered from a table the
+ * OS's device notifications keep current, so polling them is cheap. On
+ * success *out is the session; close it with sysinfo_close(). */
+SYSINFO_API int sysinfo_open(const char* cache_path, sysinfo_session** out);
+
+/* Saves the cache and releases the session. No call may be running on it. */
+SYSINFO_API void sysinfo_close(sysinfo_session* session);
+
+/* Collects one report section ("cpu", "disk", "process", ...) and writes
+ * its record to buf[0..cap). *len receives the record's size, which is
+ * also what a too-small buffer would need; the record is not NUL
+ * terminated. timeout_ms == 0 means no time limit. */
+SYSINFO_API int sysinfo_section(sysinfo_session* session, const char* section, int format, unsigned timeout_ms,
+                                char* buf, size_t cap, size_t* len);
+
+/* Runs one "SELECT ... FROM <class>" (UTF-8) and writes it as a record of
+ * a section named "query" holding one result. */
+SYSINFO_API int sysinfo_query(sysinfo_session* session, const char* wql, int format, unsigned timeout_ms, char* buf,
+                              size_t cap, size_t* len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
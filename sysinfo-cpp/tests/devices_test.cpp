@@ -0,0 +1,132 @@
+// The event-driven device table over a replayed event stream: after the
+// first enumeration, an add, change or remove updates just the row of the
+// device it names (one lookup, no re-enumeration), readers holding the
+// rows keep the version they got, and lost events bring back a full
+// enumeration. Exits non-zero with a message on the first mismatch.
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "devices.h"
+#include "fixture_source.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl; \
+            ++g_failures;                                                            \
+        }                                                                            \
+    } while (0)
+
+const char kFixture[] =
+    "[Win32_PnPEntity]\n"
+    "PNPDeviceID=USB\\A\n"
+    "Name=Alpha\n"
+    "--\n"
+    "PNPDeviceID=USB\\B\n"
+    "Name=Beta\n"
+    "--\n"
+    "PNPDeviceID=USB\\C\n"
+    "Name=Gamma\n";
+
+// One event per wait() below.
+const char kStream[] =
+    "@0 add usb\n"
+    "PNPDeviceID=USB\\D\n"
+    "Name=Delta\n"
+    "@20 change usb\n"
+    "PNPDeviceID=USB\\B\n"
+    "Name=Beta 2\n"
+    "@40 remove usb\n"
+    "PNPDeviceID=USB\\A\n";
+
+const wchar_t kQuery[] = L"SELECT PNPDeviceID, Name FROM Win32_PnPEntity";
+
+// The Name of the row with `id`, or "-" if there is none.
+std::string nameOf(const ResultSet& rs, const char* id) {
+    const int cId = rs.column("PNPDeviceID"), cName = rs.column("Name");
+    for (size_t r = 0; r < rs.rowCount(); ++r) {
+        const Value& v = rs.at(r, cId);
+        if (v.type != ValueType::String || v.s.n != std::strlen(id) || std::memcmp(v.s.p, id, v.s.n) != 0) continue;
+        const Value& name = rs.at(r, cName);
+        return name.type == ValueType::String ? std::string(name.s.p, name.s.n) : std::string();
+    }
+    return "-";
+}
+
+// Plays the next event of the stream into the table.
+void playNext(DeviceEventSource& events, DeviceTable& table) {
+    std::vector<DeviceEvent> batch;
+    events.wait(batch, std::chrono::seconds(1));
+    CHECK(batch.size() == 1);
+    for (size_t k = 0; k < batch.size(); ++k) table.apply(batch[k]);
+}
+
+void checkEvents() {
+    std::unique_ptr<FixtureSource> fixture(new FixtureSource);
+    fixture->parse(kFixture, sizeof(kFixture) - 1);
+    std::unique_ptr<DeviceReplay> replay(new DeviceReplay(std::move(fixture)));
+    replay->parse(kStream, sizeof(kStream) - 1);
+    CHECK(replay->eventCount() == 3);
+    DeviceReplay& stream = *replay;
+    // Events are played by hand, between queries, instead of by start().
+    DeviceTable table(std::move(replay), nullptr);
+    const std::unique_ptr<DeviceEventSource> events = stream.events();
+
+    const std::shared_ptr<const ResultSet> first = table.queryShared(kQuery, QueryBudget());
+    CHECK(first->rowCount() == 3);
+    CHECK(table.refreshes() == 1);
+
+    playNext(*events, table);
+    ResultSet rows = table.query(kQuery);
+    CHECK(rows.rowCount() == 4);
+    CHECK(nameOf(rows, "USB\\D") == "Delta");
+    // The reader's rows were copied, not edited.
+    CHECK(first->rowCount() == 3);
+    CHECK(nameOf(*first, "USB\\D") == "-");
+
+    playNext(*events, table);
+    table.query(kQuery, QueryBudget(), rows);
+    CHECK(rows.rowCount() == 4);
+    CHECK(nameOf(rows, "USB\\B") == "Beta 2");
+    CHECK(nameOf(*first, "USB\\B") == "Beta");
+
+    playNext(*events, table);
+    table.query(kQuery, QueryBudget(), rows);
+    CHECK(rows.rowCount() == 3);
+    CHECK(nameOf(rows, "USB\\A") == "-");
+    CHECK(nameOf(rows, "USB\\B") == "Beta 2");
+    CHECK(nameOf(rows, "USB\\C") == "Gamma");
+    CHECK(nameOf(rows, "USB\\D") == "Delta");
+
+    // Single-row updates only: one lookup per add or change, none for a
+    // remove, and the class was enumerated once.
+    CHECK(table.events() == 3);
+    CHECK(table.lookups() == 2);
+    CHECK(table.refreshes() == 1);
+    CHECK(table.hits() == 3);
+
+    // Lost events: the next query enumerates again, and finds the same.
+    table.apply(DeviceEvent());
+    table.query(kQuery, QueryBudget(), rows);
+    CHECK(table.refreshes() == 2);
+    CHECK(rows.rowCount() == 3);
+    CHECK(nameOf(rows, "USB\\B") == "Beta 2");
+    CHECK(nameOf(rows, "USB\\A") == "-");
+}
+
+} // namespace
+
+int main() {
+    checkEvents();
+    if (g_failures) std::cerr << g_failures << " checks failed" << std::endl;
+    return g_failures ? 1 : 0;
+}
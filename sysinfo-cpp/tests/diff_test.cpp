@@ -0,0 +1,192 @@
+// Hardware diffs between two versions of a section: devices matched by
+// key come out added, removed or modified; row order, readings and NULL
+// versus "" are not content, so they change neither the digest nor the
+// diff. Exits non-zero with a message on the first mismatch.
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "diff.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl; \
+            ++g_failures;                                                            \
+        }                                                                            \
+    } while (0)
+
+// One disk drive; a null `serial` or `firmware` leaves the cell NULL.
+struct Disk {
+    const char* serial;
+    const char* model;
+    const char* firmware;
+    const char* status; // a reading
+};
+
+ResultSet disks(const std::vector<Disk>& rows) {
+    ResultSet rs;
+    const int cSerial = rs.addColumn("SerialNumber");
+    const int cModel = rs.addColumn("Model");
+    const int cFirmware = rs.addColumn("FirmwareRevision");
+    const int cStatus = rs.addColumn("Status");
+    for (size_t r = 0; r < rows.size(); ++r) {
+        rs.addRow();
+        if (rows[r].serial) rs.setString(cSerial, rows[r].serial, std::strlen(rows[r].serial));
+        rs.setString(cModel, rows[r].model, std::strlen(rows[r].model));
+        if (rows[r].firmware) rs.setString(cFirmware, rows[r].firmware, std::strlen(rows[r].firmware));
+        rs.setString(cStatus, rows[r].status, std::strlen(rows[r].status));
+    }
+    return rs;
+}
+
+// Two DIMMs in the same bank and slot name, told apart by content only.
+ResultSet dimms(bool swapped) {
+    ResultSet rs;
+    const int cBank = rs.addColumn("BankLabel");
+    const int cLocator = rs.addColumn("DeviceLocator");
+    const int cCapacity = rs.addColumn("Capacity");
+    const uint64_t sizes[] = { 8ull << 30, 16ull << 30 };
+    for (size_t r = 0; r < 2; ++r) {
+        rs.addRow();
+        rs.setString(cBank, "BANK 0", 6);
+        rs.setString(cLocator, "DIMM 1", 6);
+        rs.setUint(cCapacity, sizes[swapped ? 1 - r : r]);
+    }
+    return rs;
+}
+
+ReportSection section(const std::vector<Disk>& rows, bool swapped) {
+    ReportSection s;
+    s.id = "hardware";
+    s.classes.push_back("Win32_DiskDrive");
+    s.results.push_back(disks(rows));
+    s.classes.push_back("Win32_PhysicalMemory");
+    s.results.push_back(dimms(swapped));
+    return s;
+}
+
+const DeviceChange* find(const std::vector<DeviceChange>& changes, DeviceChange::Kind kind, const wchar_t* key) {
+    for (size_t k = 0; k < changes.size(); ++k) {
+        if (changes[k].kind == kind && changes[k].key == key) return &changes[k];
+    }
+    return nullptr;
+}
+
+std::vector<Disk> baseline() {
+    std::vector<Disk> rows;
+    const Disk a = { "S1", "Alpha", "1.0", "OK" };
+    const Disk b = { "S2", "Beta", nullptr, "OK" };
+    const Disk c = { "S3", "Gamma", "", "OK" };
+    rows.push_back(a);
+    rows.push_back(b);
+    rows.push_back(c);
+    return rows;
+}
+
+void checkUnchanged() {
+    const ReportSection before = section(baseline(), false);
+
+    // Reordered rows, a changed reading, NULL and "" traded places.
+    std::vector<Disk> rows = baseline();
+    std::swap(rows[0], rows[2]);
+    rows[1].firmware = "";
+    rows[0].firmware = nullptr;
+    rows[2].status = "Pred Fail";
+    const ReportSection after = section(rows, true);
+
+    CHECK(sectionDigest(before.classes, before.results) == sectionDigest(after.classes, after.results));
+    std::vector<DeviceChange> changes;
+    diffSection(before, after, changes);
+    CHECK(changes.empty());
+}
+
+void checkChanges() {
+    const ReportSection before = section(baseline(), false);
+
+    std::vector<Disk> rows = baseline();
+    rows.erase(rows.begin());  // S1 pulled
+    rows[0].model = "Beta 2";  // S2 modified
+    rows[1].model = "Gamma 2"; // S3 modified, its "" firmware now NULL
+    rows[1].firmware = nullptr;
+    const Disk d = { "S4", "Delta", "2.0", "OK" };
+    rows.insert(rows.begin(), d);
+    const ReportSection after = section(rows, false);
+
+    CHECK(sectionDigest(before.classes, before.results) != sectionDigest(after.classes, after.results));
+    std::vector<DeviceChange> changes;
+    diffSection(before, after, changes);
+    CHECK(changes.size() == 4);
+    CHECK(find(changes, DeviceChange::Removed, L"S1") != nullptr);
+    CHECK(find(changes, DeviceChange::Added, L"S4") != nullptr);
+    const DeviceChange* modified = find(changes, DeviceChange::Modified, L"S2");
+    CHECK(modified != nullptr);
+    if (modified) {
+        CHECK(modified->section == "hardware");
+        CHECK(modified->cls == "Win32_DiskDrive");
+        CHECK(modified->fields.size() == 1);
+        if (modified->fields.size() == 1) {
+            CHECK(modified->fields[0].property == "Model");
+            CHECK(modified->fields[0].before == L"Beta");
+            CHECK(modified->fields[0].after == L"Beta 2");
+        }
+    }
+    modified = find(changes, DeviceChange::Modified, L"S3");
+    CHECK(modified != nullptr);
+    if (modified) {
+        CHECK(modified->fields.size() == 1);
+        if (modified->fields.size() == 1) CHECK(modified->fields[0].property == "Model");
+    }
+}
+
+// Disks without serial numbers are numbered, and DIMMs sharing a key
+// counted, in the order of their content: swapping them is no change.
+// One of two DIMMs going away is one removal; which of the two keys goes
+// depends on the digests, so the other may come out modified.
+void checkDuplicateKeys() {
+    std::vector<Disk> rows;
+    const Disk a = { nullptr, "Alpha", "1.0", "OK" };
+    const Disk b = { nullptr, "Beta", "1.0", "OK" };
+    rows.push_back(a);
+    rows.push_back(b);
+    ReportSection before = section(rows, false);
+    std::swap(rows[0], rows[1]);
+    ReportSection after = section(rows, false);
+    std::vector<DeviceChange> changes;
+    diffSection(before, after, changes);
+    CHECK(changes.empty());
+
+    after.results[1] = ResultSet();
+    after.results[1].addColumn("BankLabel");
+    after.results[1].addColumn("DeviceLocator");
+    after.results[1].addColumn("Capacity");
+    after.results[1].addRow();
+    after.results[1].setString(0, "BANK 0", 6);
+    after.results[1].setString(1, "DIMM 1", 6);
+    after.results[1].setUint(2, 16ull << 30);
+    changes.clear();
+    diffSection(before, after, changes);
+    size_t removed = 0;
+    for (size_t k = 0; k < changes.size(); ++k) {
+        CHECK(changes[k].cls == "Win32_PhysicalMemory");
+        CHECK(changes[k].kind != DeviceChange::Added);
+        if (changes[k].kind == DeviceChange::Removed) ++removed;
+    }
+    CHECK(removed == 1);
+}
+
+} // namespace
+
+int main() {
+    checkUnchanged();
+    checkChanges();
+    checkDuplicateKeys();
+    if (g_failures) std::cerr << g_failures << " checks failed" << std::endl;
+    return g_failures ? 1 : 0;
+}
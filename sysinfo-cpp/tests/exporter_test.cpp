@@ -0,0 +1,171 @@
+// The --serve exporter on a loopback port over a fixture: GET /metrics is
+// an OpenMetrics page ending in "# EOF", HEAD sends its headers only,
+// other paths are 404, other methods 405, and a client that never sends
+// its request is dropped after the per-connection deadline. Exits non-zero
+// with a message on the first mismatch.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exporter.h"
+#include "fixture_source.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl; \
+            ++g_failures;                                                            \
+        }                                                                            \
+    } while (0)
+
+typedef std::chrono::steady_clock Clock;
+
+const char kFixture[] =
+    "[Win32_Processor]\n"
+    "Name=Alpha\n"
+    "NumberOfCores:u64=4\n";
+
+// The exporter's per-connection deadline, plus slack.
+const std::chrono::milliseconds kClientDeadline(2000);
+const std::chrono::milliseconds kSlack(1000);
+
+// A loopback port nobody listens on right now.
+std::string freePort() {
+    const int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    std::string port;
+    if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+        getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len) == 0) {
+        port = std::to_string(static_cast<unsigned>(ntohs(addr.sin_port)));
+    }
+    close(s);
+    return port;
+}
+
+int connectTo(const std::string& port) {
+    const int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(std::stoul(port)));
+    timeval tv = { 5, 0 }; // a hung exporter fails the test instead of hanging it
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+// Everything the server sends until it closes the connection.
+std::string readAll(int s) {
+    std::string reply;
+    char buf[4096];
+    for (ssize_t n; (n = recv(s, buf, sizeof(buf), 0)) > 0;) reply.append(buf, static_cast<size_t>(n));
+    return reply;
+}
+
+// Sends `request` and returns the whole response, or "" if the exporter
+// can't be reached.
+std::string exchange(const std::string& port, const std::string& request) {
+    const int s = connectTo(port);
+    if (s < 0) return std::string();
+    send(s, request.data(), request.size(), MSG_NOSIGNAL);
+    const std::string reply = readAll(s);
+    close(s);
+    return reply;
+}
+
+bool startsWith(const std::string& s, const char* prefix) {
+    return s.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+bool endsWith(const std::string& s, const char* suffix) {
+    const size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+void checkServe(const std::string& port) {
+    // 503 until the first collection is in.
+    std::string page;
+    for (const Clock::time_point give = Clock::now() + std::chrono::seconds(5); Clock::now() < give;) {
+        page = exchange(port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        if (startsWith(page, "HTTP/1.1 200 ")) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    CHECK(startsWith(page, "HTTP/1.1 200 OK\r\n"));
+    CHECK(page.find("\r\nContent-Type: application/openmetrics-text") != std::string::npos);
+    CHECK(page.find("sysinfo_query_complete{section=\"cpu\",class=\"Win32_Processor\"} 1\n") != std::string::npos);
+    CHECK(endsWith(page, "# EOF\n"));
+
+    const std::string head = exchange(port, "HEAD /metrics HTTP/1.1\r\n\r\n");
+    CHECK(startsWith(head, "HTTP/1.1 200 OK\r\n"));
+    CHECK(endsWith(head, "\r\n\r\n"));
+    CHECK(page.compare(0, head.size(), head) == 0);
+
+    CHECK(startsWith(exchange(port, "GET /other HTTP/1.1\r\n\r\n"), "HTTP/1.1 404 "));
+    CHECK(startsWith(exchange(port, "GET /metricsx HTTP/1.1\r\n\r\n"), "HTTP/1.1 404 "));
+    CHECK(startsWith(exchange(port, "GET /metrics?x=1 HTTP/1.1\r\n\r\n"), "HTTP/1.1 200 "));
+    CHECK(startsWith(exchange(port, "POST /metrics HTTP/1.1\r\nContent-Length: 0\r\n\r\n"), "HTTP/1.1 405 "));
+
+    // Silent client: closed without an answer once its time is up.
+    const int s = connectTo(port);
+    CHECK(s >= 0);
+    if (s >= 0) {
+        const Clock::time_point start = Clock::now();
+        CHECK(readAll(s).empty());
+        const Clock::duration took = Clock::now() - start;
+        CHECK(took >= kClientDeadline - std::chrono::milliseconds(100));
+        CHECK(took < kClientDeadline + kSlack);
+        close(s);
+    }
+}
+
+} // namespace
+
+int main() {
+    FixtureSource src;
+    src.parse(kFixture, sizeof(kFixture) - 1);
+    std::vector<SectionDef> sections(1);
+    sections[0].id = "cpu";
+    sections[0].queries.push_back(L"SELECT Name, NumberOfCores FROM Win32_Processor");
+    sections[0].print = nullptr;
+
+    ExporterOptions opt;
+    opt.port = freePort();
+    opt.refresh = std::chrono::milliseconds(100);
+    CHECK(!opt.port.empty());
+    std::wostringstream log;
+    int result = -1;
+    std::thread exporter([&]() { result = runExporter(src, sections, opt, log); });
+
+    checkServe(opt.port);
+
+    // As Ctrl+C would.
+    std::raise(SIGTERM);
+    exporter.join();
+    CHECK(result == 0);
+    if (g_failures) std::cerr << g_failures << " checks failed" << std::endl;
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+// Round trip of the history codec: ticks written with HistoryWriter come
+// back from queryHistory unchanged, one per 1 ms bucket, and coarse buckets
+// (folded from block rollups where they can be) match the raw values.
+// Exits non-zero with a message on the first mismatch.
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "history.h"
+#include "mapped_file.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl; \
+            ++g_failures;                                                            \
+        }                                                                            \
+    } while (0)
+
+struct Sample {
+    int64_t time;
+    uint64_t value;
+};
+
+typedef std::map<std::string, std::vector<Sample> > Written;
+
+// Values that exercise every value encoding: unchanged, inside the previous
+// window, a new window, the full 64 bits, and back to zero.
+uint64_t valueAt(uint64_t& rng, size_t tick) {
+    static const uint64_t kEdges[] = { 0, 0, 1, UINT64_MAX, UINT64_MAX, 0x8000000000000000ull, 0, 42, 43, 41 };
+    if (tick < sizeof(kEdges) / sizeof(kEdges[0])) return kEdges[tick];
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (rng & 3) ? (rng >> (rng & 63)) : 1000;
+}
+
+// Writes a few blocks' worth of ticks: "steady" every tick, "sparse" on
+// every third (the "no value" marker in between), "late" joining the
+// segment halfway. Time steps include a jump that needs the 64-bit escape.
+Written writeTicks(const std::string& path) {
+    Written written;
+    HistoryWriter writer;
+    std::string error;
+    CHECK(writer.open(path, error));
+    uint64_t rng = 88172645463325252ull;
+    int64_t time = 1700000000000;
+    std::vector<HistoryPoint> points;
+    for (size_t t = 0; t < 4000; ++t) {
+        if (t == 1500) time += int64_t(1) << 40;
+        else if (t == 1501) time += 7;
+        else if (t % 97 == 0) time += 1000 + static_cast<int64_t>(t % 300);
+        else time += 1000;
+        points.clear();
+        HistoryPoint p;
+        p.series = "steady";
+        p.value = valueAt(rng, t);
+        points.push_back(p);
+        if (t % 3 == 0) {
+            p.series = "sparse";
+            p.value = t;
+            points.push_back(p);
+        }
+        if (t >= 2000) {
+            p.series = "late";
+            p.value = UINT64_MAX - t;
+            points.push_back(p);
+        }
+        writer.append(time, points);
+        for (size_t k = 0; k < points.size(); ++k) {
+            const Sample s = { time, points[k].value };
+            written[points[k].series].push_back(s);
+        }
+    }
+    return written;
+}
+
+void checkExact(const MappedFile& file, const Written& written) {
+    std::vector<HistorySeries> series;
+    std::string error;
+    CHECK(queryHistory(file.data(), file.size(), "", 0, INT64_MAX, 1, series, error));
+    CHECK(series.size() == written.size());
+    for (size_t s = 0; s < series.size(); ++s) {
+        Written::const_iterator it = written.find(series[s].name);
+        CHECK(it != written.end());
+        if (it == written.end()) continue;
+        const std::vector<HistoryBucket>& buckets = series[s].buckets;
+        CHECK(buckets.size() == it->second.size());
+        for (size_t b = 0; b < buckets.size() && b < it->second.size(); ++b) {
+            CHECK(buckets[b].start == it->second[b].time);
+            CHECK(buckets[b].count == 1);
+            CHECK(buckets[b].min == it->second[b].value);
+            CHECK(buckets[b].max == it->second[b].value);
+        }
+    }
+}
+
+void checkBuckets(const MappedFile& file, const Written& written, int64_t from, int64_t stepMs) {
+    std::vector<HistorySeries> series;
+    std::string error;
+    CHECK(queryHistory(file.data(), file.size(), "", from, INT64_MAX, stepMs, series, error));
+    for (size_t s = 0; s < series.size(); ++s) {
+        Written::const_iterator it = written.find(series[s].name);
+        if (it == written.end()) continue;
+        std::map<int64_t, HistoryBucket> expected;
+        for (size_t k = 0; k < it->second.size(); ++k) {
+            const Sample& sample = it->second[k];
+            if (sample.time < from) continue;
+            const int64_t start = from + (sample.time - from) / stepMs * stepMs;
+            const HistoryBucket fresh = { start, sample.value, sample.value, 0.0, 0 };
+            HistoryBucket& b = expected.insert(std::make_pair(start, fresh)).first->second;
+            b.min = std::min(b.min, sample.value);
+            b.max = std::max(b.max, sample.value);
+            b.sum += static_cast<double>(sample.value);
+            ++b.count;
+        }
+        const std::vector<HistoryBucket>& buckets = series[s].buckets;
+        CHECK(buckets.size() == expected.size());
+        std::map<int64_t, HistoryBucket>::const_iterator e = expected.begin();
+        for (size_t b = 0; b < buckets.size() && e != expected.end(); ++b, ++e) {
+            CHECK(buckets[b].start == e->second.start);
+            CHECK(buckets[b].count == e->second.count);
+            CHECK(buckets[b].min == e->second.min);
+            CHECK(buckets[b].max == e->second.max);
+            const double diff = buckets[b].sum - e->second.sum;
+            CHECK(diff <= e->second.sum * 1e-12 && -diff <= e->second.sum * 1e-12);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    const std::string path = "history_test.tmp";
+    std::remove(path.c_str());
+    const Written written = writeTicks(path);
+    MappedFile file;
+    CHECK(file.open(path));
+    if (file.data()) {
+        checkExact(file, written);
+        const int64_t first = written.find("steady")->second.front().time;
+        checkBuckets(file, written, first, 3600 * 1000);
+        checkBuckets(file, written, first - 123457, 25 * 60 * 1000);
+    }
+    file.close();
+    std::remove(path.c_str());
+    if (g_failures) std::cerr << g_failures << " checks failed" << std::endl;
+    return g_failures ? 1 : 0;
+}
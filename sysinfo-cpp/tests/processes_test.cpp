@@ -0,0 +1,177 @@
+// The Linux process scan over a generated /proc: every numeric entry comes
+// back once, in pid order, with its fields in Win32_Process units however
+// its name is spelt, and the summary's top-N and per-user rollups match
+// the records. Run as root, some processes are given to another user.
+// Exits non-zero with a message on the first mismatch.
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "processes.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << std::endl; \
+            ++g_failures;                                                            \
+        }                                                                            \
+    } while (0)
+
+// Enough for the scan to split the pids over several threads.
+const unsigned kCount = 10000;
+const size_t kTop = 5;
+
+struct Fake {
+    unsigned pid;
+    const char* name;
+    unsigned threads;
+    uint64_t utime, stime, rss; // clock ticks, pages
+    uid_t uid;
+};
+
+Fake fake(unsigned k, uid_t other) {
+    static const char* const names[] = { "kworker/3:1-events", "systemd", "Web Content", "(sd-pam)", "a) b (c" };
+    const Fake f = { 100 + k * 3, names[k % 5], 1 + k % 64, k % 997, (k * 31) % 503, (k * 7919) % 10007,
+                     k % 3 == 0 ? other : getuid() };
+    return f;
+}
+
+// The <pid>/stat files the scan reads, plus entries it must skip.
+bool writeTree(const std::string& dir, uid_t other) {
+    for (unsigned k = 0; k < kCount; ++k) {
+        const Fake f = fake(k, other);
+        const std::string sub = dir + "/" + std::to_string(static_cast<unsigned long long>(f.pid));
+        if (mkdir(sub.c_str(), 0755) != 0) return false;
+        FILE* file = std::fopen((sub + "/stat").c_str(), "w");
+        if (!file) return false;
+        std::fprintf(file, "%u (%s) S %u %u %u 0 -1 4194560 0 0 0 0 %llu %llu 0 0 20 0 %u 0 0 0 %llu "
+                     "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n",
+                     f.pid, f.name, k ? 100 : 0, f.pid, f.pid, static_cast<unsigned long long>(f.utime),
+                     static_cast<unsigned long long>(f.stime), f.threads, static_cast<unsigned long long>(f.rss));
+        std::fclose(file);
+        if (f.uid != getuid() && chown(sub.c_str(), f.uid, static_cast<gid_t>(-1)) != 0) return false;
+    }
+    return mkdir((dir + "/self").c_str(), 0755) == 0 && mkdir((dir + "/12ab").c_str(), 0755) == 0;
+}
+
+void removeTree(const std::string& dir) {
+    for (unsigned k = 0; k < kCount; ++k) {
+        const std::string sub = dir + "/" + std::to_string(static_cast<unsigned long long>(100 + k * 3));
+        unlink((sub + "/stat").c_str());
+        rmdir(sub.c_str());
+    }
+    rmdir((dir + "/self").c_str());
+    rmdir((dir + "/12ab").c_str());
+    rmdir(dir.c_str());
+}
+
+// Pids of the `top` processes ranked by `value`, ties to the lower pid.
+template <typename Value>
+std::vector<unsigned> expectedTop(uid_t other, Value value) {
+    std::vector<std::pair<uint64_t, unsigned> > ranked;
+    for (unsigned k = 0; k < kCount; ++k) ranked.push_back(std::make_pair(value(fake(k, other)), k));
+    std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint64_t, unsigned>& a, const std::pair<uint64_t, unsigned>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    std::vector<unsigned> pids;
+    for (size_t k = 0; k < kTop; ++k) pids.push_back(fake(ranked[k].second, other).pid);
+    return pids;
+}
+
+void check(const std::string& dir, uid_t other) {
+    const uint64_t ticks = static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+    ProcessSnapshot snap;
+    snapshotProcesses(dir, true, QueryBudget(), snap);
+    CHECK(snap.status == QueryStatus::Complete);
+    CHECK(snap.processes.size() == kCount);
+    CHECK(snap.owners.size() == (other != getuid() ? 2u : 1u));
+    for (unsigned k = 0; k < kCount && k < snap.processes.size(); ++k) {
+        const Fake f = fake(k, other);
+        const ProcessRecord& p = snap.processes[k];
+        if (p.pid != f.pid || p.name != f.name || p.parentPid != (k ? 100u : 0u) || p.threads != f.threads ||
+            p.userTime != f.utime * 10000000 / ticks || p.kernelTime != f.stime * 10000000 / ticks ||
+            p.workingSet != f.rss * page || p.owner >= snap.owners.size()) {
+            std::cerr << "pid " << f.pid << " read back wrong" << std::endl;
+            ++g_failures;
+            break;
+        }
+    }
+
+    const ResultSet rs = queryProcesses(L"SELECT ProcessId, Name, WorkingSetSize, UserModeTime, KernelModeTime, "
+                                        L"ThreadCount, Owner FROM Win32_Process", dir, QueryBudget());
+    ProcessSummary sum;
+    summarizeProcesses(rs, kTop, sum);
+    CHECK(sum.processes == kCount);
+    uint64_t threads = 0, workingSet = 0;
+    for (unsigned k = 0; k < kCount; ++k) {
+        threads += fake(k, other).threads;
+        workingSet += fake(k, other).rss * page;
+    }
+    CHECK(sum.threads == threads);
+    CHECK(sum.workingSet == workingSet);
+
+    const int cPid = rs.column("ProcessId");
+    const std::vector<unsigned> byMemory = expectedTop(other, [](const Fake& f) { return f.rss; });
+    const std::vector<unsigned> byCpu = expectedTop(other, [ticks](const Fake& f) {
+        return f.utime * 10000000 / ticks + f.stime * 10000000 / ticks;
+    });
+    CHECK(sum.topMemory.size() == kTop && sum.topCpu.size() == kTop);
+    for (size_t k = 0; k < kTop && k < sum.topMemory.size() && k < sum.topCpu.size(); ++k) {
+        CHECK(rs.at(sum.topMemory[k], cPid).asUint() == byMemory[k]);
+        CHECK(rs.at(sum.topCpu[k], cPid).asUint() == byCpu[k]);
+    }
+
+    // Per user, largest working set first.
+    CHECK(sum.users.size() == snap.owners.size());
+    uint64_t processes = 0;
+    for (size_t u = 0; u < sum.users.size(); ++u) {
+        const UserRollup& user = sum.users[u];
+        uint64_t count = 0, userThreads = 0, userSet = 0;
+        for (unsigned k = 0; k < kCount; ++k) {
+            const Fake f = fake(k, other);
+            if (snap.owners[snap.processes[k].owner] != user.user) continue;
+            ++count;
+            userThreads += f.threads;
+            userSet += f.rss * page;
+        }
+        CHECK(user.processes == count);
+        CHECK(user.threads == userThreads);
+        CHECK(user.workingSet == userSet);
+        if (u) CHECK(sum.users[u - 1].workingSet >= user.workingSet);
+        processes += user.processes;
+    }
+    CHECK(processes == kCount);
+}
+
+} // namespace
+
+int main() {
+    char dir[] = "/tmp/processes_test-XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::cerr << "cannot create a directory under /tmp" << std::endl;
+        return 1;
+    }
+    const uid_t other = getuid() == 0 ? 1 : getuid(); // chown needs root
+    if (writeTree(dir, other)) {
+        check(dir, other);
+    } else {
+        std::cerr << "cannot write the process tree" << std::endl;
+        ++g_failures;
+    }
+    removeTree(dir);
+    if (g_failures) std::cerr << g_failures << " checks failed" << std::endl;
+    return g_failures ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+#include "profile.h"
+#include "x86_cpuid.h"
+
+namespace {
+
+// Columns a query asked for, as indexes into one class's column table:
+// slot[k] is the result column of table entry k, or -1.
+class Columns {
+public:
+    Columns(const std::wstring& wql, const char* const* names, int count, ResultSet& rs) : m_slot(count, -1) {
+        const std::vector<std::wstring> cols = wqlColumns(wql);
+        for (size_t c = 0; c < (cols.empty() ? size_t(count) : cols.size()); ++c) {
+            const std::string name = cols.empty() ? names[c] : std::string(cols[c].begin(), cols[c].end()); // ASCII
+            const int col = rs.addColumn(name);
+            for (int k = 0; k < count; ++k) {
+                if (name == names[k]) m_slot[k] = col;
+            }
+        }
+    }
+
+    int operator[](int k) const { return m_slot[k]; }
+
+private:
+    std::vector<int> m_slot;
+};
+
+void setText(ResultSet& rs, int col, const std::string& s) {
+    if (col >= 0) rs.setString(col, s.data(), s.size());
+}
+
+void setUint(ResultSet& rs, int col, uint64_t v) {
+    if (col >= 0) rs.setUint(col, v);
+}
+
+enum PackageColumn { PkgPackage, PkgCores, PkgLogicalProcessors, PkgNumaNodes, PkgFeatures, kPackageColumns };
+const char* const kPackageNames[kPackageColumns] = { "Package", "Cores", "LogicalProcessors", "NumaNodes", "Features" };
+
+enum NodeColumn { NodeId, NodeCpus, NodeCoreCpus, NodeAffinityMask, NodeMemorySize, NodeDistances, kNodeColumns };
+const char* const kNodeNames[kNodeColumns] = { "NodeId", "Cpus", "CoreCpus", "AffinityMask", "MemorySize", "Distances" };
+
+enum CpuColumn { CpuProcessorId, CpuPackage, CpuNumaNode, CpuCore, CpuThread, CpuCoreType, kCpuColumns };
+const char* const kCpuNames[kCpuColumns] = { "ProcessorId", "Package", "NumaNode", "Core", "Thread", "CoreType" };
+
+enum CacheColumn { CacheDeviceID, CacheLevel, CacheType, CacheSize, CacheLineSize, CacheAssociativity, CacheSharedCpus,
+                   kCacheColumns };
+const char* const kCacheNames[kCacheColumns] = { "DeviceID", "Level", "Type", "Size", "LineSize", "Associativity",
+                                                 "SharedCpus" };
+
+// One thread per core: the first SMT sibling of each core among `cpus`.
+std::vector<unsigned> firstThreads(const CpuTopology& topo, const std::vector<unsigned>& cpus) {
+    std::vector<unsigned> out;
+    for (size_t k = 0; k < topo.cpus.size(); ++k) {
+        const CpuTopology::Cpu& c = topo.cpus[k];
+        if (c.thread == 0 && std::binary_search(cpus.begin(), cpus.end(), c.id)) out.push_back(c.id);
+    }
+    return out;
+}
+
+void packageRows(const CpuTopology& topo, const Columns& slot, ResultSet& rs) {
+    std::string features;
+    if (slot[PkgFeatures] >= 0) {
+        const std::vector<std::string> names = cpuFeatures();
+        for (size_t k = 0; k < names.size(); ++k) features += (k ? " " : "") + names[k];
+    }
+    std::vector<unsigned> packages;
+    for (size_t k = 0; k < topo.cpus.size(); ++k) packages.push_back(topo.cpus[k].package);
+    std::sort(packages.begin(), packages.end());
+    packages.erase(std::unique(packages.begin(), packages.end()), packages.end());
+
+    for (size_t p = 0; p < packages.size(); ++p) {
+        std::vector<unsigned> cores;
+        std::vector<int> nodes;
+        uint64_t logical = 0;
+        for (size_t k = 0; k < topo.cpus.size(); ++k) {
+            const CpuTopology::Cpu& c = topo.cpus[k];
+            if (c.package != packages[p]) continue;
+            ++logical;
+            cores.push_back(c.core);
+            nodes.push_back(c.node);
+        }
+        std::sort(cores.begin(), cores.end());
+        std::sort(nodes.begin(), nodes.end());
+        rs.addRow();
+        setUint(rs, slot[PkgPackage], packages[p]);
+        setUint(rs, slot[PkgCores], std::unique(cores.begin(), cores.end()) - cores.begin());
+        setUint(rs, slot[PkgLogicalProcessors], logical);
+        setUint(rs, slot[PkgNumaNodes], std::unique(nodes.begin(), nodes.end()) - nodes.begin());
+        if (!features.empty()) setText(rs, slot[PkgFeatures], features);
+    }
+}
+
+void nodeRows(const CpuTopology& topo, const Columns& slot, ResultSet& rs) {
+    for (size_t k = 0; k < topo.nodes.size(); ++k) {
+        const CpuTopology::Node& n = topo.nodes[k];
+        rs.addRow();
+        setUint(rs, slot[NodeId], n.id);
+        setText(rs, slot[NodeCpus], cpuListText(n.cpus));
+        if (slot[NodeCoreCpus] >= 0) setText(rs, slot[NodeCoreCpus], cpuListText(firstThreads(topo, n.cpus)));
+        setText(rs, slot[NodeAffinityMask], cpuMaskText(n.cpus));
+        if (n.memory) setUint(rs, slot[NodeMemorySize], n.memory);
+        if (!n.distances.empty() && slot[NodeDistances] >= 0) {
+            std::string text;
+            for (size_t d = 0; d < n.distances.size(); ++d) text += (d ? " " : "") + std::to_string(n.distances[d]);
+            setText(rs, slot[NodeDistances], text);
+        }
+    }
+}
+
+void cpuRows(const CpuTopology& topo, const Columns& slot, ResultSet& rs) {
+    for (size_t k = 0; k < topo.cpus.size(); ++k) {
+        const CpuTopology::Cpu& c = topo.cpus[k];
+        rs.addRow();
+        setUint(rs, slot[CpuProcessorId], c.id);
+        setUint(rs, slot[CpuPackage], c.package);
+        if (c.node >= 0) setUint(rs, slot[CpuNumaNode], static_cast<unsigned>(c.node));
+        setUint(rs, slot[CpuCore], c.core);
+        setUint(rs, slot[CpuThread], c.thread);
+        if (c.type != CoreType::Unknown) {
+            setText(rs, slot[CpuCoreType], c.type == CoreType::Performance ? "Performance" : "Efficiency");
+        }
+    }
+}
+
+void cacheRows(const CpuTopology& topo, const Columns& slot, ResultSet& rs) {
+    for (size_t k = 0; k < topo.caches.size(); ++k) {
+        const CpuTopology::Cache& c = topo.caches[k];
+        char id[32];
+        const char* suffix = c.type == 'd' ? "d" : c.type == 'i' ? "i" : "";
+        std::snprintf(id, sizeof(id), "L%u%s cpu%u", c.level, suffix, c.cpus.empty() ? 0 : c.cpus[0]);
+        rs.addRow();
+        setText(rs, slot[CacheDeviceID], id);
+        setUint(rs, slot[CacheLevel], c.level);
+        setText(rs, slot[CacheType], c.type == 'd' ? "Data" : c.type == 'i' ? "Instruction" : "Unified");
+        setUint(rs, slot[CacheSize], c.size);
+        if (c.lineSize) setUint(rs, slot[CacheLineSize], c.lineSize);
+        if (c.ways) setUint(rs, slot[CacheAssociativity], c.ways);
+        setText(rs, slot[CacheSharedCpus], cpuListText(c.cpus));
+    }
+}
+
+} // namespace
+
+std::string cpuListText(const std::vector<unsigned>& cpus) {
+    std::string out;
+    for (size_t k = 0; k < cpus.size();) {
+        size_t end = k;
+        while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1) ++end;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[k]);
+        if (end > k) out += '-' + std::to_string(cpus[end]);
+        k = end + 1;
+    }
+    return out;
+}
+
+bool parseCpuList(const char* s, size_t n, std::vector<unsigned>& out) {
+    out.clear();
+    size_t k = 0;
+    while (k < n && (s[k] == ' ' || s[k] == '\n')) ++k;
+    while (k < n && s[k] != '\n') {
+        unsigned first = 0, last;
+        const size_t start = k;
+        while (k < n && s[k] >= '0' && s[k] <= '9') first = first * 10 + (s[k++] - '0');
+        if (k == start) return false;
+        last = first;
+        if (k < n && s[k] == '-') {
+            const size_t from = ++k;
+            last = 0;
+            while (k < n && s[k] >= '0' && s[k] <= '9') last = last * 10 + (s[k++] - '0');
+            if (k == from || last < first) return false;
+        }
+        for (unsigned c = first; c <= last; ++c) out.push_back(c);
+        if (k < n && s[k] == ',') ++k;
+        else if (k < n && s[k] != '\n' && s[k] != ' ') return false;
+        else break;
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return true;
+}
+
+std::string cpuMaskText(const std::vector<unsigned>& cpus) {
+    if (cpus.empty()) return "0x0";
+    std::vector<unsigned char> nibbles(cpus.back() / 4 + 1, 0);
+    for (size_t k = 0; k < cpus.size(); ++k) nibbles[cpus[k] / 4] |= 1 << (cpus[k] % 4);
+    std::string out = "0x";
+    for (size_t k = nibbles.size(); k-- > 0;) out += "0123456789abcdef"[nibbles[k]];
+    return out;
+}
+
+std::vector<std::string> cpuFeatures() {
+    std::vector<std::string> out;
+#ifdef SYSINFO_X86
+    unsigned r[4];
+    cpuid(0, 0, r);
+    const unsigned maxLeaf = r[0];
+    if (maxLeaf < 1) return out;
+    cpuid(1, 0, r);
+    const unsigned ecx1 = r[2], edx1 = r[3];
+    unsigned ebx7 = 0, ecx7 = 0, edx7 = 0, eax71 = 0;
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, r);
+        ebx7 = r[1];
+        ecx7 = r[2];
+        edx7 = r[3];
+        if (r[0] >= 1) {
+            cpuid(7, 1, r);
+            eax71 = r[0];
+        }
+    }
+    cpuid(0x80000000, 0, r);
+    unsigned ecxExt = 0;
+    if (r[0] >= 0x80000001) {
+        cpuid(0x80000001, 0, r);
+        ecxExt = r[2];
+    }
+
+    // The vector extensions are usable only where the OS saves their
+    // registers: YMM for AVX, ZMM and the opmasks for AVX-512, the tile
+    // registers for AMX.
+    const uint64_t xcr0 = (ecx1 & (1u << 27)) ? enabledXsaveFeatures() : 0;
+    const bool ymm = (xcr0 & 0x6) == 0x6, zmm = ymm && (xcr0 & 0xE0) == 0xE0, tiles = (xcr0 & 0x60000) == 0x60000;
+
+    struct Flag {
+        const char* name;
+        unsigned reg;
+        unsigned bit;
+        int state; // 0 none, 1 YMM, 2 ZMM, 3 tiles
+    };
+    const Flag flags[] = {
+        { "SSE", edx1, 25, 0 },          { "SSE2", edx1, 26, 0 },          { "SSE3", ecx1, 0, 0 },
+        { "SSSE3", ecx1, 9, 0 },         { "SSE4.1", ecx1, 19, 0 },        { "SSE4.2", ecx1, 20, 0 },
+        { "POPCNT", ecx1, 23, 0 },       { "LZCNT", ecxExt, 5, 0 },        { "BMI1", ebx7, 3, 0 },
+        { "BMI2", ebx7, 8, 0 },          { "AES", ecx1, 25, 0 },           { "PCLMULQDQ", ecx1, 1, 0 },
+        { "SHA", ebx7, 29, 0 },          { "AVX", ecx1, 28, 1 },           { "F16C", ecx1, 29, 1 },
+        { "FMA", ecx1, 12, 1 },          { "AVX2", ebx7, 5, 1 },           { "AVX-VNNI", eax71, 4, 1 },
+        { "VAES", ecx7, 9, 1 },          { "GFNI", ecx7, 8, 0 },           { "AVX-512F", ebx7, 16, 2 },
+        { "AVX-512CD", ebx7, 28, 2 },    { "AVX-512BW", ebx7, 30, 2 },     { "AVX-512DQ", ebx7, 17, 2 },
+        { "AVX-512VL", ebx7, 31, 2 },    { "AVX-512IFMA", ebx7, 21, 2 },   { "AVX-512VBMI", ecx7, 1, 2 },
+        { "AVX-512VBMI2", ecx7, 6, 2 },  { "AVX-512VNNI", ecx7, 11, 2 },   { "AVX-512BITALG", ecx7, 12, 2 },
+        { "AVX-512VPOPCNTDQ", ecx7, 14, 2 }, { "AVX-512BF16", eax71, 5, 2 }, { "AVX-512FP16", edx7, 23, 2 },
+        { "AMX-TILE", edx7, 24, 3 },     { "AMX-BF16", edx7, 22, 3 },      { "AMX-INT8", edx7, 25, 3 },
+    };
+    for (size_t k = 0; k < sizeof(flags) / sizeof(flags[0]); ++k) {
+        const Flag& f = flags[k];
+        if (!(f.reg & (1u << f.bit))) continue;
+        if ((f.state == 1 && !ymm) || (f.state == 2 && !zmm) || (f.state == 3 && !tiles)) continue;
+        out.push_back(f.name);
+    }
+#endif
+    return out;
+}
+
+ResultSet queryCpuTopology(const std::wstring& wql, const QueryBudget& budget) {
+    const std::wstring cls = wqlClassName(wql);
+    ResultSet rs;
+    CpuTopology topo;
+    const QueryStatus status = readCpuTopology(budget, topo);
+    // A kernel without NUMA support shows no nodes: all of it is one node.
+    if (topo.nodes.empty() && !topo.cpus.empty()) {
+        CpuTopology::Node node = { 0, std::vector<unsigned>(), 0, std::vector<unsigned>() };
+        for (size_t k = 0; k < topo.cpus.size(); ++k) {
+            node.cpus.push_back(topo.cpus[k].id);
+            topo.cpus[k].node = 0;
+        }
+        topo.nodes.push_back(node);
+    }
+    profileFirstRow();
+
+    if (cls == L"Sysinfo_Package") {
+        packageRows(topo, Columns(wql, kPackageNames, kPackageColumns, rs), rs);
+    } else if (cls == L"Sysinfo_NumaNode") {
+        nodeRows(topo, Columns(wql, kNodeNames, kNodeColumns, rs), rs);
+    } else if (cls == L"Sysinfo_LogicalProcessor") {
+        cpuRows(topo, Columns(wql, kCpuNames, kCpuColumns, rs), rs);
+    } else {
+        cacheRows(topo, Columns(wql, kCacheNames, kCacheColumns, rs), rs);
+    }
+    rs.setStatus(status);
+    return rs;
+}
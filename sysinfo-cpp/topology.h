@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "datasource.h"
+
+// Processor topology: packages, NUMA nodes, cores and their SMT threads,
+// the cache hierarchy and the ISA extensions the OS lets programs use. It
+// is answered as four Sysinfo_* classes with WMI-style rows, so it flows
+// through the report, the structured formats and --diff like the rest.
+
+enum class CoreType : uint8_t { Unknown, Performance, Efficiency };
+
+struct CpuTopology {
+    struct Cpu {
+        unsigned id;      // the OS's logical processor number
+        unsigned package;
+        int node;         // NUMA node, or -1
+        unsigned core;    // core id within the package
+        unsigned thread;  // position among the core's SMT siblings
+        CoreType type;    // Unknown unless the CPU has several core types
+    };
+    struct Cache {
+        unsigned level;
+        char type;        // 'd'ata, 'i'nstruction or 'u'nified
+        uint64_t size;    // bytes
+        unsigned lineSize;
+        unsigned ways;    // 0 when not reported; fully associative caches report their line count
+        std::vector<unsigned> cpus; // logical processors sharing it
+    };
+    struct Node {
+        unsigned id;
+        std::vector<unsigned> cpus;
+        uint64_t memory;  // bytes; 0 when not reported
+        std::vector<unsigned> distances; // to every node in id order; empty when not reported
+    };
+    std::vector<Cpu> cpus;     // by id
+    std::vector<Cache> caches; // by level, then first CPU
+    std::vector<Node> nodes;   // by id
+};
+
+// Reads the topology of the online processors: /sys/devices/system/cpu and
+// /sys/devices/system/node on Linux, GetLogicalProcessorInformationEx on
+// Windows. Core types come from the perf PMUs of hybrid CPUs (cpu_core,
+// cpu_atom) on Linux and from core efficiency classes on Windows.
+QueryStatus readCpuTopology(const QueryBudget& budget, CpuTopology& out);
+
+// ISA extensions both the CPU and the OS support, from CPUID and XCR0:
+// "SSE4.2", "AVX2", "AVX-512F", "AMX-TILE" and so on. Empty off x86.
+std::vector<std::string> cpuFeatures();
+
+// "0-3,8,10-11" for a sorted list of CPU numbers, as taskset -c, numactl
+// and cpuset.cpus take it.
+std::string cpuListText(const std::vector<unsigned>& cpus);
+
+// Parses such a list; false if it isn't one.
+bool parseCpuList(const char* s, size_t n, std::vector<unsigned>& out);
+
+// Hex bit mask over logical processor numbers ("0xff00ff"), as taskset and
+// Windows' start /affinity take it.
+std::string cpuMaskText(const std::vector<unsigned>& cpus);
+
+// Answers "SELECT ... FROM Sysinfo_Package", "Sysinfo_NumaNode",
+// "Sysinfo_LogicalProcessor" or "Sysinfo_Cache" from readCpuTopology()
+// and cpuFeatures(). Sysinfo_NumaNode rows carry the suggested cpusets:
+// every CPU of the node, and one thread per core for work that shouldn't
+// share a core.
+ResultSet queryCpuTopology(const std::wstring& wql, const QueryBudget& budget);
@@ -0,0 +1,133 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "procfs.h"
+
+namespace {
+
+const char kCpuDir[] = "/sys/devices/system/cpu";
+const char kNodeDir[] = "/sys/devices/system/node";
+
+bool readList(FileReader& r, const char* path, std::vector<unsigned>& out) {
+    Slice s;
+    return r.value(path, s) && parseCpuList(s.p, s.n, out) && !out.empty();
+}
+
+bool readNumber(FileReader& r, const char* path, unsigned& out) {
+    Slice s;
+    if (!r.value(path, s)) return false;
+    out = static_cast<unsigned>(s.toU64());
+    return true;
+}
+
+// "32K", "1024K", "32M": sysfs cache sizes.
+uint64_t cacheBytes(Slice s) {
+    uint64_t v = s.toU64();
+    if (s.n && (s.p[s.n - 1] == 'K' || s.p[s.n - 1] == 'k')) v <<= 10;
+    else if (s.n && s.p[s.n - 1] == 'M') v <<= 20;
+    return v;
+}
+
+bool cacheBefore(const CpuTopology::Cache& a, const CpuTopology::Cache& b) {
+    if (a.level != b.level) return a.level < b.level;
+    if (a.type != b.type) return a.type < b.type; // data, instruction, unified
+    return a.cpus < b.cpus;
+}
+
+void readCaches(FileReader& r, unsigned cpu, std::vector<CpuTopology::Cache>& caches) {
+    char path[128];
+    for (unsigned index = 0;; ++index) {
+        CpuTopology::Cache c = { 0, 'u', 0, 0, 0, std::vector<unsigned>() };
+        std::snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/level", kCpuDir, cpu, index);
+        if (!readNumber(r, path, c.level)) return;
+        Slice s;
+        std::snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/type", kCpuDir, cpu, index);
+        if (r.value(path, s)) c.type = s.equals("Data") ? 'd' : s.equals("Instruction") ? 'i' : 'u';
+        std::snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/shared_cpu_list", kCpuDir, cpu, index);
+        if (!readList(r, path, c.cpus)) c.cpus.assign(1, cpu);
+        // Each cache is listed under every CPU sharing it; keep the copy
+        // of its first one.
+        if (c.cpus[0] != cpu) continue;
+        std::snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/size", kCpuDir, cpu, index);
+        if (r.value(path, s)) c.size = cacheBytes(s);
+        std::snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/coherency_line_size", kCpuDir, cpu, index);
+        readNumber(r, path, c.lineSize);
+        std::snprintf(path, sizeof(path), "%s/cpu%u/cache/index%u/ways_of_associativity", kCpuDir, cpu, index);
+        readNumber(r, path, c.ways);
+        caches.push_back(c);
+    }
+}
+
+} // namespace
+
+QueryStatus readCpuTopology(const QueryBudget& budget, CpuTopology& out) {
+    FileReader r;
+    r.setBudget(&budget);
+    char path[128];
+
+    std::vector<unsigned> online;
+    std::snprintf(path, sizeof(path), "%s/online", kCpuDir);
+    if (!readList(r, path, online)) return r.status();
+
+    // Hybrid CPUs register one perf PMU per core type.
+    std::vector<unsigned> pCores, eCores;
+    readList(r, "/sys/devices/cpu_core/cpus", pCores);
+    readList(r, "/sys/devices/cpu_atom/cpus", eCores);
+
+    for (size_t k = 0; k < online.size(); ++k) {
+        const unsigned id = online[k];
+        CpuTopology::Cpu c = { id, 0, -1, id, 0, CoreType::Unknown };
+        std::snprintf(path, sizeof(path), "%s/cpu%u/topology/physical_package_id", kCpuDir, id);
+        readNumber(r, path, c.package);
+        std::snprintf(path, sizeof(path), "%s/cpu%u/topology/core_id", kCpuDir, id);
+        readNumber(r, path, c.core);
+        std::vector<unsigned> siblings;
+        std::snprintf(path, sizeof(path), "%s/cpu%u/topology/thread_siblings_list", kCpuDir, id);
+        if (readList(r, path, siblings)) {
+            c.thread = static_cast<unsigned>(std::lower_bound(siblings.begin(), siblings.end(), id) - siblings.begin());
+        }
+        if (std::binary_search(pCores.begin(), pCores.end(), id)) c.type = CoreType::Performance;
+        else if (std::binary_search(eCores.begin(), eCores.end(), id)) c.type = CoreType::Efficiency;
+        out.cpus.push_back(c);
+        readCaches(r, id, out.caches);
+    }
+    std::sort(out.caches.begin(), out.caches.end(), cacheBefore);
+
+    std::vector<unsigned> nodes;
+    std::snprintf(path, sizeof(path), "%s/online", kNodeDir);
+    readList(r, path, nodes);
+    for (size_t k = 0; k < nodes.size(); ++k) {
+        CpuTopology::Node n = { nodes[k], std::vector<unsigned>(), 0, std::vector<unsigned>() };
+        std::snprintf(path, sizeof(path), "%s/node%u/cpulist", kNodeDir, n.id);
+        readList(r, path, n.cpus); // memory-only nodes have none
+        Slice text, line, key, value;
+        std::snprintf(path, sizeof(path), "%s/node%u/meminfo", kNodeDir, n.id);
+        if (r.read(path, text)) {
+            // "Node 0 MemTotal:       16310780 kB"
+            for (LineReader lines(text); lines.next(line);) {
+                if (line.split(':', key, value) && key.n >= 8 && std::memcmp(key.p + key.n - 8, "MemTotal", 8) == 0) {
+                    n.memory = value.toU64() << 10;
+                    break;
+                }
+            }
+        }
+        std::snprintf(path, sizeof(path), "%s/node%u/distance", kNodeDir, n.id);
+        if (r.value(path, text)) {
+            for (size_t at = 0; at < text.n;) {
+                while (at < text.n && text.p[at] == ' ') ++at;
+                if (at == text.n) break;
+                const Slice rest(text.p + at, text.n - at);
+                n.distances.push_back(static_cast<unsigned>(rest.toU64()));
+                while (at < text.n && text.p[at] != ' ') ++at;
+            }
+        }
+        for (size_t c = 0; c < out.cpus.size(); ++c) {
+            if (std::binary_search(n.cpus.begin(), n.cpus.end(), out.cpus[c].id)) out.cpus[c].node = static_cast<int>(n.id);
+        }
+        out.nodes.push_back(n);
+    }
+    return r.status();
+}
@@ -0,0 +1,109 @@
+#define NOMINMAX
+#include <windows.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "topology.h"
+
+namespace {
+
+// Logical processor numbers run across processor groups: group g's CPU k
+// is g * 64 + k, as in the Linux numbering on the same machine.
+std::vector<unsigned> maskCpus(const GROUP_AFFINITY& mask) {
+    std::vector<unsigned> cpus;
+    for (unsigned k = 0; k < sizeof(KAFFINITY) * 8; ++k) {
+        if (mask.Mask & (KAFFINITY(1) << k)) cpus.push_back(mask.Group * 64u + k);
+    }
+    return cpus;
+}
+
+bool cacheBefore(const CpuTopology::Cache& a, const CpuTopology::Cache& b) {
+    if (a.level != b.level) return a.level < b.level;
+    if (a.type != b.type) return a.type < b.type; // data, instruction, unified
+    return a.cpus < b.cpus;
+}
+
+} // namespace
+
+QueryStatus readCpuTopology(const QueryBudget& budget, CpuTopology& out) {
+    DWORD len = 0;
+    GetLogicalProcessorInformationEx(RelationAll, NULL, &len);
+    std::vector<char> buf(len);
+    if (!len || !GetLogicalProcessorInformationEx(
+                    RelationAll, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buf.data()), &len)) {
+        return budget.check();
+    }
+
+    struct Core {
+        std::vector<unsigned> cpus;
+        BYTE efficiency;
+    };
+    std::vector<Core> cores;
+    std::vector<std::vector<unsigned> > packages;
+    for (DWORD at = 0; at < len;) {
+        const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info =
+            *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buf.data() + at);
+        at += info.Size;
+        if (info.Relationship == RelationProcessorCore) {
+            Core core = { maskCpus(info.Processor.GroupMask[0]), info.Processor.EfficiencyClass };
+            cores.push_back(core);
+        } else if (info.Relationship == RelationProcessorPackage) {
+            std::vector<unsigned> cpus;
+            for (WORD g = 0; g < info.Processor.GroupCount; ++g) {
+                const std::vector<unsigned> group = maskCpus(info.Processor.GroupMask[g]);
+                cpus.insert(cpus.end(), group.begin(), group.end());
+            }
+            packages.push_back(cpus);
+        } else if (info.Relationship == RelationCache) {
+            const CACHE_RELATIONSHIP& c = info.Cache;
+            if (c.Type == CacheTrace) continue;
+            CpuTopology::Cache cache = { c.Level, c.Type == CacheData ? 'd' : c.Type == CacheInstruction ? 'i' : 'u',
+                                         c.CacheSize, c.LineSize,
+                                         c.Associativity == CACHE_FULLY_ASSOCIATIVE ? c.CacheSize / std::max<WORD>(c.LineSize, 1)
+                                                                                    : c.Associativity,
+                                         maskCpus(c.GroupMask) };
+            out.caches.push_back(cache);
+        } else if (info.Relationship == RelationNumaNode) {
+            CpuTopology::Node node = { info.NumaNode.NodeNumber, maskCpus(info.NumaNode.GroupMask), 0,
+                                       std::vector<unsigned>() };
+            out.nodes.push_back(node);
+        }
+    }
+
+    // Efficiency classes only mean something when cores differ in them;
+    // the highest class is the performance cores.
+    BYTE lowest = 0xFF, highest = 0;
+    for (size_t k = 0; k < cores.size(); ++k) {
+        lowest = std::min(lowest, cores[k].efficiency);
+        highest = std::max(highest, cores[k].efficiency);
+    }
+    for (size_t k = 0; k < cores.size(); ++k) {
+        const std::vector<unsigned>& threads = cores[k].cpus;
+        for (size_t t = 0; t < threads.size(); ++t) {
+            CpuTopology::Cpu c = { threads[t], 0, -1, static_cast<unsigned>(k), static_cast<unsigned>(t),
+                                   CoreType::Unknown };
+            if (lowest != highest) c.type = cores[k].efficiency == highest ? CoreType::Performance : CoreType::Efficiency;
+            for (size_t p = 0; p < packages.size(); ++p) {
+                if (std::find(packages[p].begin(), packages[p].end(), c.id) != packages[p].end()) {
+                    c.package = static_cast<unsigned>(p);
+                }
+            }
+            for (size_t n = 0; n < out.nodes.size(); ++n) {
+                const std::vector<unsigned>& cpus = out.nodes[n].cpus;
+                if (std::binary_search(cpus.begin(), cpus.end(), c.id)) c.node = static_cast<int>(out.nodes[n].id);
+            }
+            out.cpus.push_back(c);
+        }
+    }
+    struct ById {
+        bool operator()(const CpuTopology::Cpu& a, const CpuTopology::Cpu& b) const { return a.id < b.id; }
+    };
+    struct NodeById {
+        bool operator()(const CpuTopology::Node& a, const CpuTopology::Node& b) const { return a.id < b.id; }
+    };
+    std::sort(out.cpus.begin(), out.cpus.end(), ById());
+    std::sort(out.nodes.begin(), out.nodes.end(), NodeById());
+    std::sort(out.caches.begin(), out.caches.end(), cacheBefore);
+    return budget.check();
+}
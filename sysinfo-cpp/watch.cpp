@@ -0,0 +1,227 @@
+#include "watch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <cwchar>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "history.h"
+#include "sections.h"
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+// How long a wait may go without looking at g_stop.
+const std::chrono::milliseconds kStopPoll(250);
+
+void onStopSignal(int) {
+    g_stop = 1;
+}
+
+// A key cell as a map key. The type is part of it, as in Value::equals.
+std::string keyText(const Value& v) {
+    std::string text(1, static_cast<char>(v.type));
+    switch (v.type) {
+    case ValueType::String: text.append(v.s.p, v.s.n); break;
+    case ValueType::Int: text += std::to_string(static_cast<long long>(v.i)); break;
+    case ValueType::Uint:
+    case ValueType::Bool: text += std::to_string(static_cast<unsigned long long>(v.asUint())); break;
+    default: break;
+    }
+    return text;
+}
+
+typedef std::unordered_map<std::string, size_t> RowIndex;
+
+// Row of each key in `rs`; the first one wins for repeated keys.
+void indexRows(const ResultSet& rs, int keyCol, RowIndex& index) {
+    index.clear();
+    index.reserve(rs.rowCount());
+    for (size_t r = 0; r < rs.rowCount(); ++r) index.insert(std::make_pair(keyText(rs.at(r, keyCol)), r));
+}
+
+long findRow(const RowIndex& index, const Value& key) {
+    RowIndex::const_iterator it = index.find(keyText(key));
+    return it == index.end() ? -1 : static_cast<long>(it->second);
+}
+
+// Prints what changed in one watch between two ticks. Both results come
+// from the same query, so their columns line up. Keyed rows are matched
+// through an index of each side, so a tick stays linear in the rows.
+// Single-row queries print only changed fields: their row coming and
+// going just means the query failed on one side.
+void printChanges(const WatchDef& w, const ResultSet& prev, const ResultSet& cur, const std::wstring& stamp,
+                  std::wostream& out) {
+    const int keyCol = w.key ? cur.column(w.key) : -1;
+    const bool sameShape = prev.columnCount() == cur.columnCount();
+    RowIndex prevRows, curRows;
+    if (keyCol >= 0 && sameShape) {
+        indexRows(prev, keyCol, prevRows);
+        indexRows(cur, keyCol, curRows);
+    }
+    for (size_t r = 0; r < cur.rowCount(); ++r) {
+        long old = -1;
+        if (keyCol < 0) {
+            old = r < prev.rowCount() ? static_cast<long>(r) : -1;
+        } else if (sameShape) {
+            old = findRow(prevRows, cur.at(r, keyCol));
+        }
+        if (old < 0) {
+            if (keyCol >= 0) out << L"[" << stamp << L"] " << w.id << L" + " << safeGet(cur, r, keyCol) << L"\n";
+            continue;
+        }
+        for (size_t c = 0; c < cur.columnCount(); ++c) {
+            const int col = static_cast<int>(c);
+            if (col == keyCol || cur.at(r, col).equals(prev.at(old, col))) continue;
+            out << L"[" << stamp << L"] " << w.id;
+            if (keyCol >= 0) out << L" " << safeGet(cur, r, keyCol);
+            out << L" " << utf8ToWide(cur.columnName(col).data(), cur.columnName(col).size()) << L" "
+                << safeGet(prev, old, col) << L" -> " << safeGet(cur, r, col) << L"\n";
+        }
+    }
+    if (keyCol < 0) return;
+    for (size_t r = 0; r < prev.rowCount(); ++r) {
+        if (!sameShape || findRow(curRows, prev.at(r, keyCol)) < 0) {
+            out << L"[" << stamp << L"] " << w.id << L" - " << safeGet(prev, r, keyCol) << L"\n";
+        }
+    }
+}
+
+// Integer view of a cell; strings count only if they are all digits.
+bool numericCell(const Value& v, uint64_t& n) {
+    switch (v.type) {
+    case ValueType::Int:
+    case ValueType::Uint:
+    case ValueType::Bool: n = v.asUint(); return true;
+    case ValueType::String:
+        for (uint32_t k = 0; k < v.s.n; ++k) {
+            if (v.s.p[k] < '0' || v.s.p[k] > '9') return false;
+        }
+        n = v.asUint();
+        return v.s.n != 0;
+    default: return false;
+    }
+}
+
+// Adds the numeric cells of one watch's result to a history tick.
+void addPoints(const WatchDef& w, const ResultSet& rs, std::vector<HistoryPoint>& points) {
+    const int keyCol = w.key ? rs.column(w.key) : -1;
+    for (size_t r = 0; r < rs.rowCount(); ++r) {
+        std::string prefix = w.id;
+        if (keyCol >= 0) {
+            const Value& key = rs.at(r, keyCol);
+            uint64_t n;
+            if (key.type == ValueType::String) prefix += "/" + std::string(key.s.p, key.s.n);
+            else if (numericCell(key, n)) prefix += "/" + std::to_string(n);
+            else continue;
+        }
+        for (size_t c = 0; c < rs.columnCount(); ++c) {
+            const int col = static_cast<int>(c);
+            HistoryPoint point;
+            if (col == keyCol || !numericCell(rs.at(r, col), point.value)) continue;
+            point.series = prefix + "/" + rs.columnName(col);
+            points.push_back(std::move(point));
+        }
+    }
+}
+
+int64_t unixMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::wstring localTimestamp() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+    wchar_t buf[32];
+    size_t n = std::wcsftime(buf, sizeof(buf) / sizeof(buf[0]), L"%Y-%m-%d %H:%M:%S", &tm);
+    return std::wstring(buf, n);
+}
+
+} // namespace
+
+const std::vector<WatchDef>& volatileWatches() {
+    static const std::vector<WatchDef> watches = {
+        { "memory", L"SELECT FreePhysicalMemory FROM Win32_OperatingSystem", nullptr },
+        { "disk", L"SELECT DeviceID, FreeSpace FROM Win32_LogicalDisk WHERE DriveType=3", "DeviceID" },
+        { "network", L"SELECT Name, NetConnectionStatus, NetEnabled FROM Win32_NetworkAdapter WHERE PhysicalAdapter=True", "Name" },
+        // Presence only: select nothing but the key.
+        { "drive", L"SELECT PNPDeviceID FROM Win32_DiskDrive", "PNPDeviceID" },
+        { "usb", L"SELECT PNPDeviceID FROM Win32_PnPEntity WHERE PNPClass = 'USB' OR Service = 'USBSTOR' OR Name LIKE '%USB Mass Storage%' OR Name LIKE '%USB Composite Device%'", "PNPDeviceID" },
+    };
+    return watches;
+}
+
+void runWatch(DataSource& src, const std::vector<WatchDef>& watches, std::chrono::milliseconds interval,
+              bool timing, HistoryWriter* history, std::wostream& out) {
+    g_stop = 0;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    src.threadAttach();
+    std::vector<std::wstring> queries;
+    // Shared rows: the device table hands out its own, unchanged between
+    // events, which need no comparing.
+    std::vector<std::shared_ptr<const ResultSet> > prev;
+    for (size_t k = 0; k < watches.size(); ++k) {
+        queries.push_back(watches[k].wql);
+        prev.push_back(src.queryShared(queries[k], QueryBudget()));
+    }
+    std::vector<HistoryPoint> points;
+    if (history) {
+        for (size_t k = 0; k < watches.size(); ++k) {
+            if (!prev[k]->partial()) addPoints(watches[k], *prev[k], points);
+        }
+        history->append(unixMillis(), points);
+    }
+
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + interval;
+    while (!g_stop) {
+        // Short slices, so a signal stops the loop without sitting out the
+        // rest of a long interval.
+        while (!g_stop && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(kStopPoll, next - std::chrono::steady_clock::now()));
+        }
+        next += interval;
+        if (g_stop) break;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const std::wstring stamp = localTimestamp();
+        // A tick may take at most one interval; a query cut short keeps
+        // its previous rows rather than reporting devices as gone.
+        const QueryBudget budget(start + interval, nullptr);
+        const int64_t now = unixMillis();
+        points.clear();
+        for (size_t k = 0; k < watches.size(); ++k) {
+            std::shared_ptr<const ResultSet> cur = src.queryShared(queries[k], budget);
+            if (cur->partial()) continue;
+            if (cur != prev[k]) printChanges(watches[k], *prev[k], *cur, stamp, out);
+            if (history) addPoints(watches[k], *cur, points);
+            prev[k] = cur;
+        }
+        if (history) history->append(now, points);
+        out.flush();
+        // A tick slower than the interval (e.g. a stalled WMI provider)
+        // delays the schedule instead of firing back-to-back catch-ups.
+        if (next < std::chrono::steady_clock::now()) next = std::chrono::steady_clock::now() + interval;
+        if (timing) {
+            long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+            std::wcerr << L"Tick took " << us << L" us" << std::endl;
+        }
+    }
+    src.threadDetach();
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+}
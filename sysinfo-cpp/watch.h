@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+#include "datasource.h"
+
+class HistoryWriter;
+
+// A volatile property group re-queried on every --watch tick. Rows are
+// matched across ticks by the `key` column (nullptr: a single-row query);
+// the other selected columns are compared and reported when they change.
+// A query that selects only the key column tracks device presence.
+struct WatchDef {
+    const char* id;
+    const wchar_t* wql;
+    const char* key;
+};
+
+// Free memory, drive free space, adapter link state and USB/disk presence.
+// Static hardware (CPU, BIOS, board, ...) is never re-queried.
+const std::vector<WatchDef>& volatileWatches();
+
+// Queries every watch once as the baseline, then once per `interval`,
+// printing only the fields that changed since the previous tick:
+//   [2024-05-01 12:00:05] memory FreePhysicalMemory 8012345 -> 7998000
+//   [2024-05-01 12:00:05] disk C: FreeSpace 1000 -> 900
+//   [2024-05-01 12:00:05] usb + USB\VID_046D&PID_C52B\5&2A3B
+// Runs on the calling thread until SIGINT/SIGTERM. Each tick's queries
+// share a budget of one interval. With `timing`, the cost of each tick goes
+// to stderr. With a `history`, every numeric non-key cell of every tick,
+// the baseline included, is recorded as series "disk/C:/FreeSpace" (keyed
+// watches) or "memory/FreePhysicalMemory".
+void runWatch(DataSource& src, const std::vector<WatchDef>& watches, std::chrono::milliseconds interval,
+              bool timing, HistoryWriter* history, std::wostream& out);
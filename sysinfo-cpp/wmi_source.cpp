@@ -0,0 +1,398 @@
+#define NOMINMAX
+#include <windows.h>
+#include <comdef.h> // For _bstr_t
+#include <Wbemidl.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cwchar>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "wmi_source.h"
+#include "enumerate.h"
+#include "processes.h"
+#include "profile.h"
+#include "topology.h"
+
+#pragma comment(lib, "wbemuuid.lib")
+
+WmiSource::WmiSource() : m_pLoc(NULL), m_pSvc(NULL), m_comInitialized(false), m_batch(kDefaultEnumBatch) {}
+
+WmiSource::~WmiSource() {
+    uninitialize();
+}
+
+bool WmiSource::initialize() {
+    HRESULT hres;
+
+    hres = CoInitializeEx(0, COINIT_MULTITHREADED);
+    if (FAILED(hres)) {
+        std::wcerr << L"Failed to initialize COM library. Error code = 0x" << std::hex << hres << std::endl;
+        return false;
+    }
+    m_comInitialized = true;
+
+    hres = CoInitializeSecurity(
+        NULL,
+        -1,                          // COM authentication
+        NULL,                        // Authentication services
+        NULL,                        // Reserved
+        RPC_C_AUTHN_LEVEL_DEFAULT,   // Default authentication
+        RPC_C_IMP_LEVEL_IMPERSONATE, // Default Impersonation
+        NULL,                        // Authentication info
+        EOAC_NONE,                   // Additional capabilities
+        NULL                         // Reserved
+    );
+    if (FAILED(hres)) {
+        std::wcerr << L"Failed to initialize security. Error code = 0x" << std::hex << hres << std::endl;
+        uninitialize();
+        return false;
+    }
+
+    hres = CoCreateInstance(
+        CLSID_WbemLocator,
+        0,
+        CLSCTX_INPROC_SERVER,
+        IID_IWbemLocator, (LPVOID *)&m_pLoc);
+    if (FAILED(hres)) {
+        std::wcerr << L"Failed to create IWbemLocator object. Error code = 0x" << std::hex << hres << std::endl;
+        m_pLoc = NULL;
+        uninitialize();
+        return false;
+    }
+
+    hres = m_pLoc->ConnectServer(
+        _bstr_t(L"ROOT\\CIMV2"), // Object path of WMI namespace
+        NULL,                    // User name. NULL = current user
+        NULL,                    // User password. NULL = current
+        0,                       // Locale. NULL indicates current
+        NULL,                    // Security flags.
+        0,                       // Authority (e.g. Kerberos)
+        0,                       // Context object
+        &m_pSvc                  // pointer to IWbemServices proxy
+    );
+    if (FAILED(hres)) {
+        std::wcerr << L"Could not connect to WMI namespace ROOT\\CIMV2. Error code = 0x" << std::hex << hres << std::endl;
+        m_pSvc = NULL;
+        uninitialize();
+        return false;
+    }
+
+    hres = CoSetProxyBlanket(
+        m_pSvc,                      // Indicates the proxy to set
+        RPC_C_AUTHN_WINNT,           // RPC_C_AUTHN_xxx
+        RPC_C_AUTHZ_NONE,            // RPC_C_AUTHZ_xxx
+        NULL,                        // Server principal name
+        RPC_C_AUTHN_LEVEL_CALL,      // RPC_C_AUTHN_LEVEL_xxx
+        RPC_C_IMP_LEVEL_IMPERSONATE, // RPC_C_IMP_LEVEL_xxx
+        NULL,                        // client identity
+        EOAC_NONE                    // proxy capabilities
+    );
+    if (FAILED(hres)) {
+        std::wcerr << L"Could not set proxy blanket. Error code = 0x" << std::hex << hres << std::endl;
+        uninitialize();
+        return false;
+    }
+    return true;
+}
+
+void WmiSource::uninitialize() {
+    if (m_pSvc) {
+        m_pSvc->Release();
+        m_pSvc = NULL;
+    }
+    if (m_pLoc) {
+        m_pLoc->Release();
+        m_pLoc = NULL;
+    }
+    if (m_comInitialized) {
+        CoUninitialize();
+        m_comInitialized = false;
+    }
+}
+
+void WmiSource::threadAttach() {
+    // The proxy lives in the MTA; every worker has to join it before use.
+    CoInitializeEx(0, COINIT_MULTITHREADED);
+}
+
+void WmiSource::threadDetach() {
+    CoUninitialize();
+}
+
+namespace {
+
+// WMI delivers CIM uint64/sint64 as BSTRs; parse them once at ingest so
+// renderers never go string -> number again.
+bool parseWideInt(const wchar_t* s, size_t n, bool isSigned, ResultSet& rs, int col) {
+    bool negative = false;
+    size_t k = 0;
+    if (isSigned && n && s[0] == L'-') {
+        negative = true;
+        k = 1;
+    }
+    if (k == n) return false;
+    uint64_t v = 0;
+    for (; k < n; ++k) {
+        unsigned d = static_cast<unsigned>(s[k] - L'0');
+        if (d > 9 || v > (UINT64_MAX - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    if (isSigned) {
+        rs.setInt(col, negative ? -static_cast<int64_t>(v) : static_cast<int64_t>(v));
+    } else {
+        rs.setUint(col, v);
+    }
+    return true;
+}
+
+void storeVariant(ResultSet& rs, int col, const VARIANT& v, CIMTYPE cimType) {
+    switch (v.vt) {
+    case VT_BSTR: {
+        const wchar_t* s = v.bstrVal ? v.bstrVal : L"";
+        size_t n = v.bstrVal ? SysStringLen(v.bstrVal) : 0;
+        if ((cimType == CIM_UINT64 || cimType == CIM_SINT64) && parseWideInt(s, n, cimType == CIM_SINT64, rs, col)) break;
+        rs.setWide(col, s, n);
+        break;
+    }
+    // Unsigned CIM types narrower than 64 bits still arrive in signed variants.
+    case VT_I1: rs.setInt(col, v.cVal); break;
+    case VT_UI1: rs.setUint(col, v.bVal); break;
+    case VT_I2: rs.setInt(col, v.iVal); break;
+    case VT_UI2: rs.setUint(col, v.uiVal); break;
+    case VT_I4:
+        if (cimType == CIM_UINT32 || cimType == CIM_UINT16) {
+            rs.setUint(col, static_cast<uint32_t>(v.lVal));
+        } else {
+            rs.setInt(col, v.lVal);
+        }
+        break;
+    case VT_UI4: rs.setUint(col, v.ulVal); break;
+    case VT_I8: rs.setInt(col, v.llVal); break;
+    case VT_UI8: rs.setUint(col, v.ullVal); break;
+    case VT_BOOL: rs.setBool(col, v.boolVal == VARIANT_TRUE); break;
+    default:
+        // VT_NULL/VT_EMPTY stay NULL; arrays, reals and embedded objects
+        // are not used by any section.
+        break;
+    }
+}
+
+// IEnumWbemClassObject::Next behind the ObjectEnumerator interface. The
+// objects of the last step stay valid in object(k) until the next call.
+class WbemEnumerator : public ObjectEnumerator {
+public:
+    explicit WbemEnumerator(IEnumWbemClassObject* e) : m_enum(e), m_count(0) {}
+    ~WbemEnumerator() { release(); }
+
+    EnumStep next(std::chrono::milliseconds timeout, size_t count) {
+        release();
+        m_objects.resize(count);
+        ULONG returned = 0;
+        HRESULT hr = m_enum->Next(static_cast<long>(timeout.count()), static_cast<ULONG>(count), &m_objects[0], &returned);
+        m_count = returned;
+        // S_OK: a full batch. WBEM_S_TIMEDOUT: a short one, more may come.
+        // WBEM_S_FALSE: a short one at the end of the results.
+        EnumStep step = { m_count, FAILED(hr) || hr == WBEM_S_FALSE };
+        return step;
+    }
+
+    IWbemClassObject* object(size_t k) const { return m_objects[k]; }
+
+private:
+    void release() {
+        for (size_t k = 0; k < m_count; ++k) m_objects[k]->Release();
+        m_count = 0;
+    }
+
+    IEnumWbemClassObject* m_enum;
+    std::vector<IWbemClassObject*> m_objects;
+    size_t m_count;
+};
+
+std::string narrowName(const wchar_t* s, size_t n) {
+    std::string out(n, '\0');
+    for (size_t k = 0; k < n; ++k) out[k] = static_cast<char>(s[k]); // property names are ASCII
+    return out;
+}
+
+} // namespace
+
+// General WMI multi-row query. Property names are interned once per query
+// (from the SELECT list) and fetched by name, instead of a GetNames call
+// and a map of strings per object.
+ResultSet WmiSource::query(const std::wstring& wql, const QueryBudget& budget) {
+    ResultSet results;
+    query(wql, budget, results);
+    return results;
+}
+
+void WmiSource::query(const std::wstring& wql, const QueryBudget& budget, ResultSet& results) {
+    results.clear();
+    // Win32_Process through WMI takes seconds on a busy host; one native
+    // snapshot answers it with the same columns.
+    const std::wstring cls = wqlClassName(wql);
+    if (cls == L"Win32_Process") {
+        results = queryProcesses(wql, std::string(), budget);
+        return;
+    }
+    // Topology has no WMI class; Win32_Processor only has per-package totals.
+    if (cls.compare(0, 8, L"Sysinfo_") == 0) {
+        results = queryCpuTopology(wql, budget);
+        return;
+    }
+
+    if (!m_pSvc) {
+        std::wcerr << L"WMI Service not initialized." << std::endl;
+        return;
+    }
+
+    std::vector<std::wstring> names = wqlColumns(wql);
+    for (size_t c = 0; c < names.size(); ++c) {
+        results.addColumn(narrowName(names[c].data(), names[c].size()));
+    }
+
+    HRESULT hres;
+    IEnumWbemClassObject* pEnumerator = NULL;
+
+    hres = m_pSvc->ExecQuery(
+        bstr_t(L"WQL"),
+        bstr_t(wql.c_str()),
+        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+        NULL,
+        &pEnumerator
+    );
+
+    if (FAILED(hres)) {
+        return;
+    }
+
+    // Fetch in batches with a bounded wait, so one slow provider can't
+    // hold a worker past the budget.
+    WbemEnumerator objects(pEnumerator);
+    QueryStatus status = enumerateBatched(objects, m_batch, budget, [&](size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            IWbemClassObject* pclsObj = objects.object(k);
+            if (names.empty()) {
+                // "SELECT *": take the property names from the first object.
+                SAFEARRAY* pNames = NULL;
+                if (SUCCEEDED(pclsObj->GetNames(NULL, WBEM_FLAG_ALWAYS | WBEM_FLAG_NONSYSTEM_ONLY, NULL, &pNames)) && pNames != NULL) {
+                    LONG lLBound, lUBound;
+                    SafeArrayGetLBound(pNames, 1, &lLBound);
+                    SafeArrayGetUBound(pNames, 1, &lUBound);
+                    for (LONG i = lLBound; i <= lUBound; ++i) {
+                        BSTR bstrName = NULL;
+                        if (SUCCEEDED(SafeArrayGetElement(pNames, &i, &bstrName)) && bstrName != NULL) {
+                            names.push_back(std::wstring(bstrName, SysStringLen(bstrName)));
+                            results.addColumn(narrowName(bstrName, SysStringLen(bstrName)));
+                            SysFreeString(bstrName); // Free bstrName allocated by SafeArrayGetElement
+                        }
+                    }
+                    SafeArrayDestroy(pNames); // pNames was allocated by GetNames
+                }
+            }
+
+            if (!results.rowCount()) profileFirstRow();
+            results.addRow();
+            for (size_t c = 0; c < names.size(); ++c) {
+                VARIANT vtProp;
+                VariantInit(&vtProp); // Initialize variant
+                CIMTYPE cimType = CIM_EMPTY;
+
+                HRESULT hrGet = pclsObj->Get(names[c].c_str(), 0, &vtProp, &cimType, 0);
+                if (SUCCEEDED(hrGet)) {
+                    storeVariant(results, static_cast<int>(c), vtProp, cimType);
+                } else {
+                    results.setString(static_cast<int>(c), "[Error Getting Value]", 21);
+                }
+                VariantClear(&vtProp);
+            }
+        }
+    });
+    results.setStatus(status);
+
+    pEnumerator->Release();
+}
+
+namespace {
+
+// Where the WHERE keyword of a statement starts, outside string literals;
+// npos if there is none.
+size_t wherePosition(const std::wstring& wql) {
+    bool quoted = false;
+    for (size_t i = 0; i + 5 <= wql.size(); ++i) {
+        if (wql[i] == L'\'') quoted = !quoted;
+        if (quoted || (i && !iswspace(wql[i - 1])) || _wcsnicmp(wql.c_str() + i, L"WHERE", 5) != 0) continue;
+        if (i + 5 == wql.size() || iswspace(wql[i + 5])) return i;
+    }
+    return std::wstring::npos;
+}
+
+// A WQL string literal: backslashes and quotes are escaped.
+std::wstring wqlString(const std::string& s) {
+    std::wstring out = L"'";
+    for (size_t k = 0; k < s.size(); ++k) {
+        if (s[k] == '\\' || s[k] == '\'') out += L'\\';
+        out += static_cast<wchar_t>(static_cast<unsigned char>(s[k]));
+    }
+    out += L"'";
+    return out;
+}
+
+// Instance IDs compare without case; the listener's come from interface
+// paths, which are often lower case.
+std::string instanceId(const Value& v) {
+    std::string out;
+    if (v.type != ValueType::String) return out;
+    out.assign(v.s.p, v.s.n);
+    for (size_t k = 0; k < out.size(); ++k) out[k] = static_cast<char>(std::toupper(static_cast<unsigned char>(out[k])));
+    return out;
+}
+
+} // namespace
+
+// A lookup is the class's own query with one more condition: the device's
+// PNPDeviceID, or for a link change the adapter's InterfaceIndex.
+bool WmiSource::queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget,
+                             ResultSet& rows, std::vector<std::string>& paths) {
+    const std::wstring cls = wqlClassName(wql);
+    if (cls != L"Win32_PnPEntity" && cls != L"Win32_SoundDevice" && cls != L"Win32_NetworkAdapter" &&
+        cls != L"Win32_DiskDrive") {
+        return false;
+    }
+    // Fetch the PNPDeviceID too if the query doesn't select it.
+    const std::vector<std::wstring> cols = wqlColumns(wql);
+    bool selected = cols.empty();
+    for (size_t c = 0; c < cols.size() && !selected; ++c) selected = _wcsicmp(cols[c].c_str(), L"PNPDeviceID") == 0;
+    std::wstring text = wql;
+    if (!selected) {
+        std::vector<std::wstring> withId(cols);
+        withId.push_back(L"PNPDeviceID");
+        text = wqlWithColumns(wql, withId);
+    }
+    if (!path.empty()) {
+        const bool index = path.find_first_not_of("0123456789") == std::string::npos;
+        const std::wstring cond =
+            index ? L"InterfaceIndex=" + std::wstring(path.begin(), path.end()) : L"PNPDeviceID=" + wqlString(path);
+        const size_t where = wherePosition(text);
+        if (where == std::wstring::npos) text += L" WHERE " + cond;
+        else text = text.substr(0, where) + L"WHERE (" + text.substr(where + 5) + L") AND " + cond;
+    }
+
+    ResultSet found = query(text, budget);
+    const int idCol = found.column("PNPDeviceID");
+    for (size_t r = 0; r < found.rowCount(); ++r) paths.push_back(instanceId(found.at(r, idCol)));
+    if (selected) {
+        rows = std::move(found);
+        return true;
+    }
+    for (size_t c = 0; c < cols.size(); ++c) rows.addColumn(found.columnName(static_cast<int>(c)));
+    for (size_t r = 0; r < found.rowCount(); ++r) {
+        rows.addRow();
+        for (size_t c = 0; c < cols.size(); ++c) rows.setValue(static_cast<int>(c), found.at(r, static_cast<int>(c)));
+    }
+    rows.setStatus(found.status());
+    return true;
+}
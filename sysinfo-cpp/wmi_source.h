@@ -0,0 +1,36 @@
+#pragma once
+#include "datasource.h"
+
+struct IWbemLocator;
+struct IWbemServices;
+
+// Live data from ROOT\CIMV2. COM is initialised as MTA, so the services
+// proxy can be shared by every collector worker thread.
+class WmiSource : public DataSource {
+public:
+    WmiSource();
+    ~WmiSource();
+
+    // Connects to WMI; false (with a message on stderr) on failure.
+    bool initialize();
+
+    using DataSource::query;
+    ResultSet query(const std::wstring& wql, const QueryBudget& budget);
+    void query(const std::wstring& wql, const QueryBudget& budget, ResultSet& into);
+    // Devices are named by their instance ID (PNPDeviceID), network
+    // adapters also by interface index.
+    bool queryDevices(const std::wstring& wql, const std::string& path, const QueryBudget& budget, ResultSet& rows,
+                      std::vector<std::string>& paths);
+    void threadAttach();
+    void threadDetach();
+    // Objects fetched per IEnumWbemClassObject::Next call.
+    void setBatchSize(size_t objects) { m_batch = objects; }
+
+private:
+    void uninitialize();
+
+    IWbemLocator* m_pLoc;
+    IWbemServices* m_pSvc;
+    bool m_comInitialized;
+    size_t m_batch;
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+// CPUID and XGETBV, where the architecture has them: SYSINFO_X86 is
+// defined on x86 and x86-64 builds only.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SYSINFO_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// EAX, EBX, ECX, EDX of leaf `leaf`, subleaf `sub`. Leaves above the
+// highest supported one (leaf 0 EAX) return garbage; check first.
+inline void cpuid(unsigned leaf, unsigned sub, unsigned (&r)[4]) {
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuidex(regs, static_cast<int>(leaf), static_cast<int>(sub));
+    for (int k = 0; k < 4; ++k) r[k] = static_cast<unsigned>(regs[k]);
+#else
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+#endif
+}
+
+// Which register states the OS saves on a context switch (XCR0). Only
+// valid when CPUID leaf 1 reports OSXSAVE (ECX bit 27).
+inline uint64_t enabledXsaveFeatures() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+#endif